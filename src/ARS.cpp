@@ -46,20 +46,46 @@ void ARS::CalibrateParams() {
 
   float objScore;
   float scoreDiff = 0;
+  std::vector<float> batchParams(CALI_SET_BATCH * numParams);
+  float *batchSets[CALI_SET_BATCH];
+  float batchScores[CALI_SET_BATCH];
+  int batchSize = 0, batchIndex = 0;
+  for (int b = 0; b < CALI_SET_BATCH; b++) {
+    batchSets[b] = &(batchParams[b * numParams]);
+  }
 
   while (goodSets < burnInSets || scoreDiff > convergenceCriteria) {
 
-    // Generate new parameters
-    for (int i = 0; i < numParams; i++) {
+    if (batchIndex == batchSize) {
+      // Each set adds at most one good set, so while burnInSets - goodSets
+      // sets remain the burn in cannot end and the ranges stay fixed. That
+      // many sets are drawn in the usual order and simulated together, after
+      // the burn in every set is drawn from the ranges its predecessor left.
+      batchSize = burnInSets - goodSets;
+      batchSize = (batchSize > CALI_SET_BATCH) ? CALI_SET_BATCH : batchSize;
+      batchSize = (batchSize < 1) ? 1 : batchSize;
+      for (int b = 0; b < batchSize; b++) {
+        for (int i = 0; i < numParams; i++) {
 #ifdef WIN32
-      float randVal = ((float)rand()) / RAND_MAX;
+          float randVal = ((float)rand()) / RAND_MAX;
 #else
-      float randVal = drand48(); //((float)rand()) / RAND_MAX;
+          float randVal = drand48(); //((float)rand()) / RAND_MAX;
 #endif
-      currentParams[i] = minParams[i] + (maxParams[i] - minParams[i]) * randVal;
+          batchSets[b][i] =
+              minParams[i] + (maxParams[i] - minParams[i]) * randVal;
+        }
+      }
+      if (batchSize > 1) {
+        sim->SimulateForCaliSets(batchSize, batchSets, batchScores);
+      } else {
+        batchScores[0] = sim->SimulateForCali(batchSets[0]);
+      }
+      batchIndex = 0;
     }
 
-    objScore = sim->SimulateForCali(currentParams);
+    memcpy(currentParams, batchSets[batchIndex], sizeof(float) * numParams);
+    objScore = batchScores[batchIndex];
+    batchIndex++;
     // printf("%f\n", objScore);
 
     totalSets++;
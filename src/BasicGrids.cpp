@@ -13,6 +13,9 @@
 #include <map>
 #include <stack>
 #include <stdlib.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 FloatGrid *g_DEM;
 FloatGrid *g_DDM;
@@ -28,13 +31,13 @@ struct FAMSearch {
 
 // static FAMSearch *NextUnusedGrid(std::vector<FAMSearch *> *gridCells);
 static bool GetDownstreamHeight(long x, long y, long *outsideHeight);
-static bool TestUpstream(GridNode *node, FLOW_DIR dir, GridLoc *loc);
+static bool TestUpstream(GridCell *cell, FLOW_DIR dir, GridLoc *loc);
 static bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc);
 // static bool TestUpstreamBroken(long nextX, long nextY, FLOW_DIR dir, GridLoc
 // *loc);
 static GaugeConfigSection *
 FindGauge(std::map<unsigned long, GaugeConfigSection *> *gauges,
-          GridNode *node);
+          GridCell *cell);
 static GaugeConfigSection *
 NextUnusedGauge(std::vector<GaugeConfigSection *> *gauges);
 static bool SortByFlowAccumFS(FAMSearch *fs1, FAMSearch *fs2);
@@ -43,7 +46,8 @@ static void FixFAM();
 static int FlowsOut(long nextX, long nextY, FLOW_DIR dir, long currentHeight);
 static int FlowsIn(long nextX, long nextY, FLOW_DIR dir, long currentHeight,
                    GridLoc *locIn, long maxSearch, GridLoc *locOut);
-static void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes);
+static void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes,
+                       std::vector<GridCell> *cells);
 /*FLOW_DIR reverseDir[] = {
   FLOW_SOUTH,
   FLOW_SOUTHWEST,
@@ -367,9 +371,10 @@ void ClipBasicGrids(long x, long y, long search, const char *output) {
 }
 
 void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
-                    const char *name, const char *output) {
+                    std::vector<GridCell> *cells, const char *name,
+                    const char *output) {
 
-  FixFlowDir(basin, nodes);
+  FixFlowDir(basin, nodes, cells);
 
   std::vector<GaugeConfigSection *> *gauges = basin->GetGauges();
 
@@ -378,23 +383,22 @@ void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
   long maxY = 0;
   long minY = LONG_MAX;
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    if (!node->gauge) {
+  for (size_t i = 0; i < nodes->size(); i++) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    if (node->x > maxX) {
-      maxX = node->x;
+    GridCell *cell = &(cells->at(i));
+    if (cell->x > maxX) {
+      maxX = cell->x;
     }
-    if (node->x < minX) {
-      minX = node->x;
+    if (cell->x < minX) {
+      minX = cell->x;
     }
-    if (node->y > maxY) {
-      maxY = node->y;
+    if (cell->y > maxY) {
+      maxY = cell->y;
     }
-    if (node->y < minY) {
-      minY = node->y;
+    if (cell->y < minY) {
+      minY = cell->y;
     }
   }
 
@@ -436,21 +440,21 @@ void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
     }
   }
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
+  for (size_t i = 0; i < nodes->size(); i++) {
+    GridNode *node = &(nodes->at(i));
     if (!node->gauge) {
       continue;
     }
-    for (size_t i = 0; i < gauges->size(); i++) {
-      GaugeConfigSection *gauge = gauges->at(i);
+    GridCell *cell = &(cells->at(i));
+    for (size_t g = 0; g < gauges->size(); g++) {
+      GaugeConfigSection *gauge = gauges->at(g);
       if (gauge->GetGridNodeIndex() == (long)node->index) {
         printf("[gauge %s] cellx=%li celly=%li\n", gauge->GetName(),
-               node->x - minX, node->y - minY);
+               cell->x - minX, cell->y - minY);
         break;
       }
     }
-    grid.data[node->y - minY][node->x - minX] = g_DEM->data[node->y][node->x];
+    grid.data[cell->y - minY][cell->x - minX] = g_DEM->data[cell->y][cell->x];
   }
 
   char buffer[255];
@@ -458,26 +462,24 @@ void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
           name);
   WriteFloatTifGrid(buffer, &grid);
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    if (!node->gauge) {
+  for (size_t i = 0; i < nodes->size(); i++) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y - minY][node->x - minX] = g_DDM->data[node->y][node->x];
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y - minY][cell->x - minX] = g_DDM->data[cell->y][cell->x];
   }
 
   sprintf(buffer, "%s/%s.%s", output, strrchr(g_basicConfig->GetDDM(), '/'),
           name);
   WriteFloatTifGrid(buffer, &grid);
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    if (!node->gauge) {
+  for (size_t i = 0; i < nodes->size(); i++) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y - minY][node->x - minX] = g_FAM->data[node->y][node->x];
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y - minY][cell->x - minX] = g_FAM->data[cell->y][cell->x];
   }
 
   sprintf(buffer, "%s/%s.%s", output, strrchr(g_basicConfig->GetFAM(), '/'),
@@ -485,7 +487,8 @@ void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
   WriteFloatTifGrid(buffer, &grid);
 }
 
-void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
+void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes,
+                std::vector<GridCell> *cells) {
   std::vector<GaugeConfigSection *> *gauges = basin->GetGauges();
   GaugeConfigSection *gauge = gauges->at(0);
   int maxDist = 20000.0 / g_Projection->GetLen(gauge->GetLon(), gauge->GetLat(),
@@ -494,29 +497,29 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
     maxDist = 2;
   }
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
+  for (size_t i = 0; i < nodes->size(); i++) {
+    GridNode *node = &(nodes->at(i));
     if (node->downStreamNode == INVALID_DOWNSTREAM_NODE) {
       continue;
     }
-    GridNode *dsNode = &(nodes->at(node->downStreamNode));
-    if (g_DEM->data[node->y][node->x] != g_DEM->data[dsNode->y][dsNode->x]) {
+    GridCell *cell = &(cells->at(i));
+    GridCell *dsCell = &(cells->at(node->downStreamNode));
+    if (g_DEM->data[cell->y][cell->x] != g_DEM->data[dsCell->y][dsCell->x]) {
       continue;
     }
-    long maxFlow = g_FAM->data[dsNode->y][dsNode->x] * 10000; // maxDist;
-    FLOW_DIR flowDir = (FLOW_DIR)g_DDM->data[node->y][node->x];
+    long maxFlow = g_FAM->data[dsCell->y][dsCell->x] * 10000; // maxDist;
+    FLOW_DIR flowDir = (FLOW_DIR)g_DDM->data[cell->y][cell->x];
     long testX, testY;
     float minDist = powf(maxDist, 2.0) + powf(maxDist, 2.0);
     for (int dist = 1; dist < maxDist; dist++) {
-      testX = node->x + 1 * dist;
-      testY = node->y;
+      testX = cell->x + 1 * dist;
+      testY = cell->y;
       if (testX < g_FAM->numCols &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -524,14 +527,14 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x + 1 * dist;
-      testY = node->y - 1 * dist;
+      testX = cell->x + 1 * dist;
+      testY = cell->y - 1 * dist;
       if (testX < g_FAM->numCols && testY >= 0 &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -539,13 +542,13 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x;
-      testY = node->y - 1 * dist;
+      testX = cell->x;
+      testY = cell->y - 1 * dist;
       if (testY >= 0 && g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -553,14 +556,14 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x - 1 * dist;
-      testY = node->y - 1 * dist;
+      testX = cell->x - 1 * dist;
+      testY = cell->y - 1 * dist;
       if (testX >= 0 && testY >= 0 &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -568,13 +571,13 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x - 1 * dist;
-      testY = node->y;
+      testX = cell->x - 1 * dist;
+      testY = cell->y;
       if (testX >= 0 && g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -582,14 +585,14 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x - 1 * dist;
-      testY = node->y + 1 * dist;
+      testX = cell->x - 1 * dist;
+      testY = cell->y + 1 * dist;
       if (testX >= 0 && testY < g_FAM->numRows &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -597,14 +600,14 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x;
-      testY = node->y + 1 * dist;
+      testX = cell->x;
+      testY = cell->y + 1 * dist;
       if (testY < g_FAM->numRows &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -612,14 +615,14 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
 
-      testX = node->x + 1 * dist;
-      testY = node->y + 1 * dist;
+      testX = cell->x + 1 * dist;
+      testY = cell->y + 1 * dist;
       if (testX < g_FAM->numCols && testY < g_FAM->numRows &&
           g_FAM->data[testY][testX] != g_FAM->noData &&
           g_FAM->data[testY][testX] > maxFlow &&
-          g_DEM->data[node->y][node->x] == g_DEM->data[testY][testX]) {
+          g_DEM->data[cell->y][cell->x] == g_DEM->data[testY][testX]) {
         float thisDist =
-            powf(testY - node->y, 2.0) + powf(testX - node->x, 2.0);
+            powf(testY - cell->y, 2.0) + powf(testX - cell->x, 2.0);
         if (thisDist < minDist) {
           minDist = thisDist;
           maxFlow = g_FAM->data[testY][testX];
@@ -627,16 +630,17 @@ void FixFlowDir(BasinConfigSection *basin, std::vector<GridNode> *nodes) {
         }
       }
     }
-    if (flowDir != g_DDM->data[node->y][node->x]) {
-      printf("Old dir %f, new dir %i\n", g_DDM->data[node->y][node->x],
+    if (flowDir != g_DDM->data[cell->y][cell->x]) {
+      printf("Old dir %f, new dir %i\n", g_DDM->data[cell->y][cell->x],
              flowDir);
-      g_DDM->data[node->y][node->x] = (float)(flowDir);
+      g_DDM->data[cell->y][cell->x] = (float)(flowDir);
     }
   }
 }
 
 void CarveBasin(
     BasinConfigSection *basin, std::vector<GridNode> *nodes,
+    std::vector<GridCell> *cells,
     std::map<GaugeConfigSection *, float *> *inParamSettings,
     std::map<GaugeConfigSection *, float *> *outParamSettings,
     GaugeMap *gaugeMap, float *defaultParams,
@@ -651,11 +655,15 @@ void CarveBasin(
     float *defaultInundationParams) {
 
   std::vector<GaugeConfigSection *> *gauges = basin->GetGauges();
-  std::stack<GridNode *> walkNodes;
+  std::stack<size_t> walkNodes;
   size_t currentNode = 0;
   size_t totalAccum = 0;
   GridLoc nextNode;
 
+  // A task run after another one may carve into the same cells, so the
+  // indexes the readers kept for the last basin no longer hold
+  ForgetSamplingIndexes(cells);
+
   // Figure out where each gauge is at and get the flow accumulation from the
   // grid for it. Also resets the used flag to false
   for (std::vector<GaugeConfigSection *>::iterator itr = gauges->begin();
@@ -927,55 +935,58 @@ void CarveBasin(
       totalAccum += (currentGauge->GetFlowAccum() + 1);
     }
     nodes->resize(totalAccum);
+    cells->resize(totalAccum);
     GridNode *currentN = &(*nodes)[currentNode];
+    GridCell *currentC = &(*cells)[currentNode];
 
     // Setup the initial node for initiating the search for upstream nodes
     currentN->index = currentNode;
     currentNode++;
-    currentN->x = currentGauge->GetGridLoc()->x;
-    currentN->y = currentGauge->GetGridLoc()->y;
-    g_DEM->GetRefLoc(currentN->x, currentN->y, &currentN->refLoc);
-    if (g_DEM->data[currentN->y][currentN->x] == g_DEM->noData ||
-        g_FAM->data[currentN->y][currentN->x] == g_FAM->noData ||
-        g_FAM->data[currentN->y][currentN->x] < 0) {
+    currentC->x = currentGauge->GetGridLoc()->x;
+    currentC->y = currentGauge->GetGridLoc()->y;
+    g_DEM->GetRefLoc(currentC->x, currentC->y, &currentC->refLoc);
+    if (g_DEM->data[currentC->y][currentC->x] == g_DEM->noData ||
+        g_FAM->data[currentC->y][currentC->x] == g_FAM->noData ||
+        g_FAM->data[currentC->y][currentC->x] < 0) {
       ERROR_LOGF("Gauge \"%s\" is located in a no data grid cell!",
                  currentGauge->GetName());
       return;
     }
     currentN->downStreamNode = INVALID_DOWNSTREAM_NODE;
     long outsideHeight = 0;
-    if (GetDownstreamHeight(currentN->x, currentN->y, &outsideHeight)) {
+    if (GetDownstreamHeight(currentC->x, currentC->y, &outsideHeight)) {
       currentN->horLen =
-          g_Projection->GetLen(currentN->refLoc.x, currentN->refLoc.y,
-                               (FLOW_DIR)g_DDM->data[currentN->y][currentN->x]);
-      float DEMDiff = g_DEM->data[currentN->y][currentN->x] - outsideHeight;
+          g_Projection->GetLen(currentC->refLoc.x, currentC->refLoc.y,
+                               (FLOW_DIR)g_DDM->data[currentC->y][currentC->x]);
+      float DEMDiff = g_DEM->data[currentC->y][currentC->x] - outsideHeight;
       currentN->slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / currentN->horLen;
     } else {
       currentN->horLen =
-          g_Projection->GetLen(currentN->refLoc.x, currentN->refLoc.y,
+          g_Projection->GetLen(currentC->refLoc.x, currentC->refLoc.y,
                                FLOW_NORTH); // We assume a horizontal length
                                             // because we know nothing further
       currentN->slope = 1.0 / currentN->horLen; // We assume a difference in
                                                 // height of 1 meter because we
                                                 // know nothing else
     }
-    currentN->area =
-        g_Projection->GetArea(currentN->refLoc.x, currentN->refLoc.y);
-    currentN->contribArea = currentN->area;
-    currentN->fac = g_FAM->data[currentN->y][currentN->x];
-    walkNodes.push(currentN);
+    currentC->area =
+        g_Projection->GetArea(currentC->refLoc.x, currentC->refLoc.y);
+    currentN->contribArea = currentC->area;
+    currentN->fac = g_FAM->data[currentC->y][currentC->x];
+    walkNodes.push(currentN->index);
 
     while (!walkNodes.empty()) {
 
       // Get the next node to check off the stack
-      currentN = walkNodes.top();
+      currentN = &(*nodes)[walkNodes.top()];
+      currentC = &(*cells)[walkNodes.top()];
       walkNodes.pop();
 
       // Store the previous gauge
       GaugeConfigSection *prevGauge = currentN->gauge;
 
       // Is this node actually a gauge?
-      GaugeConfigSection *nodeGauge = FindGauge(&gaugeCMap, currentN);
+      GaugeConfigSection *nodeGauge = FindGauge(&gaugeCMap, currentC);
       bool keepGoing = true;
       if (nodeGauge) {
         nodeGauge->SetGridNodeIndex(currentN->index);
@@ -1043,42 +1054,43 @@ void CarveBasin(
         }
       }
 
-      long currentNDEM = g_DEM->data[currentN->y][currentN->x];
+      long currentNDEM = g_DEM->data[currentC->y][currentC->x];
 
       // Lets figure out what flows into this node
       // We compute slope here too!
       if (keepGoing) {
         for (int i = 1; i < FLOW_QTY; i++) {
-          if (TestUpstream(currentN, (FLOW_DIR)i, &nextNode)) {
+          if (TestUpstream(currentC, (FLOW_DIR)i, &nextNode)) {
             GridNode *nextN = &(*nodes)[currentNode];
+            GridCell *nextC = &(*cells)[currentNode];
             nextN->index = currentNode;
             currentNode++;
-            nextN->x = nextNode.x;
-            nextN->y = nextNode.y;
+            nextC->x = nextNode.x;
+            nextC->y = nextNode.y;
             nextN->downStreamNode = currentN->index;
             nextN->gauge = currentN->gauge;
-            nextN->fac = g_FAM->data[nextN->y][nextN->x];
+            nextN->fac = g_FAM->data[nextC->y][nextC->x];
 
             // Calculate slope!
-            long nextNDEM = g_DEM->data[nextN->y][nextN->x];
+            long nextNDEM = g_DEM->data[nextC->y][nextC->x];
             float DEMDiff =
                 (float)(nextNDEM - currentNDEM); // Upstream (higher elevation)
                                                  // minus downstream (lower
                                                  // elevation)
-            g_DEM->GetRefLoc(nextN->x, nextN->y, &nextN->refLoc);
-            nextN->horLen = g_Projection->GetLen(nextN->refLoc.x,
-                                                 nextN->refLoc.y, (FLOW_DIR)i);
+            g_DEM->GetRefLoc(nextC->x, nextC->y, &nextC->refLoc);
+            nextN->horLen = g_Projection->GetLen(nextC->refLoc.x,
+                                                 nextC->refLoc.y, (FLOW_DIR)i);
             nextN->slope = ((DEMDiff < 1.0) ? 1.0 : DEMDiff) / nextN->horLen;
-            nextN->area =
-                g_Projection->GetArea(nextN->refLoc.x, nextN->refLoc.y);
-            nextN->contribArea = nextN->area;
+            nextC->area =
+                g_Projection->GetArea(nextC->refLoc.x, nextC->refLoc.y);
+            nextN->contribArea = nextC->area;
             // printf("Pushing node %i %i (%i, %i) from %i %i (%i, %i) %i %i\n",
             // nextN->x, nextN->y, g_DDM->data[nextN->y][nextN->x],
             // g_FAM->data[nextN->y][nextN->x], currentN->x, currentN->y,
             // g_DDM->data[currentN->y][currentN->x],
             // g_FAM->data[currentN->y][currentN->x], currentNode,
             // nodes->size());
-            walkNodes.push(nextN);
+            walkNodes.push(nextN->index);
           }
         }
       }
@@ -1090,6 +1102,7 @@ void CarveBasin(
   }
 
   nodes->resize(currentNode);
+  cells->resize(currentNode);
 
   for (long i = nodes->size() - 1; i >= 0; i--) {
     GridNode *node = &nodes->at(i);
@@ -1158,8 +1171,8 @@ bool GetDownstreamHeight(long x, long y, long *outsideHeight) {
   return false;
 }
 
-bool TestUpstream(GridNode *node, FLOW_DIR dir, GridLoc *loc) {
-  return TestUpstream(node->x, node->y, dir, loc);
+bool TestUpstream(GridCell *cell, FLOW_DIR dir, GridLoc *loc) {
+  return TestUpstream(cell->x, cell->y, dir, loc);
 }
 
 bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc) {
@@ -1279,9 +1292,9 @@ bool TestUpstreamBroken(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc) {
 
 GaugeConfigSection *
 FindGauge(std::map<unsigned long, GaugeConfigSection *> *gauges,
-          GridNode *node) {
+          GridCell *cell) {
 
-  unsigned long index = node->y * g_DEM->numCols + node->x;
+  unsigned long index = cell->y * g_DEM->numCols + cell->x;
 
   std::map<unsigned long, GaugeConfigSection *>::iterator itr =
       gauges->find(index);
@@ -1588,15 +1601,15 @@ void MakeBasic() {
       }
       if (!flowsOut && flowsIn) {
         totalSinks++;
-        std::stack<GridNode *> walkNodes;
-        std::vector<GridNode *> sinkNodes;
-        GridNode *currentN = new GridNode;
+        std::stack<FAMSearch *> walkNodes;
+        std::vector<FAMSearch *> sinkNodes;
+        FAMSearch *currentN = new FAMSearch;
         GridLoc locIn, locOut;
         locIn.x = col;
         locIn.y = row;
         currentN->x = col;
         currentN->y = row;
-        currentN->fac = -1;
+        currentN->fa = -1;
         walkNodes.push(currentN);
         while (!walkNodes.empty()) {
           // Get the next node to check off the stack
@@ -1604,16 +1617,16 @@ void MakeBasic() {
           walkNodes.pop();
           sinkNodes.push_back(currentN);
           for (int i = 1; i < FLOW_QTY; i++) {
-            if (i == currentN->fac) {
+            if (i == currentN->fa) {
               continue;
             }
             if (FlowsIn(currentN->x, currentN->y, (FLOW_DIR)i,
                         g_DEM->data[currentN->y][currentN->x], &locIn, 5,
                         &locOut)) {
-              GridNode *newN = new GridNode;
+              FAMSearch *newN = new FAMSearch;
               newN->x = locOut.x;
               newN->y = locOut.y;
-              newN->fac = reverseDir[i];
+              newN->fa = reverseDir[i];
             }
           }
         }
@@ -1631,3 +1644,132 @@ void MakeBasic() {
 
   printf("Total sinks %i", totalSinks);
 }
+
+void FindGridWindow(std::vector<GridCell> *cells, GridWindow *window) {
+  GridCell *cell = &(cells->at(0));
+  window->numCols = g_DEM->numCols;
+  window->numRows = g_DEM->numRows;
+  window->left = window->right = cell->x;
+  window->top = window->bottom = cell->y;
+  window->extent.left = window->extent.right = cell->refLoc.x;
+  window->extent.top = window->extent.bottom = cell->refLoc.y;
+  for (size_t i = 1; i < cells->size(); i++) {
+    cell = &(cells->at(i));
+    window->left = std::min(window->left, (long)cell->x);
+    window->right = std::max(window->right, (long)cell->x);
+    window->top = std::min(window->top, (long)cell->y);
+    window->bottom = std::max(window->bottom, (long)cell->y);
+    window->extent.left = std::min(window->extent.left, (double)cell->refLoc.x);
+    window->extent.right =
+        std::max(window->extent.right, (double)cell->refLoc.x);
+    window->extent.top = std::max(window->extent.top, (double)cell->refLoc.y);
+    window->extent.bottom =
+        std::min(window->extent.bottom, (double)cell->refLoc.y);
+  }
+}
+
+GridWindow *CellWindow::Get(std::vector<GridCell> *newCells) {
+  if (newCells->empty()) {
+    return NULL;
+  }
+  if (cells != newCells || numCells != newCells->size()) {
+    FindGridWindow(newCells, &window);
+    cells = newCells;
+    numCells = newCells->size();
+  }
+  return &window;
+}
+
+// A sampling index and the cells and grid geometry it was made for
+struct SamplingEntry {
+  std::vector<GridCell> *cells;
+  size_t numCells;
+  long numCols, numRows, windowLeft, windowTop;
+  double cellSize;
+  BoundingBox extent;
+  SamplingIndex index;
+};
+
+static std::vector<SamplingEntry *> samplingEntries;
+#ifndef _WIN32
+static pthread_mutex_t samplingLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+static bool IsSamplingMatch(SamplingEntry *entry, std::vector<GridCell> *cells,
+                            FloatGrid *grid) {
+  return entry->cells == cells && entry->numCells == cells->size() &&
+         entry->numCols == grid->numCols && entry->numRows == grid->numRows &&
+         entry->windowLeft == grid->windowLeft &&
+         entry->windowTop == grid->windowTop &&
+         entry->cellSize == grid->cellSize &&
+         entry->extent.left == grid->extent.left &&
+         entry->extent.top == grid->extent.top &&
+         entry->extent.right == grid->extent.right &&
+         entry->extent.bottom == grid->extent.bottom;
+}
+
+SamplingIndex *GetSamplingIndex(std::vector<GridCell> *cells,
+                                FloatGrid *grid) {
+#ifndef _WIN32
+  pthread_mutex_lock(&samplingLock);
+#endif
+  SamplingEntry *entry = NULL;
+  for (size_t e = 0; e < samplingEntries.size(); e++) {
+    if (IsSamplingMatch(samplingEntries[e], cells, grid)) {
+      entry = samplingEntries[e];
+      break;
+    }
+  }
+
+  if (!entry) {
+    entry = new SamplingEntry;
+    entry->cells = cells;
+    entry->numCells = cells->size();
+    entry->numCols = grid->numCols;
+    entry->numRows = grid->numRows;
+    entry->windowLeft = grid->windowLeft;
+    entry->windowTop = grid->windowTop;
+    entry->cellSize = grid->cellSize;
+    entry->extent = grid->extent;
+    entry->index.rows.resize(cells->size());
+    entry->index.cols.resize(cells->size());
+    long numCells = (long)cells->size();
+#if _OPENMP
+#pragma omp parallel for
+#endif
+    for (long i = 0; i < numCells; i++) {
+      GridCell *cell = &(cells->at(i));
+      GridLoc pt;
+      if (grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
+        entry->index.rows[i] = (int)(pt.y - grid->windowTop);
+        entry->index.cols[i] = (int)(pt.x - grid->windowLeft);
+      } else {
+        entry->index.rows[i] = -1;
+        entry->index.cols[i] = -1;
+      }
+    }
+    samplingEntries.push_back(entry);
+  }
+#ifndef _WIN32
+  pthread_mutex_unlock(&samplingLock);
+#endif
+
+  return &(entry->index);
+}
+
+void ForgetSamplingIndexes(std::vector<GridCell> *cells) {
+#ifndef _WIN32
+  pthread_mutex_lock(&samplingLock);
+#endif
+  for (size_t e = 0; e < samplingEntries.size();) {
+    if (samplingEntries[e]->cells == cells) {
+      delete samplingEntries[e];
+      samplingEntries.erase(samplingEntries.begin() + e);
+    } else {
+      e++;
+    }
+  }
+#ifndef _WIN32
+  pthread_mutex_unlock(&samplingLock);
+#endif
+}
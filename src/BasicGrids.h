@@ -13,9 +13,11 @@ bool LoadBasicGrids();
 void FreeBasicGridsData();
 void ClipBasicGrids(long x, long y, long search, const char *output);
 void ClipBasicGrids(BasinConfigSection *basin, std::vector<GridNode> *nodes,
-                    const char *name, const char *output);
+                    std::vector<GridCell> *cells, const char *name,
+                    const char *output);
 void CarveBasin(
     BasinConfigSection *basin, std::vector<GridNode> *nodes,
+    std::vector<GridCell> *cells,
     std::map<GaugeConfigSection *, float *> *inParamSettings,
     std::map<GaugeConfigSection *, float *> *outParamSettings,
     GaugeMap *gaugeMap, float *defaultParams,
@@ -29,6 +31,40 @@ void CarveBasin(
     std::map<GaugeConfigSection *, float *> *outInundationParamSettings,
     float *defaultInundationParams);
 void MakeBasic();
+void FindGridWindow(std::vector<GridCell> *cells, GridWindow *window);
+
+// The window of the cells a forcing reader was last given, worked out again
+// only when the cells change. NULL without cells.
+class CellWindow {
+public:
+  CellWindow() {
+    cells = NULL;
+    numCells = 0;
+  }
+  GridWindow *Get(std::vector<GridCell> *newCells);
+
+private:
+  std::vector<GridCell> *cells;
+  size_t numCells;
+  GridWindow window;
+};
+
+// Where the cells sample a grid that does not match the DEM, the row and
+// column of its data holding each cell or a row of -1 for cells outside it.
+// This is what Grid::GetGridLoc gives, less the grid's window offset.
+struct SamplingIndex {
+  std::vector<int> rows, cols;
+};
+
+// Returns the index of cells into grids with the geometry and window of
+// grid, worked out the first time it is asked for and then kept until the
+// cells are carved again. Safe to call from several threads.
+SamplingIndex *GetSamplingIndex(std::vector<GridCell> *cells, FloatGrid *grid);
+
+// Drops the sampling indexes kept for cells, CarveBasin calls this before it
+// fills them with another basin.
+void ForgetSamplingIndexes(std::vector<GridCell> *cells);
+
 void ReclassifyDDM();
 bool CheckESRIDDM();
 bool CheckSimpleDDM();
@@ -2,6 +2,7 @@
 #define BIF_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 #pragma pack(push)
 #pragma pack(1)
@@ -16,6 +17,7 @@ struct BifHeader {
 };
 #pragma pack(pop)
 
-FloatGrid *ReadFloatBifGrid(char *file);
+// The grid comes from pool when there is one and goes back to it
+FloatGrid *ReadFloatBifGrid(char *file, GridPool *pool = NULL);
 
 #endif
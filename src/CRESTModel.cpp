@@ -7,24 +7,39 @@
 #include "AscGrid.h"
 #include "CRESTModel.h"
 #include "DatedName.h"
+#include "KernelPrecision.h"
 
 static const char *stateStrings[] = {
     "SM",
 };
 
-CRESTModel::CRESTModel() {}
+void CRESTCells::Resize(size_t numCells) {
+  for (int p = 0; p < PARAM_CREST_QTY; p++) {
+    params[p].resize(numCells);
+  }
+  for (int p = 0; p < STATE_CREST_QTY; p++) {
+    states[p].resize(numCells);
+  }
+  for (int p = 0; p < DERIVED_CREST_QTY; p++) {
+    derived[p].resize(numCells);
+  }
+}
+
+CRESTModel::CRESTModel() {
+  numSets = 0;
+  precision = KERNEL_PRECISION(PRECISION_DOUBLE);
+}
 
 CRESTModel::~CRESTModel() {}
 
 bool CRESTModel::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
-  if (crestNodes.size() != nodes->size()) {
-    crestNodes.resize(nodes->size());
-  }
+  gridCells = newCells;
+  cells.Resize(nodes->size());
 
   // Fill in modelIndex in the gridNodes
   size_t numNodes = nodes->size();
@@ -54,20 +69,18 @@ void CRESTModel::InitializeStates(TimeVar *beginTime, char *statePath) {
       printf("Using CREST %s State Grid %s\n", stateStrings[p], buffer);
       if (g_DEM->IsSpatialMatch(sGrid)) {
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &nodes->at(i);
-          CRESTGridNode *cNode = &(crestNodes[i]);
-          if (sGrid->data[node->y][node->x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[node->y][node->x];
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->data[cell->y][cell->x] != sGrid->noData) {
+            cells.states[p][i] = sGrid->data[cell->y][cell->x];
           }
         }
       } else {
         GridLoc pt;
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &(nodes->at(i));
-          CRESTGridNode *cNode = &(crestNodes[i]);
-          if (sGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt) &&
               sGrid->data[pt.y][pt.x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[pt.y][pt.x];
+            cells.states[p][i] = sGrid->data[pt.y][pt.x];
           }
         }
       }
@@ -93,10 +106,9 @@ void CRESTModel::SaveStates(TimeVar *currentTime, char *statePath,
     sprintf(buffer, "%s/crest_%s_%s.tif", statePath, stateStrings[p],
             timeStr.GetName());
     for (size_t i = 0; i < nodes->size(); i++) {
-      CRESTGridNode *cNode = &(crestNodes[i]);
-      dataVals[i] = cNode->states[p];
+      dataVals[i] = cells.states[p][i];
     }
-    gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+    gridWriter->WriteGrid(nodes, gridCells, &dataVals, buffer, false);
   }
 }
 
@@ -106,171 +118,342 @@ bool CRESTModel::WaterBalance(float stepHours, std::vector<float> *precip,
                               std::vector<float> *slowFlow,
                               std::vector<float> *soilMoisture) {
 
-  size_t numNodes = nodes->size();
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+  const float *precipIn = &(precip->at(0));
+  const float *petIn = &(pet->at(0));
+  float *fastOut = &(fastFlow->at(0));
+  float *slowOut = &(slowFlow->at(0));
+  float *smOut = &(soilMoisture->at(0));
+  long numNegative = 0;
+
+  BeginStep(stepHours);
 
+  // Every cell is independent of the others
 #if _OPENMP
-  //#pragma omp parallel for
-#endif
+#pragma omp parallel for reduction(+ : numNegative)
+#else
 #pragma acc parallel loop
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    CRESTGridNode *cNode = &(crestNodes[i]);
-    WaterBalanceInt(node, cNode, stepHours, precip->at(i), pet->at(i),
-                    &(fastFlow->at(i)), &(slowFlow->at(i)));
-    soilMoisture->at(i) =
-        cNode->states[STATE_CREST_SM] * 100.0 / cNode->params[PARAM_CREST_WM];
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    numNegative += StepCells(stepHours, begin, end, precipIn, petIn, fastOut,
+                             slowOut, smOut);
   }
 
+  EndStep(numNegative);
+
   return true;
 }
 
-void CRESTModel::WaterBalanceInt(GridNode *node, CRESTGridNode *cNode,
-                                 float stepHours, float precipIn, float petIn,
-                                 float *fastFlow, float *slowFlow) {
-  double precip = precipIn * stepHours; // precipIn is mm/hr, precip is mm
-  double pet = petIn * stepHours;       // petIn in mm/hr, pet is mm
-  double R = 0.0, Wo = 0.0;
+long CRESTModel::StepCells(float stepHours, long begin, long end,
+                           const float *precip, const float *pet,
+                           float *fastFlow, float *slowFlow,
+                           float *soilMoisture) {
+  if (precision == PRECISION_SINGLE) {
+    return RunCells<float>(stepHours, NULL, begin, end, precip, pet, fastFlow,
+                           slowFlow, soilMoisture);
+  }
+  return RunCells<double>(stepHours, NULL, begin, end, precip, pet, fastFlow,
+                          slowFlow, soilMoisture);
+}
 
-  double adjPET = pet * cNode->params[PARAM_CREST_KE];
-  double temX = 0.0;
+long CRESTModel::StepList(float stepHours, const long *list, long count,
+                          const float *precip, const float *pet,
+                          float *fastFlow, float *slowFlow,
+                          float *soilMoisture) {
+  if (precision == PRECISION_SINGLE) {
+    return RunCells<float>(stepHours, list, 0, count, precip, pet, fastFlow,
+                           slowFlow, soilMoisture);
+  }
+  return RunCells<double>(stepHours, list, 0, count, precip, pet, fastFlow,
+                          slowFlow, soilMoisture);
+}
 
-  // If we aren't a channel cell, add routed in overland to precip
-  /*if (!node->channelGridCell) {
-    precip += *fastFlow;
-    *fastFlow = 0.0;
-  }*/
+void CRESTModel::EndStep(long numNegative) {
+  if (numNegative > 0) {
+    printf("Infiltration or runoff went negative in %li cells, runoff was "
+           "kept at or above 0\n",
+           numNegative);
+  }
+}
 
-  // We have more water coming in than leaving via ET.
-  if (precip > adjPET) {
-    double precipSoil =
-        (precip - adjPET) * (1 - cNode->params[PARAM_CREST_IM]); // This is the
-                                                                 // precip that
-                                                                 // makes it to
-                                                                 // the soil
-    double precipImperv =
-        precip - adjPET - precipSoil; // Portion of precip on impervious area
+bool CRESTModel::WaterBalanceBlock(float stepHours, int numSteps,
+                                   std::vector<float> *precip,
+                                   std::vector<float> *pet,
+                                   std::vector<double> *fastFlow,
+                                   std::vector<double> *slowFlow,
+                                   std::vector<float> *soilMoisture) {
+  if (precision == PRECISION_SINGLE) {
+    return RunWaterBalanceBlock<float>(stepHours, numSteps, precip, pet,
+                                       fastFlow, slowFlow, soilMoisture);
+  }
+  return RunWaterBalanceBlock<double>(stepHours, numSteps, precip, pet,
+                                      fastFlow, slowFlow, soilMoisture);
+}
 
-    // cNode->states[STATE_CREST_SM] += *slowFlow;
-    //*slowFlow = 0.0;
+bool CRESTModel::WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                                  std::vector<float> *pet,
+                                  std::vector<float> *fastFlow,
+                                  std::vector<float> *slowFlow) {
+  if (precision == PRECISION_SINGLE) {
+    return RunWaterBalanceSets<float>(stepHours, precip, pet, fastFlow,
+                                      slowFlow);
+  }
+  return RunWaterBalanceSets<double>(stepHours, precip, pet, fastFlow,
+                                     slowFlow);
+}
 
-    double interflowExcess =
-        cNode->states[STATE_CREST_SM] - cNode->params[PARAM_CREST_WM];
-    if (interflowExcess < 0.0) {
-      interflowExcess = 0.0;
+template <class Real>
+long CRESTModel::RunCells(float stepHours, const long *list, long begin,
+                          long end, const float *precip, const float *pet,
+                          float *fastFlow, float *slowFlow,
+                          float *soilMoisture) {
+  const float *sm = &(cells.states[STATE_CREST_SM][0]);
+  const float *wm = &(cells.params[PARAM_CREST_WM][0]);
+  long numNegative = 0;
+  for (long j = begin; j < end; j++) {
+    long i = list ? list[j] : j;
+    Real fast, slow;
+    if (WaterBalanceInt<Real>(&cells, i, stepHours, precip[i], pet[i], &fast,
+                              &slow)) {
+      numNegative++;
     }
+    fastFlow[i] += fast;
+    slowFlow[i] += slow;
+    soilMoisture[i] = sm[i] * 100.0 / wm[i];
+  }
+  return numNegative;
+}
 
-    if (cNode->states[STATE_CREST_SM] > cNode->params[PARAM_CREST_WM]) {
-      cNode->states[STATE_CREST_SM] = cNode->params[PARAM_CREST_WM];
-    }
+template <class Real>
+bool CRESTModel::RunWaterBalanceBlock(float stepHours, int numSteps,
+                                      std::vector<float> *precip,
+                                      std::vector<float> *pet,
+                                      std::vector<double> *fastFlow,
+                                      std::vector<double> *slowFlow,
+                                      std::vector<float> *soilMoisture) {
+
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+  const float *sm = &(cells.states[STATE_CREST_SM][0]);
+  const float *wm = &(cells.params[PARAM_CREST_WM][0]);
+  long numNegative = 0;
 
-    if (cNode->states[STATE_CREST_SM] < cNode->params[PARAM_CREST_WM]) {
-      double Wmaxm =
-          cNode->params[PARAM_CREST_WM] * (1 + cNode->params[PARAM_CREST_B]);
-      double A = Wmaxm * (1 - pow(1 - cNode->states[STATE_CREST_SM] /
-                                          cNode->params[PARAM_CREST_WM],
-                                  1 / (1 + cNode->params[PARAM_CREST_B])));
-      if (precipSoil + A >= Wmaxm) {
-        R = precipSoil -
-            (cNode->params[PARAM_CREST_WM] -
-             cNode->states[STATE_CREST_SM]); // Leftovers after filling SM
-
-        if (R < 0) {
-          printf("R to %f, [%f, %f, %f, %f, %f, %f]\n", R,
-                 cNode->params[PARAM_CREST_WM], cNode->params[PARAM_CREST_B],
-                 cNode->states[STATE_CREST_SM], A, Wmaxm, precipSoil);
-          R = 0.0;
+  // A tile's states and parameters stay in cache while it goes through every
+  // step of the block
+#if _OPENMP
+#pragma omp parallel for reduction(+ : numNegative)
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    for (int k = 0; k < numSteps; k++) {
+      const float *precipIn = &(precip[k][0]);
+      const float *petIn = &(pet[k][0]);
+      double *fastOut = &(fastFlow[k][0]);
+      double *slowOut = &(slowFlow[k][0]);
+      for (long i = begin; i < end; i++) {
+        Real fast, slow;
+        if (WaterBalanceInt<Real>(&cells, i, stepHours, precipIn[i], petIn[i],
+                                  &fast, &slow)) {
+          numNegative++;
         }
+        fastOut[i] = fast;
+        slowOut[i] = slow;
+      }
+      if (soilMoisture) {
+        float *smOut = &(soilMoisture[k][0]);
+        for (long i = begin; i < end; i++) {
+          smOut[i] = sm[i] * 100.0 / wm[i];
+        }
+      }
+    }
+  }
 
-        Wo = cNode->params[PARAM_CREST_WM];
+  if (numNegative > 0) {
+    printf("Infiltration or runoff went negative in %li cell steps, runoff "
+           "was kept at or above 0\n",
+           numNegative);
+  }
 
-      } else {
-        double infiltration =
-            cNode->params[PARAM_CREST_WM] *
-            (pow(1 - A / Wmaxm, 1 + cNode->params[PARAM_CREST_B]) -
-             pow(1 - (A + precipSoil) / Wmaxm,
-                 1 + cNode->params[PARAM_CREST_B]));
-        if (infiltration > precipSoil) {
-          infiltration = precipSoil;
-        } else if (infiltration < 0.0) {
-          printf("Infiltration went to %f, [%f, %f, %f, %f, %f, %f]\n",
-                 infiltration, cNode->params[PARAM_CREST_WM],
-                 cNode->params[PARAM_CREST_B], cNode->states[STATE_CREST_SM], A,
-                 Wmaxm, precipSoil);
-        }
+  return true;
+}
+
+bool CRESTModel::InitializeSets(
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
+    int newNumSets, std::map<GaugeConfigSection *, float *> *paramSettings,
+    std::vector<FloatGrid *> *paramGrids) {
 
-        R = precipSoil - infiltration;
+  numSets = newNumSets;
+  size_t numNodes = newNodes->size();
+  setCells.Resize(numNodes * numSets);
 
-        if (R < 0) {
-          printf("R (infil) to %f, [%f, %f, %f, %f, %f, %f]\n", R,
-                 cNode->params[PARAM_CREST_WM], cNode->params[PARAM_CREST_B],
-                 cNode->states[STATE_CREST_SM], A, Wmaxm, precipSoil);
-          R = 0.0;
-        }
-        Wo = cNode->states[STATE_CREST_SM] + infiltration;
+  // Set each parameter set up as InitializeModel would and interleave it
+  for (int s = 0; s < numSets; s++) {
+    InitializeModel(newNodes, newCells, &(paramSettings[s]), paramGrids);
+    for (int p = 0; p < PARAM_CREST_QTY; p++) {
+      for (size_t i = 0; i < numNodes; i++) {
+        setCells.params[p][i * numSets + s] = cells.params[p][i];
       }
-    } else {
-      R = precipSoil;
-      Wo = cNode->params[PARAM_CREST_WM];
     }
+    for (int p = 0; p < STATE_CREST_QTY; p++) {
+      for (size_t i = 0; i < numNodes; i++) {
+        setCells.states[p][i * numSets + s] = cells.states[p][i];
+      }
+    }
+  }
 
-    // Now R is excess water, split it between overland & interflow
+  ComputeDerived(&setCells);
+
+  return true;
+}
 
-    temX = (cNode->states[STATE_CREST_SM] + Wo) /
-           cNode->params[PARAM_CREST_WM] / 2 *
-           (cNode->params[PARAM_CREST_FC] *
-            stepHours); // Calculate how much water can infiltrate
+template <class Real>
+bool CRESTModel::RunWaterBalanceSets(float stepHours,
+                                     std::vector<float> *precip,
+                                     std::vector<float> *pet,
+                                     std::vector<float> *fastFlow,
+                                     std::vector<float> *slowFlow) {
 
-    if (R <= temX) {
-      cNode->excess[CREST_LAYER_INTERFLOW] = R;
-    } else {
-      cNode->excess[CREST_LAYER_INTERFLOW] = temX;
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+  const float *precipIn = &(precip->at(0));
+  const float *petIn = &(pet->at(0));
+  long numNegative = 0;
+
+  // The forcing of a cell is loaded once for all of the sets, which sit next
+  // to each other in setCells
+#if _OPENMP
+#pragma omp parallel for reduction(+ : numNegative)
+#endif
+  for (long i = 0; i < numNodes; i++) {
+    float cellPrecip = precipIn[i];
+    float cellPET = petIn[i];
+    long base = i * numSets;
+    for (int s = 0; s < numSets; s++) {
+      Real fast, slow;
+      if (WaterBalanceInt<Real>(&setCells, base + s, stepHours, cellPrecip,
+                                cellPET, &fast, &slow)) {
+        numNegative++;
+      }
+      fastFlow[s][i] += fast;
+      slowFlow[s][i] += slow;
     }
-    cNode->excess[CREST_LAYER_OVERLAND] =
-        R - cNode->excess[CREST_LAYER_INTERFLOW] + precipImperv;
+  }
 
-    cNode->actET = adjPET;
+  if (numNegative > 0) {
+    printf("Infiltration or runoff went negative in %li cells over %i "
+           "parameter sets, runoff was kept at or above 0\n",
+           numNegative, numSets);
+  }
 
-    cNode->excess[CREST_LAYER_INTERFLOW] +=
-        interflowExcess; // Extra interflow that got routed.
-  } else {               // All the incoming precip goes straight to ET
-    cNode->excess[CREST_LAYER_OVERLAND] = 0.0;
+  return true;
+}
 
-    // cNode->states[STATE_CREST_SM] += *slowFlow;
-    //*slowFlow = 0.0;
+template <class Real>
+bool CRESTModel::WaterBalanceInt(CRESTCells *runCells, long index,
+                                 float stepHours, float precipIn, float petIn,
+                                 Real *fastFlow, Real *slowFlow) {
+  const float wm = runCells->params[PARAM_CREST_WM][index];
+  const float ke = runCells->params[PARAM_CREST_KE][index];
+  const float fc = runCells->params[PARAM_CREST_FC][index];
+  const float wmaxm = runCells->derived[DERIVED_CREST_WMAXM][index];
+  const float b1 = runCells->derived[DERIVED_CREST_B1][index];
+  const float bInv = runCells->derived[DERIVED_CREST_BINV][index];
+  const float perv = runCells->derived[DERIVED_CREST_PERV][index];
+  float sm = runCells->states[STATE_CREST_SM][index];
+  bool negative = false;
+
+  Real precip = precipIn * stepHours; // precipIn is mm/hr, precip is mm
+  Real pet = petIn * stepHours;       // petIn in mm/hr, pet is mm
+  Real R = 0.0, Wo = 0.0;
+  Real excessOverland, excessInterflow;
+
+  Real adjPET = pet * ke;
+  Real temX = 0.0;
+
+  // Soil moisture over capacity leaves as interflow
+  Real interflowExcess = sm - wm;
+  interflowExcess = (interflowExcess < 0.0) ? 0.0 : interflowExcess;
+  sm = (sm > wm) ? wm : sm;
 
-    double interflowExcess =
-        cNode->states[STATE_CREST_SM] - cNode->params[PARAM_CREST_WM];
-    if (interflowExcess < 0.0) {
-      interflowExcess = 0.0;
-    }
-    cNode->excess[CREST_LAYER_INTERFLOW] = interflowExcess;
+  // We have more water coming in than leaving via ET.
+  if (precip > adjPET) {
+    Real precipSoil = (precip - adjPET) * perv; // This is the precip that
+                                                 // makes it to the soil
+    Real precipImperv =
+        precip - adjPET - precipSoil; // Portion of precip on impervious area
 
-    if (cNode->states[STATE_CREST_SM] > cNode->params[PARAM_CREST_WM]) {
-      cNode->states[STATE_CREST_SM] = cNode->params[PARAM_CREST_WM];
+    // The soil is either full already, fills up this step or takes in part
+    // of the water. Only the pows an outcome needs are taken, none for a full
+    // soil, one when it fills and three when it takes in part of the water.
+    // The bases are clamped so rounding never hands pow a negative number.
+    // sm, wm and bInv are stored as float and A has always been worked out
+    // from them in float
+    Real Wmaxm = wmaxm;
+    Real A = 0.0, infiltration = 0.0;
+    bool full = !(sm < wm);
+    bool fills = true;
+    if (!full) {
+      float emptyFrac = 1 - sm / wm;
+      A = Wmaxm * (1 - KernelPow((emptyFrac < 0.0f) ? 0.0f : emptyFrac, bInv));
+      fills = (precipSoil + A >= Wmaxm);
     }
-
-    double ExcessET = (adjPET - precip) * cNode->states[STATE_CREST_SM] /
-                      cNode->params[PARAM_CREST_WM];
-    if (ExcessET < cNode->states[STATE_CREST_SM]) {
-      Wo = cNode->states[STATE_CREST_SM] -
-           ExcessET; // We can evaporate away ExcessET too.
-    } else {
-      Wo = 0.0; // We don't have enough to evaporate ExcessET.
-      ExcessET = cNode->states[STATE_CREST_SM];
+    if (!fills) {
+      Real before = 1 - A / Wmaxm;
+      Real after = 1 - (A + precipSoil) / Wmaxm;
+      before = (before < 0.0) ? (Real)0.0 : before;
+      after = (after < 0.0) ? (Real)0.0 : after;
+      infiltration =
+          wm * (KernelPow(before, (Real)b1) - KernelPow(after, (Real)b1));
+      infiltration = (infiltration > precipSoil) ? precipSoil : infiltration;
     }
-    cNode->actET = ExcessET + precip;
+
+    Real RFills = precipSoil - (wm - sm); // Leftovers after filling SM
+    Real RPartial = precipSoil - infiltration;
+    R = full ? precipSoil : (fills ? RFills : RPartial);
+    Wo = (full || fills) ? wm : sm + infiltration;
+    negative = !full && (R < 0 || (!fills && infiltration < 0.0));
+    R = (R < 0) ? 0.0 : R;
+
+    // Now R is excess water, split it between overland & interflow
+
+    temX = (sm + Wo) / wm / 2 *
+           (fc * stepHours); // Calculate how much water can infiltrate
+
+    excessInterflow = (R <= temX) ? R : temX;
+    excessOverland = R - excessInterflow + precipImperv;
+    excessInterflow += interflowExcess; // Extra interflow that got routed.
+  } else { // All the incoming precip goes straight to ET
+    excessOverland = 0.0;
+    excessInterflow = interflowExcess;
+
+    Real ExcessET = (adjPET - precip) * sm / wm;
+    // We can evaporate away ExcessET too, unless there is not enough.
+    Wo = (ExcessET < sm) ? sm - ExcessET : 0.0;
   }
 
-  cNode->states[STATE_CREST_SM] = Wo;
+  runCells->states[STATE_CREST_SM][index] = Wo;
 
-  // Add Overland Excess Water to fastFlow
-  *fastFlow += (cNode->excess[CREST_LAYER_OVERLAND] / (stepHours * 3600.0f));
+  // Overland Excess Water goes to fastFlow
+  *fastFlow = (excessOverland / (stepHours * 3600.0f));
 
-  // Add Interflow Excess Water to slowFlow
-  *slowFlow += (cNode->excess[CREST_LAYER_INTERFLOW] / (stepHours * 3600.0f));
+  // Interflow Excess Water goes to slowFlow
+  *slowFlow = (excessInterflow / (stepHours * 3600.0f));
 
-  // Calculate Discharge as the sum of the leaks
-  //*discharge = (overlandLeak + interflowLeak) * node->area / 3.6;
+  return negative;
 }
 
 void CRESTModel::InitializeParameters(
@@ -282,7 +465,9 @@ void CRESTModel::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
-    CRESTGridNode *cNode = &(crestNodes[i]);
+    GridCell *cell = &gridCells->at(i);
+    float params[PARAM_CREST_QTY];
+    float *sm = &(cells.states[STATE_CREST_SM][i]);
     if (!node->gauge) {
       unused++;
       continue;
@@ -293,12 +478,12 @@ void CRESTModel::InitializeParameters(
     paramsBlah[PARAM_CREST_QTY-1]);
     }*/
     // Copy all of the parameters over
-    memcpy(cNode->params, (*paramSettings)[node->gauge],
+    memcpy(params, (*paramSettings)[node->gauge],
            sizeof(float) * PARAM_CREST_QTY);
 
     // Some of the parameters are special, deal with that here
     if (!paramGrids->at(PARAM_CREST_IM)) {
-      cNode->params[PARAM_CREST_IM] /= 100.0;
+      params[PARAM_CREST_IM] /= 100.0;
     }
 
     // Deal with the distributed parameters here
@@ -306,63 +491,85 @@ void CRESTModel::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_CREST_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
           // modelParamStrings[MODEL_CREST][paramI]);
         }
-        cNode->params[paramI] *= grid->data[pt.y][pt.x];
+        params[paramI] *= grid->data[pt.y][pt.x];
       }
     }
 
     if (!paramGrids->at(PARAM_CREST_IWU)) {
-      cNode->states[STATE_CREST_SM] = cNode->params[PARAM_CREST_IWU] *
-                                      cNode->params[PARAM_CREST_WM] / 100.0;
+      *sm = params[PARAM_CREST_IWU] * params[PARAM_CREST_WM] / 100.0;
     }
 
-    if (cNode->params[PARAM_CREST_WM] < 0.0) {
-      cNode->params[PARAM_CREST_WM] = 100.0;
+    if (params[PARAM_CREST_WM] < 0.0) {
+      params[PARAM_CREST_WM] = 100.0;
     }
 
-    if (cNode->states[STATE_CREST_SM] < 0.0) {
-      printf("Node Soil Moisture(%f) is less than 0, setting to 0.\n",
-             cNode->states[STATE_CREST_SM]);
-      cNode->states[STATE_CREST_SM] = 0.0;
-    } else if (cNode->states[STATE_CREST_SM] > cNode->params[PARAM_CREST_WM]) {
+    if (*sm < 0.0) {
+      printf("Node Soil Moisture(%f) is less than 0, setting to 0.\n", *sm);
+      *sm = 0.0;
+    } else if (*sm > params[PARAM_CREST_WM]) {
       printf("Node Soil Moisture(%f) is greater than WM, setting to %f.\n",
-             cNode->states[STATE_CREST_SM], cNode->params[PARAM_CREST_WM]);
+             *sm, params[PARAM_CREST_WM]);
     }
 
-    if (cNode->params[PARAM_CREST_IM] < 0.0) {
+    if (params[PARAM_CREST_IM] < 0.0) {
       // printf("Node Impervious Area(%f) is less than 0, setting to 0.\n",
-      // cNode->params[PARAM_CREST_IM]);
-      cNode->params[PARAM_CREST_IM] = 0.0;
-    } else if (cNode->params[PARAM_CREST_IM] > 1.0) {
+      // params[PARAM_CREST_IM]);
+      params[PARAM_CREST_IM] = 0.0;
+    } else if (params[PARAM_CREST_IM] > 1.0) {
       // printf("Node Impervious Area(%f) is greater than 1, setting to 1.\n",
-      // cNode->params[PARAM_CREST_IM]);
-      cNode->params[PARAM_CREST_IM] = 1.0;
+      // params[PARAM_CREST_IM]);
+      params[PARAM_CREST_IM] = 1.0;
     }
 
-    if (cNode->params[PARAM_CREST_B] < 0.0) {
+    if (params[PARAM_CREST_B] < 0.0) {
       // printf("Node B (%f) is less than 0, setting to 0.\n",
-      // cNode->params[PARAM_CREST_B]);
-      cNode->params[PARAM_CREST_B] = 1.0;
-    } else if (cNode->params[PARAM_CREST_B] != cNode->params[PARAM_CREST_B]) {
+      // params[PARAM_CREST_B]);
+      params[PARAM_CREST_B] = 1.0;
+    } else if (params[PARAM_CREST_B] != params[PARAM_CREST_B]) {
       // printf("Node B (%f) NaN, setting to %f.\n",
-      // cNode->params[PARAM_CREST_B], 0.0);
-      cNode->params[PARAM_CREST_B] = 0.0;
+      // params[PARAM_CREST_B], 0.0);
+      params[PARAM_CREST_B] = 0.0;
     }
 
-    if (cNode->params[PARAM_CREST_FC] < 0.0) {
+    if (params[PARAM_CREST_FC] < 0.0) {
       // printf("Node B (%f) is less than 0, setting to 0.\n",
-      // cNode->params[PARAM_CREST_B]);
-      cNode->params[PARAM_CREST_FC] = 1.0;
+      // params[PARAM_CREST_B]);
+      params[PARAM_CREST_FC] = 1.0;
+    }
+
+    for (size_t paramI = 0; paramI < PARAM_CREST_QTY; paramI++) {
+      cells.params[paramI][i] = params[paramI];
     }
   }
+
+  ComputeDerived(&cells);
+}
+
+void CRESTModel::ComputeDerived(CRESTCells *runCells) {
+  long numCells = (long)runCells->states[STATE_CREST_SM].size();
+  const float *wm = &(runCells->params[PARAM_CREST_WM][0]);
+  const float *b = &(runCells->params[PARAM_CREST_B][0]);
+  const float *im = &(runCells->params[PARAM_CREST_IM][0]);
+  float *wmaxm = &(runCells->derived[DERIVED_CREST_WMAXM][0]);
+  float *b1 = &(runCells->derived[DERIVED_CREST_B1][0]);
+  float *bInv = &(runCells->derived[DERIVED_CREST_BINV][0]);
+  float *perv = &(runCells->derived[DERIVED_CREST_PERV][0]);
+
+  for (long i = 0; i < numCells; i++) {
+    wmaxm[i] = wm[i] * (1 + b[i]);
+    b1[i] = 1 + b[i];
+    bInv[i] = 1 / (1 + b[i]);
+    perv[i] = 1 - im[i];
+  }
 }
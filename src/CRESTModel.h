@@ -11,16 +11,23 @@ enum CREST_LAYER {
   CREST_LAYER_QTY,
 };
 
-struct CRESTGridNode : BasicGridNode {
-  float params[PARAM_CREST_QTY];
-  float states[STATE_CREST_QTY];
+// Per cell constants that only depend on the parameters
+enum DERIVED_CREST {
+  DERIVED_CREST_WMAXM, // WM * (1 + B), the largest point storage
+  DERIVED_CREST_B1,    // 1 + B
+  DERIVED_CREST_BINV,  // 1 / (1 + B)
+  DERIVED_CREST_PERV,  // 1 - IM
+  DERIVED_CREST_QTY
+};
 
-  // These guys are the state variables
-  // double soilMoisture; // Current depth of water filling available pore space
+// CREST cells are stored as one contiguous array per field, so the water
+// balance sweep can run over them in parallel and with vector instructions.
+struct CRESTCells {
+  void Resize(size_t numCells);
 
-  // These are results of the water balance
-  double excess[CREST_LAYER_QTY];
-  double actET;
+  std::vector<float> params[PARAM_CREST_QTY];
+  std::vector<float> states[STATE_CREST_QTY];
+  std::vector<float> derived[DERIVED_CREST_QTY];
 };
 
 class CRESTModel : public WaterBalanceModel {
@@ -29,6 +36,7 @@ public:
   CRESTModel();
   ~CRESTModel();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath);
@@ -38,19 +46,75 @@ public:
                     std::vector<float> *pet, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *soilMoisture);
+  bool WaterBalanceBlock(float stepHours, int numSteps,
+                         std::vector<float> *precip, std::vector<float> *pet,
+                         std::vector<double> *fastFlow,
+                         std::vector<double> *slowFlow,
+                         std::vector<float> *soilMoisture);
+  bool InitializeSets(std::vector<GridNode> *newNodes,
+                      std::vector<GridCell> *newCells, int newNumSets,
+                      std::map<GaugeConfigSection *, float *> *paramSettings,
+                      std::vector<FloatGrid *> *paramGrids);
+  bool WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                        std::vector<float> *pet, std::vector<float> *fastFlow,
+                        std::vector<float> *slowFlow);
   bool IsLumped() { return false; }
   const char *GetName() { return "crest"; }
+  void SetPrecision(PRECISIONS newPrecision) { precision = newPrecision; }
+  // Tile access for SimEngine, which interleaves the water balance with the
+  // snow model a tile of cells at a time. BeginStep is called once per step
+  // before StepCells, which runs cells begin to end - 1 as WaterBalance
+  // does and returns the number of them whose runoff was kept from going
+  // negative. StepList does the same for the count cells in list. EndStep
+  // is then given the total over every tile.
+  void BeginStep(float stepHours) {}
+  long StepCells(float stepHours, long begin, long end, const float *precip,
+                 const float *pet, float *fastFlow, float *slowFlow,
+                 float *soilMoisture);
+  long StepList(float stepHours, const long *list, long count,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
+  void EndStep(long numNegative);
 
 private:
-  void WaterBalanceInt(GridNode *node, CRESTGridNode *cNode, float stepHours,
-                       float precipIn, float petIn, float *fastFlow,
-                       float *slowFlow);
+  // The public water balance functions run these with Real as the compute
+  // type picked by precision. RunCells runs list[begin] to list[end - 1],
+  // or begin to end - 1 when list is NULL.
+  template <class Real>
+  long RunCells(float stepHours, const long *list, long begin, long end,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
+  template <class Real>
+  bool RunWaterBalanceBlock(float stepHours, int numSteps,
+                            std::vector<float> *precip,
+                            std::vector<float> *pet,
+                            std::vector<double> *fastFlow,
+                            std::vector<double> *slowFlow,
+                            std::vector<float> *soilMoisture);
+  template <class Real>
+  bool RunWaterBalanceSets(float stepHours, std::vector<float> *precip,
+                           std::vector<float> *pet,
+                           std::vector<float> *fastFlow,
+                           std::vector<float> *slowFlow);
+  // Sets fastFlow and slowFlow to the runoff rates of entry index of
+  // runCells for this step
+  template <class Real>
+  bool WaterBalanceInt(CRESTCells *runCells, long index, float stepHours,
+                       float precipIn, float petIn, Real *fastFlow,
+                       Real *slowFlow);
+  void ComputeDerived(CRESTCells *runCells);
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
 
   std::vector<GridNode> *nodes;
-  std::vector<CRESTGridNode> crestNodes;
+  std::vector<GridCell> *gridCells;
+  CRESTCells cells;
+  // Parameter set batches, entry i * numSets + s is cell i of set s
+  CRESTCells setCells;
+  int numSets;
+  // Double unless a task or the build asks for single
+  PRECISIONS precision;
 };
 
 #endif
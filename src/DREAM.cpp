@@ -628,17 +628,14 @@ void DREAM::CompDensity(float **p, float *log_p, float **x,
   int count = MCMC->seq;
   int i = 0;
 
-  //#pragma omp parallel for private(objScore, i)
   if (!isEnsemble) {
-#if _OPENMP
-#pragma omp parallel for
-#endif
+    // The whole generation is handed to the simulator at once
+    std::vector<float> scores(count);
+    sim->SimulateForCaliSets(count, x, &(scores[0]));
     for (i = 0; i < count; i++) {
-      float score = sim->SimulateForCali(&(x[i][0]));
+      float score = scores[i];
       objScore = ((goal == OBJECTIVE_GOAL_MINIMIZE) ? -1.0 : 1.0f) * score;
-#if _OPENMP
-      printf("%i (%i) %f\n", i, omp_get_thread_num(), score);
-#endif
+      printf("%i %f\n", i, score);
       p[i][0] = objScore;
       p[i][1] = i;
       log_p[i] = 0.5 * objScore;
@@ -11,6 +11,24 @@ const int datePartLen[] = {
     4, 2, 2, 2, 2, 2,
 };
 
+DatedName::DatedName(const DatedName &rhs) { *this = rhs; }
+
+DatedName &DatedName::operator=(const DatedName &rhs) {
+  if (this == &rhs) {
+    return *this;
+  }
+  resolution = rhs.resolution;
+  memcpy(inUseName, rhs.inUseName, sizeof(inUseName));
+  memcpy(inUseTimeParts, rhs.inUseTimeParts, sizeof(inUseTimeParts));
+  for (int i = 0; i < TIME_UNIT_QTY; i++) {
+    timeParts[i] = NULL;
+    if (inUseTimeParts[i]) {
+      timeParts[i] = inUseName + (rhs.timeParts[i] - rhs.inUseName);
+    }
+  }
+  return *this;
+}
+
 void DatedName::SetNameStr(const char *nameStr) {
   strcpy(inUseName, nameStr);
   memset(inUseTimeParts, 0, sizeof(bool) * TIME_UNIT_QTY);
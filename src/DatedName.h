@@ -11,6 +11,10 @@ extern const int datePartLen[];
 class DatedName {
 
 public:
+  DatedName() {}
+  // Copies point their time parts into their own name
+  DatedName(const DatedName &rhs);
+  DatedName &operator=(const DatedName &rhs);
   bool ProcessName(TimeUnit *freq);
   bool ProcessNameLoose(TimeUnit *freq);
   void SetNameStr(const char *nameStr);
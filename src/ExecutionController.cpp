@@ -256,6 +256,7 @@ void ExecuteClipBasin(TaskConfigSection *task) {
   std::map<GaugeConfigSection *, float *> fullParamSettings, *paramSettings,
       fullRouteParamSettings, *routeParamSettings;
   std::vector<GridNode> nodes;
+  std::vector<GridCell> cells;
   GaugeMap gaugeMap;
 
   // Get the parameter settings for this task
@@ -273,19 +274,20 @@ void ExecuteClipBasin(TaskConfigSection *task) {
     defaultRouteParams = pitr->second;
   }
 
-  CarveBasin(task->GetBasinSec(), &nodes, paramSettings, &fullParamSettings,
-             &gaugeMap, defaultParams, routeParamSettings,
+  CarveBasin(task->GetBasinSec(), &nodes, &cells, paramSettings,
+             &fullParamSettings, &gaugeMap, defaultParams, routeParamSettings,
              &fullRouteParamSettings, defaultRouteParams, NULL, NULL, NULL,
              NULL, NULL, NULL);
 
-  ClipBasicGrids(task->GetBasinSec(), &nodes, task->GetBasinSec()->GetName(),
-                 task->GetOutput());
+  ClipBasicGrids(task->GetBasinSec(), &nodes, &cells,
+                 task->GetBasinSec()->GetName(), task->GetOutput());
 }
 
 void ExecuteClipGauge(TaskConfigSection *task) {
   std::map<GaugeConfigSection *, float *> fullParamSettings, *paramSettings,
       fullRouteParamSettings, *routeParamSettings;
   std::vector<GridNode> nodes;
+  std::vector<GridCell> cells;
   GaugeMap gaugeMap;
 
   // Get the parameter settings for this task
@@ -303,8 +305,8 @@ void ExecuteClipGauge(TaskConfigSection *task) {
     defaultRouteParams = pitr->second;
   }
 
-  CarveBasin(task->GetBasinSec(), &nodes, paramSettings, &fullParamSettings,
-             &gaugeMap, defaultParams, routeParamSettings,
+  CarveBasin(task->GetBasinSec(), &nodes, &cells, paramSettings,
+             &fullParamSettings, &gaugeMap, defaultParams, routeParamSettings,
              &fullRouteParamSettings, defaultRouteParams, NULL, NULL, NULL,
              NULL, NULL, NULL);
 
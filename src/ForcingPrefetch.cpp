@@ -0,0 +1,220 @@
+#include "ForcingPrefetch.h"
+#include "Messages.h"
+#include "PETReader.h"
+#include "PrecipReader.h"
+#include "TempReader.h"
+#include <cstdio>
+#include <cstring>
+
+ForcingPrefetch::ForcingPrefetch(std::vector<GridCell> *newCells,
+                                 std::vector<TimeVar> *newStepTimes,
+                                 int newDepth) {
+  cells = newCells;
+  stepTimes = *newStepTimes;
+  slots.resize(newDepth + 1);
+  petIsTemp = false;
+  tempDEM[0] = 0;
+  for (int f = 0; f < FORCING_QTY; f++) {
+    hasFeed[f] = false;
+    hasFallback[f] = false;
+    loaded[f] = 0;
+  }
+  taken = 0;
+  released = 0;
+  stop = false;
+#ifndef _WIN32
+  for (int f = 0; f < FORCING_QTY; f++) {
+    started[f] = false;
+  }
+  pthread_mutex_init(&lock, NULL);
+  pthread_cond_init(&loadedCond, NULL);
+  pthread_cond_init(&takenCond, NULL);
+#endif
+}
+
+ForcingPrefetch::~ForcingPrefetch() {
+#ifndef _WIN32
+  pthread_mutex_lock(&lock);
+  stop = true;
+  pthread_cond_broadcast(&takenCond);
+  pthread_mutex_unlock(&lock);
+  for (int f = 0; f < FORCING_QTY; f++) {
+    if (started[f]) {
+      pthread_join(threads[f], NULL);
+    }
+  }
+  pthread_cond_destroy(&takenCond);
+  pthread_cond_destroy(&loadedCond);
+  pthread_mutex_destroy(&lock);
+#endif
+}
+
+void ForcingPrefetch::SetPrecip(ForcingFeed *precip, ForcingFeed *qpf) {
+  hasFeed[FORCING_PRECIP] = true;
+  feeds[FORCING_PRECIP] = *precip;
+  if (qpf) {
+    hasFallback[FORCING_PRECIP] = true;
+    fallbacks[FORCING_PRECIP] = *qpf;
+  }
+}
+
+void ForcingPrefetch::SetPET(ForcingFeed *pet, bool isTemp) {
+  hasFeed[FORCING_PET] = true;
+  feeds[FORCING_PET] = *pet;
+  petIsTemp = isTemp;
+}
+
+void ForcingPrefetch::SetTemp(ForcingFeed *temp, ForcingFeed *tempF,
+                              char *demFile) {
+  hasFeed[FORCING_TEMP] = true;
+  feeds[FORCING_TEMP] = *temp;
+  if (tempF) {
+    hasFallback[FORCING_TEMP] = true;
+    fallbacks[FORCING_TEMP] = *tempF;
+  }
+  strcpy(tempDEM, demFile);
+}
+
+bool ForcingPrefetch::Start() {
+#ifndef _WIN32
+  for (size_t s = 0; s < slots.size(); s++) {
+    for (int f = 0; f < FORCING_QTY; f++) {
+      if (hasFeed[f]) {
+        slots[s].values[f].resize(cells->size());
+      }
+    }
+  }
+  for (int f = 0; f < FORCING_QTY; f++) {
+    if (!hasFeed[f]) {
+      loaded[f] = stepTimes.size();
+      continue;
+    }
+    feedThreads[f].prefetch = this;
+    feedThreads[f].feed = f;
+    if (pthread_create(&threads[f], NULL, RunFeed, &feedThreads[f])) {
+      ERROR_LOGF("%s", "Failed to start a forcing prefetch thread");
+      return false;
+    }
+    started[f] = true;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+ForcingStep *ForcingPrefetch::Next() {
+  if (taken >= stepTimes.size()) {
+    return NULL;
+  }
+  size_t step = taken;
+  ForcingStep *slot = &slots[step % slots.size()];
+#ifndef _WIN32
+  pthread_mutex_lock(&lock);
+  released = step;
+  pthread_cond_broadcast(&takenCond);
+  for (int f = 0; f < FORCING_QTY; f++) {
+    while (loaded[f] <= step) {
+      pthread_cond_wait(&loadedCond, &lock);
+    }
+  }
+  taken = step + 1;
+  pthread_mutex_unlock(&lock);
+#endif
+  return slot;
+}
+
+void *ForcingPrefetch::RunFeed(void *arg) {
+  FeedThread *feedThread = (FeedThread *)arg;
+  feedThread->prefetch->LoadSteps(feedThread->feed);
+  return NULL;
+}
+
+void ForcingPrefetch::LoadSteps(int feed) {
+#ifndef _WIN32
+  PrecipReader precipReader;
+  PETReader petReader;
+  TempReader tempReader;
+  if (feed == FORCING_TEMP) {
+    tempReader.ReadDEM(tempDEM);
+  } else {
+    tempReader.SetNullDEM();
+  }
+  ForcingFeed *current = &feeds[feed];
+  ForcingFeed *fallback = hasFallback[feed] ? &fallbacks[feed] : NULL;
+
+  for (size_t step = 0; step < stepTimes.size(); step++) {
+    // The buffers of a step are free once the simulation has moved past the
+    // step they were used for last
+    pthread_mutex_lock(&lock);
+    while (!stop && step >= released + slots.size()) {
+      pthread_cond_wait(&takenCond, &lock);
+    }
+    bool done = stop;
+    pthread_mutex_unlock(&lock);
+    if (done) {
+      return;
+    }
+
+    ForcingStep *slot = &slots[step % slots.size()];
+    std::vector<float> *values = &(slot->values[feed]);
+    // A file that is read again keeps the values of the step before
+    std::vector<float> *prev =
+        (step > 0) ? &(slots[(step - 1) % slots.size()].values[feed]) : NULL;
+    TimeVar *now = &(stepTimes[step]);
+    if (current->time < *now) {
+      current->time.Increment(current->freq);
+      current->name.UpdateName(current->time.GetTM());
+    }
+    if (fallback && fallback->time < *now) {
+      fallback->time.Increment(fallback->freq);
+      fallback->name.UpdateName(fallback->time.GetTM());
+    }
+
+    char *file = slot->file[feed], *fallbackFile = slot->fallbackFile[feed];
+    sprintf(file, "%s/%s", current->loc, current->name.GetName());
+    fallbackFile[0] = 0;
+    if (fallback) {
+      sprintf(fallbackFile, "%s/%s", fallback->loc, fallback->name.GetName());
+    }
+    bool found = false, usedFallback = false;
+    switch (feed) {
+    case FORCING_PRECIP:
+      found = precipReader.Read(file, (SUPPORTED_PRECIP_TYPES)current->type,
+                                cells, values, current->convert, prev,
+                                fallback != NULL);
+      if (!found && fallback) {
+        found = precipReader.Read(
+            fallbackFile, (SUPPORTED_PRECIP_TYPES)fallback->type, cells,
+            values, fallback->convert, prev, false);
+        usedFallback = found;
+      }
+      break;
+    case FORCING_PET:
+      found = petReader.Read(file, (SUPPORTED_PET_TYPES)current->type, cells,
+                             values, current->convert, petIsTemp,
+                             (float)now->GetTM()->tm_yday, prev);
+      break;
+    case FORCING_TEMP:
+      found = tempReader.Read(file, (SUPPORTED_TEMP_TYPES)current->type, cells,
+                              values, prev, fallback != NULL);
+      if (!found && fallback) {
+        // LoadForcings reads the forecast temperature with the type of the
+        // observed one
+        found = tempReader.Read(fallbackFile,
+                                (SUPPORTED_TEMP_TYPES)current->type, cells,
+                                values, prev, false);
+        usedFallback = found;
+      }
+      break;
+    }
+    slot->missing[feed] = !found;
+    slot->usedFallback[feed] = usedFallback;
+
+    pthread_mutex_lock(&lock);
+    loaded[feed] = step + 1;
+    pthread_cond_broadcast(&loadedCond);
+    pthread_mutex_unlock(&lock);
+  }
+#endif
+}
@@ -0,0 +1,98 @@
+#ifndef FORCING_PREFETCH_H
+#define FORCING_PREFETCH_H
+
+#include "BasicGrids.h"
+#include "DatedName.h"
+#include "Defines.h"
+#include "TimeUnit.h"
+#include "TimeVar.h"
+#include <vector>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+enum FORCING_FEEDS {
+  FORCING_PRECIP,
+  FORCING_PET,
+  FORCING_TEMP,
+  FORCING_QTY
+};
+
+// A forcing as the simulator reads it, the file name and time are copies that
+// the prefetch thread of the forcing advances on its own
+struct ForcingFeed {
+  int type; // SUPPORTED_PRECIP_TYPES, SUPPORTED_PET_TYPES or TEMP_TYPES
+  char *loc;
+  DatedName name;
+  TimeVar time;
+  TimeUnit *freq;
+  float convert;
+};
+
+// The forcings of one time step. file holds the name of the file read for
+// each forcing and fallbackFile that of the forecast tried when it was
+// missing. missing is set when neither could be read, the values are then
+// zeros as LoadForcings leaves them.
+struct ForcingStep {
+  std::vector<float> values[FORCING_QTY];
+  char file[FORCING_QTY][CONFIG_MAX_LEN * 2];
+  char fallbackFile[FORCING_QTY][CONFIG_MAX_LEN * 2];
+  bool missing[FORCING_QTY];
+  bool usedFallback[FORCING_QTY];
+};
+
+// Reads the forcings of the coming time steps while the models run. Every
+// forcing gets a thread with its own reader that goes through the steps in
+// order, so a file is reused, skipped or replaced by its forecast exactly as
+// in Simulator::LoadForcings. The steps go into a ring of depth + 1 buffers,
+// a thread waits when it is depth steps ahead of the simulation.
+class ForcingPrefetch {
+
+public:
+  // stepTimes holds the model time of every step to be read, depth is how
+  // many steps the threads may get ahead of the one being simulated
+  ForcingPrefetch(std::vector<GridCell> *newCells,
+                  std::vector<TimeVar> *newStepTimes, int newDepth);
+  ~ForcingPrefetch();
+  // fallback may be NULL for each of these. Feeds not set are not read.
+  void SetPrecip(ForcingFeed *precip, ForcingFeed *qpf);
+  void SetPET(ForcingFeed *pet, bool isTemp);
+  void SetTemp(ForcingFeed *temp, ForcingFeed *tempF, char *demFile);
+  bool Start();
+  // Waits for the forcings of the next step, the previous step's buffers are
+  // handed back to the threads. NULL past the last step.
+  ForcingStep *Next();
+
+private:
+  // Threads take a pointer to one of these
+  struct FeedThread {
+    ForcingPrefetch *prefetch;
+    int feed;
+  };
+
+  void LoadSteps(int feed);
+  static void *RunFeed(void *arg);
+
+  std::vector<GridCell> *cells;
+  std::vector<TimeVar> stepTimes;
+  // depth + 1 buffers, step s goes in slots[s % slots.size()]
+  std::vector<ForcingStep> slots;
+  ForcingFeed feeds[FORCING_QTY], fallbacks[FORCING_QTY];
+  bool hasFeed[FORCING_QTY], hasFallback[FORCING_QTY];
+  bool petIsTemp;
+  char tempDEM[CONFIG_MAX_LEN * 2];
+  FeedThread feedThreads[FORCING_QTY];
+  // Steps each feed has loaded, the steps Next handed out and those whose
+  // buffers the threads may reuse
+  size_t loaded[FORCING_QTY];
+  size_t taken, released;
+  bool stop;
+#ifndef _WIN32
+  bool started[FORCING_QTY];
+  pthread_t threads[FORCING_QTY];
+  pthread_mutex_t lock;
+  pthread_cond_t loadedCond, takenCond;
+#endif
+};
+
+#endif
@@ -18,8 +18,8 @@ void GaugeMap::Initialize(std::vector<GaugeConfigSection *> *newGauges) {
   }
 
   // Initialize storage for the partial values contributing to each gauge
-  partialVal.resize(countGauges);
-  partialArea.resize(countGauges);
+  partialVal.resize(countGauges + 1);
+  partialArea.resize(countGauges + 1);
 }
 
 void GaugeMap::AddUpstreamGauge(GaugeConfigSection *downStream,
@@ -45,60 +45,78 @@ void GaugeMap::AddUpstreamGauge(GaugeConfigSection *downStream,
   }
 }
 
-void GaugeMap::GaugeAverage(std::vector<GridNode> *nodes,
+void GaugeMap::SetGaugeIndexes(std::vector<GridNode> *nodes,
+                               std::vector<GridCell> *cells) {
+  size_t countNodes = nodes->size();
+  for (size_t i = 0; i < countNodes; i++) {
+    GridNode *node = &((*nodes)[i]);
+    GridCell *cell = &((*cells)[i]);
+    std::map<GaugeConfigSection *, size_t>::iterator itr =
+        gaugeMap.find(node->gauge);
+    cell->gaugeIndex = (itr != gaugeMap.end()) ? itr->second : gauges.size();
+  }
+}
+
+void GaugeMap::GaugeAverage(std::vector<GridCell> *cells,
                             std::vector<float> *currentValue,
                             std::vector<float> *gaugeAvg) {
   size_t countGauges = gauges.size();
-  size_t countNodes = nodes->size();
+  size_t countNodes = cells->size();
 
   // Zero out the partial vectors
-  for (size_t i = 0; i < countGauges; i++) {
+  for (size_t i = 0; i <= countGauges; i++) {
     partialVal[i] = 0;
     partialArea[i] = 0;
   }
 
   // Add up contributions to each gauge
+  const GridCell *cell = &((*cells)[0]);
+  const float *value = &((*currentValue)[0]);
   for (size_t i = 0; i < countNodes; i++) {
-    GridNode *node = &((*nodes)[i]);
-    size_t gaugeIndex = gaugeMap[node->gauge];
-    partialVal[gaugeIndex] += ((*currentValue)[i] * node->area);
-    partialArea[gaugeIndex] += node->area;
+    size_t gaugeIndex = cell[i].gaugeIndex;
+    partialVal[gaugeIndex] += (value[i] * cell[i].area);
+    partialArea[gaugeIndex] += cell[i].area;
   }
 
+  FinishAverage(&(partialVal[0]), &(partialArea[0]), gaugeAvg);
+}
+
+void GaugeMap::FinishAverage(const float *sumVal, const float *sumArea,
+                             std::vector<float> *gaugeAvg) {
+  size_t countGauges = gauges.size();
   for (size_t i = 0; i < countGauges; i++) {
     float totalVal = 0;
     float totalArea = 0;
 
-    totalVal += partialVal[i];
-    totalArea += partialArea[i];
+    totalVal += sumVal[i];
+    totalArea += sumArea[i];
 
     std::vector<GaugeConfigSection *> *intGauges = &(gaugeTree[i]);
     for (size_t j = 0; j < intGauges->size(); j++) {
       size_t gaugeIndex = gaugeMap[intGauges->at(j)];
-      totalVal += partialVal[gaugeIndex];
-      totalArea += partialArea[gaugeIndex];
+      totalVal += sumVal[gaugeIndex];
+      totalArea += sumArea[gaugeIndex];
     }
 
     gaugeAvg->at(i) = (totalVal / totalArea);
   }
 }
 
-void GaugeMap::GetGaugeArea(std::vector<GridNode> *nodes,
+void GaugeMap::GetGaugeArea(std::vector<GridCell> *cells,
                             std::vector<float> *gaugeArea) {
 
   size_t countGauges = gauges.size();
-  size_t countNodes = nodes->size();
+  size_t countNodes = cells->size();
 
   // Zero out the partial vectors
-  for (size_t i = 0; i < countGauges; i++) {
+  for (size_t i = 0; i <= countGauges; i++) {
     partialArea[i] = 0;
   }
 
   // Add up contributions to each gauge
   for (size_t i = 0; i < countNodes; i++) {
-    GridNode *node = &((*nodes)[i]);
-    size_t gaugeIndex = gaugeMap[node->gauge];
-    partialArea[gaugeIndex] += node->area;
+    GridCell *cell = &((*cells)[i]);
+    partialArea[cell->gaugeIndex] += cell->area;
   }
 
   for (size_t i = 0; i < countGauges; i++) {
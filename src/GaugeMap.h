@@ -11,16 +11,28 @@ public:
   void Initialize(std::vector<GaugeConfigSection *> *newGauges);
   void AddUpstreamGauge(GaugeConfigSection *downStream,
                         GaugeConfigSection *upStream);
-  void GaugeAverage(std::vector<GridNode> *nodes,
+  // Sets the gaugeIndex of each cell to the index of its node's gauge here.
+  // Nodes whose gauge is not in the map are given gaugeIndex equal to the
+  // number of gauges and left out of every average.
+  void SetGaugeIndexes(std::vector<GridNode> *nodes,
+                       std::vector<GridCell> *cells);
+  void GaugeAverage(std::vector<GridCell> *cells,
                     std::vector<float> *currentValue,
                     std::vector<float> *gaugeAvg);
-  void GetGaugeArea(std::vector<GridNode> *nodes,
+  // Averages given in pieces. sumVal and sumArea hold GetNumSums() entries,
+  // the sums of value * area and of area over the cells with each
+  // gaugeIndex, and FinishAverage turns them into what GaugeAverage gives.
+  size_t GetNumSums() { return gauges.size() + 1; }
+  void FinishAverage(const float *sumVal, const float *sumArea,
+                     std::vector<float> *gaugeAvg);
+  void GetGaugeArea(std::vector<GridCell> *cells,
                     std::vector<float> *gaugeArea);
 
 private:
   std::vector<GaugeConfigSection *> gauges;
   std::vector<std::vector<GaugeConfigSection *> > gaugeTree;
   std::map<GaugeConfigSection *, size_t> gaugeMap;
+  // One entry per gauge plus a last one that cells without a gauge add to
   std::vector<float> partialVal, partialArea;
 };
 
@@ -15,6 +15,17 @@ struct RefLoc {
   float y;
 };
 
+// The part of a forcing grid a reader samples, as the box of DEM cell indices
+// of its cells (inclusive) and the box around their reference points. A
+// grid with as many columns and rows as the DEM is sampled by index, any
+// other through the reference points, decoders reading through a window keep
+// the rows and columns covering the box used.
+struct GridWindow {
+  long numCols, numRows;
+  long left, top, right, bottom;
+  BoundingBox extent;
+};
+
 class Grid {
 
 public:
@@ -83,6 +94,8 @@ public:
     data = NULL;
     backingStore = NULL;
     geoSet = false;
+    windowLeft = 0;
+    windowTop = 0;
   }
   ~FloatGrid() {
     if (data) {
@@ -101,6 +114,10 @@ public:
   float noData;
   float **data;
   float *backingStore;
+  // Grids read through a GridWindow only hold the window, data[0][0] is cell
+  // (windowLeft, windowTop) of the full grid. numCols, numRows and extent
+  // are always those of the full grid. Windows are kept in backingStore.
+  long windowLeft, windowTop;
 };
 
 class LongGrid : public Grid {
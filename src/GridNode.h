@@ -8,23 +8,36 @@
 
 struct BasicGridNode {};
 
+// The basin structure of a cell: its flow network, gauge and channel geometry.
+// Its location and area are in the GridCell with the same index, see below.
 struct GridNode {
-  long x;
-  long y;
-  RefLoc refLoc;
-  float slope;
   long fac;
-  float area;
-  float contribArea;
-  float horLen;
-  bool channelGridCell;
   GaugeConfigSection *gauge;
   unsigned long downStreamNode;
   unsigned long index;
   unsigned long modelIndex;
   BasicGridNode *modelNode;
+  float slope;
+  float contribArea;
+  float horLen;
+  bool channelGridCell;
 };
 
 typedef std::vector<GridNode> GridNodeVec;
 
+// The fields of a cell that the forcing readers and the gauge averages read
+// every time step. The simulator keeps these in an array parallel to its
+// GridNodes, so those loops pull 24 bytes per cell through cache instead of a
+// whole GridNode, and the setup code reads a cell's location and area from
+// here too. The models keep their own copies of the fields they step with.
+struct GridCell {
+  RefLoc refLoc;
+  int x;
+  int y;
+  float area;
+  unsigned int gaugeIndex; // Index of the cell's gauge in its GaugeMap
+};
+
+typedef std::vector<GridCell> GridCellVec;
+
 #endif
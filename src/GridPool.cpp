@@ -0,0 +1,90 @@
+#include "GridPool.h"
+
+// Rows are padded to a multiple of this many values
+#define GRID_POOL_ALIGN 16
+// Idle grids a pool keeps at most, readers rarely see more than one size
+#define GRID_POOL_MAX_IDLE 4
+
+static unsigned long gridsAllocated = 0, gridsReused = 0;
+
+GridPool::~GridPool() {
+  for (size_t i = 0; i < taken.size(); i++) {
+    delete taken[i].grid;
+  }
+  for (size_t i = 0; i < idle.size(); i++) {
+    delete idle[i].grid;
+  }
+}
+
+FloatGrid *GridPool::Take(long numCols, long numRows) {
+  PooledGrid pooled;
+  pooled.grid = NULL;
+  for (size_t i = 0; i < idle.size(); i++) {
+    if (idle[i].numCols == numCols && idle[i].numRows == numRows) {
+      pooled = idle[i];
+      idle.erase(idle.begin() + i);
+      break;
+    }
+  }
+
+  if (pooled.grid) {
+#if _OPENMP
+#pragma omp atomic
+#endif
+    gridsReused++;
+  } else {
+    pooled.grid = new FloatGrid();
+    pooled.numCols = numCols;
+    pooled.numRows = numRows;
+    // backingStore is what new returned so the grid can delete it, data
+    // starts at the first aligned value after it
+    long stride =
+        (numCols + GRID_POOL_ALIGN - 1) / GRID_POOL_ALIGN * GRID_POOL_ALIGN;
+    FloatGrid *grid = pooled.grid;
+    grid->backingStore = new float[stride * numRows + GRID_POOL_ALIGN];
+    size_t offset = ((size_t)grid->backingStore / sizeof(float)) %
+                    GRID_POOL_ALIGN;
+    float *first = grid->backingStore + (GRID_POOL_ALIGN - offset) %
+                                            GRID_POOL_ALIGN;
+    grid->data = new float *[numRows];
+    for (long i = 0; i < numRows; i++) {
+      grid->data[i] = first + i * stride;
+    }
+#if _OPENMP
+#pragma omp atomic
+#endif
+    gridsAllocated++;
+  }
+
+  FloatGrid *grid = pooled.grid;
+  grid->numCols = numCols;
+  grid->numRows = numRows;
+  grid->windowLeft = 0;
+  grid->windowTop = 0;
+  grid->geoSet = false;
+  taken.push_back(pooled);
+  return grid;
+}
+
+void GridPool::Give(FloatGrid *grid) {
+  if (!grid) {
+    return;
+  }
+  for (size_t i = 0; i < taken.size(); i++) {
+    if (taken[i].grid == grid) {
+      idle.push_back(taken[i]);
+      taken.erase(taken.begin() + i);
+      if (idle.size() > GRID_POOL_MAX_IDLE) {
+        delete idle[0].grid;
+        idle.erase(idle.begin());
+      }
+      return;
+    }
+  }
+  delete grid;
+}
+
+void GetGridPoolStats(unsigned long *allocated, unsigned long *reused) {
+  *allocated = gridsAllocated;
+  *reused = gridsReused;
+}
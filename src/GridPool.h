@@ -0,0 +1,35 @@
+#ifndef GRID_POOL_H
+#define GRID_POOL_H
+
+#include "Grid.h"
+#include <vector>
+
+// Grids a forcing reader reads its files into and gives back once it has
+// sampled them, so a run goes through the same few buffers instead of
+// allocating a grid for every file. A grid keeps its rows in a single block,
+// each row starting on a 64 byte boundary. Every reader has a pool of its own,
+// a pool is never used by two threads at once.
+class GridPool {
+public:
+  ~GridPool();
+  // A grid with numRows rows of numCols values, one given back with as many
+  // rows and columns when there is one. numCols and numRows are set and the
+  // window cleared, the rest is left for the caller to fill in.
+  FloatGrid *Take(long numCols, long numRows);
+  // Keeps a grid from Take for the next one, any other grid is deleted
+  void Give(FloatGrid *grid);
+
+private:
+  struct PooledGrid {
+    FloatGrid *grid;
+    long numCols, numRows;
+  };
+
+  // Grids handed out and those ready to be taken again, oldest first
+  std::vector<PooledGrid> taken, idle;
+};
+
+// Grids allocated and grids reused by all pools so far
+void GetGridPoolStats(unsigned long *allocated, unsigned long *reused);
+
+#endif
@@ -4,29 +4,29 @@
 
 extern LongGrid *g_DEM;
 
-void GridWriter::Initialize(std::vector<GridNode> *nodes) {
+void GridWriter::Initialize(std::vector<GridNode> *nodes,
+                            std::vector<GridCell> *cells) {
   maxX = 0;
   minX = LONG_MAX;
   maxY = 0;
   minY = LONG_MAX;
 
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    if (!node->gauge) {
+  for (size_t i = 0; i < nodes->size(); i++) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    if (node->x > maxX) {
-      maxX = node->x;
+    GridCell *cell = &(cells->at(i));
+    if (cell->x > maxX) {
+      maxX = cell->x;
     }
-    if (node->x < minX) {
-      minX = node->x;
+    if (cell->x < minX) {
+      minX = cell->x;
     }
-    if (node->y > maxY) {
-      maxY = node->y;
+    if (cell->y > maxY) {
+      maxY = cell->y;
     }
-    if (node->y < minY) {
-      minY = node->y;
+    if (cell->y < minY) {
+      minY = cell->y;
     }
   }
 
@@ -66,16 +66,17 @@ void GridWriter::Initialize(std::vector<GridNode> *nodes) {
 }
 
 void GridWriter::WriteGrid(std::vector<GridNode> *nodes,
+                           std::vector<GridCell> *cells,
                            std::vector<float> *data, const char *file,
                            bool ascii) {
 
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &(nodes->at(i));
-    if (!node->gauge) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y - minY][node->x - minX] = data->at(i);
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y - minY][cell->x - minX] = data->at(i);
   }
 
   if (ascii) {
@@ -97,16 +98,17 @@ void GridWriter::WriteGrid(std::vector<GridNode> *nodes,
 }
 
 void GridWriter::WriteGrid(std::vector<GridNode> *nodes,
+                           std::vector<GridCell> *cells,
                            std::vector<double> *data, const char *file,
                            bool ascii) {
 
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &(nodes->at(i));
-    if (!node->gauge) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y - minY][node->x - minX] = data->at(i);
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y - minY][cell->x - minX] = data->at(i);
   }
 
   if (ascii) {
@@ -9,11 +9,12 @@
 
 class GridWriter {
 public:
-  void Initialize(std::vector<GridNode> *nodes);
-  void WriteGrid(std::vector<GridNode> *nodes, std::vector<float> *data,
-                 const char *file, bool ascii = true);
-  void WriteGrid(std::vector<GridNode> *nodes, std::vector<double> *data,
-                 const char *file, bool ascii = true);
+  void Initialize(std::vector<GridNode> *nodes, std::vector<GridCell> *cells);
+  void WriteGrid(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
+                 std::vector<float> *data, const char *file, bool ascii = true);
+  void WriteGrid(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
+                 std::vector<double> *data, const char *file,
+                 bool ascii = true);
 
 private:
   FloatGrid grid;
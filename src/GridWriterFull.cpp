@@ -34,16 +34,17 @@ void GridWriterFull::Initialize() {
 }
 
 void GridWriterFull::WriteGrid(std::vector<GridNode> *nodes,
+                               std::vector<GridCell> *cells,
                                std::vector<float> *data, const char *file,
                                bool ascii) {
 
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &(nodes->at(i));
-    if (!node->gauge) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y][node->x] = data->at(i);
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y][cell->x] = data->at(i);
   }
 
   if (ascii) {
@@ -63,16 +64,17 @@ void GridWriterFull::WriteGrid(std::vector<GridNode> *nodes,
 }
 
 void GridWriterFull::WriteGrid(std::vector<GridNode> *nodes,
+                               std::vector<GridCell> *cells,
                                std::vector<double> *data, const char *file,
                                bool ascii) {
 
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &(nodes->at(i));
-    if (!node->gauge) {
+    if (!nodes->at(i).gauge) {
       continue;
     }
-    grid.data[node->y][node->x] = data->at(i);
+    GridCell *cell = &(cells->at(i));
+    grid.data[cell->y][cell->x] = data->at(i);
   }
 
   if (ascii) {
@@ -10,10 +10,11 @@
 class GridWriterFull {
 public:
   void Initialize();
-  void WriteGrid(std::vector<GridNode> *nodes, std::vector<float> *data,
-                 const char *file, bool ascii = true);
-  void WriteGrid(std::vector<GridNode> *nodes, std::vector<double> *data,
-                 const char *file, bool ascii = true);
+  void WriteGrid(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
+                 std::vector<float> *data, const char *file, bool ascii = true);
+  void WriteGrid(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
+                 std::vector<double> *data, const char *file,
+                 bool ascii = true);
 
 private:
   FloatGrid grid;
@@ -9,11 +9,12 @@ HPModel::HPModel() {}
 HPModel::~HPModel() {}
 
 bool HPModel::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
+  gridCells = newCells;
   if (hpNodes.size() != nodes->size()) {
     hpNodes.resize(nodes->size());
   }
@@ -41,14 +42,75 @@ bool HPModel::WaterBalance(float stepHours, std::vector<float> *precip,
                            std::vector<float> *slowFlow,
                            std::vector<float> *soilMoisture) {
 
-  size_t numNodes = nodes->size();
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
 
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    HPGridNode *cNode = &(hpNodes[i]);
-    WaterBalanceInt(node, cNode, stepHours, precip->at(i), pet->at(i),
-                    &(fastFlow->at(i)), &(slowFlow->at(i)));
-    soilMoisture->at(i) = 100.0;
+  RunCells(stepHours, NULL, 0, numNodes, &(precip->at(0)), &(pet->at(0)),
+           &(fastFlow->at(0)), &(slowFlow->at(0)), &(soilMoisture->at(0)));
+
+  return true;
+}
+
+long HPModel::StepCells(float stepHours, long begin, long end,
+                        const float *precip, const float *pet,
+                        float *fastFlow, float *slowFlow,
+                        float *soilMoisture) {
+  RunCells(stepHours, NULL, begin, end, precip, pet, fastFlow, slowFlow,
+           soilMoisture);
+  return 0;
+}
+
+long HPModel::StepList(float stepHours, const long *list, long count,
+                       const float *precip, const float *pet, float *fastFlow,
+                       float *slowFlow, float *soilMoisture) {
+  RunCells(stepHours, list, 0, count, precip, pet, fastFlow, slowFlow,
+           soilMoisture);
+  return 0;
+}
+
+void HPModel::RunCells(float stepHours, const long *list, long begin,
+                       long end, const float *precip, const float *pet,
+                       float *fastFlow, float *slowFlow,
+                       float *soilMoisture) {
+  for (long j = begin; j < end; j++) {
+    long i = list ? list[j] : j;
+    WaterBalanceInt(&(nodes->at(i)), &(hpNodes[i]), stepHours, precip[i],
+                    pet[i], &(fastFlow[i]), &(slowFlow[i]));
+    soilMoisture[i] = 100.0;
+  }
+}
+
+bool HPModel::WaterBalanceBlock(float stepHours, int numSteps,
+                                std::vector<float> *precip,
+                                std::vector<float> *pet,
+                                std::vector<double> *fastFlow,
+                                std::vector<double> *slowFlow,
+                                std::vector<float> *soilMoisture) {
+
+  long numNodes = (long)nodes->size();
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    for (int k = 0; k < numSteps; k++) {
+      for (long i = begin; i < end; i++) {
+        float fast = 0.0, slow = 0.0;
+        WaterBalanceInt(&(nodes->at(i)), &(hpNodes[i]), stepHours,
+                        precip[k][i], pet[k][i], &fast, &slow);
+        fastFlow[k][i] = fast;
+        slowFlow[k][i] = slow;
+        if (soilMoisture) {
+          soilMoisture[k][i] = 100.0;
+        }
+      }
+    }
   }
 
   return true;
@@ -76,6 +138,7 @@ void HPModel::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     HPGridNode *cNode = &(hpNodes[i]);
     if (!node->gauge) {
       unused++;
@@ -90,12 +153,12 @@ void HPModel::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_HP_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        cNode->params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
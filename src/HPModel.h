@@ -13,6 +13,7 @@ public:
   HPModel();
   ~HPModel();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath);
@@ -22,10 +23,41 @@ public:
                     std::vector<float> *pet, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *soilMoisture);
+  bool WaterBalanceBlock(float stepHours, int numSteps,
+                         std::vector<float> *precip, std::vector<float> *pet,
+                         std::vector<double> *fastFlow,
+                         std::vector<double> *slowFlow,
+                         std::vector<float> *soilMoisture);
+  // Calibration runs the parameter sets one at a time instead
+  bool InitializeSets(std::vector<GridNode> *newNodes,
+                      std::vector<GridCell> *newCells, int numSets,
+                      std::map<GaugeConfigSection *, float *> *paramSettings,
+                      std::vector<FloatGrid *> *paramGrids) {
+    return false;
+  }
+  bool WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                        std::vector<float> *pet, std::vector<float> *fastFlow,
+                        std::vector<float> *slowFlow) {
+    return false;
+  }
   bool IsLumped() { return false; }
   const char *GetName() { return "hp"; }
+  // Tile access for SimEngine, see CRESTModel. HP never keeps runoff from
+  // going negative, so StepCells and StepList always return 0.
+  void BeginStep(float stepHours) {}
+  long StepCells(float stepHours, long begin, long end, const float *precip,
+                 const float *pet, float *fastFlow, float *slowFlow,
+                 float *soilMoisture);
+  long StepList(float stepHours, const long *list, long count,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
+  void EndStep(long numNegative) {}
 
 private:
+  // Runs list[begin] to list[end - 1], or begin to end - 1 when list is NULL
+  void RunCells(float stepHours, const long *list, long begin, long end,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
   void WaterBalanceInt(GridNode *node, HPGridNode *cNode, float stepHours,
                        float precipIn, float petIn, float *fastFlow,
                        float *slowFlow);
@@ -34,6 +66,7 @@ private:
                        std::vector<FloatGrid *> *paramGrids);
 
   std::vector<GridNode> *nodes;
+  std::vector<GridCell> *gridCells;
   std::vector<HPGridNode> hpNodes;
 };
 
@@ -9,11 +9,12 @@ HyMOD::HyMOD() {}
 HyMOD::~HyMOD() {}
 
 bool HyMOD::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
+  gridCells = newCells;
   if (hymodNodes.size() != nodes->size()) {
     hymodNodes.resize(nodes->size());
   }
@@ -64,6 +65,34 @@ bool HyMOD::WaterBalance(float stepHours, std::vector<float> *precip,
   return true;
 }
 
+bool HyMOD::WaterBalanceBlock(float stepHours, int numSteps,
+                              std::vector<float> *precip,
+                              std::vector<float> *pet,
+                              std::vector<double> *fastFlow,
+                              std::vector<double> *slowFlow,
+                              std::vector<float> *soilMoisture) {
+
+  size_t numNodes = nodes->size();
+
+  // The lumped model has few nodes, so the steps are simply run in order
+  for (int k = 0; k < numSteps; k++) {
+    for (size_t i = 0; i < numNodes; i++) {
+      GridNode *node = &nodes->at(i);
+      HyMODGridNode *cNode = (HyMODGridNode *)node->modelNode;
+      WaterBalanceInt(node, cNode, stepHours, precip[k].at(i), pet[k].at(i));
+      LocalRouteQF(node, cNode, stepHours);
+      LocalRouteSF(node, cNode, stepHours);
+      fastFlow[k].at(i) = cNode->dischargeQF;
+      slowFlow[k].at(i) = cNode->dischargeSF;
+      if (soilMoisture) {
+        soilMoisture[k].at(i) = 0;
+      }
+    }
+  }
+
+  return true;
+}
+
 void HyMOD::WaterBalanceInt(GridNode *node, HyMODGridNode *cNode,
                             float stepHours, float precipIn, float petIn) {
 
@@ -74,7 +103,7 @@ void HyMOD::WaterBalanceInt(GridNode *node, HyMODGridNode *cNode,
 
   float Cbeg =
       cNode->CPar * (1 - pow(1 - (cNode->XHuz / cNode->params[PARAM_HYMOD_HUZ]),
-                             1 + cNode->b)); // Contents at begining
+                             cNode->bPlus1)); // Contents at begining
   float OV2 = std::max(
       0.0f, precip + cNode->XHuz -
                 cNode->params[PARAM_HYMOD_HUZ]); // Compute OV2 if enough PP
@@ -82,7 +111,7 @@ void HyMOD::WaterBalanceInt(GridNode *node, HyMODGridNode *cNode,
   float Hint = std::min(cNode->params[PARAM_HYMOD_HUZ],
                         PPinf + cNode->XHuz); // Intermediate height
   float Cint = cNode->CPar * (1 - pow(1 - Hint / cNode->params[PARAM_HYMOD_HUZ],
-                                      1 + cNode->b)); // Intermediate contents
+                                      cNode->bPlus1)); // Intermediate contents
   float OV1 = std::max(0.0f, PPinf + Cbeg - Cint);    // Compute OV1
   float OV = OV1 + OV2;                               // Compute total OV
   float ET = std::min(pet, Cint);                     // Compute ET
@@ -91,7 +120,7 @@ void HyMOD::WaterBalanceInt(GridNode *node, HyMODGridNode *cNode,
       cNode->params[PARAM_HYMOD_HUZ] *
       (1 -
        pow(1 - Cend / cNode->CPar,
-           1 / (1 + cNode->b))); // Final height corresponding to SMA contents
+           cNode->bInv)); // Final height corresponding to SMA contents
 
   // Update states
   cNode->XHuz = Hend;
@@ -143,6 +172,8 @@ void HyMOD::InitializeParameters(
 
     // Some of the parameters are special, deal with that here
     cNode->b = log(1.0 - cNode->params[PARAM_HYMOD_B] / 2.0) / log(0.5);
+    cNode->bPlus1 = 1 + cNode->b;
+    cNode->bInv = 1 / (1 + cNode->b);
     cNode->CPar = cNode->params[PARAM_HYMOD_HUZ] / (1 + cNode->b);
     cNode->numQF = (int)cNode->params[PARAM_HYMOD_NQ];
 
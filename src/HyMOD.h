@@ -11,6 +11,8 @@ struct HyMODGridNode : BasicGridNode {
 
   // Params that aren't directly specified
   double CPar, b;
+  // 1 + b and 1 / (1 + b), the exponents of the storage curve
+  double bPlus1, bInv;
   int numQF;
 
   // States
@@ -28,6 +30,7 @@ public:
   HyMOD();
   ~HyMOD();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath);
@@ -37,6 +40,23 @@ public:
                     std::vector<float> *pet, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *soilMoisture);
+  bool WaterBalanceBlock(float stepHours, int numSteps,
+                         std::vector<float> *precip, std::vector<float> *pet,
+                         std::vector<double> *fastFlow,
+                         std::vector<double> *slowFlow,
+                         std::vector<float> *soilMoisture);
+  // Calibration runs the parameter sets one at a time instead
+  bool InitializeSets(std::vector<GridNode> *newNodes,
+                      std::vector<GridCell> *newCells, int numSets,
+                      std::map<GaugeConfigSection *, float *> *paramSettings,
+                      std::vector<FloatGrid *> *paramGrids) {
+    return false;
+  }
+  bool WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                        std::vector<float> *pet, std::vector<float> *fastFlow,
+                        std::vector<float> *slowFlow) {
+    return false;
+  }
   bool IsLumped() { return true; }
   const char *GetName() { return "hymod"; }
 
@@ -49,6 +69,7 @@ private:
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings);
 
   std::vector<GridNode> *nodes;
+  std::vector<GridCell> *gridCells;
   std::vector<HyMODGridNode> hymodNodes;
 };
 
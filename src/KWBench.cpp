@@ -0,0 +1,165 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "KWSolver.h"
+
+#define NUM_EQUATIONS (KW_BATCH_SIZE * 4096)
+#define NUM_REPEATS 10
+
+// Times the scalar, batched and warm started kinematic wave solvers on the
+// same set of equations and reports how far apart their answers are and how
+// many Newton iterations each needed, along with the error of KWFastPow
+// against pow. The equations are made twice, once with inflows unrelated to
+// the previous flows and once with inflows within 10% of them, as from one
+// time step to the next in a run.
+
+struct Equations {
+  std::vector<float> stepRatio, alpha, beta, rhs, estq;
+  std::vector<float> warmEstq, warmStore;
+};
+
+static float RandomRange(float low, float high) {
+  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+// Inflows are within change of the previous flow, or anywhere from 0 to 500
+// when change is negative
+void MakeEquations(Equations *eq, float change) {
+  eq->stepRatio.resize(NUM_EQUATIONS);
+  eq->alpha.resize(NUM_EQUATIONS);
+  eq->beta.resize(NUM_EQUATIONS);
+  eq->rhs.resize(NUM_EQUATIONS);
+  eq->estq.resize(NUM_EQUATIONS);
+  eq->warmEstq.resize(NUM_EQUATIONS);
+  eq->warmStore.resize(NUM_EQUATIONS);
+  for (size_t i = 0; i < NUM_EQUATIONS; i++) {
+    float horLen = RandomRange(90.0, 1100.0);
+    float alpha = RandomRange(0.5, 5.0);
+    float beta = RandomRange(0.5, 0.8);
+    float prevQ = (i % 16 == 0) ? 0.0 : RandomRange(0.0, 500.0);
+    float inflow = (i % 8 == 0) ? 0.0 : RandomRange(0.0, 500.0);
+    if (change >= 0.0 && prevQ > 0.0) {
+      inflow = prevQ * RandomRange(1.0 - change, 1.0 + change);
+    }
+    float inWater = RandomRange(0.0, 0.01);
+    KWSetupEquation(3600.0, horLen, inflow, prevQ, inWater, alpha, beta,
+                    &(eq->stepRatio[i]), &(eq->rhs[i]), &(eq->estq[i]));
+    eq->alpha[i] = alpha;
+    eq->beta[i] = beta;
+    eq->warmStore[i] = alpha * pow(prevQ, beta);
+    eq->warmEstq[i] = KWWarmEstimate(3600.0, horLen, inflow, prevQ, inWater,
+                                     alpha, beta, &(eq->warmStore[i]));
+  }
+}
+
+double TimeScalar(Equations *eq, std::vector<float> *q, long *iterations) {
+  clock_t start = clock();
+  for (int r = 0; r < NUM_REPEATS; r++) {
+    for (size_t i = 0; i < NUM_EQUATIONS; i++) {
+      q->at(i) = KWNewtonSolve(eq->stepRatio[i], eq->alpha[i], eq->beta[i],
+                               eq->rhs[i], eq->estq[i], iterations);
+    }
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+double TimeBatch(Equations *eq, std::vector<float> *q, long *iterations) {
+  clock_t start = clock();
+  for (int r = 0; r < NUM_REPEATS; r++) {
+    for (size_t i = 0; i < NUM_EQUATIONS; i += KW_BATCH_SIZE) {
+      for (size_t k = 0; k < KW_BATCH_SIZE; k++) {
+        q->at(i + k) = eq->estq[i + k];
+      }
+      *iterations += KWNewtonSolveBatch(&(eq->stepRatio[i]), &(eq->alpha[i]),
+                                        &(eq->beta[i]), &(eq->rhs[i]),
+                                        &(q->at(i)), KW_BATCH_SIZE);
+    }
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+double TimeWarm(Equations *eq, std::vector<float> *q, long *iterations) {
+  float store;
+  clock_t start = clock();
+  for (int r = 0; r < NUM_REPEATS; r++) {
+    for (size_t i = 0; i < NUM_EQUATIONS; i++) {
+      q->at(i) = KWNewtonSolveWarm(eq->stepRatio[i], eq->alpha[i], eq->beta[i],
+                                   eq->rhs[i], eq->warmEstq[i],
+                                   eq->warmStore[i], &store, iterations);
+    }
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+double MaxDifference(std::vector<float> *a, std::vector<float> *b) {
+  double maxDiff = 0.0;
+  for (size_t i = 0; i < NUM_EQUATIONS; i++) {
+    double diff = fabs(a->at(i) - b->at(i));
+    if (a->at(i) > 1.0) {
+      diff /= a->at(i);
+    }
+    if (diff > maxDiff) {
+      maxDiff = diff;
+    }
+  }
+  return maxDiff;
+}
+
+void CheckFastPow() {
+  double maxError = 0.0;
+  float worstX = 0.0, worstY = 0.0;
+  for (float y = -1.0; y <= 1.0; y += 0.05) {
+    for (float x = 1e-6; x < 1e6; x *= 1.0001) {
+      double exact = pow((double)x, (double)y);
+      double error = fabs(KWFastPow(x, y) - exact) / exact;
+      if (error > maxError) {
+        maxError = error;
+        worstX = x;
+        worstY = y;
+      }
+    }
+  }
+  printf("KWFastPow max relative error %g at %g^%g\n", maxError, worstX,
+         worstY);
+}
+
+void RunSolvers(float change) {
+  Equations eq;
+  std::vector<float> scalarQ(NUM_EQUATIONS), batchQ(NUM_EQUATIONS),
+      warmQ(NUM_EQUATIONS);
+  long scalarIterations = 0, batchIterations = 0, warmIterations = 0;
+  double numSolves = (double)NUM_EQUATIONS * NUM_REPEATS;
+
+  MakeEquations(&eq, change);
+
+  double scalarTime = TimeScalar(&eq, &scalarQ, &scalarIterations);
+  double batchTime = TimeBatch(&eq, &batchQ, &batchIterations);
+  double warmTime = TimeWarm(&eq, &warmQ, &warmIterations);
+  if (change < 0.0) {
+    printf("Solved %i equations %i times, unrelated inflows\n", NUM_EQUATIONS,
+           NUM_REPEATS);
+  } else {
+    printf("Solved %i equations %i times, inflows within %g%%\n",
+           NUM_EQUATIONS, NUM_REPEATS, change * 100.0);
+  }
+  printf("Scalar: %.3f s, %.3f iterations per solve\n", scalarTime,
+         scalarIterations / numSolves);
+  printf("Batch: %.3f s, %.3f iterations per solve, speedup %.2fx\n",
+         batchTime, batchIterations / numSolves, scalarTime / batchTime);
+  printf("Warm: %.3f s, %.3f iterations per solve, speedup %.2fx\n", warmTime,
+         warmIterations / numSolves, scalarTime / warmTime);
+  printf("Largest difference from scalar, batch %g, warm %g\n",
+         MaxDifference(&scalarQ, &batchQ), MaxDifference(&scalarQ, &warmQ));
+}
+
+int main(int argc, char *argv[]) {
+  srand(1);
+  CheckFastPow();
+  RunSolvers(-1.0);
+  RunSolvers(0.1);
+
+  return 0;
+}
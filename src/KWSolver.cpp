@@ -0,0 +1,233 @@
+#include "KWSolver.h"
+#include <cmath>
+#include <cstring>
+#include <math.h>
+
+void KWSetupEquation(float stepSeconds, float horLen, double inflow,
+                     float prevQ, float inWater, float alpha, float beta,
+                     float *stepRatio, float *rhs, float *estq) {
+  float A, B, C, D, E;
+  float backDiffq = 0.0;
+  if (inflow + prevQ > 0.0) {
+    backDiffq = pow((inflow + prevQ) / 2.0, beta - 1.0);
+    if (!std::isfinite(backDiffq)) {
+      backDiffq = 0.0;
+    }
+  }
+  A = (stepSeconds / horLen) * inflow;
+  B = alpha * beta * prevQ * backDiffq;
+  C = stepSeconds * inWater;
+  D = stepSeconds / horLen;
+  E = alpha * beta * backDiffq;
+  *estq = (A + B + C) / (D + E);
+  *rhs = A + alpha * pow(prevQ, beta) + stepSeconds * inWater;
+  *stepRatio = D;
+}
+
+float KWNewtonSolve(float stepRatio, float alpha, float beta, float rhs,
+                    float estq, long *iterations) {
+  int itr;
+  for (itr = 0; itr < 10; itr++) {
+    float resError = stepRatio * estq + alpha * pow(estq, beta) - rhs;
+    if (!std::isfinite(resError)) {
+      resError = 0.0;
+    }
+    if (fabsf(resError) < KW_RESIDUAL_TOLERANCE) {
+      break;
+    }
+    float resErrorD1 = stepRatio + alpha * beta * pow(estq, beta - 1.0);
+    if (!std::isfinite(resErrorD1)) {
+      resErrorD1 = 1.0;
+    }
+    estq = estq - resError / resErrorD1;
+    if (estq < 0) {
+      estq = 0.0;
+    }
+  }
+  *iterations += itr;
+  if (estq < 0) {
+    estq = 0.0;
+  }
+  return estq;
+}
+
+float KWWarmEstimate(float stepSeconds, float horLen, double inflow,
+                     float prevQ, float inWater, float alpha, float beta,
+                     float *estStore) {
+  float stepRatio = stepSeconds / horLen;
+  float prevStore = (prevQ > 0.0) ? *estStore : 0.0;
+  float rhs = stepRatio * inflow + prevStore + stepSeconds * inWater;
+
+  // The linearized solution of KWSetupEquation, without its second pow
+  float backDiffq = 0.0;
+  if (inflow + prevQ > 0.0) {
+    backDiffq = pow((inflow + prevQ) / 2.0, beta - 1.0);
+    if (!std::isfinite(backDiffq)) {
+      backDiffq = 0.0;
+    }
+  }
+  float slope = alpha * beta * backDiffq;
+  float estq = (stepRatio * inflow + slope * prevQ + stepSeconds * inWater) /
+               (stepRatio + slope);
+  *estStore = (estq > 0.0) ? alpha * pow(estq, beta) : 0.0;
+  if (prevQ <= 0.0) {
+    return estq;
+  }
+
+  // A Halley step from the previous flow, whose residual and derivatives are
+  // known from prevStore. It is kept when it is closer to the solution.
+  float res = stepRatio * prevQ + prevStore - rhs;
+  float d1 = stepRatio + beta * prevStore / prevQ;
+  float d2 = beta * (beta - 1.0f) * prevStore / (prevQ * prevQ);
+  float warmq = prevQ - 2.0f * res * d1 / (2.0f * d1 * d1 - res * d2);
+  if (!(warmq > 0.0) || !std::isfinite(warmq)) {
+    return estq;
+  }
+  float warmStore = alpha * pow(warmq, beta);
+  if (fabsf(stepRatio * warmq + warmStore - rhs) <
+      fabsf(stepRatio * estq + *estStore - rhs)) {
+    *estStore = warmStore;
+    return warmq;
+  }
+  return estq;
+}
+
+float KWNewtonSolveWarm(float stepRatio, float alpha, float beta, float rhs,
+                        float estq, float estStore, float *store,
+                        long *iterations) {
+  float powq = estStore;
+  int itr;
+  for (itr = 0; itr < 10; itr++) {
+    float resError = stepRatio * estq + powq - rhs;
+    if (!std::isfinite(resError) || fabsf(resError) < KW_RESIDUAL_TOLERANCE) {
+      break;
+    }
+    float resErrorD1 = stepRatio + beta * powq / estq;
+    if (!std::isfinite(resErrorD1)) {
+      resErrorD1 = 1.0;
+    }
+    estq = estq - resError / resErrorD1;
+    if (estq < 0) {
+      estq = 0.0;
+    }
+    powq = alpha * pow(estq, beta);
+  }
+  *iterations += itr;
+  *store = powq;
+  return estq;
+}
+
+static inline int FloatToBits(float f) {
+  int i;
+  memcpy(&i, &f, sizeof(i));
+  return i;
+}
+
+static inline float BitsToFloat(int i) {
+  float f;
+  memcpy(&f, &i, sizeof(f));
+  return f;
+}
+
+static inline float FastLog2(float x) {
+  // Split x into m * 2^e with m in [sqrt(1/2), sqrt(2)), then
+  // log2(m) = 2 / ln(2) * atanh(t) with t = (m - 1) / (m + 1). |t| < 0.172 so
+  // the series below is good to 4e-8.
+  int bits = FloatToBits(x);
+  int e = ((bits >> 23) & 0xff) - 127;
+  int mantissa = bits & 0x007fffff;
+  int big = (mantissa > 0x3504f3) ? 1 : 0; // m > sqrt(2)
+  float m = BitsToFloat(mantissa | (big ? 0x3f000000 : 0x3f800000));
+  e += big;
+  float t = (m - 1.0f) / (m + 1.0f);
+  float t2 = t * t;
+  float p = t * (2.88539008f +
+                 t2 * (0.961796694f + t2 * (0.577078016f + t2 * 0.412198583f)));
+  return (float)e + p;
+}
+
+static inline float FastExp2(float z) {
+  // 2^z = 2^n * e^(f * ln(2)) with n the nearest integer and |f| <= 0.5, the
+  // Taylor series to the 6th power is good to 2e-7.
+  float half = z + 0.5f;
+  int n = (int)half;
+  n -= (half < (float)n) ? 1 : 0;
+  float f = z - (float)n;
+  float p =
+      1.0f +
+      f * (0.693147181f +
+           f * (0.240226507f +
+                f * (0.0555041087f +
+                     f * (0.00961812911f +
+                          f * (0.00133335581f + f * 0.000154035304f)))));
+  int bits = (n + 127) << 23;
+  bits = (n < -126) ? 0 : bits;
+  bits = (n > 127) ? 0x7f800000 : bits;
+  return p * BitsToFloat(bits);
+}
+
+float KWFastPow(float x, float y) { return FastExp2(y * FastLog2(x)); }
+
+long KWNewtonSolveBatch(const float *stepRatio, const float *alpha,
+                        const float *beta, const float *rhs, float *q,
+                        int count) {
+  int done[KW_BATCH_SIZE];
+  float zeroD1[KW_BATCH_SIZE];
+  for (int k = 0; k < count; k++) {
+    done[k] = 0;
+    // The derivative at q = 0, where q^(beta - 1) is infinite for beta < 1
+    // and the scalar solver falls back to 1.
+    if (beta[k] < 1.0f) {
+      zeroD1[k] = 1.0f;
+    } else if (beta[k] == 1.0f) {
+      zeroD1[k] = stepRatio[k] + alpha[k];
+    } else {
+      zeroD1[k] = stepRatio[k];
+    }
+  }
+
+  // The lanes are kept free of branches. Compilers will not vectorize a loop
+  // where a floating point operation only happens on some paths unless trapping
+  // math is turned off, so both sides of every choice are computed and the
+  // right one is picked.
+  long iterations = 0;
+  int active = count;
+  for (int itr = 0; itr < 10 && active > 0; itr++) {
+    active = 0;
+#if _OPENMP >= 201307
+#pragma omp simd reduction(+ : active)
+#endif
+    for (int k = 0; k < count; k++) {
+      float estq = q[k];
+      int positive = (estq > 0.0f) ? 1 : 0;
+      float safeq = estq * (float)positive + (float)(1 - positive);
+      // q^(beta - 1) comes from q^beta / q, it stays finite for any q > 0 in
+      // single precision so unlike the scalar solver the derivative needs no
+      // check.
+      float powq = FastExp2(beta[k] * FastLog2(safeq)) * (float)positive;
+      float resError = stepRatio[k] * estq + alpha[k] * powq - rhs[k];
+      float posD1 = stepRatio[k] + alpha[k] * beta[k] * powq / safeq;
+      float resErrorD1 =
+          posD1 * (float)positive + zeroD1[k] * (float)(1 - positive);
+      // A residual that is not finite counts as converged, as in the scalar
+      // solver. The tests are done on the bits, for positive floats their
+      // order matches that of the integers.
+      int absBits = FloatToBits(resError) & 0x7fffffff;
+      int converged =
+          (absBits < FloatToBits((float)KW_RESIDUAL_TOLERANCE)) ? 1 : 0;
+      converged |= (absBits >= 0x7f800000) ? 1 : 0;
+      converged |= done[k];
+      resError = converged ? 0.0f : resError;
+      float newq = estq - resError / resErrorD1;
+      q[k] = (newq < 0.0f) ? 0.0f : newq;
+      done[k] = converged;
+      active += 1 - converged;
+    }
+    iterations += active;
+  }
+
+  for (int k = 0; k < count; k++) {
+    q[k] = (q[k] < 0.0f) ? 0.0f : q[k];
+  }
+  return iterations;
+}
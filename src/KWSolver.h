@@ -0,0 +1,59 @@
+#ifndef KW_SOLVER_H
+#define KW_SOLVER_H
+
+// Largest number of equations handed to KWNewtonSolveBatch at once
+#define KW_BATCH_SIZE 64
+
+// Residual at which every solver stops iterating
+#define KW_RESIDUAL_TOLERANCE 0.01
+
+// Sets up the implicit step of the kinematic wave equation for one cell,
+// stepRatio * q + alpha * q^beta = rhs, given the inflow from upstream, the
+// previous flow and the water added this step. estq is the solution of the
+// equation linearized around the average of inflow and previous flow.
+void KWSetupEquation(float stepSeconds, float horLen, double inflow,
+                     float prevQ, float inWater, float alpha, float beta,
+                     float *stepRatio, float *rhs, float *estq);
+
+// Solves stepRatio * q + alpha * q^beta = rhs for q >= 0 with Newton's method
+// starting from estq. This is the solver used for every cell by the default
+// kinematic wave solver. The number of Newton updates made is added to
+// *iterations.
+float KWNewtonSolve(float stepRatio, float alpha, float beta, float rhs,
+                    float estq, long *iterations);
+
+// Starting estimate for KWNewtonSolveWarm. This is the linearized solution of
+// KWSetupEquation, or a Halley step from the previous flow prevQ when that
+// leaves a smaller residual. alpha * prevQ^beta is already known from the
+// last step and passed in *estStore, so the step from prevQ needs no pow of
+// its own. *estStore is set to alpha * estimate^beta.
+float KWWarmEstimate(float stepSeconds, float horLen, double inflow,
+                     float prevQ, float inWater, float alpha, float beta,
+                     float *estStore);
+
+// Same equation and tolerance as KWNewtonSolve with estStore =
+// alpha * estq^beta. Each iteration makes a single call to pow since the
+// derivative alpha * beta * q^(beta - 1) is taken from beta * alpha * q^beta /
+// q. *store is set to alpha * q^beta at the solution so the next step can
+// reuse it.
+float KWNewtonSolveWarm(float stepRatio, float alpha, float beta, float rhs,
+                        float estq, float estStore, float *store,
+                        long *iterations);
+
+// Same as KWNewtonSolve for count independent equations at once. q holds the
+// starting estimates on entry and the solutions on exit. All lanes iterate
+// together, a lane stops updating once it has converged and the loop ends when
+// every lane has. Powers are evaluated with KWFastPow. Returns the number of
+// Newton updates made summed over the lanes.
+long KWNewtonSolveBatch(const float *stepRatio, const float *alpha,
+                        const float *beta, const float *rhs, float *q,
+                        int count);
+
+// x^y for x > 0 evaluated as exp2(y * log2(x)) with polynomials instead of
+// calls into libm. The relative error is below 1.1e-6 while |y * log2(x)| < 16,
+// which covers flows from 1e-5 to 1e5 for exponents up to 1, and grows in
+// proportion to |y * log2(x)| beyond that (4e-6 at 64). Results under 2^-126
+// flush to 0 and results over 2^127 overflow. KWBench checks the bound.
+float KWFastPow(float x, float y);
+
+#endif
@@ -17,6 +17,7 @@ void InitializeKW();
 void SimulateRouting();
 
 std::vector<GridNode> nodes;
+std::vector<GridCell> gridCells;
 RoutingModel *rModel;
 std::map<GaugeConfigSection *, float *> fullParamSettingsRoute;
 std::vector<float> currentFF, currentSF, currentQ;
@@ -42,16 +43,18 @@ void InitializeKW() {
   rModel = new KWRoute();
 
   nodes.resize(NUM_GRID_CELLS);
+  gridCells.resize(NUM_GRID_CELLS);
   currentQ.resize(nodes.size());
   currentSF.resize(nodes.size());
   currentFF.resize(nodes.size());
   for (int currentNode = 0; currentNode < NUM_GRID_CELLS; currentNode++) {
     GridNode *currentN = &(nodes)[currentNode];
+    GridCell *currentC = &(gridCells)[currentNode];
 
     // Setup the initial node for initiating the search for upstream nodes
     currentN->index = currentNode;
-    currentN->x = currentNode;
-    currentN->y = 0;
+    currentC->x = currentNode;
+    currentC->y = 0;
     if (currentNode == 0) {
       currentN->downStreamNode = INVALID_DOWNSTREAM_NODE;
     } else {
@@ -61,7 +64,7 @@ void InitializeKW() {
     currentN->slope = 0.01;       // 10.0 / currentN->horLen; // We assume a
                             // difference in height of 1 meter because we know
                             // nothing else
-    currentN->area = (CELL_SIZE * CELL_SIZE) / 1000000.0; // km2
+    currentC->area = (CELL_SIZE * CELL_SIZE) / 1000000.0; // km2
     currentN->fac = NUM_GRID_CELLS - currentNode + 1;
     currentN->gauge = &gaugeConfigSec;
 
@@ -85,7 +88,8 @@ void InitializeKW() {
   params[PARAM_KINEMATIC_ALPHA] = 3.49;
   params[PARAM_KINEMATIC_BETA] = 0.60;
 
-  rModel->InitializeModel(&nodes, &fullParamSettingsRoute, &paramGridsRoute);
+  rModel->InitializeModel(&nodes, &gridCells, &fullParamSettingsRoute,
+                          &paramGridsRoute);
 }
 
 void SimulateRouting() {
@@ -0,0 +1,47 @@
+#ifndef KERNEL_PRECISION_H
+#define KERNEL_PRECISION_H
+
+#include "Model.h"
+#include <cmath>
+
+// Precision a model starts out with, native is the type its kernel has always
+// computed in. Building with -DEF5_PRECISION=PRECISION_SINGLE (or DOUBLE)
+// gives every model the same one.
+#ifdef EF5_PRECISION
+#define KERNEL_PRECISION(native) (EF5_PRECISION)
+#else
+#define KERNEL_PRECISION(native) (native)
+#endif
+
+// Building with -DWBBENCH_COUNT counts the calls to pow and exp made by the
+// kernels, which wbbench reports per cell step. The counters are not atomic,
+// wbbench runs on a single thread.
+#ifdef WBBENCH_COUNT
+extern unsigned long g_kernelPowCalls, g_kernelExpCalls;
+#define KERNEL_COUNT(counter, calls) ((counter) += (calls))
+#else
+#define KERNEL_COUNT(counter, calls)
+#endif
+
+// Math functions for kernels templated on their compute type Real, the float
+// versions call the single precision functions so nothing is widened to double
+inline float KernelPow(float x, float y) {
+  KERNEL_COUNT(g_kernelPowCalls, 1);
+  return powf(x, y);
+}
+inline double KernelPow(double x, double y) {
+  KERNEL_COUNT(g_kernelPowCalls, 1);
+  return pow(x, y);
+}
+inline float KernelExp(float x) {
+  KERNEL_COUNT(g_kernelExpCalls, 1);
+  return expf(x);
+}
+inline double KernelExp(double x) {
+  KERNEL_COUNT(g_kernelExpCalls, 1);
+  return exp(x);
+}
+inline float KernelMax(float x, float y) { return fmaxf(x, y); }
+inline double KernelMax(double x, double y) { return fmax(x, y); }
+
+#endif
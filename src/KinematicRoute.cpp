@@ -1,36 +1,88 @@
 #include "KinematicRoute.h"
 #include "AscGrid.h"
 #include "DatedName.h"
+#include "KWSolver.h"
+#include "KernelPrecision.h"
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <map>
 
-// fac -> index map
-std::map<long,std::vector<int> > FAcMapping;
-
 static const char *stateStrings[] = {
     "pCQ",
     "pOQ",
     "IR",
 };
 
+void KWCells::Resize(size_t numCells) {
+  for (int p = 0; p < PARAM_KINEMATIC_QTY; p++) {
+    params[p].resize(numCells);
+  }
+  for (int p = 0; p < STATE_KW_QTY; p++) {
+    states[p].resize(numCells);
+  }
+  channelGridCell.resize(numCells);
+  belowChannel.resize(numCells);
+  horLen.resize(numCells);
+  area.resize(numCells);
+  slopeSqrt.resize(numCells);
+  nexTime.resize(numCells);
+  for (int r = 0; r < 2; r++) {
+    routeTarget[r].resize(numCells);
+    routeAmount[r].resize(numCells);
+  }
+  stepRatio.resize(numCells);
+  overlandStore.resize(numCells);
+  channelStore.resize(numCells);
+  active.resize(numCells);
+}
+
+template <class Real> void KWFlows<Real>::Reset(size_t numCells) {
+  for (int l = 0; l < KW_LAYER_QTY; l++) {
+    incomingWater[l].assign(numCells, 0.0);
+  }
+  incomingWaterOverland.assign(numCells, 0.0);
+  incomingWaterChannel.assign(numCells, 0.0);
+  interflowLeak.assign(numCells, 0.0);
+}
+
+template <> KWFlows<float> *KWRoute::Flows<float>() {
+  return &(kwCells.flowsSingle);
+}
+
+template <> KWFlows<double> *KWRoute::Flows<double>() {
+  return &(kwCells.flowsDouble);
+}
+
 KWRoute::KWRoute() {
+  solver = KW_SOLVER_NEWTON;
+  cacheValid = false;
+  meanIterations = 0.0;
+  activeSet = false;
+  activeFraction = 1.0;
+  runoffSource = NULL;
+  precision = KERNEL_PRECISION(PRECISION_DOUBLE);
 }
 
 KWRoute::~KWRoute() {}
 
 float KWRoute::SetObsInflow(long index, float inflow) {
-  KWGridNode *cNode = &(kwNodes[index]);
   GridNode *node = &nodes->at(index);
+  cacheValid = false; // Both the states and alpha may change here
+  float *pq = &(kwCells.states[STATE_KW_PQ][index]);
   float prev;
   if (!node->channelGridCell) {
-    prev = cNode->states[STATE_KW_PQ] * node->horLen;
-    cNode->states[STATE_KW_PQ] = inflow / node->horLen;
-    cNode->incomingWaterOverland = inflow / node->horLen;
+    prev = *pq * node->horLen;
+    *pq = inflow / node->horLen;
+    if (precision == PRECISION_SINGLE) {
+      kwCells.flowsSingle.incomingWaterOverland[index] = inflow / node->horLen;
+    } else {
+      kwCells.flowsDouble.incomingWaterOverland[index] = inflow / node->horLen;
+    }
   } else {
-    prev = cNode->states[STATE_KW_PQ];
+    prev = *pq;
     float diff = 0.0;
     if (inflow > 1.0 && prev > 1.0) {
       diff = inflow / prev - 1.0;
@@ -48,58 +100,91 @@ float KWRoute::SetObsInflow(long index, float inflow) {
       for (size_t i = 0; i < numNodes; i++) {
         node = &nodes->at(i);
         if (node->gauge == thisGauge) {
-          KWGridNode *cNode = &(kwNodes[i]);
-          cNode->params[PARAM_KINEMATIC_ALPHA] *= multiplier;
-          if (cNode->params[PARAM_KINEMATIC_ALPHA] < 0.01) {
-            cNode->params[PARAM_KINEMATIC_ALPHA] = 0.01;
-          } else if (cNode->params[PARAM_KINEMATIC_ALPHA] > 200.0) {
-            cNode->params[PARAM_KINEMATIC_ALPHA] = 200.0;
+          float *alpha = &(kwCells.params[PARAM_KINEMATIC_ALPHA][i]);
+          *alpha *= multiplier;
+          if (*alpha < 0.01) {
+            *alpha = 0.01;
+          } else if (*alpha > 200.0) {
+            *alpha = 200.0;
           }
         }
       }
     }
-    cNode->states[STATE_KW_PQ] = inflow;
-    cNode->incomingWaterChannel = inflow;
+    *pq = inflow;
+    if (precision == PRECISION_SINGLE) {
+      kwCells.flowsSingle.incomingWaterChannel[index] = inflow;
+    } else {
+      kwCells.flowsDouble.incomingWaterChannel[index] = inflow;
+    }
   }
   return prev;
 }
 
 bool KWRoute::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
-  if (kwNodes.size() != nodes->size()) {
-    kwNodes.resize(nodes->size());
+  gridCells = newCells;
+  kwCells.Resize(nodes->size());
+  if (precision == PRECISION_SINGLE) {
+    kwCells.flowsSingle.Reset(nodes->size());
+  } else {
+    kwCells.flowsDouble.Reset(nodes->size());
   }
 
   // Fill in modelIndex in the gridNodes
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     node->modelIndex = i;
-    KWGridNode *cNode = &(kwNodes[i]);
-    cNode->slopeSqrt = pow(node->slope, 0.5f);
-    cNode->hillSlopeSqrt = pow(node->slope * 0.5, 0.5f);
-    cNode->incomingWater[KW_LAYER_INTERFLOW] = 0.0;
-    cNode->incomingWater[KW_LAYER_FASTFLOW] = 0.0;
-    cNode->incomingWaterOverland = 0.0;
-    cNode->incomingWaterChannel = 0.0;
+    kwCells.horLen[i] = node->horLen;
+    kwCells.area[i] = cell->area;
+    kwCells.slopeSqrt[i] = pow(node->slope, 0.5f);
     for (int p = 0; p < STATE_KW_QTY; p++) {
-      cNode->states[p] = 0.0;
+      kwCells.states[p][i] = 0.0;
     }
-    FAcMapping[node->fac].push_back(i);
   }
 
+  network.Build(nodes);
+
   // printf("Index1 is %li and index2 is %li\n", index1, index2);
   InitializeParameters(paramSettings, paramGrids);
-  initialized = false;
+  GroupCells();
+  interflowTables.clear();
+  interflowGather = NULL;
+  cacheValid = false;
   maxSpeed = 1.0;
 
   return true;
 }
 
+void KWRoute::GroupCells() {
+  // Hillslope cells with no channel cell upstream of them go first in every
+  // task, see RouteCells. Going from the headwaters down, a cell is below a
+  // channel when it is one or any cell draining into it is.
+  size_t numLevels = network.GetNumLevels();
+  for (size_t l = 0; l < numLevels; l++) {
+    size_t levelSize = network.GetLevelSize(l);
+    const long *cells = network.GetLevelCells(l);
+    for (size_t c = 0; c < levelSize; c++) {
+      long i = cells[c];
+      unsigned char below = kwCells.channelGridCell[i];
+      size_t numUpstream = network.GetUpstreamCount(i);
+      const long *upstream = network.GetUpstreamCells(i);
+      for (size_t u = 0; u < numUpstream; u++) {
+        below |= kwCells.belowChannel[upstream[u]];
+      }
+      kwCells.belowChannel[i] = below;
+    }
+  }
+  if (!kwCells.belowChannel.empty()) {
+    network.GroupTaskCells(&(kwCells.belowChannel[0]));
+  }
+}
+
 void KWRoute::InitializeStates(TimeVar *beginTime, char *statePath,
                                std::vector<float> *fastFlow,
                                std::vector<float> *slowFlow) {
@@ -107,6 +192,7 @@ void KWRoute::InitializeStates(TimeVar *beginTime, char *statePath,
   timeStr.SetNameStr("YYYYMMDD_HHUU");
   timeStr.ProcessNameLoose(NULL);
   timeStr.UpdateName(beginTime->GetTM());
+  cacheValid = false;
 
   char buffer[255];
   for (int p = 0; p < STATE_KW_QTY; p++) {
@@ -119,20 +205,18 @@ void KWRoute::InitializeStates(TimeVar *beginTime, char *statePath,
              buffer);
       if (g_DEM->IsSpatialMatch(sGrid)) {
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &nodes->at(i);
-          KWGridNode *cNode = &(kwNodes[i]);
-          if (sGrid->data[node->y][node->x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[node->y][node->x];
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->data[cell->y][cell->x] != sGrid->noData) {
+            kwCells.states[p][i] = sGrid->data[cell->y][cell->x];
           }
         }
       } else {
         GridLoc pt;
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &(nodes->at(i));
-          KWGridNode *cNode = &(kwNodes[i]);
-          if (sGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt) &&
               sGrid->data[pt.y][pt.x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[pt.y][pt.x];
+            kwCells.states[p][i] = sGrid->data[pt.y][pt.x];
           }
         }
       }
@@ -159,10 +243,9 @@ void KWRoute::SaveStates(TimeVar *currentTime, char *statePath,
     sprintf(buffer, "%s/kwr_%s_%s.tif", statePath, stateStrings[p],
             timeStr.GetName());
     for (size_t i = 0; i < nodes->size(); i++) {
-      KWGridNode *cNode = &(kwNodes[i]);
-      dataVals[i] = cNode->states[p];
+      dataVals[i] = kwCells.states[p][i];
     }
-    gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+    gridWriter->WriteGrid(nodes, gridCells, &dataVals, buffer, false);
   }
 }
 
@@ -170,268 +253,488 @@ bool KWRoute::Route(float stepHours, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *discharge) {
 
-  if (!initialized) {
-    initialized = true;
-    InitializeRouting(stepHours * 3600.0f);
+  routeStepSeconds = stepHours * 3600.0f;
+  interflowGather = GetInterflowTable(routeStepSeconds);
+  routeFastFlow = fastFlow;
+  routeSlowFlow = slowFlow;
+  solverIterations = 0;
+  solverCells = 0;
+  if (solver == KW_SOLVER_WARMSTART &&
+      (!cacheValid || cachedStepSeconds != routeStepSeconds)) {
+    CacheConstants(routeStepSeconds);
+  }
+  if (precision == PRECISION_SINGLE) {
+    RunRoute<float>(fastFlow, slowFlow, discharge);
+  } else {
+    RunRoute<double>(fastFlow, slowFlow, discharge);
   }
-
-  size_t numNodes = nodes->size();
-  // for (long i = numNodes - 1; i >= 0; i--) {
-  //   KWGridNode *cNode = &(kwNodes[i]);
-  //   RouteInt(stepHours * 3600.0f, &(nodes->at(i)), cNode, fastFlow->at(i),
-  //            slowFlow->at(i));
-  // }
-
-  // PARALLELIZED BY LEVEL EXECUTION OF FAc ROUTING 
-  for (std::map<long, std::vector<int> >::const_iterator it = FAcMapping.begin(); it != FAcMapping.end(); ++it) {
-#pragma acc parallel loop
-    for(long j = 0; j < it->second.size(); j++) {
-      int i = it->second[j];
-      KWGridNode *cNode = &(kwNodes[i]);
-      RouteInt(stepHours * 3600.0f, &(nodes->at(i)), cNode, fastFlow->at(i), slowFlow->at(i));
-    }
-  }
-
-  for (size_t i = 0; i < numNodes; i++)
-  {
-    KWGridNode *cNode = &(kwNodes[i]);
-    slowFlow->at(i) = 0.0; // cNode->incomingWater[KW_LAYER_INTERFLOW];
-    fastFlow->at(i) = 0.0; // cNode->incomingWater[KW_LAYER_FASTFLOW];
-    cNode->incomingWaterOverland = 0.0;
-    cNode->incomingWaterChannel = 0.0;
-    if (!cNode->channelGridCell)
-    {
-      float q = cNode->incomingWater[KW_LAYER_FASTFLOW] * nodes->at(i).horLen;
-      q += (cNode->incomingWater[KW_LAYER_INTERFLOW] * nodes->at(i).area / 3.6);
-      discharge->at(i) = q; // * (stepHours * 3600.0f);
-    }
-    else
-    {
-      discharge->at(i) = cNode->incomingWater[KW_LAYER_FASTFLOW];
-    }
-    cNode->states[STATE_KW_IR] =
-        cNode->states[STATE_KW_IR] + cNode->incomingWater[KW_LAYER_INTERFLOW];
-    cNode->incomingWater[KW_LAYER_INTERFLOW] =
-        0.0; // Zero here so we can save states
-    cNode->incomingWater[KW_LAYER_FASTFLOW] =
-        0.0; // Zero here so we can save states
-    }
 
   // InitializeRouting(stepHours * 3600.0f);
 
   return true;
 }
 
-void KWRoute::RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
-                       float fastFlow, float slowFlow) {
-  if (!cNode->channelGridCell) {
-    float beta = 0.6;
-    float alpha = cNode->params[PARAM_KINEMATIC_ALPHA0];
-
-    fastFlow /= 1000.0;          // mm to m
-    float newInWater = fastFlow; // / node->horLen;
-
-    float A, B, C, D, E;
-    float backDiffq = 0.0;
-    if (cNode->incomingWaterOverland + cNode->states[STATE_KW_PQ] > 0.0) {
-      backDiffq =
-          pow((cNode->incomingWaterOverland + cNode->states[STATE_KW_PQ]) / 2.0,
-              beta - 1.0);
-      if (!std::isfinite(backDiffq)) {
-        backDiffq = 0.0;
-      }
-    }
-    A = (stepSeconds / node->horLen) * cNode->incomingWaterOverland;
-    B = alpha * beta * cNode->states[STATE_KW_PQ] * backDiffq;
-    C = stepSeconds * newInWater;
-    D = stepSeconds / node->horLen;
-    E = alpha * beta * backDiffq;
-    float estq = (A + B + C) / (D + E); // cms/m
-    float rhs = A + alpha * pow(cNode->states[STATE_KW_PQ], beta) +
-                stepSeconds * newInWater;
-    for (int itr = 0; itr < 10; itr++) {
-      float resError =
-          (stepSeconds / node->horLen) * estq + alpha * pow(estq, beta) - rhs;
-      if (!std::isfinite(resError)) {
-        resError = 0.0;
-      }
-      if (fabsf(resError) < 0.01) {
-        break;
-      }
-      float resErrorD1 =
-          (stepSeconds / node->horLen) + alpha * beta * pow(estq, beta - 1.0);
-      if (!std::isfinite(resErrorD1)) {
-        resErrorD1 = 1.0;
-      }
-      estq = estq - resError / resErrorD1;
-      if (estq < 0) {
-        estq = 0.0;
-      }
-    }
-    if (estq < 0.0) {
-      estq = 0.0;
-    }
-
-    float newq = estq;
-
-    cNode->states[STATE_KW_PQ] = newq;
-    if (node->downStreamNode != INVALID_DOWNSTREAM_NODE) {
-#pragma acc atomic update
-	kwNodes[nodes->at(node->downStreamNode).modelIndex].incomingWaterOverland += newq;
-    }
-
-    cNode->incomingWater[KW_LAYER_FASTFLOW] = newq;
-    // Add Interflow Excess Water to Reservoir
-    cNode->states[STATE_KW_IR] += slowFlow;
-    double interflowLeak =
-        cNode->states[STATE_KW_IR] * cNode->params[PARAM_KINEMATIC_LEAKI];
-    // printf(" %f ", interflowLeak);
-    cNode->states[STATE_KW_IR] -= interflowLeak;
-    if (cNode->states[STATE_KW_IR] < 0) {
-      cNode->states[STATE_KW_IR] = 0;
-    }
-
-    if (cNode->routeCNode[0][KW_LAYER_INTERFLOW]) {
-      double interflowLeak0 =
-          interflowLeak * cNode->routeAmount[0][KW_LAYER_INTERFLOW] *
-          node->area / cNode->routeNode[0][KW_LAYER_INTERFLOW]->area;
-      double leakAmount = interflowLeak0;
-      /*if (cNode->routeNode[0][KW_LAYER_INTERFLOW]->channelGridCell) {
-      printf(" 0 got %f ",
-      cNode->routeCNode[0][KW_LAYER_INTERFLOW]->incomingWater[KW_LAYER_INTERFLOW]);
-      }*/
-      cNode->routeCNode[0][KW_LAYER_INTERFLOW]
-          ->incomingWater[KW_LAYER_INTERFLOW] += leakAmount;
-      //*res += leakAmount; // Make this an atomic add for parallelization
-    }
-
-    if (cNode->routeCNode[1][KW_LAYER_INTERFLOW]) {
-      double interflowLeak1 =
-          interflowLeak * cNode->routeAmount[1][KW_LAYER_INTERFLOW] *
-          node->area / cNode->routeNode[1][KW_LAYER_INTERFLOW]->area;
-      double leakAmount = interflowLeak1;
-      // printf(" 1 got %f ", leakAmount);
-      double *res = &(cNode->routeCNode[1][KW_LAYER_INTERFLOW]
-                          ->incomingWater[KW_LAYER_INTERFLOW]);
-      *res += leakAmount; // Make this an atomic add for parallelization
+template <class Real>
+void KWRoute::RunRoute(std::vector<float> *fastFlow,
+                       std::vector<float> *slowFlow,
+                       std::vector<float> *discharge) {
+  KWFlows<Real> *flows = Flows<Real>();
+
+  size_t numNodes = nodes->size();
+  if (activeSet) {
+    MarkActiveCells<Real>(fastFlow);
+    activeFraction = (numNodes > 0) ? (float)numActive / (float)numNodes : 0.0;
+  }
+
+  // Each sub-tree is routed once all of the sub-trees draining into it are
+  // done, see RouteCells.
+  network.RouteTasks(this, runoffSource);
+  meanIterations =
+      (solverCells > 0) ? (float)solverIterations / (float)solverCells : 0.0;
+
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long i = 0; i < (long)numNodes; i++) {
+    Real *interflow = &(flows->incomingWater[KW_LAYER_INTERFLOW][i]);
+    Real *outflow = &(flows->incomingWater[KW_LAYER_FASTFLOW][i]);
+    if (!kwCells.channelGridCell[i]) {
+      *interflow = GatherInterflow<Real>(i);
+    }
+    slowFlow->at(i) = 0.0; // flows->incomingWater[KW_LAYER_INTERFLOW][i];
+    fastFlow->at(i) = 0.0; // flows->incomingWater[KW_LAYER_FASTFLOW][i];
+    flows->incomingWaterOverland[i] = 0.0;
+    flows->incomingWaterChannel[i] = 0.0;
+    if (!kwCells.channelGridCell[i]) {
+      float q = *outflow * kwCells.horLen[i];
+      q += (*interflow * kwCells.area[i] / 3.6);
+      discharge->at(i) = q; // * (stepHours * 3600.0f);
+    } else {
+      discharge->at(i) = *outflow;
     }
+    kwCells.states[STATE_KW_IR][i] = kwCells.states[STATE_KW_IR][i] + *interflow;
+    *interflow = 0.0; // Zero here so we can save states
+    *outflow = 0.0;   // Zero here so we can save states
+  }
+}
+
+void KWRoute::RouteCells(const long *cells, size_t count) {
+  if (precision == PRECISION_SINGLE) {
+    RunRouteCells<float>(cells, count);
   } else {
-    // First do overland routing
+    RunRouteCells<double>(cells, count);
+  }
+}
 
-    float beta = 0.6;
-    float alpha = cNode->params[PARAM_KINEMATIC_ALPHA0];
-    slowFlow += cNode->incomingWater[KW_LAYER_INTERFLOW];
-    // printf(" %f ", cNode->incomingWater[KW_LAYER_INTERFLOW]);
-    fastFlow /= 1000.0; // mm to m
-    slowFlow /= 1000.0; // mm to m
-    float newInWater = (fastFlow + slowFlow);
-
-    float A, B, C, D, E;
-    float backDiffq = 0.0;
-    if (cNode->incomingWaterOverland + cNode->states[STATE_KW_PO] > 0.0) {
-      backDiffq =
-          pow((cNode->incomingWaterOverland + cNode->states[STATE_KW_PO]) / 2.0,
-              beta - 1.0);
-      if (!std::isfinite(backDiffq)) {
-        backDiffq = 0.0;
+template <class Real>
+void KWRoute::RunRouteCells(const long *cells, size_t count) {
+  long iterations = 0;
+
+  // Every task lists the hillslope cells with no channel cell upstream of them
+  // first, see InitializeModel. They only receive overland flow from each
+  // other, so they are solved by a kernel of their own and drain their
+  // interflow reservoirs in a separate pass.
+  size_t numHillslope = 0;
+  while (numHillslope < count && !kwCells.belowChannel[cells[numHillslope]]) {
+    numHillslope++;
+  }
+  const long *hillslope = cells;
+  size_t numSolved = numHillslope;
+  std::vector<long> activeCells;
+  if (activeSet) {
+    // Solving a hillslope cell outside the active set would leave its flow at
+    // zero. Cells below a channel are always active.
+    activeCells.reserve(numHillslope);
+    for (size_t j = 0; j < numHillslope; j++) {
+      if (kwCells.active[cells[j]]) {
+        activeCells.push_back(cells[j]);
       }
     }
-    A = (stepSeconds / node->horLen) * cNode->incomingWaterOverland;
-    B = alpha * beta * cNode->states[STATE_KW_PO] * backDiffq;
-    C = stepSeconds * newInWater;
-    D = stepSeconds / node->horLen;
-    E = alpha * beta * backDiffq;
-    float estq = (A + B + C) / (D + E); // cms/m
-    float rhs = A + alpha * pow(cNode->states[STATE_KW_PO], beta) +
-                stepSeconds * newInWater;
-    for (int itr = 0; itr < 10; itr++) {
-      float resError =
-          (stepSeconds / node->horLen) * estq + alpha * pow(estq, beta) - rhs;
-      if (!std::isfinite(resError)) {
-        resError = 0.0;
-      }
-      if (fabsf(resError) < 0.01) {
-        break;
-      }
-      float resErrorD1 =
-          (stepSeconds / node->horLen) + alpha * beta * pow(estq, beta - 1.0);
-      if (!std::isfinite(resErrorD1)) {
-        resErrorD1 = 1.0;
-      }
-      estq = estq - resError / resErrorD1;
-      if (estq < 0) {
-        estq = 0.0;
-      }
+    numSolved = activeCells.size();
+    hillslope = (numSolved > 0) ? &(activeCells[0]) : NULL;
+  }
+
+  if (solver == KW_SOLVER_BATCH) {
+    RouteLevelBatches<Real>(hillslope, numSolved, &iterations);
+  } else if (solver == KW_SOLVER_WARMSTART) {
+    for (size_t j = 0; j < numSolved; j++) {
+      long i = hillslope[j];
+      GatherOverland<Real>(i);
+      RouteWarmHillslope<Real>(routeStepSeconds, i, routeFastFlow->at(i),
+                               &iterations);
     }
-    if (estq < 0) {
-      estq = 0.0;
+  } else {
+    for (size_t j = 0; j < numSolved; j++) {
+      long i = hillslope[j];
+      GatherOverland<Real>(i);
+      RouteHillslope<Real>(routeStepSeconds, i, routeFastFlow->at(i),
+                           &iterations);
     }
-    float newq = estq;
+  }
+  for (size_t j = 0; j < numHillslope; j++) {
+    LeakInterflow<Real>(cells[j], routeSlowFlow->at(cells[j]));
+  }
 
-    cNode->states[STATE_KW_PO] = newq;
+  // Channel cells, along with any hillslope cells below a channel
+  const long *channel = cells + numHillslope;
+  size_t numChannel = count - numHillslope;
+  if (solver == KW_SOLVER_BATCH) {
+    RouteLevelBatches<Real>(channel, numChannel, &iterations);
+  } else {
+    bool warm = (solver == KW_SOLVER_WARMSTART);
+    for (size_t j = 0; j < numChannel; j++) {
+      long i = channel[j];
+      float fastFlow = routeFastFlow->at(i);
+      float slowFlow = routeSlowFlow->at(i);
+      GatherInflow<Real>(i);
+      if (!kwCells.channelGridCell[i]) {
+        if (warm) {
+          RouteWarmHillslope<Real>(routeStepSeconds, i, fastFlow,
+                                   &iterations);
+        } else {
+          RouteHillslope<Real>(routeStepSeconds, i, fastFlow, &iterations);
+        }
+        LeakInterflow<Real>(i, slowFlow);
+      } else if (warm) {
+        RouteWarmChannel<Real>(routeStepSeconds, i, fastFlow, slowFlow,
+                               &iterations);
+      } else {
+        RouteChannel<Real>(routeStepSeconds, i, fastFlow, slowFlow,
+                           &iterations);
+      }
+    }
+  }
 
-    // Here we compute channel routing
-    beta = cNode->params[PARAM_KINEMATIC_BETA];
-    alpha = cNode->params[PARAM_KINEMATIC_ALPHA];
+#if _OPENMP
+#pragma omp atomic
+#endif
+  solverIterations += iterations;
+#if _OPENMP
+#pragma omp atomic
+#endif
+  solverCells += numSolved + numChannel;
+}
 
-    // Channel Flow
-    // Compute Q at current grid point
-    float backDiffQ = 0.0;
-    if (cNode->incomingWaterChannel + cNode->states[STATE_KW_PQ] > 0.0) {
-      backDiffQ =
-          pow((cNode->incomingWaterChannel + cNode->states[STATE_KW_PQ]) / 2.0,
-              beta - 1.0);
-      if (!std::isfinite(backDiffQ)) {
-        backDiffQ = 0.0;
+template <class Real>
+void KWRoute::RouteLevelBatches(const long *cells, size_t count,
+                                long *iterations) {
+  // The cells are sorted by level and cells within one level do not depend on
+  // each other, so each run of same level cells is solved together.
+  size_t j = 0;
+  while (j < count) {
+    size_t level = network.GetLevel(cells[j]);
+    size_t end = j + 1;
+    while (end < count && end - j < KW_BATCH_SIZE &&
+           network.GetLevel(cells[end]) == level) {
+      end++;
+    }
+    RouteBatch<Real>(routeStepSeconds, cells + j, end - j, iterations);
+
+    // Hillslope cells below a channel leak their interflow straight away, the
+    // others do so in a pass of their own
+    for (size_t k = j; k < end; k++) {
+      long i = cells[k];
+      if (kwCells.belowChannel[i] && !kwCells.channelGridCell[i]) {
+        LeakInterflow<Real>(i, routeSlowFlow->at(i));
       }
     }
+    j = end;
+  }
+}
 
-    A = (stepSeconds / node->horLen) * cNode->incomingWaterChannel;
-    B = alpha * beta * cNode->states[STATE_KW_PQ] * backDiffQ;
-    C = stepSeconds * newq;
-    D = stepSeconds / node->horLen;
-    E = alpha * beta * backDiffQ;
-    float estQ = (A + B + C) / (D + E); // cms
-    rhs =
-        A + alpha * pow(cNode->states[STATE_KW_PQ], beta) + stepSeconds * newq;
-    for (int itr = 0; itr < 10; itr++) {
-      float resError =
-          (stepSeconds / node->horLen) * estQ + alpha * pow(estQ, beta) - rhs;
-      if (!std::isfinite(resError)) {
-        resError = 0.0;
-      }
-      if (fabsf(resError) < 0.01) {
-        break;
-      }
-      float resErrorD1 =
-          (stepSeconds / node->horLen) + alpha * beta * pow(estQ, beta - 1.0);
-      if (!std::isfinite(resErrorD1)) {
-        resErrorD1 = 1.0;
-      }
-      estQ = estQ - resError / resErrorD1;
-      if (estQ < 0) {
-        estQ = 0.0;
-      }
+template <class Real>
+void KWRoute::MarkActiveCells(std::vector<float> *fastFlow) {
+  // A hillslope cell's overland flow only depends on its fast flow, its
+  // previous flow and what the hillslope cells upstream of it send. Cells
+  // with none of these, and only such cells upstream of them, stay at zero
+  // flow. Interflow does not enter the hillslope equation, so those cells
+  // only need their interflow reservoir drained. Channel cells take in
+  // interflow as well and are few, so they are always routed.
+  size_t numNodes = nodes->size();
+  KWFlows<Real> *flows = Flows<Real>();
+  std::fill(kwCells.active.begin(), kwCells.active.end(), 0);
+  numActive = 0;
+  for (size_t i = 0; i < numNodes; i++) {
+    if (!kwCells.channelGridCell[i] && fastFlow->at(i) == 0.0 &&
+        kwCells.states[STATE_KW_PQ][i] == 0.0 &&
+        flows->incomingWaterOverland[i] == 0.0) {
+      continue;
     }
-    if (estQ < 0) {
-      estQ = 0.0;
+    // Everything below an active cell has already been marked
+    long c = i;
+    while (c >= 0 && !kwCells.active[c]) {
+      kwCells.active[c] = 1;
+      numActive++;
+      c = network.GetDownStream(c);
     }
-    float newWater = estQ;
-    /*if (newWater != newWater) {
-    printf("New water is %f (%f, %f) %f %f [%f %f %f %f %f] %f %f\n", newWater,
-    cNode->incomingWaterChannel, cNode->states[STATE_KW_PQ], newq,
-    cNode->incomingWaterOverland, A, B, C, D, E, alpha, 0.0);
-    }*/
-    cNode->states[STATE_KW_PQ] =
-        newWater; // Update previous Q for further routing if "steps" > 1
-    if (node->downStreamNode != INVALID_DOWNSTREAM_NODE) {
-#pragma acc atomic update
-	kwNodes[nodes->at(node->downStreamNode).modelIndex].incomingWaterChannel += newWater;
+  }
+}
+
+template <class Real>
+void KWRoute::GatherOverland(long index) {
+  // Outflow from the cells directly upstream, all of them hillslope cells
+  KWFlows<Real> *flows = Flows<Real>();
+  Real overland = 0.0;
+  size_t numUpstream = network.GetUpstreamCount(index);
+  const long *upstream = network.GetUpstreamCells(index);
+  const float *pq = &(kwCells.states[STATE_KW_PQ][0]);
+  for (size_t u = 0; u < numUpstream; u++) {
+    overland += pq[upstream[u]];
+  }
+  flows->incomingWaterOverland[index] += overland;
+}
+
+template <class Real>
+void KWRoute::GatherInflow(long index) {
+  // Outflow from the cells directly upstream, hillslope cells feed the
+  // overland flow and channel cells the channel flow.
+  KWFlows<Real> *flows = Flows<Real>();
+  Real overland = 0.0, channel = 0.0;
+  size_t numUpstream = network.GetUpstreamCount(index);
+  const long *upstream = network.GetUpstreamCells(index);
+  const float *pq = &(kwCells.states[STATE_KW_PQ][0]);
+  for (size_t u = 0; u < numUpstream; u++) {
+    if (kwCells.channelGridCell[upstream[u]]) {
+      channel += pq[upstream[u]];
+    } else {
+      overland += pq[upstream[u]];
+    }
+  }
+  flows->incomingWaterOverland[index] += overland;
+  flows->incomingWaterChannel[index] += channel;
+
+  // Channel cells consume their interflow while routing, hillslope cells
+  // collect theirs after every cell has been routed.
+  if (kwCells.channelGridCell[index]) {
+    flows->incomingWater[KW_LAYER_INTERFLOW][index] =
+        GatherInterflow<Real>(index);
+  }
+}
+
+template <class Real>
+Real KWRoute::GatherInterflow(long index) {
+  KWFlows<Real> *flows = Flows<Real>();
+  Real interflow = 0.0;
+  size_t numSources = interflowGather->GetCount(index);
+  const long *sources = interflowGather->GetSources(index);
+  const double *weights = interflowGather->GetWeights(index);
+  const Real *leak = &(flows->interflowLeak[0]);
+  for (size_t s = 0; s < numSources; s++) {
+    interflow += leak[sources[s]] * (Real)weights[s];
+  }
+  return interflow;
+}
+
+template <class Real>
+void KWRoute::RouteHillslope(float stepSeconds, long index, float fastFlow,
+                             long *iterations) {
+  KWFlows<Real> *flows = Flows<Real>();
+  float stepRatio, rhs, estq;
+  float beta = 0.6;
+  float alpha = kwCells.params[PARAM_KINEMATIC_ALPHA0][index];
+
+  fastFlow /= 1000.0;          // mm to m
+  float newInWater = fastFlow; // / horLen;
+
+  KWSetupEquation(stepSeconds, kwCells.horLen[index],
+                  flows->incomingWaterOverland[index],
+                  kwCells.states[STATE_KW_PQ][index], newInWater, alpha, beta,
+                  &stepRatio, &rhs, &estq);
+  float newq =
+      KWNewtonSolve(stepRatio, alpha, beta, rhs, estq, iterations); // cms/m
+
+  kwCells.states[STATE_KW_PQ][index] = newq;
+  flows->incomingWater[KW_LAYER_FASTFLOW][index] = newq;
+}
+
+template <class Real>
+void KWRoute::RouteChannel(float stepSeconds, long index, float fastFlow,
+                           float slowFlow, long *iterations) {
+  KWFlows<Real> *flows = Flows<Real>();
+  float horLen = kwCells.horLen[index];
+  float prevQ = kwCells.states[STATE_KW_PQ][index];
+  float stepRatio, rhs, estq;
+
+  // First do overland routing
+  float beta = 0.6;
+  float alpha = kwCells.params[PARAM_KINEMATIC_ALPHA0][index];
+  float prevO = kwCells.states[STATE_KW_PO][index];
+  slowFlow += flows->incomingWater[KW_LAYER_INTERFLOW][index];
+  fastFlow /= 1000.0; // mm to m
+  slowFlow /= 1000.0; // mm to m
+  float newInWater = (fastFlow + slowFlow);
+
+  KWSetupEquation(stepSeconds, horLen, flows->incomingWaterOverland[index],
+                  prevO, newInWater, alpha, beta, &stepRatio, &rhs, &estq);
+  float newq =
+      KWNewtonSolve(stepRatio, alpha, beta, rhs, estq, iterations); // cms/m
+
+  kwCells.states[STATE_KW_PO][index] = newq;
+
+  // Here we compute channel routing
+  beta = kwCells.params[PARAM_KINEMATIC_BETA][index];
+  alpha = kwCells.params[PARAM_KINEMATIC_ALPHA][index];
+  KWSetupEquation(stepSeconds, horLen, flows->incomingWaterChannel[index],
+                  prevQ, newq, alpha, beta, &stepRatio, &rhs, &estq);
+  float newWater =
+      KWNewtonSolve(stepRatio, alpha, beta, rhs, estq, iterations); // cms
+
+  kwCells.states[STATE_KW_PQ][index] =
+      newWater; // Update previous Q for further routing if "steps" > 1
+
+  flows->incomingWater[KW_LAYER_FASTFLOW][index] = newWater;
+  flows->incomingWater[KW_LAYER_INTERFLOW][index] = 0.0;
+}
+
+template <class Real>
+void KWRoute::RouteWarmHillslope(float stepSeconds, long index, float fastFlow,
+                                 long *iterations) {
+  KWFlows<Real> *flows = Flows<Real>();
+  float stepRatio = kwCells.stepRatio[index];
+  Real incomingWaterOverland = flows->incomingWaterOverland[index];
+  float prevQ = kwCells.states[STATE_KW_PQ][index];
+  float beta = 0.6;
+  float alpha = kwCells.params[PARAM_KINEMATIC_ALPHA0][index];
+  float *overlandStore = &(kwCells.overlandStore[index]);
+  float estStore = *overlandStore;
+
+  fastFlow /= 1000.0; // mm to m
+  float newInWater = fastFlow;
+  float rhs = stepRatio * incomingWaterOverland + *overlandStore +
+              stepSeconds * newInWater;
+  float estq =
+      KWWarmEstimate(stepSeconds, kwCells.horLen[index], incomingWaterOverland,
+                     prevQ, newInWater, alpha, beta, &estStore);
+  float newq = KWNewtonSolveWarm(stepRatio, alpha, beta, rhs, estq, estStore,
+                                 overlandStore, iterations); // cms/m
+
+  kwCells.states[STATE_KW_PQ][index] = newq;
+  flows->incomingWater[KW_LAYER_FASTFLOW][index] = newq;
+}
+
+template <class Real>
+void KWRoute::RouteWarmChannel(float stepSeconds, long index, float fastFlow,
+                               float slowFlow, long *iterations) {
+  KWFlows<Real> *flows = Flows<Real>();
+  float horLen = kwCells.horLen[index];
+  float stepRatio = kwCells.stepRatio[index];
+  Real incomingWaterOverland = flows->incomingWaterOverland[index];
+  float prevQ = kwCells.states[STATE_KW_PQ][index];
+  float beta = 0.6;
+  float alpha = kwCells.params[PARAM_KINEMATIC_ALPHA0][index];
+  float *overlandStore = &(kwCells.overlandStore[index]);
+  float estStore = *overlandStore;
+
+  // First do overland routing
+  fastFlow /= 1000.0; // mm to m
+  float prevO = kwCells.states[STATE_KW_PO][index];
+  slowFlow += flows->incomingWater[KW_LAYER_INTERFLOW][index];
+  slowFlow /= 1000.0; // mm to m
+  float newInWater = (fastFlow + slowFlow);
+  float rhs = stepRatio * incomingWaterOverland + *overlandStore +
+              stepSeconds * newInWater;
+  float estq = KWWarmEstimate(stepSeconds, horLen, incomingWaterOverland,
+                              prevO, newInWater, alpha, beta, &estStore);
+  float newq = KWNewtonSolveWarm(stepRatio, alpha, beta, rhs, estq, estStore,
+                                 overlandStore, iterations); // cms/m
+  kwCells.states[STATE_KW_PO][index] = newq;
+
+  // Here we compute channel routing
+  beta = kwCells.params[PARAM_KINEMATIC_BETA][index];
+  alpha = kwCells.params[PARAM_KINEMATIC_ALPHA][index];
+  Real incomingWaterChannel = flows->incomingWaterChannel[index];
+  float *channelStore = &(kwCells.channelStore[index]);
+  estStore = *channelStore;
+  rhs = stepRatio * incomingWaterChannel + *channelStore + stepSeconds * newq;
+  estq = KWWarmEstimate(stepSeconds, horLen, incomingWaterChannel, prevQ, newq,
+                        alpha, beta, &estStore);
+  float newWater = KWNewtonSolveWarm(stepRatio, alpha, beta, rhs, estq,
+                                     estStore, channelStore, iterations); // cms
+
+  kwCells.states[STATE_KW_PQ][index] = newWater;
+  flows->incomingWater[KW_LAYER_FASTFLOW][index] = newWater;
+  flows->incomingWater[KW_LAYER_INTERFLOW][index] = 0.0;
+}
+
+template <class Real>
+void KWRoute::RouteBatch(float stepSeconds, const long *cells, size_t count,
+                         long *iterations) {
+  KWFlows<Real> *flows = Flows<Real>();
+  float stepRatio[KW_BATCH_SIZE] = {0}, alpha[KW_BATCH_SIZE] = {0},
+        beta[KW_BATCH_SIZE] = {0}, rhs[KW_BATCH_SIZE] = {0}, q[KW_BATCH_SIZE];
+  long channel[KW_BATCH_SIZE];
+  int numChannel = 0;
+
+  // Overland flow for every cell
+  for (size_t k = 0; k < count; k++) {
+    long i = cells[k];
+    GatherInflow<Real>(i);
+    float fastFlow = routeFastFlow->at(i);
+    float prev;
+    fastFlow /= 1000.0; // mm to m
+    float newInWater = fastFlow;
+    if (!kwCells.channelGridCell[i]) {
+      prev = kwCells.states[STATE_KW_PQ][i];
+    } else {
+      float slowFlow = routeSlowFlow->at(i);
+      slowFlow += flows->incomingWater[KW_LAYER_INTERFLOW][i];
+      slowFlow /= 1000.0; // mm to m
+      newInWater = (fastFlow + slowFlow);
+      prev = kwCells.states[STATE_KW_PO][i];
+    }
+    alpha[k] = kwCells.params[PARAM_KINEMATIC_ALPHA0][i];
+    beta[k] = 0.6;
+    KWSetupEquation(stepSeconds, kwCells.horLen[i],
+                    flows->incomingWaterOverland[i], prev, newInWater,
+                    alpha[k], beta[k], &(stepRatio[k]), &(rhs[k]), &(q[k]));
+  }
+  *iterations += KWNewtonSolveBatch(stepRatio, alpha, beta, rhs, q, count);
+
+  // Channel flow for the channel cells
+  for (size_t k = 0; k < count; k++) {
+    long i = cells[k];
+    if (!kwCells.channelGridCell[i]) {
+      kwCells.states[STATE_KW_PQ][i] = q[k];
+      flows->incomingWater[KW_LAYER_FASTFLOW][i] = q[k];
+      continue;
     }
+    kwCells.states[STATE_KW_PO][i] = q[k];
+    int c = numChannel++;
+    channel[c] = i;
+    alpha[c] = kwCells.params[PARAM_KINEMATIC_ALPHA][i];
+    beta[c] = kwCells.params[PARAM_KINEMATIC_BETA][i];
+    KWSetupEquation(stepSeconds, kwCells.horLen[i],
+                    flows->incomingWaterChannel[i],
+                    kwCells.states[STATE_KW_PQ][i], q[k], alpha[c], beta[c],
+                    &(stepRatio[c]), &(rhs[c]), &(q[c]));
+  }
+  *iterations +=
+      KWNewtonSolveBatch(stepRatio, alpha, beta, rhs, q, numChannel);
+
+  for (int c = 0; c < numChannel; c++) {
+    long i = channel[c];
+    kwCells.states[STATE_KW_PQ][i] = q[c];
+    flows->incomingWater[KW_LAYER_FASTFLOW][i] = q[c];
+    flows->incomingWater[KW_LAYER_INTERFLOW][i] = 0.0;
+  }
+}
 
-    cNode->incomingWater[KW_LAYER_FASTFLOW] = newWater;
-    cNode->incomingWater[KW_LAYER_INTERFLOW] = 0.0;
+template <class Real>
+void KWRoute::LeakInterflow(long index, float slowFlow) {
+  KWFlows<Real> *flows = Flows<Real>();
+  // Add Interflow Excess Water to Reservoir
+  float interflowRes = kwCells.states[STATE_KW_IR][index];
+  interflowRes += slowFlow;
+  Real interflowLeak =
+      interflowRes * kwCells.params[PARAM_KINEMATIC_LEAKI][index];
+  interflowRes -= interflowLeak;
+  if (interflowRes < 0) {
+    interflowRes = 0;
   }
+  kwCells.states[STATE_KW_IR][index] = interflowRes;
+
+  // The receiving cells pull this through interflowGather
+  flows->interflowLeak[index] = interflowLeak;
 }
 
 void KWRoute::InitializeParameters(
@@ -443,93 +746,111 @@ void KWRoute::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
-    KWGridNode *cNode = &(kwNodes[i]);
+    GridCell *cell = &gridCells->at(i);
+    float params[PARAM_KINEMATIC_QTY];
     if (!node->gauge) {
       unused++;
       continue;
     }
     // Copy all of the parameters over
-    memcpy(cNode->params, (*paramSettings)[node->gauge],
+    memcpy(params, (*paramSettings)[node->gauge],
            sizeof(float) * PARAM_KINEMATIC_QTY);
 
     if (!paramGrids->at(PARAM_KINEMATIC_ISU)) {
-      cNode->states[STATE_KW_IR] = cNode->params[PARAM_KINEMATIC_ISU];
+      kwCells.states[STATE_KW_IR][i] = params[PARAM_KINEMATIC_ISU];
     }
-    cNode->incomingWater[KW_LAYER_INTERFLOW] = 0.0;
-    cNode->incomingWater[KW_LAYER_FASTFLOW] = 0.0;
 
     // Deal with the distributed parameters here
     GridLoc pt;
     for (size_t paramI = 0; paramI < PARAM_KINEMATIC_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
           // modelParamStrings[MODEL_CREST][paramI]);
         }
-        cNode->params[paramI] *= grid->data[pt.y][pt.x];
+        params[paramI] *= grid->data[pt.y][pt.x];
       }
     }
 
-    if (cNode->params[PARAM_KINEMATIC_LEAKI] < 0.0) {
+    if (params[PARAM_KINEMATIC_LEAKI] < 0.0) {
       // printf("Node Leak Interflow(%f) is less than 0, setting to 0.\n",
-      // cNode->params[PARAM_KINEMATIC_LEAKI]);
-      cNode->params[PARAM_KINEMATIC_LEAKI] = 0.0;
-    } else if (cNode->params[PARAM_KINEMATIC_LEAKI] > 1.0) {
+      // params[PARAM_KINEMATIC_LEAKI]);
+      params[PARAM_KINEMATIC_LEAKI] = 0.0;
+    } else if (params[PARAM_KINEMATIC_LEAKI] > 1.0) {
       // printf("Node Leak Interflow(%f) is greater than 1, setting to 1.\n",
-      // cNode->params[PARAM_KINEMATIC_LEAKI]);
-      cNode->params[PARAM_KINEMATIC_LEAKI] = 1.0;
+      // params[PARAM_KINEMATIC_LEAKI]);
+      params[PARAM_KINEMATIC_LEAKI] = 1.0;
     }
 
-    if (cNode->params[PARAM_KINEMATIC_ALPHA] < 0.0) {
+    if (params[PARAM_KINEMATIC_ALPHA] < 0.0) {
       // printf("Node Alpha(%f) is less than 0, setting to 1.\n",
-      // cNode->params[PARAM_KINEMATIC_ALPHA]);
-      cNode->params[PARAM_KINEMATIC_ALPHA] = 1.0;
+      // params[PARAM_KINEMATIC_ALPHA]);
+      params[PARAM_KINEMATIC_ALPHA] = 1.0;
     }
 
-    if (cNode->params[PARAM_KINEMATIC_ALPHA0] < 0.0) {
+    if (params[PARAM_KINEMATIC_ALPHA0] < 0.0) {
       // printf("Node Alpha0(%f) is less than 0, setting to 1.\n",
-      // cNode->params[PARAM_KINEMATIC_ALPHA0]);
-      cNode->params[PARAM_KINEMATIC_ALPHA0] = 1.0;
+      // params[PARAM_KINEMATIC_ALPHA0]);
+      params[PARAM_KINEMATIC_ALPHA0] = 1.0;
     }
 
-    if (cNode->params[PARAM_KINEMATIC_BETA] < 0.0) {
+    if (params[PARAM_KINEMATIC_BETA] < 0.0) {
       // printf("Node Beta(%f) is less than 0, setting to 0.6.\n",
-      // cNode->params[PARAM_KINEMATIC_BETA]);
-      cNode->params[PARAM_KINEMATIC_BETA] = 0.6;
+      // params[PARAM_KINEMATIC_BETA]);
+      params[PARAM_KINEMATIC_BETA] = 0.6;
     }
 
-    if (node->fac > cNode->params[PARAM_KINEMATIC_TH]) {
+    if (node->fac > params[PARAM_KINEMATIC_TH]) {
       node->channelGridCell = true;
-      cNode->channelGridCell = true;
+      kwCells.channelGridCell[i] = true;
     } else {
       node->channelGridCell = false;
-      cNode->channelGridCell = false;
+      kwCells.channelGridCell[i] = false;
+    }
+
+    for (size_t paramI = 0; paramI < PARAM_KINEMATIC_QTY; paramI++) {
+      kwCells.params[paramI][i] = params[paramI];
     }
   }
 }
 
-void KWRoute::InitializeRouting(float timeSeconds) {
+void KWRoute::PrepareTimeStep(float stepHours) {
+  GetInterflowTable(stepHours * 3600.0f);
+}
+
+RoutingGather *KWRoute::GetInterflowTable(float stepSeconds) {
+  // The interflow targets only depend on the parameters and the step length,
+  // so a table is kept for every step length seen since InitializeModel.
+  std::map<float, RoutingGather>::iterator itr =
+      interflowTables.find(stepSeconds);
+  if (itr != interflowTables.end()) {
+    return &(itr->second);
+  }
+  RoutingGather *gather = &(interflowTables[stepSeconds]);
+  InitializeRouting(stepSeconds, gather);
+  return gather;
+}
+
+void KWRoute::InitializeRouting(float timeSeconds, RoutingGather *gather) {
 
   // This pass distributes parameters & calculates the time it takes for water
   // to cross the grid cell.
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    KWGridNode *cNode = &(kwNodes[i]);
-
     // Calculate the water speed for interflow
-    float speedUnder = cNode->params[PARAM_KINEMATIC_UNDER] * cNode->slopeSqrt;
+    float speedUnder =
+        kwCells.params[PARAM_KINEMATIC_UNDER][i] * kwCells.slopeSqrt[i];
 
-    float nexTimeUnder = node->horLen / speedUnder;
-    cNode->nexTime[KW_LAYER_INTERFLOW] = nexTimeUnder;
+    float nexTimeUnder = kwCells.horLen[i] / speedUnder;
+    kwCells.nexTime[i] = nexTimeUnder;
   }
 
   // This pass figures out which cell water is routed to
@@ -537,7 +858,6 @@ void KWRoute::InitializeRouting(float timeSeconds) {
     GridNode *currentNode, *previousNode;
     float currentSeconds, previousSeconds;
     GridNode *node = &nodes->at(i);
-    KWGridNode *cNode = &(kwNodes[i]);
 
     // Interflow routing
     previousSeconds = 0;
@@ -545,12 +865,11 @@ void KWRoute::InitializeRouting(float timeSeconds) {
     currentNode = node;
     previousNode = NULL;
     while (currentSeconds < timeSeconds && currentNode &&
-           !kwNodes[currentNode->modelIndex].channelGridCell) {
+           !kwCells.channelGridCell[currentNode->modelIndex]) {
       if (currentNode) {
         previousSeconds = currentSeconds;
         previousNode = currentNode;
-        currentSeconds +=
-            kwNodes[currentNode->modelIndex].nexTime[KW_LAYER_INTERFLOW];
+        currentSeconds += kwCells.nexTime[currentNode->modelIndex];
         if (currentNode->downStreamNode != INVALID_DOWNSTREAM_NODE) {
           currentNode = &(nodes->at(currentNode->downStreamNode));
         } else {
@@ -565,23 +884,53 @@ void KWRoute::InitializeRouting(float timeSeconds) {
       }
     }
 
-    cNode->routeNode[0][KW_LAYER_INTERFLOW] = currentNode;
-    cNode->routeCNode[0][KW_LAYER_INTERFLOW] =
-        (currentNode) ? &(kwNodes[currentNode->modelIndex]) : NULL;
-    cNode->routeNode[1][KW_LAYER_INTERFLOW] = previousNode;
-    cNode->routeCNode[1][KW_LAYER_INTERFLOW] =
-        (previousNode) ? &(kwNodes[previousNode->modelIndex]) : NULL;
-    if (currentNode && !kwNodes[currentNode->modelIndex].channelGridCell) {
+    kwCells.routeTarget[0][i] = (currentNode) ? currentNode->modelIndex : -1;
+    kwCells.routeTarget[1][i] = (previousNode) ? previousNode->modelIndex : -1;
+    if (currentNode && !kwCells.channelGridCell[currentNode->modelIndex]) {
       if ((currentSeconds - previousSeconds) > 0) {
-        cNode->routeAmount[0][KW_LAYER_INTERFLOW] =
-            (timeSeconds - previousSeconds) /
-            (currentSeconds - previousSeconds);
-        cNode->routeAmount[1][KW_LAYER_INTERFLOW] =
-            1.0 - cNode->routeAmount[0][KW_LAYER_INTERFLOW];
+        kwCells.routeAmount[0][i] = (timeSeconds - previousSeconds) /
+                                    (currentSeconds - previousSeconds);
+        kwCells.routeAmount[1][i] = 1.0 - kwCells.routeAmount[0][i];
       }
     } else {
-      cNode->routeAmount[0][KW_LAYER_INTERFLOW] = 1.0;
-      cNode->routeAmount[1][KW_LAYER_INTERFLOW] = 0.0;
+      kwCells.routeAmount[0][i] = 1.0;
+      kwCells.routeAmount[1][i] = 0.0;
+    }
+  }
+
+  // Invert the interflow targets so each cell can pull its interflow. Only
+  // hillslope cells leak interflow.
+  gather->Clear(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    if (kwCells.channelGridCell[i]) {
+      continue;
+    }
+    for (int r = 0; r < 2; r++) {
+      long target = kwCells.routeTarget[r][i];
+      if (target >= 0) {
+        gather->Add(i, target,
+                    kwCells.routeAmount[r][i] * kwCells.area[i] /
+                        kwCells.area[target]);
+      }
     }
   }
+  gather->Finalize();
+}
+
+void KWRoute::CacheConstants(float stepSeconds) {
+  size_t numNodes = nodes->size();
+  for (size_t i = 0; i < numNodes; i++) {
+    float alpha0 = kwCells.params[PARAM_KINEMATIC_ALPHA0][i];
+    float alpha = kwCells.params[PARAM_KINEMATIC_ALPHA][i];
+    float beta = kwCells.params[PARAM_KINEMATIC_BETA][i];
+    float prevOverland = kwCells.channelGridCell[i]
+                             ? kwCells.states[STATE_KW_PO][i]
+                             : kwCells.states[STATE_KW_PQ][i];
+    kwCells.stepRatio[i] = stepSeconds / kwCells.horLen[i];
+    kwCells.overlandStore[i] = alpha0 * pow(prevOverland, 0.6f);
+    kwCells.channelStore[i] =
+        alpha * pow(kwCells.states[STATE_KW_PQ][i], beta);
+  }
+  cachedStepSeconds = stepSeconds;
+  cacheValid = true;
 }
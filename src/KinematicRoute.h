@@ -2,6 +2,7 @@
 #define KW_MODEL_H
 
 #include "ModelBase.h"
+#include "RoutingNetwork.h"
 
 enum KW_LAYER {
   KW_LAYER_FASTFLOW,
@@ -11,36 +12,60 @@ enum KW_LAYER {
 
 enum STATES_KW { STATE_KW_PQ, STATE_KW_PO, STATE_KW_IR, STATE_KW_QTY };
 
-struct KWGridNode : BasicGridNode {
-  float params[PARAM_KINEMATIC_QTY];
-  float states[STATE_KW_QTY];
+// Water passed between cells during a step, held in the routing compute type
+// so single precision runs move half as many bytes.
+template <class Real> struct KWFlows {
+  // Sizes every field for numCells cells and sets it to zero
+  void Reset(size_t numCells);
 
-  bool channelGridCell;
-  double slopeSqrt;
-  double hillSlopeSqrt;
+  std::vector<Real> incomingWater[KW_LAYER_QTY];
+  std::vector<Real> incomingWaterOverland, incomingWaterChannel;
+  std::vector<Real>
+      interflowLeak; // Interflow leaving the cell during the current step
+};
+
+// Kinematic wave cells are stored as one contiguous array per field, so the
+// routing sweep only drags the fields it uses through the cache.
+struct KWCells {
+  void Resize(size_t numCells);
+
+  std::vector<float> params[PARAM_KINEMATIC_QTY];
+  std::vector<float> states[STATE_KW_QTY];
+
+  std::vector<unsigned char> channelGridCell;
+  std::vector<unsigned char> belowChannel; // Channel cells and the cells
+                                           // downstream of one
+  std::vector<float> horLen;
+  std::vector<float> area;
+  std::vector<double> slopeSqrt;
+
+  std::vector<double>
+      nexTime; // This is a by product of computing interflow routing
+  std::vector<long> routeTarget[2]; // Cell we route interflow to, -1 for none
+  std::vector<double> routeAmount[2];
 
-  double
-      nexTime[KW_LAYER_QTY]; // This is a by product of computing cell routing
-  KWGridNode *routeCNode[2][KW_LAYER_QTY]; // This is the node we route water to
-  GridNode *routeNode[2][KW_LAYER_QTY];
-  double routeAmount[2][KW_LAYER_QTY];
-  double incomingWater[KW_LAYER_QTY];
+  // Only the flows of the precision being routed in are sized
+  KWFlows<float> flowsSingle;
+  KWFlows<double> flowsDouble;
 
-  // double reservoirs[KW_LAYER_QTY]; // CREST has two excess storage reservoirs
-  // (overland & interflow)
+  // Used by the warm started solver, the stores hold alpha * Q^beta for the
+  // previous overland and channel flow.
+  std::vector<float> stepRatio;
+  std::vector<float> overlandStore, channelStore;
 
-  // double previousStreamflow; //cms
-  // double previousOverland;
-  double incomingWaterOverland, incomingWaterChannel;
+  // Cells that need their kinematic wave equations solved this step when only
+  // the active set is routed
+  std::vector<unsigned char> active;
 };
 
-class KWRoute : public RoutingModel {
+class KWRoute : public RoutingModel, public RoutingKernel {
 
 public:
   KWRoute();
   ~KWRoute();
   float SetObsInflow(long index, float inflow);
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath,
@@ -51,19 +76,78 @@ public:
   bool Route(float stepHours, std::vector<float> *fastFlow,
              std::vector<float> *slowFlow, std::vector<float> *discharge);
   float GetMaxSpeed() { return maxSpeed; }
+  void PrepareTimeStep(float stepHours);
+  float GetMeanIterations() { return meanIterations; }
+  float GetActiveFraction() { return activeFraction; }
+  void RouteCells(const long *cells, size_t count);
+  void SetSolver(KW_SOLVERS newSolver) { solver = newSolver; }
+  void SetActiveSet(bool useActiveSet) { activeSet = useActiveSet; }
+  // Must be called before InitializeModel
+  void SetPrecision(PRECISIONS newPrecision) { precision = newPrecision; }
+  // When source is not NULL Route has it fill in the fast and slow flow of
+  // each sub-tree right before routing it, the active set needs all of the
+  // fast flow up front and must be off.
+  void SetRunoffSource(RoutingSource *source) { runoffSource = source; }
+  size_t GetNumTasks() { return network.GetNumTasks(); }
 
 private:
-  void RouteInt(float stepSeconds, GridNode *node, KWGridNode *cNode,
-                float fastFlow, float slowFlow);
+  // Route and RouteCells run these with Real as the compute type picked by
+  // precision, Flows returns the flows kept in that type
+  template <class Real>
+  void RunRoute(std::vector<float> *fastFlow, std::vector<float> *slowFlow,
+                std::vector<float> *discharge);
+  template <class Real> void RunRouteCells(const long *cells, size_t count);
+  template <class Real> KWFlows<Real> *Flows();
+  template <class Real> void GatherInflow(long index);
+  template <class Real> Real GatherInterflow(long index);
+  template <class Real> void GatherOverland(long index);
+  template <class Real>
+  void RouteHillslope(float stepSeconds, long index, float fastFlow,
+                      long *iterations);
+  template <class Real>
+  void RouteChannel(float stepSeconds, long index, float fastFlow,
+                    float slowFlow, long *iterations);
+  template <class Real>
+  void RouteWarmHillslope(float stepSeconds, long index, float fastFlow,
+                          long *iterations);
+  template <class Real>
+  void RouteWarmChannel(float stepSeconds, long index, float fastFlow,
+                        float slowFlow, long *iterations);
+  template <class Real>
+  void RouteLevelBatches(const long *cells, size_t count, long *iterations);
+  template <class Real>
+  void RouteBatch(float stepSeconds, const long *cells, size_t count,
+                  long *iterations);
+  template <class Real> void LeakInterflow(long index, float slowFlow);
+  void CacheConstants(float stepSeconds);
+  void GroupCells();
+  template <class Real> void MarkActiveCells(std::vector<float> *fastFlow);
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
-  void InitializeRouting(float timeSeconds);
+  RoutingGather *GetInterflowTable(float stepSeconds);
+  void InitializeRouting(float timeSeconds, RoutingGather *gather);
 
   std::vector<GridNode> *nodes;
-  std::vector<KWGridNode> kwNodes;
+  std::vector<GridCell> *gridCells;
+  KWCells kwCells;
+  RoutingNetwork network;
+  std::map<float, RoutingGather> interflowTables; // By step length in seconds
+  RoutingGather *interflowGather;
+  float routeStepSeconds;
+  std::vector<float> *routeFastFlow, *routeSlowFlow;
+  RoutingSource *runoffSource;
+  KW_SOLVERS solver;
+  bool cacheValid;
+  float cachedStepSeconds;
+  long solverIterations, solverCells;
+  float meanIterations;
+  bool activeSet;
+  // Double unless a task or the build asks for single
+  PRECISIONS precision;
+  long numActive;
+  float activeFraction;
   float maxSpeed;
-  bool initialized;
 };
 
 #endif
@@ -5,18 +5,22 @@
 #include <cstdio>
 #include <cstring>
 
-LRRoute::LRRoute() {}
+LRRoute::LRRoute() {
+  runoffSource = NULL;
+  depthTolerance = 0.0;
+}
 
 LRRoute::~LRRoute() {}
 
 float LRRoute::SetObsInflow(long index, float inflow) { return 0.0; }
 
 bool LRRoute::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
+  gridCells = newCells;
   if (lrNodes.size() != nodes->size()) {
     lrNodes.resize(nodes->size());
   }
@@ -28,10 +32,26 @@ bool LRRoute::InitializeModel(
     node->modelIndex = i;
     LRGridNode *cNode = &(lrNodes[i]);
     cNode->slopeSqrt = pow(node->slope, 0.5f);
+    cNode->horLen = node->horLen;
+    cNode->channelGridCell = node->channelGridCell;
+    cNode->speedChanged = true;
   }
 
+  network.Build(nodes);
+
   InitializeParameters(paramSettings, paramGrids);
-  initialized = false;
+
+  // Interflow moves at a fixed speed, so its crossing times are known up front
+  for (size_t i = 0; i < numNodes; i++) {
+    LRGridNode *cNode = &(lrNodes[i]);
+    float speedUnder = cNode->params[PARAM_LINEAR_UNDER] * cNode->slopeSqrt;
+    float nexTimeUnder = cNode->horLen / speedUnder;
+    cNode->nexTime[LR_LAYER_INTERFLOW] = nexTimeUnder;
+  }
+  routeGather[LR_LAYER_OVERLAND] = &overlandGather;
+  routeGather[LR_LAYER_INTERFLOW] = NULL;
+  interflowTables.clear();
+  routedSeconds = 0.0;
   maxSpeed = 1.0;
 
   return true;
@@ -47,35 +67,43 @@ bool LRRoute::Route(float stepHours, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *discharge) {
 
-  if (!initialized) {
-    initialized = true;
+  // Targets are found at the end of every step for the next one, which may
+  // be of another length
+  if (stepHours * 3600.0f != routedSeconds) {
     InitializeRouting(stepHours * 3600.0f);
   }
 
-  size_t numNodes = nodes->size();
-
-  for (size_t i = 0; i < numNodes; i++) {
-    LRGridNode *cNode = &(lrNodes[i]);
-    RouteInt(&(nodes->at(i)), cNode, fastFlow->at(i), slowFlow->at(i));
-  }
+  routeFastFlow = fastFlow;
+  routeSlowFlow = slowFlow;
 
-  for (size_t i = 0; i < numNodes; i++) {
-    LRGridNode *cNode = &(lrNodes[i]);
-    fastFlow->at(i) = cNode->incomingWater[LR_LAYER_OVERLAND];
-    cNode->incomingWater[LR_LAYER_OVERLAND] = 0.0;
-    slowFlow->at(i) = cNode->incomingWater[LR_LAYER_INTERFLOW];
-    cNode->incomingWater[LR_LAYER_INTERFLOW] = 0.0;
-  }
+  // Each sub-tree is routed once all of the sub-trees draining into it are
+  // done, see RouteCells.
+  network.RouteTasks(this, runoffSource);
 
   InitializeRouting(stepHours * 3600.0f);
 
   return true;
 }
 
-void LRRoute::RouteInt(GridNode *node, LRGridNode *cNode, float fastFlow,
-                       float slowFlow) {
+void LRRoute::RouteCells(const long *cells, size_t count) {
+  // Every cell drains its own reservoirs first, then each cell pulls what the
+  // cells upstream of it sent. Routing targets are always downstream, so
+  // everything sent to these cells comes from this batch or one routed
+  // before it.
+  for (size_t j = 0; j < count; j++) {
+    long i = cells[j];
+    RouteInt(&(lrNodes[i]), routeFastFlow->at(i), routeSlowFlow->at(i));
+  }
+  for (size_t j = 0; j < count; j++) {
+    long i = cells[j];
+    routeFastFlow->at(i) = GatherOutflow(i, LR_LAYER_OVERLAND);
+    routeSlowFlow->at(i) = GatherOutflow(i, LR_LAYER_INTERFLOW);
+  }
+}
 
-  if (!node->channelGridCell) {
+void LRRoute::RouteInt(LRGridNode *cNode, float fastFlow, float slowFlow) {
+
+  if (!cNode->channelGridCell) {
     cNode->reservoirs[LR_LAYER_OVERLAND] += fastFlow;
   }
 
@@ -86,7 +114,7 @@ void LRRoute::RouteInt(GridNode *node, LRGridNode *cNode, float fastFlow,
     cNode->reservoirs[LR_LAYER_OVERLAND] = 0;
   }
 
-  if (node->channelGridCell) {
+  if (cNode->channelGridCell) {
     overlandLeak += fastFlow;
   }
 
@@ -99,45 +127,21 @@ void LRRoute::RouteInt(GridNode *node, LRGridNode *cNode, float fastFlow,
     cNode->reservoirs[LR_LAYER_INTERFLOW] = 0;
   }
 
-  if (cNode->routeCNode[0][LR_LAYER_OVERLAND]) {
-    double overlandLeak0 =
-        overlandLeak * cNode->routeAmount[0][LR_LAYER_OVERLAND] * node->area /
-        cNode->routeNode[0][LR_LAYER_OVERLAND]->area;
-    double leakAmount = overlandLeak0;
-    double *res = &(cNode->routeCNode[0][LR_LAYER_OVERLAND]
-                        ->incomingWater[LR_LAYER_OVERLAND]);
-    *res += leakAmount; // Make this an atomic add for parallelization
-  }
-
-  if (cNode->routeCNode[1][LR_LAYER_OVERLAND]) {
-    double overlandLeak1 =
-        overlandLeak * cNode->routeAmount[1][LR_LAYER_OVERLAND] * node->area /
-        cNode->routeNode[1][LR_LAYER_OVERLAND]->area;
-    double leakAmount = overlandLeak1;
-    double *res = &(cNode->routeCNode[1][LR_LAYER_OVERLAND]
-                        ->incomingWater[LR_LAYER_OVERLAND]);
-    *res += leakAmount; // Make this an atomic add for parallelization
-  }
-
-  if (cNode->routeCNode[0][LR_LAYER_INTERFLOW]) {
-    double interflowLeak0 =
-        interflowLeak * cNode->routeAmount[0][LR_LAYER_INTERFLOW] * node->area /
-        cNode->routeNode[0][LR_LAYER_INTERFLOW]->area;
-    double leakAmount = interflowLeak0;
-    double *res = &(cNode->routeCNode[0][LR_LAYER_INTERFLOW]
-                        ->incomingWater[LR_LAYER_INTERFLOW]);
-    *res += leakAmount; // Make this an atomic add for parallelization
-  }
+  // The receiving cells pull these through routeGather
+  cNode->outflow[LR_LAYER_OVERLAND] = overlandLeak;
+  cNode->outflow[LR_LAYER_INTERFLOW] = interflowLeak;
+}
 
-  if (cNode->routeCNode[1][LR_LAYER_INTERFLOW]) {
-    double interflowLeak1 =
-        interflowLeak * cNode->routeAmount[1][LR_LAYER_INTERFLOW] * node->area /
-        cNode->routeNode[1][LR_LAYER_INTERFLOW]->area;
-    double leakAmount = interflowLeak1;
-    double *res = &(cNode->routeCNode[1][LR_LAYER_INTERFLOW]
-                        ->incomingWater[LR_LAYER_INTERFLOW]);
-    *res += leakAmount; // Make this an atomic add for parallelization
+double LRRoute::GatherOutflow(long index, int layer) {
+  double water = 0.0;
+  RoutingGather *gather = routeGather[layer];
+  size_t numSources = gather->GetCount(index);
+  const long *sources = gather->GetSources(index);
+  const double *weights = gather->GetWeights(index);
+  for (size_t s = 0; s < numSources; s++) {
+    water += lrNodes[sources[s]].outflow[layer] * weights[s];
   }
+  return water;
 }
 
 void LRRoute::InitializeParameters(
@@ -149,6 +153,7 @@ void LRRoute::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     LRGridNode *cNode = &(lrNodes[i]);
     if (!node->gauge) {
       unused++;
@@ -172,12 +177,12 @@ void LRRoute::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_LINEAR_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        cNode->params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
@@ -212,18 +217,25 @@ void LRRoute::InitializeParameters(
     } else {
       node->channelGridCell = false;
     }
+    cNode->channelGridCell = node->channelGridCell;
   }
 }
 
 void LRRoute::InitializeRouting(float timeSeconds) {
 
-  maxSpeed = 0;
+  // A new step length moves every target, otherwise the targets only need to
+  // be found again when some cell's speed has changed.
+  bool newStep = (timeSeconds != routedSeconds);
+  routedSeconds = timeSeconds;
+  long numChanged = 0;
 
   // This pass distributes parameters & calculates the time it takes for water
   // to cross the grid cell.
-  size_t numNodes = nodes->size();
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
+  long numNodes = (long)nodes->size();
+#if _OPENMP
+#pragma omp parallel for reduction(+ : numChanged)
+#endif
+  for (long i = 0; i < numNodes; i++) {
     LRGridNode *cNode = &(lrNodes[i]);
 
     float waterDepth = (cNode->reservoirs[LR_LAYER_OVERLAND] *
@@ -231,13 +243,24 @@ void LRRoute::InitializeRouting(float timeSeconds) {
                         cNode->reservoirs[LR_LAYER_INTERFLOW] *
                             cNode->params[PARAM_LINEAR_LEAKI]) /
                        1000.0f;
-    if (node->channelGridCell) {
+    if (cNode->channelGridCell) {
       waterDepth += (cNode->incomingWater[LR_LAYER_OVERLAND]) / 1000.0f;
     }
     if (waterDepth < 0.0001) {
       waterDepth = 0.0001;
     }
 
+    // Small changes in depth keep the speed from the last time it was
+    // computed
+    if (!newStep && fabsf(waterDepth - cNode->routeDepth) <=
+                        depthTolerance * cNode->routeDepth) {
+      cNode->speedChanged = false;
+      continue;
+    }
+    cNode->routeDepth = waterDepth;
+    cNode->speedChanged = true;
+    numChanged++;
+
     // Calculate the approximate speed of the water in meters per second (thus
     // COEM is in meters per second) Slope is meters vertical change over meters
     // horizontal change so thus unitless
@@ -245,106 +268,141 @@ void LRRoute::InitializeRouting(float timeSeconds) {
 
     // We have different mannings roughness multipliers for overland & channel
     // grid cells
-    if (node->fac > cNode->params[PARAM_LINEAR_TH]) {
+    if (cNode->channelGridCell) {
       speed *= cNode->params[PARAM_LINEAR_RIVER];
     } else {
       speed *= cNode->params[PARAM_LINEAR_COEM];
     }
+    cNode->speed = speed;
 
-    if (speed > maxSpeed) {
-      maxSpeed = speed;
-    }
+    float nexTime = cNode->horLen / speed;
+    cNode->nexTime[LR_LAYER_OVERLAND] = nexTime;
+  }
 
-    // Calculate the water speed for interflow
-    float speedUnder = cNode->params[PARAM_LINEAR_UNDER] * cNode->slopeSqrt;
+  maxSpeed = 0;
+  for (long i = 0; i < numNodes; i++) {
+    if (lrNodes[i].speed > maxSpeed) {
+      maxSpeed = lrNodes[i].speed;
+    }
+  }
 
-    float nexTime = node->horLen / speed;
-    float nexTimeUnder = node->horLen / speedUnder;
-    cNode->nexTime[LR_LAYER_OVERLAND] = nexTime;
-    cNode->nexTime[LR_LAYER_INTERFLOW] = nexTimeUnder;
+  if (newStep || numChanged > 0) {
+    FindRouteTargets(LR_LAYER_OVERLAND, timeSeconds, &overlandGather,
+                     newStep);
   }
+  routeGather[LR_LAYER_INTERFLOW] = GetInterflowTable(timeSeconds);
+}
 
-  // This pass figures out which cell water is routed to
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *currentNode, *previousNode;
-    float currentSeconds, previousSeconds;
-    GridNode *node = &nodes->at(i);
-    LRGridNode *cNode = &(lrNodes[i]);
+void LRRoute::PrepareTimeStep(float stepHours) {
+  GetInterflowTable(stepHours * 3600.0f);
+}
 
-    // Overland routing
-    previousSeconds = 0;
-    currentSeconds = 0;
-    currentNode = node;
-    previousNode = NULL;
-    while (currentSeconds < timeSeconds) {
-      if (currentNode) {
-        previousSeconds = currentSeconds;
-        previousNode = currentNode;
-        currentSeconds +=
-            lrNodes[currentNode->modelIndex].nexTime[LR_LAYER_OVERLAND];
-        if (currentNode->downStreamNode != INVALID_DOWNSTREAM_NODE) {
-          currentNode = &(nodes->at(currentNode->downStreamNode));
-        } else {
-          currentNode = NULL;
-        }
+RoutingGather *LRRoute::GetInterflowTable(float stepSeconds) {
+  // Interflow speeds never change, so a table of its targets is kept for every
+  // step length seen since InitializeModel. Overland targets follow the water
+  // depth and are found again as it changes.
+  std::map<float, RoutingGather>::iterator itr =
+      interflowTables.find(stepSeconds);
+  if (itr != interflowTables.end()) {
+    return &(itr->second);
+  }
+  RoutingGather *gather = &(interflowTables[stepSeconds]);
+  FindRouteTargets(LR_LAYER_INTERFLOW, stepSeconds, gather, true);
+  return gather;
+}
+
+void LRRoute::FindRouteTargets(int layer, float timeSeconds,
+                               RoutingGather *gather, bool allCells) {
+
+  // Water leaving a cell is routed to the two cells on its flow path where the
+  // travel time crosses timeSeconds. With the travel time from every cell to
+  // past the outlet, the time from a cell to one downstream of it is the
+  // difference of the two, so the crossing is found with a search along the
+  // network's jump pointers instead of a walk. Crossing times of a whole step
+  // or more end the walk either way, capping them keeps the sums finite.
+  // Unless allCells is set, only cells with a changed speed less than
+  // timeSeconds downstream of them get new targets, nearestChange holds the
+  // first changed cell on each cell's path or -1.
+  size_t numNodes = nodes->size();
+  std::vector<double> &remaining = travelTime[layer];
+  remaining.resize(numNodes);
+  nearestChange.resize(numNodes);
+  for (size_t l = network.GetNumLevels(); l > 0; l--) {
+    size_t levelSize = network.GetLevelSize(l - 1);
+    const long *cells = network.GetLevelCells(l - 1);
+    for (size_t c = 0; c < levelSize; c++) {
+      long i = cells[c];
+      double nexTime = lrNodes[i].nexTime[layer];
+      if (!(nexTime < timeSeconds)) {
+        nexTime = timeSeconds;
+      }
+      unsigned long downStream = nodes->at(i).downStreamNode;
+      remaining[i] = nexTime + ((downStream != INVALID_DOWNSTREAM_NODE)
+                                    ? remaining[downStream]
+                                    : 0.0);
+      if (lrNodes[i].speedChanged) {
+        nearestChange[i] = i;
       } else {
-        if (timeSeconds > currentSeconds) {
-          previousNode = NULL;
-        }
-        break; // We have effectively run out of nodes to transverse, this is
-               // done!
+        nearestChange[i] = (downStream != INVALID_DOWNSTREAM_NODE)
+                               ? nearestChange[downStream]
+                               : -1;
       }
     }
+  }
 
-    cNode->routeNode[0][LR_LAYER_OVERLAND] = currentNode;
-    cNode->routeCNode[0][LR_LAYER_OVERLAND] =
-        (currentNode) ? &(lrNodes[currentNode->modelIndex]) : NULL;
-    cNode->routeNode[1][LR_LAYER_OVERLAND] = previousNode;
-    cNode->routeCNode[1][LR_LAYER_OVERLAND] =
-        (previousNode) ? &(lrNodes[previousNode->modelIndex]) : NULL;
-    if ((currentSeconds - previousSeconds) > 0) {
-      cNode->routeAmount[0][LR_LAYER_OVERLAND] =
-          (timeSeconds - previousSeconds) / (currentSeconds - previousSeconds);
-      cNode->routeAmount[1][LR_LAYER_OVERLAND] =
-          1.0 - cNode->routeAmount[0][LR_LAYER_OVERLAND];
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long i = 0; i < (long)numNodes; i++) {
+    LRGridNode *cNode = &(lrNodes[i]);
+    long change = nearestChange[i];
+    if (!allCells &&
+        (change < 0 || !(remaining[change] > remaining[i] - timeSeconds))) {
+      continue;
     }
 
-    // Interflow routing
-    previousSeconds = 0;
-    currentSeconds = 0;
-    currentNode = node;
-    previousNode = NULL;
-    while (currentSeconds < timeSeconds) {
-      if (currentNode) {
-        previousSeconds = currentSeconds;
-        previousNode = currentNode;
-        currentSeconds +=
-            lrNodes[currentNode->modelIndex].nexTime[LR_LAYER_INTERFLOW];
-        if (currentNode->downStreamNode != INVALID_DOWNSTREAM_NODE) {
-          currentNode = &(nodes->at(currentNode->downStreamNode));
-        } else {
-          currentNode = NULL;
-        }
-      } else {
-        if (timeSeconds > currentSeconds) {
-          previousNode = NULL;
-        }
-        break; // We have effectively run out of nodes to transverse, this is
-               // done!
-      }
+    // previousNode is the last cell reached before timeSeconds runs out and
+    // currentNode the one after it, NULL once past the outlet. When the whole
+    // path takes less than timeSeconds the water leaves the basin.
+    long last =
+        network.FindLastAbove(i, &(remaining[0]), remaining[i] - timeSeconds);
+    GridNode *previousNode = &(nodes->at(last));
+    GridNode *currentNode =
+        (previousNode->downStreamNode != INVALID_DOWNSTREAM_NODE)
+            ? &(nodes->at(previousNode->downStreamNode))
+            : NULL;
+    if (!currentNode && remaining[i] < timeSeconds) {
+      previousNode = NULL;
     }
 
-    cNode->routeNode[0][LR_LAYER_INTERFLOW] = currentNode;
-    cNode->routeCNode[0][LR_LAYER_INTERFLOW] =
+    cNode->routeNode[0][layer] = currentNode;
+    cNode->routeCNode[0][layer] =
         (currentNode) ? &(lrNodes[currentNode->modelIndex]) : NULL;
-    cNode->routeNode[1][LR_LAYER_INTERFLOW] = previousNode;
-    cNode->routeCNode[1][LR_LAYER_INTERFLOW] =
+    cNode->routeNode[1][layer] = previousNode;
+    cNode->routeCNode[1][layer] =
         (previousNode) ? &(lrNodes[previousNode->modelIndex]) : NULL;
-    if ((currentSeconds - previousSeconds) > 0) {
-      cNode->routeAmount[0][LR_LAYER_INTERFLOW] =
-          (timeSeconds - previousSeconds) / (currentSeconds - previousSeconds);
-      cNode->routeAmount[1][LR_LAYER_INTERFLOW] =
-          1.0 - cNode->routeAmount[0][LR_LAYER_INTERFLOW];
+    double previousSeconds = remaining[i] - remaining[last];
+    double lastSeconds = lrNodes[last].nexTime[layer];
+    if (lastSeconds > 0) {
+      cNode->routeAmount[0][layer] =
+          (timeSeconds - previousSeconds) / lastSeconds;
+      cNode->routeAmount[1][layer] = 1.0 - cNode->routeAmount[0][layer];
+    }
+  }
+
+  // Invert the routing targets so each cell can pull its incoming water
+  gather->Clear(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    GridCell *cell = &gridCells->at(i);
+    LRGridNode *cNode = &(lrNodes[i]);
+    for (int r = 0; r < 2; r++) {
+      GridNode *target = cNode->routeNode[r][layer];
+      if (target) {
+        float targetArea = gridCells->at(target->modelIndex).area;
+        gather->Add(i, target->modelIndex,
+                    cNode->routeAmount[r][layer] * cell->area / targetArea);
+      }
     }
   }
+  gather->Finalize();
 }
@@ -2,6 +2,7 @@
 #define LR_MODEL_H
 
 #include "ModelBase.h"
+#include "RoutingNetwork.h"
 
 enum LR_LAYER {
   LR_LAYER_OVERLAND,
@@ -13,6 +14,11 @@ struct LRGridNode : BasicGridNode {
   float params[PARAM_LINEAR_QTY];
 
   double slopeSqrt;
+  float horLen;
+  bool channelGridCell; // Copied from the GridNode so stepping does not read it
+  float routeDepth; // Water depth the overland speed was last computed with
+  float speed;
+  bool speedChanged; // Whether the last InitializeRouting changed the speed
 
   double
       nexTime[LR_LAYER_QTY]; // This is a by product of computing cell routing
@@ -23,14 +29,17 @@ struct LRGridNode : BasicGridNode {
 
   double reservoirs[LR_LAYER_QTY]; // CREST has two excess storage reservoirs
                                    // (overland & interflow)
+  double outflow[LR_LAYER_QTY]; // Water leaving this cell during the current
+                                // step
 };
 
-class LRRoute : public RoutingModel {
+class LRRoute : public RoutingModel, public RoutingKernel {
 
 public:
   LRRoute();
   ~LRRoute();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath,
@@ -41,20 +50,41 @@ public:
   bool Route(float stepHours, std::vector<float> *fastFlow,
              std::vector<float> *slowFlow, std::vector<float> *discharge);
   float GetMaxSpeed() { return maxSpeed; }
+  void PrepareTimeStep(float stepHours);
+  void RouteCells(const long *cells, size_t count);
+  // When source is not NULL Route has it fill in the fast and slow flow of
+  // each sub-tree right before routing it
+  void SetRunoffSource(RoutingSource *source) { runoffSource = source; }
+  size_t GetNumTasks() { return network.GetNumTasks(); }
+  // Overland speeds are kept while a cell's water depth stays within this
+  // fraction of the depth they were computed with, 0 recomputes them on any
+  // change
+  void SetDepthTolerance(float tolerance) { depthTolerance = tolerance; }
 
 private:
-  void RouteInt(GridNode *node, LRGridNode *cNode, float fastFlow,
-                float slowFlow);
+  void RouteInt(LRGridNode *cNode, float fastFlow, float slowFlow);
+  double GatherOutflow(long index, int layer);
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeRouting(float timeSeconds);
+  RoutingGather *GetInterflowTable(float stepSeconds);
+  void FindRouteTargets(int layer, float timeSeconds, RoutingGather *gather,
+                        bool allCells);
   float SetObsInflow(long index, float inflow);
 
   std::vector<GridNode> *nodes;
+  std::vector<GridCell> *gridCells;
   std::vector<LRGridNode> lrNodes;
-  float maxSpeed;
-  bool initialized;
+  RoutingNetwork network;
+  RoutingGather *routeGather[LR_LAYER_QTY];
+  RoutingGather overlandGather;
+  std::map<float, RoutingGather> interflowTables; // By step length in seconds
+  std::vector<double> travelTime[LR_LAYER_QTY];
+  std::vector<long> nearestChange;
+  std::vector<float> *routeFastFlow, *routeSlowFlow;
+  RoutingSource *runoffSource;
+  float maxSpeed, routedSeconds, depthTolerance;
 };
 
 #endif
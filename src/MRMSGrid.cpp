@@ -4,7 +4,7 @@
 #include <math.h>
 #include <zlib.h>
 
-FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
+static FloatGrid *ReadMRMS(char *file, FloatGrid *grid, GridPool *pool) {
 
   gzFile fileH;
 
@@ -55,8 +55,34 @@ FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
 
   gzclose(fileH);
 
-  float *__restrict__ backingStore = new float[num];
   const float scalef = (float)header.var_scale;
+  dx = header.dx / float(header.dxy_scale);
+  nw_lon = (float)header.nw_lon / (float)header.map_scale - (dx / 2.0);
+  nw_lat = (float)header.nw_lat / (float)header.map_scale - (dx / 2.0);
+  if (pool) {
+    // The file goes from south to north, the rows of the pooled grid stay
+    // where they are and are filled in reverse
+    grid = pool->Take(header.nx, header.ny);
+    grid->cellSize = dx;
+    grid->extent.top = nw_lat;
+    grid->extent.left = nw_lon;
+    grid->noData = -999.0;
+    const int numRows = (int)grid->numRows;
+    const int nX = header.nx;
+    for (int i = 0; i < numRows; i++) {
+      const short int *row = binary_data + (numRows - i - 1) * nX;
+      float *__restrict__ out = grid->data[i];
+      for (int j = 0; j < nX; j++) {
+        out[j] = ((float)row[j]) / scalef;
+      }
+    }
+    delete[] binary_data;
+    grid->extent.bottom = grid->extent.top - grid->numRows * grid->cellSize;
+    grid->extent.right = grid->extent.left + grid->numCols * grid->cellSize;
+    return grid;
+  }
+
+  float *__restrict__ backingStore = new float[num];
   int li = 0;
   /*#pragma omp parallel for
    for (li = 0; li < num; li += 4) {
@@ -81,10 +107,7 @@ FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
    }
    }*/
 
-  dx = header.dx / float(header.dxy_scale);
   // dy = header.dy/float(header.dxy_scale);
-  nw_lon = (float)header.nw_lon / (float)header.map_scale - (dx / 2.0);
-  nw_lat = (float)header.nw_lat / (float)header.map_scale - (dx / 2.0);
   if (!grid) {
     grid = new FloatGrid();
     grid->numCols = header.nx;
@@ -141,7 +164,17 @@ FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
   return grid;
 }
 
+FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid) {
+
+  return ReadMRMS(file, grid, NULL);
+}
+
+FloatGrid *ReadFloatMRMSGrid(char *file, GridPool *pool) {
+
+  return ReadMRMS(file, NULL, pool);
+}
+
 FloatGrid *ReadFloatMRMSGrid(char *file) {
 
-  return ReadFloatMRMSGrid(file, NULL);
+  return ReadMRMS(file, NULL, NULL);
 }
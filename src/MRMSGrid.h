@@ -2,6 +2,7 @@
 #define MRMS_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 #pragma pack(push)
 #pragma pack(1)
@@ -39,6 +40,8 @@ struct MRMSHeader2D {
 #pragma pack(pop)
 
 FloatGrid *ReadFloatMRMSGrid(char *file, FloatGrid *grid);
+// The grid comes from pool and goes back to it
+FloatGrid *ReadFloatMRMSGrid(char *file, GridPool *pool);
 FloatGrid *ReadFloatMRMSGrid(char *file);
 
 #endif
@@ -5,6 +5,17 @@ const char *runStyleStrings[] = {
     "clip_basin", "clip_gauge", "make_basic", "basin_avg",
 };
 
+const char *kwSolverStrings[] = {
+    "newton",
+    "batch",
+    "warmstart",
+};
+
+const char *precisionStrings[] = {
+    "single",
+    "double",
+};
+
 const char *modelStrings[] = {
 #undef ADDMODEL
 #define ADDMODEL(a, b) a,
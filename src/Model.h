@@ -27,6 +27,22 @@ enum RUNSTYLE {
   STYLE_QTY,
 };
 
+enum KW_SOLVERS {
+  KW_SOLVER_NEWTON,
+  KW_SOLVER_BATCH,
+  KW_SOLVER_WARMSTART,
+  KW_SOLVER_QTY,
+};
+
+// Type the CREST, SAC, Snow-17 and kinematic wave kernels compute in. Each
+// model keeps the type it has always used unless a task sets PRECISION, or the
+// build defines EF5_PRECISION as one of these for every model.
+enum PRECISIONS {
+  PRECISION_SINGLE,
+  PRECISION_DOUBLE,
+  PRECISION_QTY,
+};
+
 enum MODELS {
 #undef ADDMODEL
 #define ADDMODEL(a, b) MODEL_##b,
@@ -158,6 +174,8 @@ enum VCI_PARAMS {
 };
 
 extern const char *runStyleStrings[];
+extern const char *kwSolverStrings[];
+extern const char *precisionStrings[];
 extern const char *modelStrings[];
 extern const char *modelParamSetStrings[];
 extern const char *modelCaliParamStrings[];
@@ -7,11 +7,15 @@
 #include "TimeUnit.h"
 #include <vector>
 
+// Number of cells WaterBalanceBlock takes through a block of steps at a time
+#define WB_BLOCK_TILE 256
+
 class Model {
 
 public:
   virtual bool
   InitializeModel(TimeUnit *timeStep, std::vector<GridNode> *nodes,
+                  std::vector<GridCell> *cells,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
                   std::vector<FloatGrid *> *paramGrids) = 0;
   virtual void InitializeStates(TimeVar *beginTime, char *statePath) = 0;
@@ -29,7 +33,7 @@ class WaterBalanceModel {
 
 public:
   virtual bool
-  InitializeModel(std::vector<GridNode> *nodes,
+  InitializeModel(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
                   std::vector<FloatGrid *> *paramGrids) = 0;
   virtual void InitializeStates(TimeVar *beginTime, char *statePath) = 0;
@@ -40,6 +44,34 @@ public:
                             std::vector<float> *fastFlow,
                             std::vector<float> *slowFlow,
                             std::vector<float> *soilMoisture) = 0;
+  // Runs numSteps steps of stepHours each. precip, pet, fastFlow, slowFlow and
+  // soilMoisture point to numSteps vectors, one per step. fastFlow[k] and
+  // slowFlow[k] are set to the runoff of step k, which is what WaterBalance
+  // would have added to its fastFlow and slowFlow, and soilMoisture may be
+  // NULL. Cells do not depend on each other so each tile of WB_BLOCK_TILE
+  // cells is taken through every step before moving on to the next.
+  virtual bool WaterBalanceBlock(float stepHours, int numSteps,
+                                 std::vector<float> *precip,
+                                 std::vector<float> *pet,
+                                 std::vector<double> *fastFlow,
+                                 std::vector<double> *slowFlow,
+                                 std::vector<float> *soilMoisture) = 0;
+  // Parameter set batches for calibration. InitializeSets sets the model up
+  // with numSets copies of every cell, paramSettings points to one map per
+  // set, and each set starts from the states InitializeModel would give it.
+  // WaterBalanceSets then advances every set by one step on the same forcing,
+  // adding the runoff of set s to fastFlow[s] and slowFlow[s]. The sets of a
+  // cell are stored next to each other so each forcing value is loaded once
+  // for all of them. Models without batches return false from InitializeSets.
+  virtual bool
+  InitializeSets(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
+                 int numSets,
+                 std::map<GaugeConfigSection *, float *> *paramSettings,
+                 std::vector<FloatGrid *> *paramGrids) = 0;
+  virtual bool WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                                std::vector<float> *pet,
+                                std::vector<float> *fastFlow,
+                                std::vector<float> *slowFlow) = 0;
   virtual bool IsLumped() = 0;
   virtual const char *GetName() = 0;
 };
@@ -48,7 +80,7 @@ class RoutingModel {
 
 public:
   virtual bool
-  InitializeModel(std::vector<GridNode> *nodes,
+  InitializeModel(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
                   std::vector<FloatGrid *> *paramGrids) = 0;
   virtual void InitializeStates(TimeVar *beginTime, char *statePath,
@@ -61,13 +93,17 @@ public:
                      std::vector<float> *discharge) = 0;
   virtual float GetMaxSpeed() = 0;
   virtual float SetObsInflow(long index, float inflow) = 0;
+  // Builds the routing tables that only depend on the parameters and the time
+  // step length, so switching to a step length prepared here costs nothing.
+  // Route builds them on first use otherwise.
+  virtual void PrepareTimeStep(float stepHours) = 0;
 };
 
 class SnowModel {
 
 public:
   virtual bool
-  InitializeModel(std::vector<GridNode> *nodes,
+  InitializeModel(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
                   std::vector<FloatGrid *> *paramGrids) = 0;
   virtual void InitializeStates(TimeVar *beginTime, char *statePath) = 0;
@@ -84,7 +120,7 @@ class InundationModel {
 
 public:
   virtual bool
-  InitializeModel(std::vector<GridNode> *nodes,
+  InitializeModel(std::vector<GridNode> *nodes, std::vector<GridCell> *cells,
                   std::map<GaugeConfigSection *, float *> *paramSettings,
                   std::vector<FloatGrid *> *paramGrids) = 0;
   virtual bool Inundation(std::vector<float> *discharge,
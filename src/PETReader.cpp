@@ -8,12 +8,12 @@
 #include <cstring>
 
 bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
-                     std::vector<GridNode> *nodes,
+                     std::vector<GridCell> *cells,
                      std::vector<float> *currentPET, float petConvert,
                      bool isTemp, float jday, std::vector<float> *prevPET) {
   if (!strcmp(lastPETFile, file)) {
     if (prevPET) {
-      for (size_t i = 0; i < nodes->size(); i++) {
+      for (size_t i = 0; i < cells->size(); i++) {
         currentPET->at(i) = prevPET->at(i);
       }
     }
@@ -30,10 +30,10 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
     petGrid = ReadFloatAscGrid(file);
     break;
   case PET_BIF:
-    petGrid = ReadFloatBifGrid(file);
+    petGrid = ReadFloatBifGrid(file, &pool);
     break;
   case PET_TIF:
-    petGrid = ReadFloatTifGrid(file);
+    petGrid = ReadFloatTifGridWindow(file, window.Get(cells), &pool);
     break;
   default:
     ERROR_LOG("Unsupported PET format!");
@@ -42,7 +42,7 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
 
   if (!petGrid) {
     // If the file is not found or something else is wrong we assume zero values
-    for (size_t i = 0; i < nodes->size(); i++) {
+    for (size_t i = 0; i < cells->size(); i++) {
       currentPET->at(i) = 0;
     }
     return false;
@@ -51,25 +51,29 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
   // We have two options now... Either the pet grid & the basic grids are the
   // same Or they are different!
 
+  // Windowed grids only hold the rows and columns around the cells
+  long left = petGrid->windowLeft, top = petGrid->windowTop;
+
   if (g_DEM->IsSpatialMatch(petGrid)) {
     // The grids are the same! Our life is easy!
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (petGrid->data[node->y][node->x] > 0.0) {
-        currentPET->at(i) = petGrid->data[node->y][node->x] * petConvert;
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      float value = petGrid->data[cell->y - top][cell->x - left];
+      if (value > 0.0) {
+        currentPET->at(i) = value * petConvert;
       } else {
         currentPET->at(i) = 0.0;
       }
     }
 
   } else {
-    // The grids are different, we must do some resampling fun.
-    GridLoc pt;
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (petGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
-          petGrid->data[pt.y][pt.x] > 0.0) {
-        currentPET->at(i) = petGrid->data[pt.y][pt.x] * petConvert;
+    // The grids are different, each cell takes the value the sampling index
+    // points it to
+    SamplingIndex *index = GetSamplingIndex(cells, petGrid);
+    for (size_t i = 0; i < cells->size(); i++) {
+      int row = index->rows[i];
+      if (row >= 0 && petGrid->data[row][index->cols[i]] > 0.0) {
+        currentPET->at(i) = petGrid->data[row][index->cols[i]] * petConvert;
       } else {
         currentPET->at(i) = 0;
       }
@@ -79,15 +83,15 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
   // See if this is a temperature grid and if so convert it into PET using Hamon
   // (1961).
   if (isTemp) {
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
       if (currentPET->at(i) <= 0 && currentPET->at(i) != petGrid->noData) {
         currentPET->at(i) =
             0; // Hey, its below freezing, no potential evaporation!
       } else if (currentPET->at(i) != petGrid->noData) {
         float lon, lat;
         RefLoc pt;
-        g_DEM->GetRefLoc(node->x, node->y, &pt);
+        g_DEM->GetRefLoc(cell->x, cell->y, &pt);
         g_Projection->UnprojectPoint(pt.x, pt.y, &lon, &lat);
         float e_s = 0.2749e8 * exp(-4278.6 / (currentPET->at(i) + 242.8));
         float delta = 0.4093 * sin(2 * PI * jday / 365 - 1.405);
@@ -103,7 +107,7 @@ bool PETReader::Read(char *file, SUPPORTED_PET_TYPES type,
   }
 
   // We don't actually need to keep the PET grid in memory anymore
-  delete petGrid;
+  pool.Give(petGrid);
 
   return true;
 }
@@ -3,17 +3,21 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "PETType.h"
 #include <vector>
 
 class PETReader {
 public:
-  bool Read(char *file, SUPPORTED_PET_TYPES type, std::vector<GridNode> *nodes,
+  PETReader() { lastPETFile[0] = 0; }
+  bool Read(char *file, SUPPORTED_PET_TYPES type, std::vector<GridCell> *cells,
             std::vector<float> *currentPET, float petConvert, bool isTemp,
             float jday, std::vector<float> *prevPET = NULL);
 
 private:
   char lastPETFile[CONFIG_MAX_LEN * 2];
+  CellWindow window;
+  GridPool pool;
 };
 
 #endif
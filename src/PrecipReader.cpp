@@ -10,12 +10,12 @@
 #include <cstring>
 
 bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
-                        std::vector<GridNode> *nodes,
+                        std::vector<GridCell> *cells,
                         std::vector<float> *currentPrecip, float precipConvert,
                         std::vector<float> *prevPrecip, bool hasQPF) {
   if (!strcmp(lastPrecipFile, file)) {
     if (prevPrecip) {
-      for (size_t i = 0; i < nodes->size(); i++) {
+      for (size_t i = 0; i < cells->size(); i++) {
         currentPrecip->at(i) = prevPrecip->at(i);
       }
     }
@@ -37,13 +37,13 @@ bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
     precipGrid = ReadFloatAscGrid(file);
     break;
   case PRECIP_BIF:
-    precipGrid = ReadFloatBifGrid(file);
+    precipGrid = ReadFloatBifGrid(file, &pool);
     break;
   case PRECIP_TIF:
-    precipGrid = ReadFloatTifGrid(file);
+    precipGrid = ReadFloatTifGridWindow(file, window.Get(cells), &pool);
     break;
   case PRECIP_MRMS:
-    precipGrid = ReadFloatMRMSGrid(file);
+    precipGrid = ReadFloatMRMSGrid(file, &pool);
     break;
   case PRECIP_TRMMRT:
     precipGrid = ReadFloatTRMMRTGrid(file, precipGrid);
@@ -58,7 +58,7 @@ bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
   if (!precipGrid) {
     // The precip file was not found! We return zeros if there is no qpf.
     if (!hasQPF) {
-      for (size_t i = 0; i < nodes->size(); i++) {
+      for (size_t i = 0; i < cells->size(); i++) {
         currentPrecip->at(i) = 0;
       }
     }
@@ -74,37 +74,41 @@ bool PrecipReader::Read(char *file, SUPPORTED_PRECIP_TYPES type,
   // We have two options now... Either the precip grid & the basic grids are the
   // same Or they are different!
 
+  // Windowed grids only hold the rows and columns around the cells
+  long left = precipGrid->windowLeft, top = precipGrid->windowTop;
+
   if (g_DEM->IsSpatialMatch(precipGrid)) {
 // The grids are the same! Our life is easy!
 #pragma omp parallel for
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (precipGrid->data[node->y][node->x] != precipGrid->noData &&
-          precipGrid->data[node->y][node->x] > 0.0) {
-        currentPrecip->at(i) =
-            precipGrid->data[node->y][node->x] * precipConvert;
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      float value = precipGrid->data[cell->y - top][cell->x - left];
+      if (value != precipGrid->noData && value > 0.0) {
+        currentPrecip->at(i) = value * precipConvert;
       } else {
         currentPrecip->at(i) = 0;
       }
     }
 
   } else {
-// The grids are different, we must do some resampling fun.
+    // The grids are different, each cell takes the value the sampling index
+    // points it to
+    SamplingIndex *index = GetSamplingIndex(cells, precipGrid);
 #pragma omp parallel for
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridLoc pt;
-      GridNode *node = &(nodes->at(i));
-      if (precipGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
-          precipGrid->data[pt.y][pt.x] != precipGrid->noData &&
-          precipGrid->data[pt.y][pt.x] > 0.0) {
-        currentPrecip->at(i) = precipGrid->data[pt.y][pt.x] * precipConvert;
-      } else {
-        currentPrecip->at(i) = 0;
+    for (size_t i = 0; i < cells->size(); i++) {
+      int row = index->rows[i];
+      if (row >= 0) {
+        float value = precipGrid->data[row][index->cols[i]];
+        if (value != precipGrid->noData && value > 0.0) {
+          currentPrecip->at(i) = value * precipConvert;
+          continue;
+        }
       }
+      currentPrecip->at(i) = 0;
     }
   }
 
-  delete precipGrid;
+  pool.Give(precipGrid);
 
   return true;
 }
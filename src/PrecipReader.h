@@ -3,18 +3,22 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "PrecipType.h"
 #include <vector>
 
 class PrecipReader {
 public:
+  PrecipReader() { lastPrecipFile[0] = 0; }
   bool Read(char *file, SUPPORTED_PRECIP_TYPES type,
-            std::vector<GridNode> *nodes, std::vector<float> *currentPrecip,
+            std::vector<GridCell> *cells, std::vector<float> *currentPrecip,
             float precipConvert, std::vector<float> *prevPrecip = NULL,
             bool hasQPF = false);
 
 private:
   char lastPrecipFile[CONFIG_MAX_LEN * 2];
+  CellWindow window;
+  GridPool pool;
 };
 
 #endif
@@ -0,0 +1,269 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include "CRESTModel.h"
+#include "Defines.h"
+#include "EF5.h"
+#include "GaugeConfigSection.h"
+#include "GridNode.h"
+#include "KinematicRoute.h"
+#include "Model.h"
+#include "ModelBase.h"
+#include "SAC.h"
+
+#define NUM_GRID_CELLS 20000
+#define CELL_SIZE (1000.0)
+#define TOTAL_TIME_STEPS 200
+#define MAX_VOLUME_ERROR 1e-4
+#define MAX_PEAK_ERROR 1e-3
+
+// Runs CREST and SAC followed by kinematic wave routing over a synthetic river
+// network once computing in single precision and once in double precision,
+// and compares the discharge at the outlet and at an inner gauge. Single
+// precision passes when the total volume and the peak at both gauges stay
+// within MAX_VOLUME_ERROR and MAX_PEAK_ERROR of double precision.
+
+struct GaugeSeries {
+  std::vector<float> outlet, inner;
+};
+
+void PrintStartupMessage();
+void InitializeNetwork();
+double Simulate(MODELS model, PRECISIONS precision, GaugeSeries *results);
+bool Compare(const char *name, GaugeSeries *single, GaugeSeries *twice);
+
+std::vector<GridNode> nodes;
+std::vector<GridCell> gridCells;
+std::map<GaugeConfigSection *, float *> crestSettings, sacSettings, kwSettings;
+std::vector<FloatGrid *> paramGrids;
+std::vector<float> precip, pet;
+GaugeConfigSection *outletGauge, *innerGauge;
+long innerNode;
+float crestParams[PARAM_CREST_QTY];
+float sacParams[PARAM_SAC_QTY];
+float kwParams[PARAM_KINEMATIC_QTY];
+
+int main(int argc, char *argv[]) {
+
+  PrintStartupMessage();
+  InitializeNetwork();
+
+  bool passed = true;
+  MODELS models[] = {MODEL_CREST, MODEL_SAC};
+  const char *names[] = {"CREST", "SAC"};
+  for (int m = 0; m < 2; m++) {
+    GaugeSeries single, twice;
+    double singleTime = Simulate(models[m], PRECISION_SINGLE, &single);
+    double doubleTime = Simulate(models[m], PRECISION_DOUBLE, &twice);
+    printf("%s: single %.3f s, double %.3f s\n", names[m], singleTime,
+           doubleTime);
+    if (!Compare(names[m], &single, &twice)) {
+      passed = false;
+    }
+  }
+
+  if (!passed) {
+    printf("FAILED: single precision strays too far from double\n");
+    return 1;
+  }
+  printf("PASSED\n");
+
+  return ERROR_SUCCESS;
+}
+
+static float RandomRange(float low, float high) {
+  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+void InitializeNetwork() {
+  srand(1);
+
+  // Each cell drains into one of the cells before it so cell 0 is the outlet
+  nodes.resize(NUM_GRID_CELLS);
+  gridCells.resize(NUM_GRID_CELLS);
+  for (int currentNode = 0; currentNode < NUM_GRID_CELLS; currentNode++) {
+    GridNode *currentN = &(nodes)[currentNode];
+    GridCell *currentC = &(gridCells)[currentNode];
+    currentN->index = currentNode;
+    currentC->x = currentNode;
+    currentC->y = 0;
+    if (currentNode == 0) {
+      currentN->downStreamNode = INVALID_DOWNSTREAM_NODE;
+    } else {
+      currentN->downStreamNode = (currentNode - 1) / 2;
+    }
+    currentN->horLen = CELL_SIZE;
+    currentN->slope = RandomRange(0.001, 0.05);
+    currentC->area = (CELL_SIZE * CELL_SIZE) / 1000000.0;
+    currentN->contribArea = currentC->area;
+    currentN->fac = 1;
+  }
+  for (int currentNode = NUM_GRID_CELLS - 1; currentNode > 0; currentNode--) {
+    GridNode *downN = &(nodes)[nodes[currentNode].downStreamNode];
+    downN->fac += nodes[currentNode].fac;
+    downN->contribArea += nodes[currentNode].contribArea;
+  }
+
+  // The inner gauge sits on the second largest branch
+  outletGauge = new GaugeConfigSection((char *)"outlet");
+  innerGauge = new GaugeConfigSection((char *)"inner");
+  innerNode = 1;
+  outletGauge->SetGridNodeIndex(0);
+  outletGauge->SetFlowAccum(nodes[0].fac);
+  innerGauge->SetGridNodeIndex(innerNode);
+  innerGauge->SetFlowAccum(nodes[innerNode].fac);
+  for (int currentNode = 0; currentNode < NUM_GRID_CELLS; currentNode++) {
+    // Cells in the subtree of innerNode have an ancestor of innerNode
+    long c = currentNode;
+    while (c > innerNode) {
+      c = (c - 1) / 2;
+    }
+    nodes[currentNode].gauge = (c == innerNode) ? innerGauge : outletGauge;
+  }
+
+  crestParams[PARAM_CREST_WM] = 120.0;
+  crestParams[PARAM_CREST_B] = 0.3;
+  crestParams[PARAM_CREST_IM] = 2.0;
+  crestParams[PARAM_CREST_KE] = 0.9;
+  crestParams[PARAM_CREST_FC] = 5.0;
+  crestParams[PARAM_CREST_IWU] = 30.0;
+
+  sacParams[PARAM_SAC_UZTWM] = 50.0;
+  sacParams[PARAM_SAC_UZFWM] = 40.0;
+  sacParams[PARAM_SAC_UZK] = 0.3;
+  sacParams[PARAM_SAC_PCTIM] = 0.01;
+  sacParams[PARAM_SAC_ADIMP] = 0.1;
+  sacParams[PARAM_SAC_RIVA] = 0.0;
+  sacParams[PARAM_SAC_ZPERC] = 40.0;
+  sacParams[PARAM_SAC_REXP] = 2.0;
+  sacParams[PARAM_SAC_LZTWM] = 150.0;
+  sacParams[PARAM_SAC_LZFSM] = 50.0;
+  sacParams[PARAM_SAC_LZFPM] = 100.0;
+  sacParams[PARAM_SAC_LZSK] = 0.05;
+  sacParams[PARAM_SAC_LZPK] = 0.005;
+  sacParams[PARAM_SAC_PFREE] = 0.3;
+  sacParams[PARAM_SAC_SIDE] = 0.0;
+  sacParams[PARAM_SAC_RSERV] = 0.3;
+  sacParams[PARAM_SAC_UZTWC] = 0.5;
+  sacParams[PARAM_SAC_UZFWC] = 0.2;
+  sacParams[PARAM_SAC_ADIMC] = 30.0;
+  sacParams[PARAM_SAC_LZTWC] = 0.5;
+  sacParams[PARAM_SAC_LZFSC] = 0.3;
+  sacParams[PARAM_SAC_LZFPC] = 0.4;
+
+  kwParams[PARAM_KINEMATIC_UNDER] = 1.0;
+  kwParams[PARAM_KINEMATIC_LEAKI] = 0.05;
+  kwParams[PARAM_KINEMATIC_TH] = 50.0;
+  kwParams[PARAM_KINEMATIC_ISU] = 0.0;
+  kwParams[PARAM_KINEMATIC_ALPHA] = 2.0;
+  kwParams[PARAM_KINEMATIC_BETA] = 0.6;
+  kwParams[PARAM_KINEMATIC_ALPHA0] = 1.5;
+
+  GaugeConfigSection *gauges[] = {outletGauge, innerGauge};
+  for (int g = 0; g < 2; g++) {
+    crestSettings[gauges[g]] = crestParams;
+    sacSettings[gauges[g]] = sacParams;
+    kwSettings[gauges[g]] = kwParams;
+  }
+
+  // We only use lumped parameters here for ease of use.
+  for (size_t paramI = 0; paramI < PARAM_SAC_QTY; paramI++) {
+    paramGrids.push_back(NULL);
+  }
+
+  // A storm crosses the basin in the first half, it is dry afterwards
+  precip.resize((size_t)NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  pet.resize((size_t)NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      size_t index = (size_t)t * NUM_GRID_CELLS + i;
+      bool storm = t < TOTAL_TIME_STEPS / 2 && (t / 10 + i) % 4 == 0;
+      precip[index] = storm ? RandomRange(1.0, 20.0) : 0.0;
+      pet[index] = RandomRange(0.0, 0.3);
+    }
+  }
+}
+
+double Simulate(MODELS model, PRECISIONS precision, GaugeSeries *results) {
+  WaterBalanceModel *wbModel;
+  std::map<GaugeConfigSection *, float *> *wbSettings;
+  if (model == MODEL_CREST) {
+    CRESTModel *crestModel = new CRESTModel();
+    crestModel->SetPrecision(precision);
+    wbModel = crestModel;
+    wbSettings = &crestSettings;
+  } else {
+    SAC *sacModel = new SAC();
+    sacModel->SetPrecision(precision);
+    wbModel = sacModel;
+    wbSettings = &sacSettings;
+  }
+  KWRoute *rModel = new KWRoute();
+  rModel->SetPrecision(precision);
+
+  wbModel->InitializeModel(&nodes, &gridCells, wbSettings, &paramGrids);
+  rModel->InitializeModel(&nodes, &gridCells, &kwSettings, &paramGrids);
+
+  std::vector<float> stepPrecip(NUM_GRID_CELLS), stepPET(NUM_GRID_CELLS);
+  std::vector<float> fastFlow(NUM_GRID_CELLS), slowFlow(NUM_GRID_CELLS),
+      soilMoisture(NUM_GRID_CELLS), discharge(NUM_GRID_CELLS);
+  results->outlet.clear();
+  results->inner.clear();
+  clock_t start = clock();
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      stepPrecip[i] = precip[(size_t)t * NUM_GRID_CELLS + i];
+      stepPET[i] = pet[(size_t)t * NUM_GRID_CELLS + i];
+      fastFlow[i] = 0.0;
+      slowFlow[i] = 0.0;
+    }
+    wbModel->WaterBalance(1.0, &stepPrecip, &stepPET, &fastFlow, &slowFlow,
+                          &soilMoisture);
+    rModel->Route(1.0, &fastFlow, &slowFlow, &discharge);
+    results->outlet.push_back(discharge[0]);
+    results->inner.push_back(discharge[innerNode]);
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static bool CompareSeries(const char *name, const char *gauge,
+                          std::vector<float> *single,
+                          std::vector<float> *twice) {
+  double volumeSingle = 0.0, volumeDouble = 0.0;
+  float peakSingle = 0.0, peakDouble = 0.0;
+  for (size_t t = 0; t < twice->size(); t++) {
+    volumeSingle += single->at(t);
+    volumeDouble += twice->at(t);
+    if (single->at(t) > peakSingle) {
+      peakSingle = single->at(t);
+    }
+    if (twice->at(t) > peakDouble) {
+      peakDouble = twice->at(t);
+    }
+  }
+  double volumeError = fabs(volumeSingle - volumeDouble) / volumeDouble;
+  double peakError = fabs(peakSingle - peakDouble) / peakDouble;
+  printf("%s %s: volume error %.3g, peak %f vs %f, error %.3g\n", name, gauge,
+         volumeError, peakSingle, peakDouble, peakError);
+  return volumeError <= MAX_VOLUME_ERROR && peakError <= MAX_PEAK_ERROR;
+}
+
+bool Compare(const char *name, GaugeSeries *single, GaugeSeries *twice) {
+  bool outletOk =
+      CompareSeries(name, "outlet", &(single->outlet), &(twice->outlet));
+  bool innerOk =
+      CompareSeries(name, "inner", &(single->inner), &(twice->inner));
+  return outletOk && innerOk;
+}
+
+void PrintStartupMessage() {
+  printf("%s", "********************************************************\n");
+  printf("%s", "**   Ensemble Framework For Flash Flood Forecasting   **\n");
+  printf("**                   Version %s                     **\n",
+         EF5_VERSION);
+  printf("**                   Precision Test                    **\n");
+  printf("%s", "********************************************************\n");
+}
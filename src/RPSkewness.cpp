@@ -88,7 +88,7 @@ float lut200[] = {
     4.652, 4.718, 4.783, 4.847, 4.904, 4.97,
 };
 
-bool ReadLP3File(char *file, std::vector<GridNode> *nodes,
+bool ReadLP3File(char *file, std::vector<GridCell> *cells,
                  std::vector<float> *lp3Vals) {
   FloatGrid *grid = NULL;
 
@@ -104,10 +104,10 @@ bool ReadLP3File(char *file, std::vector<GridNode> *nodes,
   if (g_DEM->IsSpatialMatch(grid)) {
     printf("Loading exact match LP3 grid %s\n", file);
     // The grids are the same! Our life is easy!
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (grid->data[node->y][node->x] != grid->noData) {
-        lp3Vals->at(i) = grid->data[node->y][node->x];
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      if (grid->data[cell->y][cell->x] != grid->noData) {
+        lp3Vals->at(i) = grid->data[cell->y][cell->x];
       } else {
         lp3Vals->at(i) = 0;
       }
@@ -117,9 +117,9 @@ bool ReadLP3File(char *file, std::vector<GridNode> *nodes,
     printf("LP3 grids aren't an exact match so guessing! %s\n", file);
     // The grids are different, we must do some resampling fun.
     GridLoc pt;
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      if (grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt) &&
           grid->data[pt.y][pt.x] != grid->noData) {
         lp3Vals->at(i) = grid->data[pt.y][pt.x];
       } else {
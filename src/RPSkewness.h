@@ -15,7 +15,7 @@ struct RPData {
   float q200;
 };
 
-bool ReadLP3File(char *file, std::vector<GridNode> *nodes,
+bool ReadLP3File(char *file, std::vector<GridCell> *cells,
                  std::vector<float> *lp3Vals);
 void CalcLP3Vals(std::vector<float> *stdGrid, std::vector<float> *avgGrid,
                  std::vector<float> *scGrid, std::vector<RPData> *rpData,
@@ -0,0 +1,297 @@
+#include "RoutingNetwork.h"
+#include <algorithm>
+
+void RoutingNetwork::Build(std::vector<GridNode> *nodes) {
+  size_t numNodes = nodes->size();
+  std::vector<long> upstreamCount(numNodes, 0);
+  std::vector<size_t> &level = cellLevel;
+  level.assign(numNodes, 0);
+
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &nodes->at(i);
+    if (node->downStreamNode != INVALID_DOWNSTREAM_NODE) {
+      upstreamCount[node->downStreamNode]++;
+    }
+  }
+
+  // Upstream adjacency, the cells draining into each cell in index order
+  upstreamStart.assign(numNodes + 1, 0);
+  for (size_t i = 0; i < numNodes; i++) {
+    upstreamStart[i + 1] = upstreamStart[i] + upstreamCount[i];
+  }
+  std::vector<size_t> fill(upstreamStart.begin(), upstreamStart.end() - 1);
+  upstreamCells.resize(upstreamStart[numNodes]);
+  for (size_t i = 0; i < numNodes; i++) {
+    unsigned long downStream = nodes->at(i).downStreamNode;
+    if (downStream != INVALID_DOWNSTREAM_NODE) {
+      upstreamCells[fill[downStream]++] = i;
+    }
+  }
+
+  // Walk the network from the headwaters down, a cell is only visited once all
+  // of the cells draining into it have been.
+  std::vector<long> ready;
+  ready.reserve(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    if (upstreamCount[i] == 0) {
+      ready.push_back(i);
+    }
+  }
+  size_t numLevels = 0;
+  for (size_t r = 0; r < ready.size(); r++) {
+    long i = ready[r];
+    if (level[i] + 1 > numLevels) {
+      numLevels = level[i] + 1;
+    }
+    unsigned long downStream = nodes->at(i).downStreamNode;
+    if (downStream == INVALID_DOWNSTREAM_NODE) {
+      continue;
+    }
+    if (level[downStream] < level[i] + 1) {
+      level[downStream] = level[i] + 1;
+    }
+    upstreamCount[downStream]--;
+    if (upstreamCount[downStream] == 0) {
+      ready.push_back(downStream);
+    }
+  }
+
+  // Bucket the cells by level
+  levelStart.assign(numLevels + 1, 0);
+  for (size_t i = 0; i < numNodes; i++) {
+    levelStart[level[i] + 1]++;
+  }
+  for (size_t l = 0; l < numLevels; l++) {
+    levelStart[l + 1] += levelStart[l];
+  }
+  fill.assign(levelStart.begin(), levelStart.end() - 1);
+  levelCells.resize(numNodes);
+  for (size_t i = 0; i < numNodes; i++) {
+    levelCells[fill[level[i]]++] = i;
+  }
+
+  BuildJumps(nodes);
+  Partition(nodes);
+}
+
+void RoutingNetwork::BuildJumps(std::vector<GridNode> *nodes) {
+  size_t numNodes = nodes->size();
+  std::vector<long> depth(numNodes, 0);
+  downStream.assign(numNodes, -1);
+  jump.assign(numNodes, -1);
+
+  // Going from the outlets up, a cell jumps twice as far as its downstream
+  // cell does whenever that cell and the cell it jumps to have equal jump
+  // lengths, otherwise one step. The jump lengths along any path then form a
+  // skew binary pattern and every cell downstream is O(log depth) hops away.
+  for (size_t c = numNodes; c > 0; c--) {
+    long i = levelCells[c - 1];
+    unsigned long next = nodes->at(i).downStreamNode;
+    if (next == INVALID_DOWNSTREAM_NODE) {
+      jump[i] = i;
+      continue;
+    }
+    long down = (long)next;
+    long downJump = jump[down];
+    downStream[i] = down;
+    depth[i] = depth[down] + 1;
+    if (depth[down] - depth[downJump] ==
+        depth[downJump] - depth[jump[downJump]]) {
+      jump[i] = jump[downJump];
+    } else {
+      jump[i] = down;
+    }
+  }
+}
+
+long RoutingNetwork::FindLastAbove(long cell, const double *value,
+                                   double threshold) {
+  while (true) {
+    long down = downStream[cell];
+    if (down < 0 || value[down] <= threshold) {
+      return cell;
+    }
+    long far = jump[cell];
+    cell = (value[far] > threshold) ? far : down;
+  }
+}
+
+void RoutingNetwork::Partition(std::vector<GridNode> *nodes) {
+  size_t numNodes = nodes->size();
+  std::vector<long> subTreeSize(numNodes, 0);
+  std::vector<bool> taskRoot(numNodes, false);
+
+  // Pick the sub-tree outlets, going from the headwaters down so the size of
+  // the still open sub-tree above each cell is known when we get to it.
+  for (size_t c = 0; c < numNodes; c++) {
+    long i = levelCells[c];
+    GridNode *node = &nodes->at(i);
+    long size = 1;
+    size_t numUpstream = GetUpstreamCount(i);
+    const long *upstream = GetUpstreamCells(i);
+    for (size_t u = 0; u < numUpstream; u++) {
+      if (!taskRoot[upstream[u]]) {
+        size += subTreeSize[upstream[u]];
+      }
+    }
+    subTreeSize[i] = size;
+    if (node->downStreamNode == INVALID_DOWNSTREAM_NODE) {
+      taskRoot[i] = true;
+    } else if (nodes->at(node->downStreamNode).gauge != node->gauge) {
+      taskRoot[i] = true;
+    } else if (size >= ROUTING_TASK_MIN_CELLS &&
+               GetUpstreamCount(node->downStreamNode) > 1) {
+      taskRoot[i] = true;
+    }
+  }
+
+  // Number the tasks from the outlets up, so a task always has a lower number
+  // than the tasks draining into it.
+  std::vector<long> task(numNodes, 0);
+  taskDownStream.clear();
+  for (size_t c = numNodes; c > 0; c--) {
+    long i = levelCells[c - 1];
+    unsigned long downStream = nodes->at(i).downStreamNode;
+    if (taskRoot[i]) {
+      task[i] = taskDownStream.size();
+      taskDownStream.push_back((downStream == INVALID_DOWNSTREAM_NODE)
+                                   ? -1
+                                   : task[downStream]);
+    } else {
+      task[i] = task[downStream];
+    }
+  }
+
+  size_t numTasks = taskDownStream.size();
+  taskUpstreamCount.assign(numTasks, 0);
+  for (size_t t = 0; t < numTasks; t++) {
+    if (taskDownStream[t] >= 0) {
+      taskUpstreamCount[taskDownStream[t]]++;
+    }
+  }
+
+  // Group the cells by task, keeping them in headwater first order
+  taskStart.assign(numTasks + 1, 0);
+  for (size_t i = 0; i < numNodes; i++) {
+    taskStart[task[i] + 1]++;
+  }
+  for (size_t t = 0; t < numTasks; t++) {
+    taskStart[t + 1] += taskStart[t];
+  }
+  std::vector<size_t> fill(taskStart.begin(), taskStart.end() - 1);
+  taskCells.resize(numNodes);
+  for (size_t c = 0; c < numNodes; c++) {
+    long i = levelCells[c];
+    taskCells[fill[task[i]]++] = i;
+  }
+}
+
+void RoutingNetwork::GroupTaskCells(const unsigned char *group) {
+  size_t numTasks = GetNumTasks();
+  std::vector<long> later;
+  for (size_t t = 0; t < numTasks; t++) {
+    size_t fill = taskStart[t];
+    later.clear();
+    for (size_t c = taskStart[t]; c < taskStart[t + 1]; c++) {
+      long i = taskCells[c];
+      if (group[i]) {
+        later.push_back(i);
+      } else {
+        taskCells[fill++] = i;
+      }
+    }
+    std::copy(later.begin(), later.end(), taskCells.begin() + fill);
+  }
+}
+
+void RoutingNetwork::RouteTasks(RoutingKernel *kernel, RoutingSource *source) {
+  long numTasks = (long)GetNumTasks();
+  taskPending = taskUpstreamCount;
+
+#if _OPENMP
+#pragma omp parallel
+#pragma omp single
+  {
+    for (long t = 0; t < numTasks; t++) {
+      if (taskUpstreamCount[t] == 0) {
+#pragma omp task firstprivate(t)
+        RunTask(kernel, source, t);
+      }
+    }
+  }
+#else
+  for (long t = numTasks - 1; t >= 0; t--) {
+    if (source) {
+      source->FillCells(t, &(taskCells[taskStart[t]]),
+                        taskStart[t + 1] - taskStart[t]);
+    }
+    kernel->RouteCells(&(taskCells[taskStart[t]]),
+                       taskStart[t + 1] - taskStart[t]);
+  }
+#endif
+}
+
+void RoutingNetwork::RunTask(RoutingKernel *kernel, RoutingSource *source,
+                             long task) {
+  // Whoever finishes the last sub-tree draining into a task goes on to route
+  // that task as well.
+  while (task >= 0) {
+    if (source) {
+      source->FillCells(task, &(taskCells[taskStart[task]]),
+                        taskStart[task + 1] - taskStart[task]);
+    }
+    kernel->RouteCells(&(taskCells[taskStart[task]]),
+                       taskStart[task + 1] - taskStart[task]);
+    long downStream = taskDownStream[task];
+    if (downStream < 0) {
+      break;
+    }
+    long remaining;
+#if _OPENMP
+#pragma omp flush
+#pragma omp atomic capture
+#endif
+    remaining = --taskPending[downStream];
+    if (remaining > 0) {
+      break;
+    }
+#if _OPENMP
+#pragma omp flush
+#endif
+    task = downStream;
+  }
+}
+
+void RoutingGather::Clear(size_t numNodes) {
+  start.assign(numNodes + 1, 0);
+  pendingSources.clear();
+  pendingTargets.clear();
+  pendingWeights.clear();
+}
+
+void RoutingGather::Add(long source, long target, double weight) {
+  pendingSources.push_back(source);
+  pendingTargets.push_back(target);
+  pendingWeights.push_back(weight);
+}
+
+void RoutingGather::Finalize() {
+  size_t numNodes = start.size() - 1;
+  size_t numEntries = pendingTargets.size();
+
+  // Counting sort by target, entries keep the order they were added in
+  for (size_t e = 0; e < numEntries; e++) {
+    start[pendingTargets[e] + 1]++;
+  }
+  for (size_t i = 0; i < numNodes; i++) {
+    start[i + 1] += start[i];
+  }
+  std::vector<size_t> fill(start.begin(), start.end() - 1);
+  sources.resize(numEntries);
+  weights.resize(numEntries);
+  for (size_t e = 0; e < numEntries; e++) {
+    size_t pos = fill[pendingTargets[e]]++;
+    sources[pos] = pendingSources[e];
+    weights[pos] = pendingWeights[e];
+  }
+}
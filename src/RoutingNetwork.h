@@ -0,0 +1,118 @@
+#ifndef ROUTING_NETWORK_H
+#define ROUTING_NETWORK_H
+
+#include "GridNode.h"
+#include <vector>
+
+// Sub-trees smaller than this are merged into the sub-tree downstream of them
+#define ROUTING_TASK_MIN_CELLS 2048
+
+// Routes a batch of cells, the cells are given in upstream to downstream order
+class RoutingKernel {
+
+public:
+  virtual ~RoutingKernel() {}
+  virtual void RouteCells(const long *cells, size_t count) = 0;
+};
+
+// Fills in what the routing of a batch of cells reads, such as their runoff,
+// just before the batch is routed. task is the index of the sub-tree the
+// cells make up.
+class RoutingSource {
+
+public:
+  virtual ~RoutingSource() {}
+  virtual void FillCells(long task, const long *cells, size_t count) = 0;
+};
+
+// Topology tables shared by the routing schemes. A cell's level is the length
+// of the longest upstream path ending at that cell, so every cell upstream of
+// it has a lower level and all cells within one level are independent of each
+// other. Cells are stored grouped by level, level 0 (headwaters) first.
+//
+// Every cell also keeps a jump pointer to a cell further downstream, laid out
+// so that any cell on its flow path can be reached in a logarithmic number of
+// hops, see FindLastAbove.
+//
+// The network is also cut into sub-trees at gauges and at confluences where
+// the branch above holds at least ROUTING_TASK_MIN_CELLS cells. Each sub-tree
+// is a task that can be routed as soon as the sub-trees draining into it are
+// done, which avoids a barrier after every level.
+class RoutingNetwork {
+
+public:
+  void Build(std::vector<GridNode> *nodes);
+  // Routes every task with kernel, source may be NULL and is otherwise run on
+  // the cells of each task right before kernel
+  void RouteTasks(RoutingKernel *kernel, RoutingSource *source);
+  size_t GetNumTasks() { return taskDownStream.size(); }
+  size_t GetNumLevels() { return levelStart.size() - 1; }
+  size_t GetLevelSize(size_t level) {
+    return levelStart[level + 1] - levelStart[level];
+  }
+  const long *GetLevelCells(size_t level) {
+    return &(levelCells[levelStart[level]]);
+  }
+  size_t GetLevel(long cell) { return cellLevel[cell]; }
+  // The cell downstream of cell, -1 at an outlet
+  long GetDownStream(long cell) { return downStream[cell]; }
+  size_t GetUpstreamCount(long cell) {
+    return upstreamStart[cell + 1] - upstreamStart[cell];
+  }
+  const long *GetUpstreamCells(long cell) {
+    return upstreamCells.empty() ? NULL
+                                 : &(upstreamCells[0]) + upstreamStart[cell];
+  }
+  // Follows the flow path down from cell while value stays above threshold
+  // and returns the last cell on it that is. value must not increase along any
+  // flow path and value[cell] must be above threshold.
+  long FindLastAbove(long cell, const double *value, double threshold);
+  // Moves the cells with a nonzero group behind the others within every task,
+  // keeping both parts in headwater first order. This stays a valid routing
+  // order as long as the group never goes from nonzero back to zero going
+  // downstream.
+  void GroupTaskCells(const unsigned char *group);
+
+private:
+  void BuildJumps(std::vector<GridNode> *nodes);
+  void Partition(std::vector<GridNode> *nodes);
+  void RunTask(RoutingKernel *kernel, RoutingSource *source, long task);
+
+  std::vector<long> levelCells;
+  std::vector<size_t> levelStart, cellLevel;
+  std::vector<long> upstreamCells;
+  std::vector<size_t> upstreamStart;
+  std::vector<long> downStream, jump;
+  std::vector<long> taskCells;
+  std::vector<size_t> taskStart;
+  std::vector<long> taskDownStream, taskUpstreamCount, taskPending;
+};
+
+// Compressed sparse row list of the cells that send water to each cell along
+// with the fraction of the sender's outflow that arrives. Routing pulls its
+// inflow through this list instead of adding into the receiving cell, so
+// cells can be routed in parallel without atomics and the order of the sums
+// never depends on the thread count.
+class RoutingGather {
+
+public:
+  void Clear(size_t numNodes);
+  void Add(long source, long target, double weight);
+  void Finalize();
+  size_t GetCount(long cell) { return start[cell + 1] - start[cell]; }
+  const long *GetSources(long cell) {
+    return sources.empty() ? NULL : &(sources[0]) + start[cell];
+  }
+  const double *GetWeights(long cell) {
+    return weights.empty() ? NULL : &(weights[0]) + start[cell];
+  }
+
+private:
+  std::vector<long> sources;
+  std::vector<double> weights;
+  std::vector<size_t> start;
+  std::vector<long> pendingSources, pendingTargets;
+  std::vector<double> pendingWeights;
+};
+
+#endif
@@ -1,33 +1,59 @@
 #include "SAC.h"
 #include "DatedName.h"
+#include "KernelPrecision.h"
 #include <cmath>
 #include <cstdio>
 #include <cstring>
 
-SAC::SAC() {}
+static const char *stateStrings[] = {
+    "UZTWC", "UZFWC", "LZTWC", "LZFSC", "LZFPC", "ADIMC",
+};
+
+static const char *stateFileStrings[] = {
+    "uztwc", "uzfwc", "lztwc", "lzfsc", "lzfpc", "adimc",
+};
+
+void SACCells::Resize(size_t numCells) {
+  for (int p = 0; p < PARAM_SAC_QTY; p++) {
+    params[p].resize(numCells);
+  }
+  for (int p = 0; p < STATE_SAC_QTY; p++) {
+    states[p].resize(numCells);
+  }
+  for (int p = 0; p < DERIVED_SAC_QTY; p++) {
+    derived[p].resize(numCells);
+  }
+  for (int p = 0; p < DEPLETION_SAC_QTY; p++) {
+    depletion[p].resize(numCells);
+    incDepletion[p].resize(numCells);
+  }
+  incCount.resize(numCells);
+  hasGauge.resize(numCells);
+}
+
+SAC::SAC() {
+  depletionDays = 0.0f;
+  numSets = 0;
+  setDepletionDays = 0.0f;
+  precision = KERNEL_PRECISION(PRECISION_SINGLE);
+}
 
 SAC::~SAC() {}
 
 bool SAC::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
-  if (sacNodes.size() != nodes->size()) {
-    sacNodes.resize(nodes->size());
-  }
-
-  // Fill in modelNode in the gridNodes
-  std::vector<SACGridNode>::iterator citr = sacNodes.begin();
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    SACGridNode *cNode = &(*citr);
-
-    node->modelNode = cNode;
+  gridCells = newCells;
+  cells.Resize(nodes->size());
 
-    citr++;
+  // Fill in modelIndex in the gridNodes
+  size_t numNodes = nodes->size();
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &nodes->at(i);
+    node->modelIndex = i;
   }
 
   InitializeParameters(paramSettings, paramGrids);
@@ -42,124 +68,27 @@ void SAC::InitializeStates(TimeVar *beginTime, char *statePath) {
   timeStr.UpdateName(beginTime->GetTM());
 
   char buffer[255];
-  sprintf(buffer, "%s/uztwc_%s.tif", statePath, timeStr.GetName());
-  FloatGrid *smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous UZTWC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->UZTWC = smGrid->data[node->y][node->x];
-        }
-      }
-    } else {
-      printf("Previous UZTWC Grid %s not a spatial match!\n", buffer);
-    }
-    delete smGrid;
-  } else {
-    printf("Previous UZTWC Grid %s not found!\n", buffer);
-  }
-
-  sprintf(buffer, "%s/uzfwc_%s.tif", statePath, timeStr.GetName());
-  smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous UZFWC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->UZFWC = smGrid->data[node->y][node->x];
-        }
-      }
-    } else {
-      printf("Previous UZFWC Grid %s not a spatial match!\n", buffer);
-    }
-    delete smGrid;
-  } else {
-    printf("Previous UZFWC Grid %s not found!\n", buffer);
-  }
-
-  sprintf(buffer, "%s/lztwc_%s.tif", statePath, timeStr.GetName());
-  smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous LZTWC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->LZTWC = smGrid->data[node->y][node->x];
-        }
-      }
-    } else {
-      printf("Previous LZTWC Grid %s not a spatial match!\n", buffer);
-    }
-    delete smGrid;
-  } else {
-    printf("Previous LZTWC Grid %s not found!\n", buffer);
-  }
-
-  sprintf(buffer, "%s/lzfsc_%s.tif", statePath, timeStr.GetName());
-  smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous LZFSC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->LZFSC = smGrid->data[node->y][node->x];
-        }
-      }
-    } else {
-      printf("Previous LZFSC Grid %s not a spatial match!\n", buffer);
-    }
-    delete smGrid;
-  } else {
-    printf("Previous LZFSC Grid %s not found!\n", buffer);
-  }
-
-  sprintf(buffer, "%s/lzfpc_%s.tif", statePath, timeStr.GetName());
-  smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous LZFPC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->LZFPC = smGrid->data[node->y][node->x];
-        }
-      }
-    } else {
-      printf("Previous LZFPC Grid %s not a spatial match!\n", buffer);
-    }
-    delete smGrid;
-  } else {
-    printf("Previous LZFPC Grid %s not found!\n", buffer);
-  }
-
-  sprintf(buffer, "%s/adimc_%s.tif", statePath, timeStr.GetName());
-  smGrid = ReadFloatTifGrid(buffer);
-  if (smGrid) {
-    if (g_DEM->IsSpatialMatch(smGrid)) {
-      printf("Using Previous ADIMC Grid %s\n", buffer);
-      for (size_t i = 0; i < nodes->size(); i++) {
-        GridNode *node = &nodes->at(i);
-        SACGridNode *cNode = &(sacNodes[i]);
-        if (smGrid->data[node->y][node->x] != smGrid->noData) {
-          cNode->ADIMC = smGrid->data[node->y][node->x];
+  for (int p = 0; p < STATE_SAC_QTY; p++) {
+    sprintf(buffer, "%s/%s_%s.tif", statePath, stateFileStrings[p],
+            timeStr.GetName());
+    FloatGrid *smGrid = ReadFloatTifGrid(buffer);
+    if (smGrid) {
+      if (g_DEM->IsSpatialMatch(smGrid)) {
+        printf("Using Previous %s Grid %s\n", stateStrings[p], buffer);
+        for (size_t i = 0; i < nodes->size(); i++) {
+          GridCell *cell = &gridCells->at(i);
+          if (smGrid->data[cell->y][cell->x] != smGrid->noData) {
+            cells.states[p][i] = smGrid->data[cell->y][cell->x];
+          }
         }
+      } else {
+        printf("Previous %s Grid %s not a spatial match!\n", stateStrings[p],
+               buffer);
       }
+      delete smGrid;
     } else {
-      printf("Previous ADIMC Grid %s not a spatial match!\n", buffer);
+      printf("Previous %s Grid %s not found!\n", stateStrings[p], buffer);
     }
-    delete smGrid;
-  } else {
-    printf("Previous ADIMC Grid %s not found!\n", buffer);
   }
 }
 
@@ -173,406 +102,665 @@ void SAC::SaveStates(TimeVar *currentTime, char *statePath,
   std::vector<float> dataVals;
   dataVals.resize(nodes->size());
 
-  // UZTWC, UZFWC, LZTWC, LZFSC, LZFPC, ADIMC
-
   char buffer[255];
-  sprintf(buffer, "%s/uztwc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->UZTWC;
+  for (int p = 0; p < STATE_SAC_QTY; p++) {
+    sprintf(buffer, "%s/%s_%s.tif", statePath, stateFileStrings[p],
+            timeStr.GetName());
+    for (size_t i = 0; i < nodes->size(); i++) {
+      dataVals[i] = cells.states[p][i];
+    }
+    gridWriter->WriteGrid(nodes, gridCells, &dataVals, buffer, false);
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+}
 
-  sprintf(buffer, "%s/uzfwc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->UZFWC;
+bool SAC::WaterBalance(float stepHours, std::vector<float> *precip,
+                       std::vector<float> *pet, std::vector<float> *fastFlow,
+                       std::vector<float> *slowFlow,
+                       std::vector<float> *soilMoisture) {
+
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+  const float *precipIn = &(precip->at(0));
+  const float *petIn = &(pet->at(0));
+  float *fastOut = &(fastFlow->at(0));
+  float *slowOut = &(slowFlow->at(0));
+  float *smOut = &(soilMoisture->at(0));
+
+  BeginStep(stepHours);
 
-  sprintf(buffer, "%s/lztwc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->LZTWC;
+  // Every cell is independent of the others
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    StepCells(stepHours, begin, end, precipIn, petIn, fastOut, slowOut,
+              smOut);
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
 
-  sprintf(buffer, "%s/lzfsc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->LZFSC;
+  return true;
+}
+
+void SAC::BeginStep(float stepHours) {
+  float stepDays = stepHours / 24.0f;
+  if (stepDays != depletionDays) {
+    ComputeDepletion(&cells, stepDays);
+    depletionDays = stepDays;
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+}
 
-  sprintf(buffer, "%s/lzfpc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->LZFPC;
+long SAC::StepCells(float stepHours, long begin, long end, const float *precip,
+                    const float *pet, float *fastFlow, float *slowFlow,
+                    float *soilMoisture) {
+  if (precision == PRECISION_DOUBLE) {
+    RunCells<double>(stepHours, NULL, begin, end, precip, pet, fastFlow,
+                     slowFlow, soilMoisture);
+  } else {
+    RunCells<float>(stepHours, NULL, begin, end, precip, pet, fastFlow,
+                    slowFlow, soilMoisture);
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+  return 0;
+}
 
-  sprintf(buffer, "%s/adimc_%s.tif", statePath, timeStr.GetName());
-  for (size_t i = 0; i < nodes->size(); i++) {
-    SACGridNode *cNode = &(sacNodes[i]);
-    dataVals[i] = cNode->ADIMC;
+long SAC::StepList(float stepHours, const long *list, long count,
+                   const float *precip, const float *pet, float *fastFlow,
+                   float *slowFlow, float *soilMoisture) {
+  if (precision == PRECISION_DOUBLE) {
+    RunCells<double>(stepHours, list, 0, count, precip, pet, fastFlow,
+                     slowFlow, soilMoisture);
+  } else {
+    RunCells<float>(stepHours, list, 0, count, precip, pet, fastFlow,
+                    slowFlow, soilMoisture);
   }
-  gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+  return 0;
 }
-bool SAC::WaterBalance(float stepHours, std::vector<float> *precip,
-                       std::vector<float> *pet, std::vector<float> *fastFlow,
-                       std::vector<float> *slowFlow,
-                       std::vector<float> *soilMoisture) {
 
-  size_t numNodes = nodes->size();
-  size_t i = 0;
+bool SAC::WaterBalanceBlock(float stepHours, int numSteps,
+                            std::vector<float> *precip,
+                            std::vector<float> *pet,
+                            std::vector<double> *fastFlow,
+                            std::vector<double> *slowFlow,
+                            std::vector<float> *soilMoisture) {
+  if (precision == PRECISION_DOUBLE) {
+    return RunWaterBalanceBlock<double>(stepHours, numSteps, precip, pet,
+                                        fastFlow, slowFlow, soilMoisture);
+  }
+  return RunWaterBalanceBlock<float>(stepHours, numSteps, precip, pet,
+                                     fastFlow, slowFlow, soilMoisture);
+}
 
-#if _OPENMP
-  //#pragma omp parallel for
-#endif
-  for (i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    if (!node->gauge) {
+bool SAC::WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                           std::vector<float> *pet,
+                           std::vector<float> *fastFlow,
+                           std::vector<float> *slowFlow) {
+  if (precision == PRECISION_DOUBLE) {
+    return RunWaterBalanceSets<double>(stepHours, precip, pet, fastFlow,
+                                       slowFlow);
+  }
+  return RunWaterBalanceSets<float>(stepHours, precip, pet, fastFlow,
+                                    slowFlow);
+}
+
+template <class Real>
+void SAC::RunCells(float stepHours, const long *list, long begin, long end,
+                   const float *precip, const float *pet, float *fastFlow,
+                   float *slowFlow, float *soilMoisture) {
+  const unsigned char *hasGauge = &(cells.hasGauge[0]);
+  const float *uztwc = &(cells.states[STATE_SAC_UZTWC][0]);
+  const float *uzfwc = &(cells.states[STATE_SAC_UZFWC][0]);
+  const float *uztwm = &(cells.params[PARAM_SAC_UZTWM][0]);
+  const float *uzfwm = &(cells.params[PARAM_SAC_UZFWM][0]);
+  for (long j = begin; j < end; j++) {
+    long i = list ? list[j] : j;
+    if (!hasGauge[i]) {
       continue;
     }
-    SACGridNode *cNode = (SACGridNode *)node->modelNode;
-    WaterBalanceInt(node, cNode, stepHours, precip->at(i), pet->at(i));
-    fastFlow->at(i) += (cNode->dischargeF / (stepHours * 3600.0f));
-    slowFlow->at(i) += (cNode->dischargeS / (stepHours * 3600.0f));
-    soilMoisture->at(i) =
-        100.0 * (cNode->UZTWC + cNode->UZFWC) /
-        (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_UZFWM]);
-    if (!std::isfinite(soilMoisture->at(i))) {
-      soilMoisture->at(i) = 0;
+    Real dischargeF, dischargeS;
+    WaterBalanceInt<Real>(&cells, i, stepHours, precip[i], pet[i],
+                          &dischargeF, &dischargeS);
+    fastFlow[i] += (dischargeF / (stepHours * 3600.0f));
+    slowFlow[i] += (dischargeS / (stepHours * 3600.0f));
+    soilMoisture[i] = 100.0 * (uztwc[i] + uzfwc[i]) / (uztwm[i] + uzfwm[i]);
+    if (!std::isfinite(soilMoisture[i])) {
+      soilMoisture[i] = 0;
     }
-    // soilMoisture->at(i) = (cNode->UZTWC + cNode->UZFWC) /
-    // (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_UZFWM]);
-    // discharge->at(i) = (cNode->dischargeF + cNode->dischargeS) * node->area *
+    // discharge->at(i) = (dischargeF + dischargeS) * node->area *
     // 0.277777777777778f; // Convert from mm/time to cms;  printf(" Q %f\n",
     // discharge->at(i));  LocalRouteQF(node, cNode);  LocalRouteSF(node, cNode);
   }
+}
+
+template <class Real>
+bool SAC::RunWaterBalanceBlock(float stepHours, int numSteps,
+                               std::vector<float> *precip,
+                               std::vector<float> *pet,
+                               std::vector<double> *fastFlow,
+                               std::vector<double> *slowFlow,
+                               std::vector<float> *soilMoisture) {
+
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+
+  float stepDays = stepHours / 24.0f;
+  if (stepDays != depletionDays) {
+    ComputeDepletion(&cells, stepDays);
+    depletionDays = stepDays;
+  }
+
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+  const unsigned char *hasGauge = &(cells.hasGauge[0]);
+  const float *uztwc = &(cells.states[STATE_SAC_UZTWC][0]);
+  const float *uzfwc = &(cells.states[STATE_SAC_UZFWC][0]);
+  const float *uztwm = &(cells.params[PARAM_SAC_UZTWM][0]);
+  const float *uzfwm = &(cells.params[PARAM_SAC_UZFWM][0]);
+
+  // A tile's states and parameters stay in cache while it goes through every
+  // step of the block
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    for (int k = 0; k < numSteps; k++) {
+      const float *precipIn = &(precip[k][0]);
+      const float *petIn = &(pet[k][0]);
+      double *fastOut = &(fastFlow[k][0]);
+      double *slowOut = &(slowFlow[k][0]);
+      float *smOut = (soilMoisture) ? &(soilMoisture[k][0]) : NULL;
+      for (long i = begin; i < end; i++) {
+        if (!hasGauge[i]) {
+          fastOut[i] = 0.0;
+          slowOut[i] = 0.0;
+          continue;
+        }
+        Real dischargeF, dischargeS;
+        WaterBalanceInt<Real>(&cells, i, stepHours, precipIn[i], petIn[i],
+                              &dischargeF, &dischargeS);
+        fastOut[i] = (dischargeF / (stepHours * 3600.0f));
+        slowOut[i] = (dischargeS / (stepHours * 3600.0f));
+        if (smOut) {
+          smOut[i] = 100.0 * (uztwc[i] + uzfwc[i]) / (uztwm[i] + uzfwm[i]);
+          if (!std::isfinite(smOut[i])) {
+            smOut[i] = 0;
+          }
+        }
+      }
+    }
+  }
 
   return true;
 }
 
-void SAC::WaterBalanceInt(GridNode *node, SACGridNode *cNode, float stepHours,
-                          float precipIn, float petIn) {
+void SAC::ComputeDepletion(SACCells *runCells, float stepDays) {
+  // The free water depletion fractions only depend on the parameters and the
+  // length of the increment, most cells use a single increment per step so
+  // these are computed once for each step length rather than every step.
+  long numCells = (long)runCells->hasGauge.size();
+  const float *uzk = &(runCells->params[PARAM_SAC_UZK][0]);
+  const float *lzpk = &(runCells->params[PARAM_SAC_LZPK][0]);
+  const float *lzsk = &(runCells->params[PARAM_SAC_LZSK][0]);
+  float *duz = &(runCells->depletion[DEPLETION_SAC_UZ][0]);
+  float *dlzp = &(runCells->depletion[DEPLETION_SAC_LZP][0]);
+  float *dlzs = &(runCells->depletion[DEPLETION_SAC_LZS][0]);
+  float *incCount = &(runCells->incCount[0]);
+
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long i = 0; i < numCells; i++) {
+    duz[i] = 1.0f - pow(1.0f - uzk[i], stepDays);
+    dlzp[i] = 1.0f - pow(1.0f - lzpk[i], stepDays);
+    dlzs[i] = 1.0f - pow(1.0f - lzsk[i], stepDays);
+    incCount[i] = 0.0f;
+    KERNEL_COUNT(g_kernelPowCalls, 3);
+  }
+}
+
+void SAC::ComputeDerived(SACCells *runCells) {
+  long numCells = (long)runCells->hasGauge.size();
+  const std::vector<float> *p = runCells->params;
+  std::vector<float> *d = runCells->derived;
+
+  for (long i = 0; i < numCells; i++) {
+    d[DERIVED_SAC_PAREA][i] =
+        1.0f - p[PARAM_SAC_PCTIM][i] - p[PARAM_SAC_ADIMP][i];
+    d[DERIVED_SAC_UZM][i] = p[PARAM_SAC_UZTWM][i] + p[PARAM_SAC_UZFWM][i];
+    d[DERIVED_SAC_TWM][i] = p[PARAM_SAC_UZTWM][i] + p[PARAM_SAC_LZTWM][i];
+    d[DERIVED_SAC_LZM][i] = p[PARAM_SAC_LZTWM][i] + p[PARAM_SAC_LZFPM][i] +
+                            p[PARAM_SAC_LZFSM][i];
+    d[DERIVED_SAC_LZMR][i] = p[PARAM_SAC_LZTWM][i] + p[PARAM_SAC_LZFPM][i] +
+                             p[PARAM_SAC_LZFSM][i] - p[PARAM_SAC_RSERV][i];
+    d[DERIVED_SAC_HPL][i] = p[PARAM_SAC_LZFPM][i] /
+                            (p[PARAM_SAC_LZFPM][i] + p[PARAM_SAC_LZFSM][i]);
+    d[DERIVED_SAC_TFREE][i] = 1.0f - p[PARAM_SAC_PFREE][i];
+    d[DERIVED_SAC_SIDE][i] = 1.0f + p[PARAM_SAC_SIDE][i];
+    d[DERIVED_SAC_BFCC][i] = 1.0f / (1.0f + p[PARAM_SAC_SIDE][i]);
+  }
+}
+
+bool SAC::InitializeSets(
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
+    int newNumSets, std::map<GaugeConfigSection *, float *> *paramSettings,
+    std::vector<FloatGrid *> *paramGrids) {
+
+  numSets = newNumSets;
+  size_t numNodes = newNodes->size();
+  setCells.Resize(numNodes * numSets);
+
+  // Set each parameter set up as InitializeModel would and interleave it
+  for (int s = 0; s < numSets; s++) {
+    InitializeModel(newNodes, newCells, &(paramSettings[s]), paramGrids);
+    for (int p = 0; p < PARAM_SAC_QTY; p++) {
+      for (size_t i = 0; i < numNodes; i++) {
+        setCells.params[p][i * numSets + s] = cells.params[p][i];
+      }
+    }
+    for (int p = 0; p < STATE_SAC_QTY; p++) {
+      for (size_t i = 0; i < numNodes; i++) {
+        setCells.states[p][i * numSets + s] = cells.states[p][i];
+      }
+    }
+    for (size_t i = 0; i < numNodes; i++) {
+      setCells.hasGauge[i * numSets + s] = cells.hasGauge[i];
+    }
+  }
+
+  ComputeDerived(&setCells);
+  setDepletionDays = 0.0f;
+
+  return true;
+}
+
+template <class Real>
+bool SAC::RunWaterBalanceSets(float stepHours, std::vector<float> *precip,
+                              std::vector<float> *pet,
+                              std::vector<float> *fastFlow,
+                              std::vector<float> *slowFlow) {
+
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+
+  float stepDays = stepHours / 24.0f;
+  if (stepDays != setDepletionDays) {
+    ComputeDepletion(&setCells, stepDays);
+    setDepletionDays = stepDays;
+  }
+
+  const float *precipIn = &(precip->at(0));
+  const float *petIn = &(pet->at(0));
+  const unsigned char *hasGauge = &(setCells.hasGauge[0]);
+
+  // The forcing of a cell is loaded once for all of the sets, which sit next
+  // to each other in setCells
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long i = 0; i < numNodes; i++) {
+    float cellPrecip = precipIn[i];
+    float cellPET = petIn[i];
+    long base = i * numSets;
+    for (int s = 0; s < numSets; s++) {
+      if (!hasGauge[base + s]) {
+        continue;
+      }
+      Real dischargeF, dischargeS;
+      WaterBalanceInt<Real>(&setCells, base + s, stepHours, cellPrecip,
+                            cellPET, &dischargeF, &dischargeS);
+      fastFlow[s][i] += (dischargeF / (stepHours * 3600.0f));
+      slowFlow[s][i] += (dischargeS / (stepHours * 3600.0f));
+    }
+  }
+
+  return true;
+}
+
+template <class Real>
+void SAC::WaterBalanceInt(SACCells *runCells, long index, float stepHours,
+                          float precipIn, float petIn, Real *dischargeF,
+                          Real *dischargeS) {
+
+  const float UZTWM = runCells->params[PARAM_SAC_UZTWM][index];
+  const float UZFWM = runCells->params[PARAM_SAC_UZFWM][index];
+  const float UZK = runCells->params[PARAM_SAC_UZK][index];
+  const float PCTIM = runCells->params[PARAM_SAC_PCTIM][index];
+  const float ADIMP = runCells->params[PARAM_SAC_ADIMP][index];
+  const float RIVA = runCells->params[PARAM_SAC_RIVA][index];
+  const float ZPERC = runCells->params[PARAM_SAC_ZPERC][index];
+  const float REXP = runCells->params[PARAM_SAC_REXP][index];
+  const float LZTWM = runCells->params[PARAM_SAC_LZTWM][index];
+  const float LZFSM = runCells->params[PARAM_SAC_LZFSM][index];
+  const float LZFPM = runCells->params[PARAM_SAC_LZFPM][index];
+  const float LZSK = runCells->params[PARAM_SAC_LZSK][index];
+  const float LZPK = runCells->params[PARAM_SAC_LZPK][index];
+  const float PFREE = runCells->params[PARAM_SAC_PFREE][index];
+  const float RSERV = runCells->params[PARAM_SAC_RSERV][index];
+  const float PAREA = runCells->derived[DERIVED_SAC_PAREA][index];
+  const float UZM = runCells->derived[DERIVED_SAC_UZM][index];
+  const float TWM = runCells->derived[DERIVED_SAC_TWM][index];
+  const float LZM = runCells->derived[DERIVED_SAC_LZM][index];
+  const float LZMR = runCells->derived[DERIVED_SAC_LZMR][index];
+  const float HPL = runCells->derived[DERIVED_SAC_HPL][index];
+  const float TFREE = runCells->derived[DERIVED_SAC_TFREE][index];
+  const float SIDE1 = runCells->derived[DERIVED_SAC_SIDE][index];
+  const float BFCCF = runCells->derived[DERIVED_SAC_BFCC][index];
+
+  Real UZTWC = runCells->states[STATE_SAC_UZTWC][index];
+  Real UZFWC = runCells->states[STATE_SAC_UZFWC][index];
+  Real LZTWC = runCells->states[STATE_SAC_LZTWC][index];
+  Real LZFSC = runCells->states[STATE_SAC_LZFSC][index];
+  Real LZFPC = runCells->states[STATE_SAC_LZFPC][index];
+  Real ADIMC = runCells->states[STATE_SAC_ADIMC][index];
 
   /*float precip = 0.0f; //precipIn * stepHours; // precipIn is mm/hr, precip is
 mm float pet = 20.0f; //petIn * stepHours; // petIn in mm/hr, pet is mm float DT
 = 3.0f / 24.0f; //stepHours / 24.0f;*/
 
-  float precip =
+  Real precip =
       precipIn *
       stepHours; // stepHours; //stepHours; // precipIn is mm/hr, precip is mm
-  float pet = petIn * stepHours; // * 0.06; // petIn in mm/hr, pet is mm
-  float DT = stepHours / 24.0f;
-
-  float PAREA =
-      1.0f - cNode->params[PARAM_SAC_PCTIM] - cNode->params[PARAM_SAC_ADIMP];
+  Real pet = petIn * stepHours; // * 0.06; // petIn in mm/hr, pet is mm
+  Real DT = stepHours / 24.0f;
 
   /*******************************/
   /*       ET Calculations       */
   /*******************************/
 
-  float E1 = 0.0f;  // ET from upper zone
-  float RED = 0.0f; // Residual ET demand
-  float E2 = 0.0f;  // ET from UZFWC
-  float E3 = 0.0f;  // ET from lower zone (LZTWC)
-  float E5 = 0.0f;  // ET from ADIMP area
-
-  E1 = pet *
-       (cNode->UZTWC / cNode->params[PARAM_SAC_UZTWM]); // ET from upper zone
-  RED = pet - E1;                                       // Residual ET demand
-  cNode->UZTWC -= E1;
-  if (cNode->UZTWC < 0.0f) { // E1 can't exceed UZTWC
-    E1 += cNode->UZTWC;
-    cNode->UZTWC = 0.0f;
+  Real E1 = 0.0f;  // ET from upper zone
+  Real RED = 0.0f; // Residual ET demand
+  Real E2 = 0.0f;  // ET from UZFWC
+  Real E3 = 0.0f;  // ET from lower zone (LZTWC)
+  Real E5 = 0.0f;  // ET from ADIMP area
+
+  E1 = pet * (UZTWC / UZTWM); // ET from upper zone
+  RED = pet - E1;             // Residual ET demand
+  UZTWC -= E1;
+  if (UZTWC < 0.0f) { // E1 can't exceed UZTWC
+    E1 += UZTWC;
+    UZTWC = 0.0f;
     RED = pet - E1;
-    if (cNode->UZFWC < RED) {
-      E2 = cNode->UZFWC;
-      cNode->UZFWC = 0.0f;
+    if (UZFWC < RED) {
+      E2 = UZFWC;
+      UZFWC = 0.0f;
       RED = RED - E2;
     } else {
       E2 = RED;
-      cNode->UZFWC -= E2;
+      UZFWC -= E2;
       RED = 0.0f;
     }
   }
 
-  if ((cNode->UZTWC / cNode->params[PARAM_SAC_UZTWM]) <
-      (cNode->UZFWC / cNode->params[PARAM_SAC_UZFWM])) {
+  if ((UZTWC / UZTWM) < (UZFWC / UZFWM)) {
     // Upper zone free water ratio exceeds upper zone tension
     // water ratio, thus transfer free water to tension
-    float UZRAT =
-        (cNode->UZTWC + cNode->UZFWC) /
-        (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_UZFWM]);
-    cNode->UZTWC = cNode->params[PARAM_SAC_UZTWM] * UZRAT;
-    cNode->UZFWC = cNode->params[PARAM_SAC_UZFWM] * UZRAT;
+    Real UZRAT = (UZTWC + UZFWC) / UZM;
+    UZTWC = UZTWM * UZRAT;
+    UZFWC = UZFWM * UZRAT;
   }
 
-  if (cNode->UZTWC < 0.00001f) {
-    cNode->UZTWC = 0.0f;
+  if (UZTWC < 0.00001f) {
+    UZTWC = 0.0f;
   }
 
-  if (cNode->UZFWC < 0.00001f) {
-    cNode->UZFWC = 0.0f;
+  if (UZFWC < 0.00001f) {
+    UZFWC = 0.0f;
   }
 
-  E3 = RED * (cNode->LZTWC / (cNode->params[PARAM_SAC_UZTWM] +
-                              cNode->params[PARAM_SAC_LZTWM]));
-  cNode->LZTWC -= E3;
+  E3 = RED * (LZTWC / TWM);
+  LZTWC -= E3;
 
-  if (cNode->LZTWC < 0.0f) {
+  if (LZTWC < 0.0f) {
     // E3 can't exceed LZTWC
-    E3 += cNode->LZTWC;
-    cNode->LZTWC = 0.0f;
+    E3 += LZTWC;
+    LZTWC = 0.0f;
   }
 
-  float RATLZT = cNode->LZTWC / cNode->params[PARAM_SAC_LZTWM];
-  float RATLZ =
-      (cNode->LZTWC + cNode->LZFPC + cNode->LZFSC -
-       cNode->params[PARAM_SAC_RSERV]) /
-      (cNode->params[PARAM_SAC_LZTWM] + cNode->params[PARAM_SAC_LZFPM] +
-       cNode->params[PARAM_SAC_LZFSM] - cNode->params[PARAM_SAC_RSERV]);
+  Real RATLZT = LZTWC / LZTWM;
+  Real RATLZ = (LZTWC + LZFPC + LZFSC - RSERV) / LZMR;
 
   if (RATLZT < RATLZ) {
     // Resupply lower zone tension water from lower
     // zone free water if more water available there.
-    float DEL = (RATLZ - RATLZT) * cNode->params[PARAM_SAC_LZTWM];
-    cNode->LZTWC += DEL;
-    cNode->LZFSC -= DEL;
-    if (cNode->LZFSC < 0.0f) {
+    Real DEL = (RATLZ - RATLZT) * LZTWM;
+    LZTWC += DEL;
+    LZFSC -= DEL;
+    if (LZFSC < 0.0f) {
       // If transfer exceeds LZFSC then remainder comes from LZFPC
-      cNode->LZFPC += cNode->LZFSC;
-      cNode->LZFSC = 0.0f;
+      LZFPC += LZFSC;
+      LZFSC = 0.0f;
     }
   }
 
-  if (cNode->LZTWC < 0.00001f) {
-    cNode->LZTWC = 0.0f;
+  if (LZTWC < 0.00001f) {
+    LZTWC = 0.0f;
   }
 
-  E5 = E1 + (RED + E2) * ((cNode->ADIMC - E1 - cNode->UZTWC) /
-                          (cNode->params[PARAM_SAC_UZTWM] +
-                           cNode->params[PARAM_SAC_LZTWM]));
+  E5 = E1 + (RED + E2) * ((ADIMC - E1 - UZTWC) / TWM);
   // Adjust adimc, additional impervious area storage, for evaporation
-  cNode->ADIMC -= E5;
+  ADIMC -= E5;
 
-  if (cNode->ADIMC < 0.0f) {
-    E5 += cNode->ADIMC;
-    cNode->ADIMC = 0.0f;
+  if (ADIMC < 0.0f) {
+    E5 += ADIMC;
+    ADIMC = 0.0f;
   }
 
-  E5 *= cNode->params[PARAM_SAC_ADIMP];
+  E5 *= ADIMP;
 
   /**********************************************/
   /*    Compute Percolation & runoff amounts    */
   /**********************************************/
 
   // TWX is the time interval available moisture in excess of UZTW requirements
-  float TWX = precip + cNode->UZTWC - cNode->params[PARAM_SAC_UZTWM];
+  Real TWX = precip + UZTWC - UZTWM;
 
   if (TWX < 0.0f) {
     // All moisture held in UZTW -- No excess.
-    cNode->UZTWC += precip;
+    UZTWC += precip;
     TWX = 0.0f;
   } else {
-    cNode->UZTWC =
-        cNode->params[PARAM_SAC_UZTWM]; // Moisture in excess of UZTW storage
+    UZTWC = UZTWM; // Moisture in excess of UZTW storage
   }
 
-  cNode->ADIMC = cNode->ADIMC + precip - TWX;
+  ADIMC = ADIMC + precip - TWX;
 
   // Compute impervious area runoff
-  float ROIMP =
-      precip *
-      cNode->params[PARAM_SAC_PCTIM]; // Runoff from minimum impervious area
-
-  float SBF = 0.0f, SSUR = 0.0f, SIF = 0.0f, SPERC = 0.0f, SDRO = 0.0f,
-        SPBF = 0.0f;
-
-  float NINC =
-      floor(1.0f + 0.2f * (cNode->UZFWC + TWX)); // Number of time increments
-                                                 // that the time interval is
-                                                 // divided into for further
-                                                 // soil-moisture accounting.
-  // No one increment will exceed 5.0 millimeters of UZFWC+PAV
+  Real ROIMP = precip * PCTIM; // Runoff from minimum impervious area
 
-  float DINC = (1.0f / NINC) * DT; // Length of each increment in days
+  Real SBF = 0.0f, SSUR = 0.0f, SIF = 0.0f, SPERC = 0.0f, SDRO = 0.0f,
+       SPBF = 0.0f;
 
-  float PINC = TWX / NINC; // Amount of available moisture for each increment.
-                           // Compute free water depletion fractions for the
-                           // time increment
-                           // being used-basic depletions are for one day
+  Real NINC = floor(1.0f + 0.2f * (UZFWC + TWX)); // Number of time increments
+                                                  // that the time interval is
+                                                  // divided into for further
+                                                  // soil-moisture accounting.
+  // No one increment will exceed 5.0 millimeters of UZFWC+PAV
 
-  float DUZ = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_UZK], DINC);
-  float DLZP = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_LZPK], DINC);
-  float DLZS = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_LZSK], DINC);
+  Real DINC = (1.0f / NINC) * DT; // Length of each increment in days
+
+  Real PINC = TWX / NINC; // Amount of available moisture for each increment.
+                          // Compute free water depletion fractions for the
+                          // time increment
+                          // being used-basic depletions are for one day
+
+  Real DUZ, DLZP, DLZS;
+  if (NINC == 1.0f) {
+    // A single increment covers the whole step, use the fractions computed
+    // for this step length
+    DUZ = runCells->depletion[DEPLETION_SAC_UZ][index];
+    DLZP = runCells->depletion[DEPLETION_SAC_LZP][index];
+    DLZS = runCells->depletion[DEPLETION_SAC_LZS][index];
+  } else if (NINC == runCells->incCount[index]) {
+    // Same number of increments as the last split step of this cell
+    DUZ = runCells->incDepletion[DEPLETION_SAC_UZ][index];
+    DLZP = runCells->incDepletion[DEPLETION_SAC_LZP][index];
+    DLZS = runCells->incDepletion[DEPLETION_SAC_LZS][index];
+  } else {
+    // Read back from the cache so reuse gives the same fractions
+    DUZ = runCells->incDepletion[DEPLETION_SAC_UZ][index] =
+        1.0f - KernelPow((Real)(1.0f - UZK), DINC);
+    DLZP = runCells->incDepletion[DEPLETION_SAC_LZP][index] =
+        1.0f - KernelPow((Real)(1.0f - LZPK), DINC);
+    DLZS = runCells->incDepletion[DEPLETION_SAC_LZS][index] =
+        1.0f - KernelPow((Real)(1.0f - LZSK), DINC);
+    runCells->incCount[index] = NINC;
+  }
 
   /*******************************************/
   /*        Do loop for time interval        */
   /*******************************************/
 
-  for (float i = 0.0f; i < NINC; i = i + 1.0f) {
-    float ADSUR = 0.0f;
-    float RATIO =
-        (cNode->ADIMC - cNode->UZTWC) / cNode->params[PARAM_SAC_LZTWM];
+  for (Real i = 0.0f; i < NINC; i = i + 1.0f) {
+    Real ADSUR = 0.0f;
+    Real RATIO = (ADIMC - UZTWC) / LZTWM;
     if (RATIO < 0.0f) {
       RATIO = 0.0f;
     }
 
-    float ADDRO =
-        PINC * pow(RATIO, 2.0f); // Amount of direct runoff from the area ADIMP
+    // Amount of direct runoff from the area ADIMP
+    Real ADDRO = PINC * KernelPow(RATIO, (Real)2.0f);
 
     // Compute baseflow
-    float BF = cNode->LZFPC * DLZP;
-    cNode->LZFPC -= BF;
-    if (cNode->LZFPC <= 0.0001f) {
-      BF += cNode->LZFPC;
-      cNode->LZFPC = 0.0f;
+    Real BF = LZFPC * DLZP;
+    LZFPC -= BF;
+    if (LZFPC <= 0.0001f) {
+      BF += LZFPC;
+      LZFPC = 0.0f;
     }
 
     SBF += BF;
     SPBF += BF;
 
-    BF = cNode->LZFSC * DLZS;
-    cNode->LZFSC -= BF;
-    if (cNode->LZFSC <= 0.0001f) {
-      BF += cNode->LZFSC;
-      cNode->LZFSC = 0.0f;
+    BF = LZFSC * DLZS;
+    LZFSC -= BF;
+    if (LZFSC <= 0.0001f) {
+      BF += LZFSC;
+      LZFSC = 0.0f;
     }
 
     SBF += BF;
 
     // Compute Percolation, If no water is available then skip
-    if ((PINC + cNode->UZFWC) <= 0.01f) {
-      /*cNode->UZFWC += PINC;
-cNode->ADIMC = cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM];
-SDRO = SDRO + ADDRO * cNode->params[PARAM_SAC_ADIMP];
-if (cNode->ADIMC < 0.00001f) {
-cNode->ADIMC = 0.0f;
+    if ((PINC + UZFWC) <= 0.01f) {
+      /*UZFWC += PINC;
+ADIMC = UZTWM + LZTWM;
+SDRO = SDRO + ADDRO * ADIMP;
+if (ADIMC < 0.00001f) {
+ADIMC = 0.0f;
 }*/
 
-      cNode->ADIMC = cNode->ADIMC + PINC - ADDRO - ADSUR;
-      if (cNode->ADIMC >
-          (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM])) {
-        ADDRO =
-            ADDRO + cNode->ADIMC -
-            (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM]);
-        cNode->ADIMC =
-            cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM];
+      ADIMC = ADIMC + PINC - ADDRO - ADSUR;
+      if (ADIMC > TWM) {
+        ADDRO = ADDRO + ADIMC - TWM;
+        ADIMC = TWM;
       }
-      SDRO = SDRO + ADDRO * cNode->params[PARAM_SAC_ADIMP];
-      if (cNode->ADIMC < 0.00001f) {
-        cNode->ADIMC = 0.0f;
+      SDRO = SDRO + ADDRO * ADIMP;
+      if (ADIMC < 0.00001f) {
+        ADIMC = 0.0f;
       }
       continue;
     }
 
-    float PERCM = cNode->params[PARAM_SAC_LZFPM] * DLZP +
-                  cNode->params[PARAM_SAC_LZFSM] * DLZS;
-    float PERC = PERCM * (cNode->UZFWC / cNode->params[PARAM_SAC_UZFWM]);
+    Real PERCM = LZFPM * DLZP + LZFSM * DLZS;
+    Real PERC = PERCM * (UZFWC / UZFWM);
     // DEFR is the lower zone moisture deficiency ratio
-    float DEFR = 1.0f - ((cNode->LZTWC + cNode->LZFPC + cNode->LZFSC) /
-                         (cNode->params[PARAM_SAC_LZTWM] +
-                          cNode->params[PARAM_SAC_LZFPM] +
-                          cNode->params[PARAM_SAC_LZFSM]));
-    float FR = 1.0f; // Change in percolation withdrawal due to frozen ground.
-    float FI = 1.0f; // Change in interflow withdrawal due to frozen ground.
+    Real DEFR = 1.0f - ((LZTWC + LZFPC + LZFSC) / LZM);
+    Real FR = 1.0f; // Change in percolation withdrawal due to frozen ground.
+    Real FI = 1.0f; // Change in interflow withdrawal due to frozen ground.
     // float IFRZE = 0.0f;
 
-    PERC = PERC *
-           (1.0f + cNode->params[PARAM_SAC_ZPERC] *
-                       pow(DEFR, cNode->params[PARAM_SAC_REXP])) *
-           FR;
+    PERC = PERC * (1.0f + ZPERC * KernelPow(DEFR, (Real)REXP)) * FR;
     // Note... percolation occurs from UZFWC before PAV is added.
 
-    if (PERC >= cNode->UZFWC) {
-      PERC = cNode->UZFWC;
+    if (PERC >= UZFWC) {
+      PERC = UZFWC;
     }
 
-    cNode->UZFWC -= PERC;
+    UZFWC -= PERC;
 
     // Check to see if percolation exceeds lower zone deficiency
-    float CHECK = cNode->LZTWC + cNode->LZFPC + cNode->LZFSC + PERC -
-                  cNode->params[PARAM_SAC_LZTWM] -
-                  cNode->params[PARAM_SAC_LZFPM] -
-                  cNode->params[PARAM_SAC_LZFSM];
+    Real CHECK = LZTWC + LZFPC + LZFSC + PERC - LZTWM - LZFPM - LZFSM;
     if (CHECK > 0.0f) {
       PERC -= CHECK;
-      cNode->UZFWC += CHECK;
+      UZFWC += CHECK;
     }
 
     SPERC += PERC; // Time interval summation of PERC
 
     // Compute interflow and keep track of time interval sum
     // Note PINC has not yet been added
-    float DEL = cNode->UZFWC * DUZ * FI;
+    Real DEL = UZFWC * DUZ * FI;
     SIF += DEL;
-    cNode->UZFWC -= DEL;
+    UZFWC -= DEL;
 
     // Distribute percolated water into the lower zones
     // tension water must be filled first except for the PFREE area.
     // PERCT is percolation to tension water and PERCF is percolation going to
     // free water
-    float PERCT = PERC * (1.0f - cNode->params[PARAM_SAC_PFREE]);
-    float PERCF;
-    if ((PERCT + cNode->LZTWC) <= cNode->params[PARAM_SAC_LZTWM]) {
-      cNode->LZTWC += PERCT;
+    Real PERCT = PERC * TFREE;
+    Real PERCF;
+    if ((PERCT + LZTWC) <= LZTWM) {
+      LZTWC += PERCT;
       PERCF = 0.0f;
     } else {
-      PERCF = PERCT + cNode->LZTWC - cNode->params[PARAM_SAC_LZTWM];
-      cNode->LZTWC = cNode->params[PARAM_SAC_LZTWM];
+      PERCF = PERCT + LZTWC - LZTWM;
+      LZTWC = LZTWM;
     }
 
     // Distribute percolation in excess of tension requirements among the
     // free water storages
-    PERCF += (PERC * cNode->params[PARAM_SAC_PFREE]);
+    PERCF += (PERC * PFREE);
     if (PERCF != 0.0f) {
-      float HPL =
-          cNode->params[PARAM_SAC_LZFPM] /
-          (cNode->params[PARAM_SAC_LZFPM] + cNode->params[PARAM_SAC_LZFSM]);
       // HPL is the relative size of the primary storage
       // as compared with total lower zone free water storage
 
-      float RATLP = cNode->LZFPC / cNode->params[PARAM_SAC_LZFPM];
-      float RATLS = cNode->LZFSC / cNode->params[PARAM_SAC_LZFSM];
+      Real RATLP = LZFPC / LZFPM;
+      Real RATLS = LZFSC / LZFSM;
       // RATLP and RATLS are content capacit ratios, or in other words
       // the relative fullness of each storage
 
-      float FRACP =
+      Real FRACP =
           (HPL * 2.0f * (1.0f - RATLP)) / ((1.0f - RATLP) + (1.0f - RATLS));
       // FRACP is the fraction going to primary
       if (FRACP > 1.0f) {
         FRACP = 1.0f;
       }
 
-      float PERCP = PERCF * FRACP;
-      float PERCS = PERCF - PERCP;
+      Real PERCP = PERCF * FRACP;
+      Real PERCS = PERCF - PERCP;
       // PERCP and PERCS are the amount of excess percolation
       // going to primary and supplemental storages, respectively
 
-      cNode->LZFSC += PERCS;
-      if (cNode->LZFSC > cNode->params[PARAM_SAC_LZFSM]) {
-        PERCS = PERCS - cNode->LZFSC + cNode->params[PARAM_SAC_LZFSM];
-        cNode->LZFSC = cNode->params[PARAM_SAC_LZFSM];
+      LZFSC += PERCS;
+      if (LZFSC > LZFSM) {
+        PERCS = PERCS - LZFSC + LZFSM;
+        LZFSC = LZFSM;
       }
 
-      cNode->LZFPC = cNode->LZFPC + PERCF - PERCS;
-      if (cNode->LZFPC > cNode->params[PARAM_SAC_LZFPM]) {
-        float EXCESS = cNode->LZFPC - cNode->params[PARAM_SAC_LZFPM];
-        cNode->LZTWC += EXCESS;
-        cNode->LZFPC = cNode->params[PARAM_SAC_LZFPM];
+      LZFPC = LZFPC + PERCF - PERCS;
+      if (LZFPC > LZFPM) {
+        Real EXCESS = LZFPC - LZFPM;
+        LZTWC += EXCESS;
+        LZFPC = LZFPM;
       }
     }
 
     // Distribute PINC between UZFWC & surface runoff
     if (PINC != 0.0f) {
-      if ((PINC + cNode->UZFWC) <= cNode->params[PARAM_SAC_UZFWM]) {
+      if ((PINC + UZFWC) <= UZFWM) {
         // No surface runoff
-        cNode->UZFWC += PINC;
+        UZFWC += PINC;
       } else {
-        float SUR = PINC + cNode->UZFWC - cNode->params[PARAM_SAC_UZFWM];
+        Real SUR = PINC + UZFWC - UZFWM;
         SSUR = SSUR + SUR * PAREA;
 
         ADSUR = SUR * (1.0f - ADDRO / PINC);
@@ -581,23 +769,20 @@ cNode->ADIMC = 0.0f;
         // currently generating direct runoff. ADDRO/PINC is the fraction
         // of ADIMP currently generating direct runoff.
 
-        SSUR = SSUR + ADSUR * cNode->params[PARAM_SAC_ADIMP];
+        SSUR = SSUR + ADSUR * ADIMP;
       }
     }
 
     // ADIMP area water balance -- SDRO is the IDT sum of the direct runoff
-    cNode->ADIMC = cNode->ADIMC + PINC - ADDRO - ADSUR;
-    if (cNode->ADIMC >
-        (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM])) {
-      ADDRO = ADDRO + cNode->ADIMC -
-              (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM]);
-      cNode->ADIMC =
-          cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM];
+    ADIMC = ADIMC + PINC - ADDRO - ADSUR;
+    if (ADIMC > TWM) {
+      ADDRO = ADDRO + ADIMC - TWM;
+      ADIMC = TWM;
     }
 
-    SDRO = SDRO + ADDRO * cNode->params[PARAM_SAC_ADIMP];
-    if (cNode->ADIMC < 0.00001f) {
-      cNode->ADIMC = 0.0f;
+    SDRO = SDRO + ADDRO * ADIMP;
+    if (ADIMC < 0.00001f) {
+      ADIMC = 0.0f;
     }
   }
 
@@ -608,36 +793,30 @@ cNode->ADIMC = 0.0f;
   // Compute sums and adjust runoff amounts by the area over which they are
   // generated
 
-  float EUSED = E1 + E2 + E3; // ET from PAREA which is 1.0 - ADIMP - PCTIM
+  Real EUSED = E1 + E2 + E3; // ET from PAREA which is 1.0 - ADIMP - PCTIM
 
   SIF *= PAREA;
 
   // Separate channel component of baseflow from the non-channel component
-  float TBF = SBF * PAREA; // Total baseflow
-  float BFCC =
-      TBF *
-      (1.0f /
-       (1.0f + cNode->params[PARAM_SAC_SIDE])); // Baseflow, channel component
-
-  float BFP = SPBF * PAREA / (1.0f + cNode->params[PARAM_SAC_SIDE]);
-  float BFS = BFCC - BFP;
+  Real TBF = SBF * PAREA;  // Total baseflow
+  Real BFCC = TBF * BFCCF; // Baseflow, channel component
+
+  Real BFP = SPBF * PAREA / SIDE1;
+  Real BFS = BFCC - BFP;
   if (BFS < 0.0f) {
     BFS = 0.0f;
   }
   // float BFNCC = TBF - BFCC; // Baseflow, non-channel component
 
-  float TCI = ROIMP + SDRO + SSUR + SIF +
-              BFCC;        // Total channel inflow for the time interval
-  float GRND = SIF + BFCC; // interflow part of ground flow
-  float SURF = TCI - GRND; // interflow part of surface flow
+  Real TCI = ROIMP + SDRO + SSUR + SIF +
+             BFCC;        // Total channel inflow for the time interval
+  Real GRND = SIF + BFCC; // interflow part of ground flow
+  Real SURF = TCI - GRND; // interflow part of surface flow
 
-  float E4 = (pet - EUSED) * cNode->params[PARAM_SAC_RIVA]; // / stepHours; //
-                                                            // ET from Riparian
-                                                            // vegetation
+  Real E4 = (pet - EUSED) * RIVA; // / stepHours; //
+                                  // ET from Riparian
+                                  // vegetation
 
-  static int II = 0;
-  // printf(" **** %i ****\n",II);
-  II++;
   // printf(" %f %f %f %f %f %f %f\n", TCI, ROIMP, SDRO, SSUR, SIF, BFCC, NINC);
 
   TCI -= E4;
@@ -657,17 +836,23 @@ cNode->ADIMC = 0.0f;
 
   EUSED *= PAREA;
   // float TET = EUSED + E5 + E4; // total evaportranspiration
-  if (cNode->ADIMC < cNode->UZTWC) {
-    cNode->ADIMC = cNode->UZTWC;
+  if (ADIMC < UZTWC) {
+    ADIMC = UZTWC;
   }
 
-  cNode->dischargeF = SURF;
-  cNode->dischargeS = GRND;
+  runCells->states[STATE_SAC_UZTWC][index] = UZTWC;
+  runCells->states[STATE_SAC_UZFWC][index] = UZFWC;
+  runCells->states[STATE_SAC_LZTWC][index] = LZTWC;
+  runCells->states[STATE_SAC_LZFSC][index] = LZFSC;
+  runCells->states[STATE_SAC_LZFPC][index] = LZFPC;
+  runCells->states[STATE_SAC_ADIMC][index] = ADIMC;
+
+  *dischargeF = SURF;
+  *dischargeS = GRND;
 
-  // printf(" %f %f %f %f %f\n", EUSED, E5, E4, pet,
-  // cNode->params[PARAM_SAC_RIVA]);  printf(" %f %f %f\n", SURF, GRND, TET);
-  // printf("1: %f %f %f %f %f %f", cNode->UZTWC, cNode->UZFWC, cNode->LZTWC,
-  // cNode->LZFSC, cNode->LZFPC, cNode->ADIMC);
+  // printf(" %f %f %f %f %f\n", EUSED, E5, E4, pet, RIVA);
+  // printf(" %f %f %f\n", SURF, GRND, TET);
+  // printf("1: %f %f %f %f %f %f", UZTWC, UZFWC, LZTWC, LZFSC, LZFPC, ADIMC);
 }
 
 void SAC::InitializeParameters(
@@ -675,40 +860,51 @@ void SAC::InitializeParameters(
     std::vector<FloatGrid *> *paramGrids) {
 
   // This pass distributes parameters
-  for (std::vector<GridNode>::iterator itr = nodes->begin();
-       itr != nodes->end(); itr++) {
-    GridNode *node = &(*itr);
-    SACGridNode *cNode = (SACGridNode *)node->modelNode;
+  size_t numNodes = nodes->size();
+  for (size_t i = 0; i < numNodes; i++) {
+    GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
+    float params[PARAM_SAC_QTY];
+    cells.hasGauge[i] = (node->gauge) ? 1 : 0;
     if (!node->gauge) {
       continue;
     }
 
     // Copy all of the parameters over
-    memcpy(cNode->params, (*paramSettings)[node->gauge],
+    memcpy(params, (*paramSettings)[node->gauge],
            sizeof(float) * PARAM_SAC_QTY);
 
     // Initialize states
-    cNode->UZTWC = cNode->params[PARAM_SAC_UZTWC] *
-                   cNode->params[PARAM_SAC_UZTWM]; // 0.0f;
-    cNode->UZFWC = cNode->params[PARAM_SAC_UZFWC] *
-                   cNode->params[PARAM_SAC_UZFWM]; // 0.0f; //2.773;
-    cNode->LZTWC = cNode->params[PARAM_SAC_LZTWC] *
-                   cNode->params[PARAM_SAC_LZTWM]; // 0.0f; //286.7;
-    cNode->LZFSC = cNode->params[PARAM_SAC_LZFSC] *
-                   cNode->params[PARAM_SAC_LZFSM]; // 0.0f;
-    cNode->LZFPC = cNode->params[PARAM_SAC_LZFPC] *
-                   cNode->params[PARAM_SAC_LZFPM]; // 0.0f; //154.2;
-    cNode->ADIMC = cNode->params[PARAM_SAC_ADIMC]; //:x0.0f;
+    cells.states[STATE_SAC_UZTWC][i] =
+        params[PARAM_SAC_UZTWC] * params[PARAM_SAC_UZTWM]; // 0.0f;
+    cells.states[STATE_SAC_UZFWC][i] =
+        params[PARAM_SAC_UZFWC] * params[PARAM_SAC_UZFWM]; // 0.0f; //2.773;
+    cells.states[STATE_SAC_LZTWC][i] =
+        params[PARAM_SAC_LZTWC] * params[PARAM_SAC_LZTWM]; // 0.0f; //286.7;
+    cells.states[STATE_SAC_LZFSC][i] =
+        params[PARAM_SAC_LZFSC] * params[PARAM_SAC_LZFSM]; // 0.0f;
+    cells.states[STATE_SAC_LZFPC][i] =
+        params[PARAM_SAC_LZFPC] * params[PARAM_SAC_LZFPM]; // 0.0f; //154.2;
+    cells.states[STATE_SAC_ADIMC][i] = params[PARAM_SAC_ADIMC]; //:x0.0f;
 
     // Deal with the distributed parameters here
     GridLoc pt;
     for (size_t paramI = 0; paramI < PARAM_CREST_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
-      if (grid && grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+      if (grid && grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] != grid->noData) {
-          cNode->params[paramI] *= grid->data[pt.y][pt.x];
+          params[paramI] *= grid->data[pt.y][pt.x];
         }
       }
     }
+
+    for (size_t paramI = 0; paramI < PARAM_SAC_QTY; paramI++) {
+      cells.params[paramI][i] = params[paramI];
+    }
   }
+
+  ComputeDerived(&cells);
+
+  // The parameters may have changed, recompute the depletion fractions
+  depletionDays = 0.0f;
 }
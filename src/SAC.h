@@ -3,12 +3,51 @@
 
 #include "ModelBase.h"
 
-struct SACGridNode : BasicGridNode {
+enum STATES_SAC {
+  STATE_SAC_UZTWC,
+  STATE_SAC_UZFWC,
+  STATE_SAC_LZTWC,
+  STATE_SAC_LZFSC,
+  STATE_SAC_LZFPC,
+  STATE_SAC_ADIMC,
+  STATE_SAC_QTY
+};
+
+// Free water depletion fractions for a time step done as a single increment
+enum DEPLETION_SAC {
+  DEPLETION_SAC_UZ,
+  DEPLETION_SAC_LZP,
+  DEPLETION_SAC_LZS,
+  DEPLETION_SAC_QTY
+};
+
+// Per cell constants that only depend on the parameters
+enum DERIVED_SAC {
+  DERIVED_SAC_PAREA, // 1 - PCTIM - ADIMP
+  DERIVED_SAC_UZM,   // UZTWM + UZFWM
+  DERIVED_SAC_TWM,   // UZTWM + LZTWM
+  DERIVED_SAC_LZM,   // LZTWM + LZFPM + LZFSM
+  DERIVED_SAC_LZMR,  // LZTWM + LZFPM + LZFSM - RSERV
+  DERIVED_SAC_HPL,   // LZFPM / (LZFPM + LZFSM)
+  DERIVED_SAC_TFREE, // 1 - PFREE
+  DERIVED_SAC_SIDE,  // 1 + SIDE
+  DERIVED_SAC_BFCC,  // 1 / (1 + SIDE)
+  DERIVED_SAC_QTY
+};
 
-  float params[PARAM_SAC_QTY];
+// SAC cells are stored as one contiguous array per field so each cell's water
+// balance only touches its own entries and the cells can run in parallel.
+struct SACCells {
+  void Resize(size_t numCells);
 
-  float UZTWC, UZFWC, LZTWC, LZFSC, LZFPC, ADIMC;
-  float dischargeF, dischargeS;
+  std::vector<float> params[PARAM_SAC_QTY];
+  std::vector<float> states[STATE_SAC_QTY];
+  std::vector<float> derived[DERIVED_SAC_QTY];
+  std::vector<float> depletion[DEPLETION_SAC_QTY];
+  // Depletion fractions for steps split into incCount increments
+  std::vector<float> incDepletion[DEPLETION_SAC_QTY];
+  std::vector<float> incCount;
+  std::vector<unsigned char> hasGauge;
 };
 
 class SAC : public WaterBalanceModel {
@@ -17,6 +56,7 @@ public:
   SAC();
   ~SAC();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath);
@@ -26,12 +66,58 @@ public:
                     std::vector<float> *pet, std::vector<float> *fastFlow,
                     std::vector<float> *slowFlow,
                     std::vector<float> *soilMoisture);
+  bool WaterBalanceBlock(float stepHours, int numSteps,
+                         std::vector<float> *precip, std::vector<float> *pet,
+                         std::vector<double> *fastFlow,
+                         std::vector<double> *slowFlow,
+                         std::vector<float> *soilMoisture);
+  bool InitializeSets(std::vector<GridNode> *newNodes,
+                      std::vector<GridCell> *newCells, int newNumSets,
+                      std::map<GaugeConfigSection *, float *> *paramSettings,
+                      std::vector<FloatGrid *> *paramGrids);
+  bool WaterBalanceSets(float stepHours, std::vector<float> *precip,
+                        std::vector<float> *pet, std::vector<float> *fastFlow,
+                        std::vector<float> *slowFlow);
   bool IsLumped() { return false; }
   const char *GetName() { return "sac"; }
+  void SetPrecision(PRECISIONS newPrecision) { precision = newPrecision; }
+  // Tile access for SimEngine, see CRESTModel. No SAC cell is ever counted
+  // as negative so StepCells always returns 0.
+  void BeginStep(float stepHours);
+  long StepCells(float stepHours, long begin, long end, const float *precip,
+                 const float *pet, float *fastFlow, float *slowFlow,
+                 float *soilMoisture);
+  long StepList(float stepHours, const long *list, long count,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
+  void EndStep(long numNegative) {}
 
 private:
-  void WaterBalanceInt(GridNode *node, SACGridNode *cNode, float stepHours,
-                       float precipIn, float petIn);
+  // The public water balance functions run these with Real as the compute
+  // type picked by precision. RunCells runs list[begin] to list[end - 1],
+  // or begin to end - 1 when list is NULL.
+  template <class Real>
+  void RunCells(float stepHours, const long *list, long begin, long end,
+                const float *precip, const float *pet, float *fastFlow,
+                float *slowFlow, float *soilMoisture);
+  template <class Real>
+  bool RunWaterBalanceBlock(float stepHours, int numSteps,
+                            std::vector<float> *precip,
+                            std::vector<float> *pet,
+                            std::vector<double> *fastFlow,
+                            std::vector<double> *slowFlow,
+                            std::vector<float> *soilMoisture);
+  template <class Real>
+  bool RunWaterBalanceSets(float stepHours, std::vector<float> *precip,
+                           std::vector<float> *pet,
+                           std::vector<float> *fastFlow,
+                           std::vector<float> *slowFlow);
+  template <class Real>
+  void WaterBalanceInt(SACCells *runCells, long index, float stepHours,
+                       float precipIn, float petIn, Real *dischargeF,
+                       Real *dischargeS);
+  void ComputeDerived(SACCells *runCells);
+  void ComputeDepletion(SACCells *runCells, float stepDays);
   // void LocalRouteQF(GridNode *node, HyMODGridNode *cNode);
   // void LocalRouteSF(GridNode *node, HyMODGridNode *cNode);
   void
@@ -39,7 +125,16 @@ private:
                        std::vector<FloatGrid *> *paramGrids);
 
   std::vector<GridNode> *nodes;
-  std::vector<SACGridNode> sacNodes;
+  std::vector<GridCell> *gridCells;
+  SACCells cells;
+  // Step length in days the depletion fractions in cells were computed for
+  float depletionDays;
+  // Parameter set batches, entry i * numSets + s is cell i of set s
+  SACCells setCells;
+  int numSets;
+  float setDepletionDays;
+  // Single unless a task or the build asks for double
+  PRECISIONS precision;
 };
 
 #endif
@@ -0,0 +1,716 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#include "Defines.h"
+#include "EF5.h"
+#include "GaugeConfigSection.h"
+#include "GridNode.h"
+#include "Model.h"
+#include "ModelBase.h"
+#include "SAC.h"
+
+#define NUM_GRID_CELLS 20000
+#define NUM_GAUGES 4
+#define TOTAL_TIME_STEPS 200
+#define PARALLEL_THREADS 8
+#define NUM_SETS 3
+
+// Runs the SAC water balance over the same cells and forcing once on a single
+// thread and once on several threads and checks that every output matches
+// exactly. Both are also compared to ReferenceWaterBalanceInt, the serial
+// kernel SAC ran before its cells were stored as struct of arrays, kept here
+// unchanged. Part way through the step length changes so the depletion
+// fractions kept for each step length are recomputed. Then runs NUM_SETS
+// parameter sets as one batch and checks each against running it alone.
+
+// A cell of the reference kernel, as SACGridNode was
+struct ReferenceSACCell {
+  float params[PARAM_SAC_QTY];
+  float UZTWC, UZFWC, LZTWC, LZFSC, LZFPC, ADIMC;
+  float dischargeF, dischargeS;
+};
+
+void PrintStartupMessage();
+void InitializeSAC();
+void SimulateSAC(int numThreads,
+                 std::map<GaugeConfigSection *, float *> *settings,
+                 bool withSoilMoisture, std::vector<float> *results);
+void SimulateSACSets(std::vector<float> *results);
+void SimulateReference(std::vector<float> *results);
+size_t CountDifferent(std::vector<float> *a, std::vector<float> *b);
+
+std::vector<GridNode> nodes;
+std::vector<GridCell> gridCells;
+std::map<GaugeConfigSection *, float *> setParamSettings[NUM_SETS];
+std::vector<FloatGrid *> paramGrids;
+std::vector<float> precip, pet;
+GaugeConfigSection *gauges[NUM_GAUGES];
+float params[NUM_SETS][NUM_GAUGES][PARAM_SAC_QTY];
+
+int main(int argc, char *argv[]) {
+
+  PrintStartupMessage();
+  InitializeSAC();
+
+  std::vector<float> reference, serial, parallel;
+  SimulateReference(&reference);
+  SimulateSAC(1, &(setParamSettings[0]), true, &serial);
+  SimulateSAC(PARALLEL_THREADS, &(setParamSettings[0]), true, &parallel);
+
+  size_t numDifferent = CountDifferent(&reference, &serial);
+  printf("Compared %lu outputs to the reference kernel, %lu differ\n",
+         (unsigned long)reference.size(), (unsigned long)numDifferent);
+  if (numDifferent > 0) {
+    printf("FAILED: SAC does not match the reference kernel\n");
+    return 1;
+  }
+
+  numDifferent = CountDifferent(&serial, &parallel);
+  printf("Compared %lu outputs, %lu differ\n", (unsigned long)serial.size(),
+         (unsigned long)numDifferent);
+  if (numDifferent > 0) {
+    printf("FAILED: parallel SAC does not match the serial run\n");
+    return 1;
+  }
+
+  std::vector<float> single, sets[NUM_SETS];
+  SimulateSACSets(sets);
+  for (int s = 0; s < NUM_SETS; s++) {
+    SimulateSAC(PARALLEL_THREADS, &(setParamSettings[s]), false, &single);
+    numDifferent = CountDifferent(&single, &(sets[s]));
+    printf("Compared %lu outputs of parameter set %i, %lu differ\n",
+           (unsigned long)single.size(), s, (unsigned long)numDifferent);
+    if (numDifferent > 0) {
+      printf("FAILED: batched SAC does not match the single run\n");
+      return 1;
+    }
+  }
+  printf("PASSED\n");
+
+  return ERROR_SUCCESS;
+}
+
+static float RandomRange(float low, float high) {
+  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+size_t CountDifferent(std::vector<float> *a, std::vector<float> *b) {
+  size_t numDifferent = 0;
+  for (size_t i = 0; i < a->size(); i++) {
+    if (a->at(i) != b->at(i)) {
+      numDifferent++;
+    }
+  }
+  return numDifferent;
+}
+
+void InitializeSAC() {
+  char gaugeName[20];
+  for (int g = 0; g < NUM_GAUGES; g++) {
+    sprintf(gaugeName, "%06i", g + 1);
+    gauges[g] = new GaugeConfigSection(gaugeName);
+    setParamSettings[0][gauges[g]] = params[0][g];
+
+    float *p = params[0][g];
+    p[PARAM_SAC_UZTWM] = 50.0 + 20.0 * g;
+    p[PARAM_SAC_UZFWM] = 20.0 + 10.0 * g;
+    p[PARAM_SAC_UZK] = 0.3 + 0.05 * g;
+    p[PARAM_SAC_PCTIM] = 0.01 * g;
+    p[PARAM_SAC_ADIMP] = 0.05 + 0.02 * g;
+    p[PARAM_SAC_RIVA] = 0.01;
+    p[PARAM_SAC_ZPERC] = 40.0 + 20.0 * g;
+    p[PARAM_SAC_REXP] = 1.5 + 0.5 * g;
+    p[PARAM_SAC_LZTWM] = 100.0 + 50.0 * g;
+    p[PARAM_SAC_LZFSM] = 20.0 + 10.0 * g;
+    p[PARAM_SAC_LZFPM] = 50.0 + 30.0 * g;
+    p[PARAM_SAC_LZSK] = 0.05 + 0.03 * g;
+    p[PARAM_SAC_LZPK] = 0.005 + 0.003 * g;
+    p[PARAM_SAC_PFREE] = 0.1 + 0.1 * g;
+    p[PARAM_SAC_SIDE] = 0.0;
+    p[PARAM_SAC_RSERV] = 0.3;
+    p[PARAM_SAC_UZTWC] = 0.2 * g;
+    p[PARAM_SAC_UZFWC] = 0.1 * g;
+    p[PARAM_SAC_ADIMC] = 10.0 * g;
+    p[PARAM_SAC_LZTWC] = 0.25 * g;
+    p[PARAM_SAC_LZFSC] = 0.2 * g;
+    p[PARAM_SAC_LZFPC] = 0.3 * g;
+  }
+
+  // The other sets scale the storages and rates of the first
+  for (int s = 1; s < NUM_SETS; s++) {
+    for (int g = 0; g < NUM_GAUGES; g++) {
+      setParamSettings[s][gauges[g]] = params[s][g];
+      float *p = params[s][g];
+      memcpy(p, params[0][g], sizeof(float) * PARAM_SAC_QTY);
+      p[PARAM_SAC_UZTWM] *= 1.0 + 0.3 * s;
+      p[PARAM_SAC_LZTWM] *= 1.0 - 0.2 * s;
+      p[PARAM_SAC_UZK] *= 1.0 - 0.25 * s;
+      p[PARAM_SAC_LZSK] *= 1.0 + 0.5 * s;
+      p[PARAM_SAC_REXP] += 0.5 * s;
+    }
+  }
+
+  // We only use lumped parameters here for ease of use.
+  for (size_t paramI = 0; paramI < PARAM_SAC_QTY; paramI++) {
+    paramGrids.push_back(NULL);
+  }
+
+  nodes.resize(NUM_GRID_CELLS);
+  gridCells.resize(NUM_GRID_CELLS);
+  for (int currentNode = 0; currentNode < NUM_GRID_CELLS; currentNode++) {
+    GridNode *currentN = &(nodes)[currentNode];
+    currentN->index = currentNode;
+    gridCells[currentNode].x = currentNode;
+    gridCells[currentNode].y = 0;
+    currentN->downStreamNode = INVALID_DOWNSTREAM_NODE;
+    // Leave a few cells outside of every basin
+    currentN->gauge =
+        (currentNode % 97 == 0) ? NULL : gauges[currentNode % NUM_GAUGES];
+  }
+
+  // Forcing for every cell and step, heavy enough in places to split the step
+  // into several increments
+  srand(1);
+  precip.resize(NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  pet.resize(NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  for (size_t i = 0; i < precip.size(); i++) {
+    precip[i] = (rand() % 3 == 0) ? RandomRange(0.0, 40.0) : 0.0;
+    pet[i] = RandomRange(0.0, 0.5);
+  }
+}
+
+void SimulateSAC(int numThreads,
+                 std::map<GaugeConfigSection *, float *> *settings,
+                 bool withSoilMoisture, std::vector<float> *results) {
+#if _OPENMP
+  omp_set_num_threads(numThreads);
+#endif
+
+  SAC model;
+  model.InitializeModel(&nodes, &gridCells, settings, &paramGrids);
+
+  std::vector<float> stepPrecip(NUM_GRID_CELLS), stepPET(NUM_GRID_CELLS);
+  std::vector<float> fastFlow(NUM_GRID_CELLS), slowFlow(NUM_GRID_CELLS),
+      soilMoisture(NUM_GRID_CELLS);
+  results->clear();
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    float stepHours = (t < TOTAL_TIME_STEPS / 2) ? 1.0 : 3.0;
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      stepPrecip[i] = precip[t * NUM_GRID_CELLS + i];
+      stepPET[i] = pet[t * NUM_GRID_CELLS + i];
+      fastFlow[i] = 0.0;
+      slowFlow[i] = 0.0;
+      soilMoisture[i] = 0.0;
+    }
+    model.WaterBalance(stepHours, &stepPrecip, &stepPET, &fastFlow, &slowFlow,
+                       &soilMoisture);
+    results->insert(results->end(), fastFlow.begin(), fastFlow.end());
+    results->insert(results->end(), slowFlow.begin(), slowFlow.end());
+    if (withSoilMoisture) {
+      results->insert(results->end(), soilMoisture.begin(),
+                      soilMoisture.end());
+    }
+  }
+}
+
+static void ReferenceWaterBalanceInt(ReferenceSACCell *cNode, float stepHours,
+                                     float precipIn, float petIn) {
+
+  float precip =
+      precipIn *
+      stepHours; // stepHours; //stepHours; // precipIn is mm/hr, precip is mm
+  float pet = petIn * stepHours; // * 0.06; // petIn in mm/hr, pet is mm
+  float DT = stepHours / 24.0f;
+
+  float PAREA =
+      1.0f - cNode->params[PARAM_SAC_PCTIM] - cNode->params[PARAM_SAC_ADIMP];
+
+  /*******************************/
+  /*       ET Calculations       */
+  /*******************************/
+
+  float E1 = 0.0f;  // ET from upper zone
+  float RED = 0.0f; // Residual ET demand
+  float E2 = 0.0f;  // ET from UZFWC
+  float E3 = 0.0f;  // ET from lower zone (LZTWC)
+  float E5 = 0.0f;  // ET from ADIMP area
+
+  E1 = pet *
+       (cNode->UZTWC / cNode->params[PARAM_SAC_UZTWM]); // ET from upper zone
+  RED = pet - E1;                                       // Residual ET demand
+  cNode->UZTWC -= E1;
+  if (cNode->UZTWC < 0.0f) { // E1 can't exceed UZTWC
+    E1 += cNode->UZTWC;
+    cNode->UZTWC = 0.0f;
+    RED = pet - E1;
+    if (cNode->UZFWC < RED) {
+      E2 = cNode->UZFWC;
+      cNode->UZFWC = 0.0f;
+      RED = RED - E2;
+    } else {
+      E2 = RED;
+      cNode->UZFWC -= E2;
+      RED = 0.0f;
+    }
+  }
+
+  if ((cNode->UZTWC / cNode->params[PARAM_SAC_UZTWM]) <
+      (cNode->UZFWC / cNode->params[PARAM_SAC_UZFWM])) {
+    // Upper zone free water ratio exceeds upper zone tension
+    // water ratio, thus transfer free water to tension
+    float UZRAT =
+        (cNode->UZTWC + cNode->UZFWC) /
+        (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_UZFWM]);
+    cNode->UZTWC = cNode->params[PARAM_SAC_UZTWM] * UZRAT;
+    cNode->UZFWC = cNode->params[PARAM_SAC_UZFWM] * UZRAT;
+  }
+
+  if (cNode->UZTWC < 0.00001f) {
+    cNode->UZTWC = 0.0f;
+  }
+
+  if (cNode->UZFWC < 0.00001f) {
+    cNode->UZFWC = 0.0f;
+  }
+
+  E3 = RED * (cNode->LZTWC / (cNode->params[PARAM_SAC_UZTWM] +
+                              cNode->params[PARAM_SAC_LZTWM]));
+  cNode->LZTWC -= E3;
+
+  if (cNode->LZTWC < 0.0f) {
+    // E3 can't exceed LZTWC
+    E3 += cNode->LZTWC;
+    cNode->LZTWC = 0.0f;
+  }
+
+  float RATLZT = cNode->LZTWC / cNode->params[PARAM_SAC_LZTWM];
+  float RATLZ =
+      (cNode->LZTWC + cNode->LZFPC + cNode->LZFSC -
+       cNode->params[PARAM_SAC_RSERV]) /
+      (cNode->params[PARAM_SAC_LZTWM] + cNode->params[PARAM_SAC_LZFPM] +
+       cNode->params[PARAM_SAC_LZFSM] - cNode->params[PARAM_SAC_RSERV]);
+
+  if (RATLZT < RATLZ) {
+    // Resupply lower zone tension water from lower
+    // zone free water if more water available there.
+    float DEL = (RATLZ - RATLZT) * cNode->params[PARAM_SAC_LZTWM];
+    cNode->LZTWC += DEL;
+    cNode->LZFSC -= DEL;
+    if (cNode->LZFSC < 0.0f) {
+      // If transfer exceeds LZFSC then remainder comes from LZFPC
+      cNode->LZFPC += cNode->LZFSC;
+      cNode->LZFSC = 0.0f;
+    }
+  }
+
+  if (cNode->LZTWC < 0.00001f) {
+    cNode->LZTWC = 0.0f;
+  }
+
+  E5 = E1 + (RED + E2) * ((cNode->ADIMC - E1 - cNode->UZTWC) /
+                          (cNode->params[PARAM_SAC_UZTWM] +
+                           cNode->params[PARAM_SAC_LZTWM]));
+  // Adjust adimc, additional impervious area storage, for evaporation
+  cNode->ADIMC -= E5;
+
+  if (cNode->ADIMC < 0.0f) {
+    E5 += cNode->ADIMC;
+    cNode->ADIMC = 0.0f;
+  }
+
+  E5 *= cNode->params[PARAM_SAC_ADIMP];
+
+  /**********************************************/
+  /*    Compute Percolation & runoff amounts    */
+  /**********************************************/
+
+  // TWX is the time interval available moisture in excess of UZTW requirements
+  float TWX = precip + cNode->UZTWC - cNode->params[PARAM_SAC_UZTWM];
+
+  if (TWX < 0.0f) {
+    // All moisture held in UZTW -- No excess.
+    cNode->UZTWC += precip;
+    TWX = 0.0f;
+  } else {
+    cNode->UZTWC =
+        cNode->params[PARAM_SAC_UZTWM]; // Moisture in excess of UZTW storage
+  }
+
+  cNode->ADIMC = cNode->ADIMC + precip - TWX;
+
+  // Compute impervious area runoff
+  float ROIMP =
+      precip *
+      cNode->params[PARAM_SAC_PCTIM]; // Runoff from minimum impervious area
+
+  float SBF = 0.0f, SSUR = 0.0f, SIF = 0.0f, SPERC = 0.0f, SDRO = 0.0f,
+        SPBF = 0.0f;
+
+  float NINC =
+      floor(1.0f + 0.2f * (cNode->UZFWC + TWX)); // Number of time increments
+                                                 // that the time interval is
+                                                 // divided into for further
+                                                 // soil-moisture accounting.
+  // No one increment will exceed 5.0 millimeters of UZFWC+PAV
+
+  float DINC = (1.0f / NINC) * DT; // Length of each increment in days
+
+  float PINC = TWX / NINC; // Amount of available moisture for each increment.
+                           // Compute free water depletion fractions for the
+                           // time increment
+                           // being used-basic depletions are for one day
+
+  float DUZ = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_UZK], DINC);
+  float DLZP = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_LZPK], DINC);
+  float DLZS = 1.0f - pow(1.0f - cNode->params[PARAM_SAC_LZSK], DINC);
+
+  /*******************************************/
+  /*        Do loop for time interval        */
+  /*******************************************/
+
+  for (float i = 0.0f; i < NINC; i = i + 1.0f) {
+    float ADSUR = 0.0f;
+    float RATIO =
+        (cNode->ADIMC - cNode->UZTWC) / cNode->params[PARAM_SAC_LZTWM];
+    if (RATIO < 0.0f) {
+      RATIO = 0.0f;
+    }
+
+    float ADDRO =
+        PINC * pow(RATIO, 2.0f); // Amount of direct runoff from the area ADIMP
+
+    // Compute baseflow
+    float BF = cNode->LZFPC * DLZP;
+    cNode->LZFPC -= BF;
+    if (cNode->LZFPC <= 0.0001f) {
+      BF += cNode->LZFPC;
+      cNode->LZFPC = 0.0f;
+    }
+
+    SBF += BF;
+    SPBF += BF;
+
+    BF = cNode->LZFSC * DLZS;
+    cNode->LZFSC -= BF;
+    if (cNode->LZFSC <= 0.0001f) {
+      BF += cNode->LZFSC;
+      cNode->LZFSC = 0.0f;
+    }
+
+    SBF += BF;
+
+    // Compute Percolation, If no water is available then skip
+    if ((PINC + cNode->UZFWC) <= 0.01f) {
+      cNode->ADIMC = cNode->ADIMC + PINC - ADDRO - ADSUR;
+      if (cNode->ADIMC >
+          (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM])) {
+        ADDRO =
+            ADDRO + cNode->ADIMC -
+            (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM]);
+        cNode->ADIMC =
+            cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM];
+      }
+      SDRO = SDRO + ADDRO * cNode->params[PARAM_SAC_ADIMP];
+      if (cNode->ADIMC < 0.00001f) {
+        cNode->ADIMC = 0.0f;
+      }
+      continue;
+    }
+
+    float PERCM = cNode->params[PARAM_SAC_LZFPM] * DLZP +
+                  cNode->params[PARAM_SAC_LZFSM] * DLZS;
+    float PERC = PERCM * (cNode->UZFWC / cNode->params[PARAM_SAC_UZFWM]);
+    // DEFR is the lower zone moisture deficiency ratio
+    float DEFR = 1.0f - ((cNode->LZTWC + cNode->LZFPC + cNode->LZFSC) /
+                         (cNode->params[PARAM_SAC_LZTWM] +
+                          cNode->params[PARAM_SAC_LZFPM] +
+                          cNode->params[PARAM_SAC_LZFSM]));
+    float FR = 1.0f; // Change in percolation withdrawal due to frozen ground.
+    float FI = 1.0f; // Change in interflow withdrawal due to frozen ground.
+    // float IFRZE = 0.0f;
+
+    PERC = PERC *
+           (1.0f + cNode->params[PARAM_SAC_ZPERC] *
+                       pow(DEFR, cNode->params[PARAM_SAC_REXP])) *
+           FR;
+    // Note... percolation occurs from UZFWC before PAV is added.
+
+    if (PERC >= cNode->UZFWC) {
+      PERC = cNode->UZFWC;
+    }
+
+    cNode->UZFWC -= PERC;
+
+    // Check to see if percolation exceeds lower zone deficiency
+    float CHECK = cNode->LZTWC + cNode->LZFPC + cNode->LZFSC + PERC -
+                  cNode->params[PARAM_SAC_LZTWM] -
+                  cNode->params[PARAM_SAC_LZFPM] -
+                  cNode->params[PARAM_SAC_LZFSM];
+    if (CHECK > 0.0f) {
+      PERC -= CHECK;
+      cNode->UZFWC += CHECK;
+    }
+
+    SPERC += PERC; // Time interval summation of PERC
+
+    // Compute interflow and keep track of time interval sum
+    // Note PINC has not yet been added
+    float DEL = cNode->UZFWC * DUZ * FI;
+    SIF += DEL;
+    cNode->UZFWC -= DEL;
+
+    // Distribute percolated water into the lower zones
+    // tension water must be filled first except for the PFREE area.
+    // PERCT is percolation to tension water and PERCF is percolation going to
+    // free water
+    float PERCT = PERC * (1.0f - cNode->params[PARAM_SAC_PFREE]);
+    float PERCF;
+    if ((PERCT + cNode->LZTWC) <= cNode->params[PARAM_SAC_LZTWM]) {
+      cNode->LZTWC += PERCT;
+      PERCF = 0.0f;
+    } else {
+      PERCF = PERCT + cNode->LZTWC - cNode->params[PARAM_SAC_LZTWM];
+      cNode->LZTWC = cNode->params[PARAM_SAC_LZTWM];
+    }
+
+    // Distribute percolation in excess of tension requirements among the
+    // free water storages
+    PERCF += (PERC * cNode->params[PARAM_SAC_PFREE]);
+    if (PERCF != 0.0f) {
+      float HPL =
+          cNode->params[PARAM_SAC_LZFPM] /
+          (cNode->params[PARAM_SAC_LZFPM] + cNode->params[PARAM_SAC_LZFSM]);
+      // HPL is the relative size of the primary storage
+      // as compared with total lower zone free water storage
+
+      float RATLP = cNode->LZFPC / cNode->params[PARAM_SAC_LZFPM];
+      float RATLS = cNode->LZFSC / cNode->params[PARAM_SAC_LZFSM];
+      // RATLP and RATLS are content capacit ratios, or in other words
+      // the relative fullness of each storage
+
+      float FRACP =
+          (HPL * 2.0f * (1.0f - RATLP)) / ((1.0f - RATLP) + (1.0f - RATLS));
+      // FRACP is the fraction going to primary
+      if (FRACP > 1.0f) {
+        FRACP = 1.0f;
+      }
+
+      float PERCP = PERCF * FRACP;
+      float PERCS = PERCF - PERCP;
+      // PERCP and PERCS are the amount of excess percolation
+      // going to primary and supplemental storages, respectively
+
+      cNode->LZFSC += PERCS;
+      if (cNode->LZFSC > cNode->params[PARAM_SAC_LZFSM]) {
+        PERCS = PERCS - cNode->LZFSC + cNode->params[PARAM_SAC_LZFSM];
+        cNode->LZFSC = cNode->params[PARAM_SAC_LZFSM];
+      }
+
+      cNode->LZFPC = cNode->LZFPC + PERCF - PERCS;
+      if (cNode->LZFPC > cNode->params[PARAM_SAC_LZFPM]) {
+        float EXCESS = cNode->LZFPC - cNode->params[PARAM_SAC_LZFPM];
+        cNode->LZTWC += EXCESS;
+        cNode->LZFPC = cNode->params[PARAM_SAC_LZFPM];
+      }
+    }
+
+    // Distribute PINC between UZFWC & surface runoff
+    if (PINC != 0.0f) {
+      if ((PINC + cNode->UZFWC) <= cNode->params[PARAM_SAC_UZFWM]) {
+        // No surface runoff
+        cNode->UZFWC += PINC;
+      } else {
+        float SUR = PINC + cNode->UZFWC - cNode->params[PARAM_SAC_UZFWM];
+        SSUR = SSUR + SUR * PAREA;
+
+        ADSUR = SUR * (1.0f - ADDRO / PINC);
+        // ADSUR is the amount of surface runoff which comes from
+        // that portion of ADIMP which is not
+        // currently generating direct runoff. ADDRO/PINC is the fraction
+        // of ADIMP currently generating direct runoff.
+
+        SSUR = SSUR + ADSUR * cNode->params[PARAM_SAC_ADIMP];
+      }
+    }
+
+    // ADIMP area water balance -- SDRO is the IDT sum of the direct runoff
+    cNode->ADIMC = cNode->ADIMC + PINC - ADDRO - ADSUR;
+    if (cNode->ADIMC >
+        (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM])) {
+      ADDRO = ADDRO + cNode->ADIMC -
+              (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM]);
+      cNode->ADIMC =
+          cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_LZTWM];
+    }
+
+    SDRO = SDRO + ADDRO * cNode->params[PARAM_SAC_ADIMP];
+    if (cNode->ADIMC < 0.00001f) {
+      cNode->ADIMC = 0.0f;
+    }
+  }
+
+  /****************************************/
+  /*       End of incremental Loop        */
+  /****************************************/
+
+  // Compute sums and adjust runoff amounts by the area over which they are
+  // generated
+
+  float EUSED = E1 + E2 + E3; // ET from PAREA which is 1.0 - ADIMP - PCTIM
+
+  SIF *= PAREA;
+
+  // Separate channel component of baseflow from the non-channel component
+  float TBF = SBF * PAREA; // Total baseflow
+  float BFCC =
+      TBF *
+      (1.0f /
+       (1.0f + cNode->params[PARAM_SAC_SIDE])); // Baseflow, channel component
+
+  float BFP = SPBF * PAREA / (1.0f + cNode->params[PARAM_SAC_SIDE]);
+  float BFS = BFCC - BFP;
+  if (BFS < 0.0f) {
+    BFS = 0.0f;
+  }
+  // float BFNCC = TBF - BFCC; // Baseflow, non-channel component
+
+  float TCI = ROIMP + SDRO + SSUR + SIF +
+              BFCC;        // Total channel inflow for the time interval
+  float GRND = SIF + BFCC; // interflow part of ground flow
+  float SURF = TCI - GRND; // interflow part of surface flow
+
+  float E4 = (pet - EUSED) * cNode->params[PARAM_SAC_RIVA]; // / stepHours; //
+                                                            // ET from Riparian
+                                                            // vegetation
+
+  TCI -= E4;
+  if (TCI < 0.0f) {
+    E4 += TCI;
+    TCI = 0.0f;
+  }
+
+  GRND -= E4;
+  if (GRND < 0.0f) {
+    SURF += GRND;
+    GRND = 0.0f;
+    if (SURF < 0.0f) {
+      SURF = 0.0f;
+    }
+  }
+
+  EUSED *= PAREA;
+  // float TET = EUSED + E5 + E4; // total evaportranspiration
+  if (cNode->ADIMC < cNode->UZTWC) {
+    cNode->ADIMC = cNode->UZTWC;
+  }
+
+  cNode->dischargeF = SURF;
+  cNode->dischargeS = GRND;
+}
+
+void SimulateReference(std::vector<float> *results) {
+  std::vector<ReferenceSACCell> cells(NUM_GRID_CELLS);
+  for (int i = 0; i < NUM_GRID_CELLS; i++) {
+    GridNode *node = &(nodes[i]);
+    if (!node->gauge) {
+      continue;
+    }
+    ReferenceSACCell *cNode = &(cells[i]);
+    memcpy(cNode->params, setParamSettings[0][node->gauge],
+           sizeof(float) * PARAM_SAC_QTY);
+    cNode->UZTWC =
+        cNode->params[PARAM_SAC_UZTWC] * cNode->params[PARAM_SAC_UZTWM];
+    cNode->UZFWC =
+        cNode->params[PARAM_SAC_UZFWC] * cNode->params[PARAM_SAC_UZFWM];
+    cNode->LZTWC =
+        cNode->params[PARAM_SAC_LZTWC] * cNode->params[PARAM_SAC_LZTWM];
+    cNode->LZFSC =
+        cNode->params[PARAM_SAC_LZFSC] * cNode->params[PARAM_SAC_LZFSM];
+    cNode->LZFPC =
+        cNode->params[PARAM_SAC_LZFPC] * cNode->params[PARAM_SAC_LZFPM];
+    cNode->ADIMC = cNode->params[PARAM_SAC_ADIMC];
+  }
+
+  std::vector<float> fastFlow(NUM_GRID_CELLS), slowFlow(NUM_GRID_CELLS),
+      soilMoisture(NUM_GRID_CELLS);
+  results->clear();
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    float stepHours = (t < TOTAL_TIME_STEPS / 2) ? 1.0 : 3.0;
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      fastFlow[i] = 0.0;
+      slowFlow[i] = 0.0;
+      soilMoisture[i] = 0.0;
+      if (!nodes[i].gauge) {
+        continue;
+      }
+      ReferenceSACCell *cNode = &(cells[i]);
+      ReferenceWaterBalanceInt(cNode, stepHours,
+                               precip[t * NUM_GRID_CELLS + i],
+                               pet[t * NUM_GRID_CELLS + i]);
+      fastFlow[i] += (cNode->dischargeF / (stepHours * 3600.0f));
+      slowFlow[i] += (cNode->dischargeS / (stepHours * 3600.0f));
+      soilMoisture[i] =
+          100.0 * (cNode->UZTWC + cNode->UZFWC) /
+          (cNode->params[PARAM_SAC_UZTWM] + cNode->params[PARAM_SAC_UZFWM]);
+      if (!std::isfinite(soilMoisture[i])) {
+        soilMoisture[i] = 0;
+      }
+    }
+    results->insert(results->end(), fastFlow.begin(), fastFlow.end());
+    results->insert(results->end(), slowFlow.begin(), slowFlow.end());
+    results->insert(results->end(), soilMoisture.begin(), soilMoisture.end());
+  }
+}
+
+void SimulateSACSets(std::vector<float> *results) {
+#if _OPENMP
+  omp_set_num_threads(PARALLEL_THREADS);
+#endif
+
+  SAC model;
+  model.InitializeSets(&nodes, &gridCells, NUM_SETS, setParamSettings,
+                       &paramGrids);
+
+  std::vector<float> stepPrecip(NUM_GRID_CELLS), stepPET(NUM_GRID_CELLS);
+  std::vector<float> fastFlow[NUM_SETS], slowFlow[NUM_SETS];
+  for (int s = 0; s < NUM_SETS; s++) {
+    fastFlow[s].resize(NUM_GRID_CELLS);
+    slowFlow[s].resize(NUM_GRID_CELLS);
+    results[s].clear();
+  }
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    float stepHours = (t < TOTAL_TIME_STEPS / 2) ? 1.0 : 3.0;
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      stepPrecip[i] = precip[t * NUM_GRID_CELLS + i];
+      stepPET[i] = pet[t * NUM_GRID_CELLS + i];
+    }
+    for (int s = 0; s < NUM_SETS; s++) {
+      for (int i = 0; i < NUM_GRID_CELLS; i++) {
+        fastFlow[s][i] = 0.0;
+        slowFlow[s][i] = 0.0;
+      }
+    }
+    model.WaterBalanceSets(stepHours, &stepPrecip, &stepPET, fastFlow,
+                           slowFlow);
+    for (int s = 0; s < NUM_SETS; s++) {
+      results[s].insert(results[s].end(), fastFlow[s].begin(),
+                        fastFlow[s].end());
+      results[s].insert(results[s].end(), slowFlow[s].begin(),
+                        slowFlow[s].end());
+    }
+  }
+}
+
+void PrintStartupMessage() {
+  printf("%s", "********************************************************\n");
+  printf("%s", "**   Ensemble Framework For Flash Flood Forecasting   **\n");
+  printf("**                   Version %s                     **\n",
+         EF5_VERSION);
+  printf("**                   SAC Test                          **\n");
+  printf("%s", "********************************************************\n");
+}
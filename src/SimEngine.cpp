@@ -0,0 +1,299 @@
+#include "SimEngine.h"
+#include "CRESTModel.h"
+#include "HPModel.h"
+#include "KinematicRoute.h"
+#include "LinearRoute.h"
+#include "SAC.h"
+#include "Snow17Model.h"
+#include <cstdio>
+#include <cstring>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+// Stands in for the snow model of engines that run without one
+class NoSnow {
+
+public:
+  void BeginStep(float jday, float stepHours) {}
+  void StepCells(float stepHours, long begin, long end, const float *precip,
+                 const float *temp, float *melt, float *swe) {}
+  void StepList(float stepHours, const long *list, long count,
+                const float *precip, const float *temp, float *melt,
+                float *swe) {}
+};
+
+template <class Snow> struct SnowTraits {
+  static const bool hasSnow = true;
+};
+
+template <> struct SnowTraits<NoSnow> {
+  static const bool hasSnow = false;
+};
+
+template <class WB, class R, class Snow>
+class SimEngine : public SimEngineBase, public RoutingSource {
+
+public:
+  SimEngine(WB *newWB, R *newRoute, Snow *newSnow, bool newCanSweep) {
+    wb = newWB;
+    route = newRoute;
+    snow = newSnow;
+    canSweep = newCanSweep;
+    gaugeMap = NULL;
+    gridCells = NULL;
+    for (int f = 0; f < SWEEP_AVG_QTY; f++) {
+      gaugeAvgs[f] = NULL;
+    }
+  }
+
+  void Balance(float jday, float stepHours, std::vector<float> *precip,
+               std::vector<float> *temp, std::vector<float> *pet,
+               std::vector<float> *melt, std::vector<float> *swe,
+               std::vector<float> *fastFlow, std::vector<float> *slowFlow,
+               std::vector<float> *soilMoisture) {
+    long numNodes = (long)fastFlow->size();
+    if (numNodes == 0) {
+      return;
+    }
+    long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+    const float *precipIn = &(precip->at(0));
+    const float *petIn = &(pet->at(0));
+    float *fastOut = &(fastFlow->at(0));
+    float *slowOut = &(slowFlow->at(0));
+    float *smOut = &(soilMoisture->at(0));
+    const float *tempIn = NULL;
+    float *meltOut = NULL, *sweOut = NULL;
+    const float *wbPrecip = precipIn;
+    if (SnowTraits<Snow>::hasSnow) {
+      tempIn = &(temp->at(0));
+      meltOut = &(melt->at(0));
+      sweOut = &(swe->at(0));
+      wbPrecip = meltOut;
+    }
+    long numNegative = 0;
+
+    snow->BeginStep(jday, stepHours);
+    wb->BeginStep(stepHours);
+
+    // Every cell is independent of the others, each tile goes through the
+    // snow model and the water balance before the next one is started
+#if _OPENMP
+#pragma omp parallel for reduction(+ : numNegative)
+#endif
+    for (long tile = 0; tile < numTiles; tile++) {
+      long begin = tile * WB_BLOCK_TILE;
+      long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                    : numNodes;
+      snow->StepCells(stepHours, begin, end, precipIn, tempIn, meltOut,
+                      sweOut);
+      numNegative += wb->StepCells(stepHours, begin, end, wbPrecip, petIn,
+                                   fastOut, slowOut, smOut);
+    }
+
+    wb->EndStep(numNegative);
+  }
+
+  void Route(float stepHours, std::vector<float> *fastFlow,
+             std::vector<float> *slowFlow, std::vector<float> *discharge) {
+    route->R::Route(stepHours, fastFlow, slowFlow, discharge);
+  }
+
+  bool CanSweep() { return canSweep; }
+
+  void Sweep(float jday, float stepHours, std::vector<float> *precip,
+             std::vector<float> *temp, std::vector<float> *pet,
+             std::vector<float> *melt, std::vector<float> *swe,
+             std::vector<float> *fastFlow, std::vector<float> *slowFlow,
+             std::vector<float> *soilMoisture, std::vector<float> *discharge) {
+    if (fastFlow->empty()) {
+      return;
+    }
+    sweepHours = stepHours;
+    sweepPrecip = &(precip->at(0));
+    sweepPET = &(pet->at(0));
+    sweepFast = &(fastFlow->at(0));
+    sweepSlow = &(slowFlow->at(0));
+    sweepSM = &(soilMoisture->at(0));
+    sweepTemp = NULL;
+    sweepMelt = NULL;
+    sweepSWE = NULL;
+    sweepWBPrecip = sweepPrecip;
+    if (SnowTraits<Snow>::hasSnow) {
+      sweepTemp = &(temp->at(0));
+      sweepMelt = &(melt->at(0));
+      sweepSWE = &(swe->at(0));
+      sweepWBPrecip = sweepMelt;
+    }
+    sweepNegative = 0;
+
+    // Fields whose averages are wanted, the others are left NULL
+    numAverages = 0;
+    const float *fields[SWEEP_AVG_QTY] = {sweepFast, sweepSlow, sweepSM,
+                                          sweepWBPrecip, sweepPET, sweepSWE,
+                                          sweepTemp};
+    for (int f = 0; f < SWEEP_AVG_QTY; f++) {
+      avgFields[f] = (gaugeAvgs[f] && fields[f]) ? fields[f] : NULL;
+      if (avgFields[f]) {
+        numAverages++;
+      }
+    }
+    size_t numSums = (numAverages > 0) ? gaugeMap->GetNumSums() : 0;
+    sumStride = (SWEEP_AVG_QTY + 1) * numSums;
+    taskSums.resize(route->GetNumTasks() * sumStride);
+
+    snow->BeginStep(jday, stepHours);
+    wb->BeginStep(stepHours);
+
+    // Route calls FillCells on every sub-tree before routing it
+    route->SetRunoffSource(this);
+    route->R::Route(stepHours, fastFlow, slowFlow, discharge);
+    route->SetRunoffSource(NULL);
+
+    wb->EndStep(sweepNegative);
+
+    if (numAverages == 0) {
+      return;
+    }
+
+    // The sums of every sub-tree are added in a fixed order so the averages
+    // do not depend on how the sub-trees were spread over threads
+    size_t numTasks = route->GetNumTasks();
+    std::vector<float> sumVal(numSums), sumArea(numSums);
+    for (size_t g = 0; g < numSums; g++) {
+      sumArea[g] = 0.0;
+      for (size_t t = 0; t < numTasks; t++) {
+        sumArea[g] += taskSums[t * sumStride + SWEEP_AVG_QTY * numSums + g];
+      }
+    }
+    for (int f = 0; f < SWEEP_AVG_QTY; f++) {
+      if (!avgFields[f]) {
+        continue;
+      }
+      for (size_t g = 0; g < numSums; g++) {
+        sumVal[g] = 0.0;
+        for (size_t t = 0; t < numTasks; t++) {
+          sumVal[g] += taskSums[t * sumStride + f * numSums + g];
+        }
+      }
+      gaugeMap->FinishAverage(&(sumVal[0]), &(sumArea[0]), gaugeAvgs[f]);
+    }
+  }
+
+  void SetGaugeAverages(GaugeMap *newGaugeMap, std::vector<GridCell> *cells,
+                        std::vector<float> **newGaugeAvgs) {
+    gaugeMap = newGaugeMap;
+    gridCells = cells;
+    for (int f = 0; f < SWEEP_AVG_QTY; f++) {
+      gaugeAvgs[f] = newGaugeAvgs[f];
+    }
+  }
+
+  void FillCells(long task, const long *cells, size_t count) {
+    snow->StepList(sweepHours, cells, (long)count, sweepPrecip, sweepTemp,
+                   sweepMelt, sweepSWE);
+    long numNegative =
+        wb->StepList(sweepHours, cells, (long)count, sweepWBPrecip, sweepPET,
+                     sweepFast, sweepSlow, sweepSM);
+#if _OPENMP
+#pragma omp atomic
+#endif
+    sweepNegative += numNegative;
+
+    if (numAverages == 0) {
+      return;
+    }
+    // Each sub-tree adds up its own cells, the last row holds the area
+    size_t numSums = sumStride / (SWEEP_AVG_QTY + 1);
+    float *sums = &(taskSums[task * sumStride]);
+    memset(sums, 0, sizeof(float) * sumStride);
+    float *sumArea = sums + SWEEP_AVG_QTY * numSums;
+    const GridCell *cell = &((*gridCells)[0]);
+    for (size_t j = 0; j < count; j++) {
+      long i = cells[j];
+      size_t gaugeIndex = cell[i].gaugeIndex;
+      for (int f = 0; f < SWEEP_AVG_QTY; f++) {
+        if (avgFields[f]) {
+          sums[f * numSums + gaugeIndex] += (avgFields[f][i] * cell[i].area);
+        }
+      }
+      sumArea[gaugeIndex] += cell[i].area;
+    }
+  }
+
+private:
+  WB *wb;
+  R *route;
+  Snow *snow;
+  bool canSweep;
+  GaugeMap *gaugeMap;
+  std::vector<GridCell> *gridCells;
+  std::vector<float> *gaugeAvgs[SWEEP_AVG_QTY];
+  // Arrays of the step Sweep is running, FillCells works on these
+  float sweepHours;
+  const float *sweepPrecip, *sweepWBPrecip, *sweepTemp, *sweepPET;
+  float *sweepMelt, *sweepSWE, *sweepFast, *sweepSlow, *sweepSM;
+  long sweepNegative;
+  const float *avgFields[SWEEP_AVG_QTY];
+  int numAverages;
+  // SWEEP_AVG_QTY + 1 rows of gauge sums per sub-tree
+  std::vector<float> taskSums;
+  size_t sumStride;
+};
+
+static NoSnow noSnow;
+
+template <class WB, class R>
+static SimEngineBase *NewSimEngineSnow(TaskConfigSection *task, WB *wbModel,
+                                       R *rModel, SnowModel *sModel,
+                                       bool canSweep) {
+  if (!sModel) {
+    return new SimEngine<WB, R, NoSnow>(wbModel, rModel, &noSnow, canSweep);
+  }
+  switch (task->GetSnow()) {
+  case SNOW_SNOW17:
+    return new SimEngine<WB, R, Snow17Model>(
+        wbModel, rModel, static_cast<Snow17Model *>(sModel), canSweep);
+  default:
+    return NULL;
+  }
+}
+
+template <class WB>
+static SimEngineBase *NewSimEngineRoute(TaskConfigSection *task, WB *wbModel,
+                                        RoutingModel *rModel,
+                                        SnowModel *sModel) {
+  // The kinematic wave active set is picked from the fast flow of every cell
+  // before any cell is routed, so it cannot be swept
+  switch (task->GetRouting()) {
+  case ROUTE_KINEMATIC:
+    return NewSimEngineSnow(task, wbModel, static_cast<KWRoute *>(rModel),
+                            sModel, !task->UseKWActiveSet());
+  case ROUTE_LINEAR:
+    return NewSimEngineSnow(task, wbModel, static_cast<LRRoute *>(rModel),
+                            sModel, true);
+  default:
+    return NULL;
+  }
+}
+
+SimEngineBase *NewSimEngine(TaskConfigSection *task,
+                            WaterBalanceModel *wbModel, RoutingModel *rModel,
+                            SnowModel *sModel) {
+  if (!wbModel || !rModel) {
+    return NULL;
+  }
+  switch (task->GetModel()) {
+  case MODEL_CREST:
+    return NewSimEngineRoute(task, static_cast<CRESTModel *>(wbModel), rModel,
+                             sModel);
+  case MODEL_SAC:
+    return NewSimEngineRoute(task, static_cast<SAC *>(wbModel), rModel,
+                             sModel);
+  case MODEL_HP:
+    return NewSimEngineRoute(task, static_cast<HPModel *>(wbModel), rModel,
+                             sModel);
+  default:
+    return NULL;
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef SIM_ENGINE_H
+#define SIM_ENGINE_H
+
+#include "GaugeMap.h"
+#include "ModelBase.h"
+#include "TaskConfigSection.h"
+
+// Gauge averages Sweep can take along the way
+enum SWEEP_AVERAGES {
+  SWEEP_AVG_FASTFLOW,
+  SWEEP_AVG_SLOWFLOW,
+  SWEEP_AVG_SOILMOISTURE,
+  SWEEP_AVG_PRECIP, // What the water balance took in, the melt with snow
+  SWEEP_AVG_PET,
+  SWEEP_AVG_SWE,
+  SWEEP_AVG_TEMP,
+  SWEEP_AVG_QTY
+};
+
+// Runs one step of a distributed simulation with the concrete model types
+// known at compile time. The snow model and the water balance run one tile of
+// WB_BLOCK_TILE cells after the other while the tile is still in cache, and
+// every model is called without going through its virtual functions. The
+// models are owned and initialized by the caller.
+class SimEngineBase {
+
+public:
+  virtual ~SimEngineBase() {}
+  // Runs the snow model, when there is one, and then the water balance on
+  // its melt. melt may be the same vector as precip. temp, melt and swe are
+  // not touched without a snow model, in which case the water balance runs
+  // on precip.
+  virtual void Balance(float jday, float stepHours, std::vector<float> *precip,
+                       std::vector<float> *temp, std::vector<float> *pet,
+                       std::vector<float> *melt, std::vector<float> *swe,
+                       std::vector<float> *fastFlow,
+                       std::vector<float> *slowFlow,
+                       std::vector<float> *soilMoisture) = 0;
+  virtual void Route(float stepHours, std::vector<float> *fastFlow,
+                     std::vector<float> *slowFlow,
+                     std::vector<float> *discharge) = 0;
+  // Sweep does what Balance and Route do in a single pass over the cells.
+  // The routing runs the snow model and the water balance on each sub-tree
+  // right before routing it and adds the cells to the gauge averages given
+  // to SetGaugeAverages. Only when CanSweep is true.
+  virtual bool CanSweep() = 0;
+  virtual void Sweep(float jday, float stepHours, std::vector<float> *precip,
+                     std::vector<float> *temp, std::vector<float> *pet,
+                     std::vector<float> *melt, std::vector<float> *swe,
+                     std::vector<float> *fastFlow,
+                     std::vector<float> *slowFlow,
+                     std::vector<float> *soilMoisture,
+                     std::vector<float> *discharge) = 0;
+  // gaugeAvgs holds SWEEP_AVG_QTY vectors the averages of each Sweep are put
+  // in, those left NULL are not taken. The averages are the same as those of
+  // GaugeAverage but for rounding, the cells are added up sub-tree by
+  // sub-tree.
+  virtual void SetGaugeAverages(GaugeMap *gaugeMap,
+                                std::vector<GridCell> *cells,
+                                std::vector<float> **gaugeAvgs) = 0;
+};
+
+// Returns an engine for the models of task or NULL for combinations without
+// one, which then run through the virtual model interfaces.
+SimEngineBase *NewSimEngine(TaskConfigSection *task,
+                            WaterBalanceModel *wbModel, RoutingModel *rModel,
+                            SnowModel *sModel);
+
+#endif
@@ -9,11 +9,12 @@ SimpleInundation::SimpleInundation() {}
 SimpleInundation::~SimpleInundation() {}
 
 bool SimpleInundation::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
+  gridCells = newCells;
   if (iNodes.size() != nodes->size()) {
     iNodes.resize(nodes->size());
   }
@@ -28,6 +29,7 @@ bool SimpleInundation::InitializeModel(
   }
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     GridNode *channelNode = node;
     node->modelIndex = i;
     while (!channelNode->channelGridCell &&
@@ -38,8 +40,9 @@ bool SimpleInundation::InitializeModel(
         iNodes[channelNode->index].params[PARAM_SI_ALPHA];
     iNodes[i].params[PARAM_SI_BETA] =
         iNodes[channelNode->index].params[PARAM_SI_BETA];
-    iNodes[i].elevation = g_DEM->data[node->y][node->x];
-    iNodes[i].elevationChannel = g_DEM->data[channelNode->y][channelNode->x];
+    iNodes[i].elevation = g_DEM->data[cell->y][cell->x];
+    GridCell *channelCell = &gridCells->at(channelNode->index);
+    iNodes[i].elevationChannel = g_DEM->data[channelCell->y][channelCell->x];
     iNodes[i].elevDiff = iNodes[i].elevation - iNodes[i].elevationChannel;
     iNodes[i].channelIndex = channelNode->index;
   }
@@ -96,6 +99,7 @@ void SimpleInundation::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     InundationGridNode *cNode = &(iNodes[i]);
     if (!node->gauge) {
       unused++;
@@ -110,12 +114,12 @@ void SimpleInundation::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_SI_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        cNode->params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
@@ -18,6 +18,7 @@ public:
   SimpleInundation();
   ~SimpleInundation();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   bool Inundation(std::vector<float> *discharge, std::vector<float> *depth);
@@ -31,6 +32,7 @@ private:
                      float dischargeIn, float *depth);
 
   std::vector<GridNode> *nodes;
+  std::vector<GridCell> *gridCells;
   std::vector<InundationGridNode> iNodes;
 };
 
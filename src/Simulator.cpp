@@ -8,6 +8,7 @@
 #include "CRESTModel.h"
 #include "GridWriterFull.h"
 #include "GriddedOutput.h"
+#include "GridPool.h"
 #include "HPModel.h"
 #include "HyMOD.h"
 #include "KinematicRoute.h"
@@ -16,6 +17,7 @@
 #include "PETConfigSection.h"
 #include "PrecipConfigSection.h"
 #include "SAC.h"
+#include "SimEngine.h"
 #include "SimpleInundation.h"
 #include "Simulator.h"
 #include "Snow17Model.h"
@@ -94,6 +96,8 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
     petConvert = 1.0;
   }
   timeStepHours = timeStep->GetTimeInSec() / 3600.0;
+  wbBlockSteps = task->GetWBBlockSteps();
+  prefetchSteps = task->GetPrefetchSteps();
 
   if (timeStepLR) {
     timeStepHoursLR = timeStepLR->GetTimeInSec() / 3600.0;
@@ -197,8 +201,8 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
   }
 
   // Carve the basin to find which nodes we're modeling on
-  CarveBasin(task->GetBasinSec(), &nodes, paramSettings, &fullParamSettings,
-             &gaugeMap, defaultParams, paramSettingsRoute,
+  CarveBasin(task->GetBasinSec(), &nodes, &cells, paramSettings,
+             &fullParamSettings, &gaugeMap, defaultParams, paramSettingsRoute,
              &fullParamSettingsRoute, defaultParamsRoute, paramSettingsSnow,
              &fullParamSettingsSnow, defaultParamsSnow, paramSettingsInundation,
              &fullParamSettingsInundation, defaultParamsInundation);
@@ -210,21 +214,12 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
     return false;
   }
 
+  // Each cell averages into its node's gauge
+  gaugeMap.SetGaugeIndexes(&nodes, &cells);
+
   // Create the appropriate model
-  switch (task->GetModel()) {
-  case MODEL_CREST:
-    wbModel = new CRESTModel();
-    break;
-  case MODEL_HYMOD:
-    wbModel = new HyMOD();
-    break;
-  case MODEL_SAC:
-    wbModel = new SAC();
-    break;
-  case MODEL_HP:
-    wbModel = new HPModel();
-    break;
-  default:
+  wbModel = NewWaterBalanceModel(task);
+  if (!wbModel) {
     ERROR_LOG("Unsupported Water Balance Model!!");
     return false;
   }
@@ -233,43 +228,30 @@ bool Simulator::InitializeBasic(TaskConfigSection *task) {
     // We need to provided updated areas
     std::vector<float> gaugeAreas;
     gaugeAreas.resize(gauges->size());
-    gaugeMap.GetGaugeArea(&nodes, &gaugeAreas);
+    gaugeMap.GetGaugeArea(&cells, &gaugeAreas);
 
     lumpedNodes.resize(gauges->size());
+    lumpedCells.resize(gauges->size());
     for (size_t i = 0; i < gauges->size(); i++) {
       GaugeConfigSection *gauge = gauges->at(i);
       memcpy(&(lumpedNodes[i]), &(nodes[gauge->GetGridNodeIndex()]),
              sizeof(GridNode));
-      lumpedNodes[i].area = gaugeAreas[i];
+      lumpedCells[i] = cells[gauge->GetGridNodeIndex()];
+      lumpedCells[i].area = gaugeAreas[i];
     }
     rModel = NULL;
   } else {
     // Create the appropriate routing
-    switch (task->GetRouting()) {
-    case ROUTE_LINEAR:
-      rModel = new LRRoute();
-      break;
-    case ROUTE_KINEMATIC:
-      rModel = new KWRoute();
-      break;
-    case ROUTE_QTY:
-      rModel = NULL;
-      break;
-    default:
+    rModel = NewRoutingModel(task);
+    if (!rModel && task->GetRouting() != ROUTE_QTY) {
       ERROR_LOG("Unsupported Routing Model!!");
       return false;
     }
   }
 
   // Create the appropriate snow model
-  switch (task->GetSnow()) {
-  case SNOW_SNOW17:
-    sModel = new Snow17Model();
-    break;
-  case SNOW_QTY:
-    sModel = NULL;
-    break;
-  default:
+  sModel = NewSnowModel(task);
+  if (!sModel && task->GetSnow() != SNOW_QTY) {
     ERROR_LOG("Unsupported Snow Model!!");
     return false;
   }
@@ -328,9 +310,9 @@ bool Simulator::InitializeSimu(TaskConfigSection *task) {
       avgVals.resize(nodes.size());
       stdVals.resize(nodes.size());
       scVals.resize(nodes.size());
-      if (ReadLP3File(task->GetStdGrid(), &nodes, &stdVals) &&
-          ReadLP3File(task->GetAvgGrid(), &nodes, &avgVals) &&
-          ReadLP3File(task->GetScGrid(), &nodes, &scVals)) {
+      if (ReadLP3File(task->GetStdGrid(), &cells, &stdVals) &&
+          ReadLP3File(task->GetAvgGrid(), &cells, &avgVals) &&
+          ReadLP3File(task->GetScGrid(), &cells, &scVals)) {
         outputRP = true;
         rpData.resize(nodes.size());
         CalcLP3Vals(&stdVals, &avgVals, &scVals, &rpData, &nodes);
@@ -536,50 +518,24 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
   caliRCurrentParams.resize(maxThreads);
   caliSFullParamSettings.resize(maxThreads);
   caliSCurrentParams.resize(maxThreads);
+  caliBlocks.resize(maxThreads);
   for (int i = 0; i < maxThreads; i++) {
-    switch (task->GetModel()) {
-    case MODEL_CREST:
-      caliWBModels[i] = new CRESTModel();
-      break;
-    case MODEL_HYMOD:
-      caliWBModels[i] = new HyMOD();
-      break;
-    case MODEL_SAC:
-      caliWBModels[i] = new SAC();
-      break;
-    case MODEL_HP:
-      caliWBModels[i] = new HPModel();
-      break;
-    default:
+    caliWBModels[i] = NewWaterBalanceModel(task);
+    if (!caliWBModels[i]) {
       ERROR_LOG("Unsupported Model!!");
       return false;
     }
 
     // Create the appropriate routing
-    switch (task->GetRouting()) {
-    case ROUTE_LINEAR:
-      caliRModels[i] = new LRRoute();
-      break;
-    case ROUTE_KINEMATIC:
-      caliRModels[i] = new KWRoute();
-      break;
-    case ROUTE_QTY:
-      caliRModels[i] = NULL;
-      break;
-    default:
+    caliRModels[i] = NewRoutingModel(task);
+    if (!caliRModels[i] && task->GetRouting() != ROUTE_QTY) {
       ERROR_LOG("Unsupported Routing Model!!");
       return false;
     }
 
     // Create the appropriate snow model
-    switch (task->GetSnow()) {
-    case SNOW_SNOW17:
-      caliSModels[i] = new Snow17Model();
-      break;
-    case SNOW_QTY:
-      caliSModels[i] = NULL;
-      break;
-    default:
+    caliSModels[i] = NewSnowModel(task);
+    if (!caliSModels[i] && task->GetSnow() != SNOW_QTY) {
       ERROR_LOG("Unsupported Snow Model!!");
       return false;
     }
@@ -623,11 +579,112 @@ bool Simulator::InitializeCali(TaskConfigSection *task) {
       }
     }
   }
+#else
+  caliBlocks.resize(1);
 #endif
 
+  // Models for running batches of parameter sets together, each set needs its
+  // own routing
+  caliUseSets = (task->GetSnow() == SNOW_QTY &&
+                 task->GetRouting() != ROUTE_QTY && !wbModel->IsLumped());
+  if (caliUseSets) {
+    caliSetWBModel = NewWaterBalanceModel(task);
+    caliSetRModels.resize(CALI_SET_BATCH);
+    caliSetWBCurrentParams.resize(CALI_SET_BATCH);
+    caliSetRCurrentParams.resize(CALI_SET_BATCH);
+    caliSetWBFullParamSettings.resize(CALI_SET_BATCH);
+    caliSetRFullParamSettings.resize(CALI_SET_BATCH);
+    for (int i = 0; i < CALI_SET_BATCH; i++) {
+      caliSetRModels[i] = NewRoutingModel(task);
+      caliSetWBCurrentParams[i] = new float[numWBParams];
+      caliSetRCurrentParams[i] = new float[numRParams];
+      ReplaceCaliParams(&fullParamSettings, caliWBParams,
+                        caliSetWBCurrentParams[i],
+                        &(caliSetWBFullParamSettings[i]));
+      ReplaceCaliParams(&fullParamSettingsRoute, caliRParams,
+                        caliSetRCurrentParams[i],
+                        &(caliSetRFullParamSettings[i]));
+    }
+  }
+
   return true;
 }
 
+WaterBalanceModel *Simulator::NewWaterBalanceModel(TaskConfigSection *task) {
+  PRECISIONS precision = task->GetPrecision();
+  switch (task->GetModel()) {
+  case MODEL_CREST: {
+    CRESTModel *crestModel = new CRESTModel();
+    if (precision != PRECISION_QTY) {
+      crestModel->SetPrecision(precision);
+    }
+    return crestModel;
+  }
+  case MODEL_HYMOD:
+    return new HyMOD();
+  case MODEL_SAC: {
+    SAC *sacModel = new SAC();
+    if (precision != PRECISION_QTY) {
+      sacModel->SetPrecision(precision);
+    }
+    return sacModel;
+  }
+  case MODEL_HP:
+    return new HPModel();
+  default:
+    return NULL;
+  }
+}
+
+RoutingModel *Simulator::NewRoutingModel(TaskConfigSection *task) {
+  switch (task->GetRouting()) {
+  case ROUTE_LINEAR: {
+    LRRoute *lrModel = new LRRoute();
+    lrModel->SetDepthTolerance(task->GetLRDepthTolerance());
+    return lrModel;
+  }
+  case ROUTE_KINEMATIC: {
+    KWRoute *kwModel = new KWRoute();
+    kwModel->SetSolver(task->GetKWSolver());
+    kwModel->SetActiveSet(task->UseKWActiveSet());
+    if (task->GetPrecision() != PRECISION_QTY) {
+      kwModel->SetPrecision(task->GetPrecision());
+    }
+    return kwModel;
+  }
+  default:
+    return NULL;
+  }
+}
+
+SnowModel *Simulator::NewSnowModel(TaskConfigSection *task) {
+  switch (task->GetSnow()) {
+  case SNOW_SNOW17: {
+    Snow17Model *snowModel = new Snow17Model();
+    if (task->GetPrecision() != PRECISION_QTY) {
+      snowModel->SetPrecision(task->GetPrecision());
+    }
+    return snowModel;
+  }
+  default:
+    return NULL;
+  }
+}
+
+void Simulator::ReplaceCaliParams(
+    std::map<GaugeConfigSection *, float *> *fullSettings, float *caliParams,
+    float *currentParams, std::map<GaugeConfigSection *, float *> *settings) {
+  for (std::map<GaugeConfigSection *, float *>::iterator itr =
+           fullSettings->begin();
+       itr != fullSettings->end(); itr++) {
+    if (itr->second == caliParams) {
+      (*settings)[itr->first] = currentParams;
+    } else {
+      (*settings)[itr->first] = itr->second;
+    }
+  }
+}
+
 void Simulator::CleanUp() {
   // Close output gauge files
   for (size_t i = 0; i < gaugeOutputs.size(); i++) {
@@ -681,7 +738,7 @@ void Simulator::BasinAvg() {
 
     sprintf(buffer, "%s/precip.%s.avg.tif", outputPath,
             currentTimeTextOutput.GetName());
-    gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
     for (long i = numNodes - 1; i >= 0; i--) {
       avgVals[i] = 0.0;
@@ -718,7 +775,7 @@ void Simulator::BasinAvg() {
     // avgVals[i] = 8.24*powf(areaUsed, -0.57)*nodes[i].contribArea;
   }
   sprintf(buffer, "%s/actionFloodThresPrecip.tif", outputPath);
-  gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
   for (long i = numNodes - 1; i >= 0; i--) {
     float areaUsed =
@@ -730,7 +787,7 @@ void Simulator::BasinAvg() {
     // avgVals[i] = 8.24*powf(areaUsed, -0.57)*nodes[i].contribArea;
   }
   sprintf(buffer, "%s/minorFloodThresPrecip.tif", outputPath);
-  gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
   for (long i = numNodes - 1; i >= 0; i--) {
     float areaUsed =
@@ -742,7 +799,7 @@ void Simulator::BasinAvg() {
     // avgVals[i] = 8.24*powf(areaUsed, -0.57)*nodes[i].contribArea;
   }
   sprintf(buffer, "%s/moderateFloodThresPrecip.tif", outputPath);
-  gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
   for (long i = numNodes - 1; i >= 0; i--) {
     float areaUsed =
@@ -754,7 +811,7 @@ void Simulator::BasinAvg() {
     // avgVals[i] = 8.24*powf(areaUsed, -0.57)*nodes[i].contribArea;
   }
   sprintf(buffer, "%s/majorFloodThresPrecip.tif", outputPath);
-  gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
   for (long i = numNodes - 1; i >= 0; i--) {
     float areaUsed =
@@ -763,22 +820,22 @@ void Simulator::BasinAvg() {
     avgVals[i] = 8.502339237 * powf(areaUsed, -0.57) * nodes[i].contribArea;
   }
   sprintf(buffer, "%s/minorFloodThres.tif", outputPath);
-  gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
 
   /*std::vector<float> rpavgVals, stdVals, scVals;
    rpavgVals.resize(nodes.size());
    stdVals.resize(nodes.size());
    scVals.resize(nodes.size());
-   if (ReadLP3File(task->GetStdGrid(), &nodes, &stdVals) &&
-   ReadLP3File(task->GetAvgGrid(), &nodes, &rpavgVals) &&
-   ReadLP3File(task->GetScGrid(), &nodes, &scVals)) {
+   if (ReadLP3File(task->GetStdGrid(), &cells, &stdVals) &&
+   ReadLP3File(task->GetAvgGrid(), &cells, &rpavgVals) &&
+   ReadLP3File(task->GetScGrid(), &cells, &scVals)) {
    rpData.resize(nodes.size());
    CalcLP3Vals(&stdVals, &rpavgVals, &scVals, &rpData, &nodes);
    for (long i = numNodes - 1; i >= 0; i--) {
    avgVals[i] = rpData[i].q5;
    }
    sprintf(buffer, "%s/q_5.tif", outputPath);
-   gridWriter.WriteGrid(&nodes, &avgVals, buffer, false);
+   gridWriter.WriteGrid(&nodes, &cells, &avgVals, buffer, false);
    }*/
 }
 
@@ -839,12 +896,12 @@ int Simulator::LoadForcings(PrecipReader *precipReader, PETReader *petReader,
     }
 
     sprintf(buffer, "%s/%s", tempSec->GetLoc(), tempFile->GetName());
-    if (!tempReader->Read(buffer, tempSec->GetType(), &nodes, &currentTempSimu,
+    if (!tempReader->Read(buffer, tempSec->GetType(), &cells, &currentTempSimu,
                           NULL, hasTempF)) {
       if (hasTempF) {
         sprintf(qpfBuffer, "%s/%s", tempFSec->GetLoc(), tempFFile->GetName());
       }
-      if (!hasTempF || !tempReader->Read(qpfBuffer, tempSec->GetType(), &nodes,
+      if (!hasTempF || !tempReader->Read(qpfBuffer, tempSec->GetType(), &cells,
                                          &currentTempSimu, NULL, false)) {
 #ifdef _WIN32
         outputError = true;
@@ -857,13 +914,13 @@ int Simulator::LoadForcings(PrecipReader *precipReader, PETReader *petReader,
 
   if (precipReader) {
     sprintf(buffer, "%s/%s", precipSec->GetLoc(), precipFile->GetName());
-    if (!precipReader->Read(buffer, precipSec->GetType(), &nodes,
+    if (!precipReader->Read(buffer, precipSec->GetType(), &cells,
                             &currentPrecipSimu, precipConvert, NULL, hasQPF)) {
       if (hasQPF) {
         sprintf(qpfBuffer, "%s/%s", qpfSec->GetLoc(), qpfFile->GetName());
       }
       if (!hasQPF ||
-          !precipReader->Read(qpfBuffer, qpfSec->GetType(), &nodes,
+          !precipReader->Read(qpfBuffer, qpfSec->GetType(), &cells,
                               &currentPrecipSimu, qpfConvert, NULL, false)) {
 #ifdef _WIN32
         outputError = true;
@@ -883,7 +940,7 @@ int Simulator::LoadForcings(PrecipReader *precipReader, PETReader *petReader,
 
   if (petReader) {
     sprintf(buffer, "%s/%s", petSec->GetLoc(), petFile->GetName());
-    if (!petReader->Read(buffer, petSec->GetType(), &nodes, &currentPETSimu,
+    if (!petReader->Read(buffer, petSec->GetType(), &cells, &currentPETSimu,
                          petConvert, petSec->IsTemperature(),
                          (float)currentTime.GetTM()->tm_yday)) {
 #ifdef _WIN32
@@ -901,6 +958,111 @@ int Simulator::LoadForcings(PrecipReader *precipReader, PETReader *petReader,
   return retVal;
 }
 
+ForcingPrefetch *Simulator::StartPrefetch(int depth) {
+  // The model time of every step left, switching to the long range time step
+  // as the simulation does
+  std::vector<TimeVar> stepTimes;
+  TimeVar stepTime = currentTime;
+  TimeUnit *stepTimeStep = timeStep;
+  bool stepInLR = inLR;
+  for (stepTime.Increment(stepTimeStep); stepTime <= endTime;
+       stepTime.Increment(stepTimeStep)) {
+    stepTimes.push_back(stepTime);
+    if (timeStepLR && !stepInLR && beginLRTime <= stepTime) {
+      stepInLR = true;
+      stepTimeStep = timeStepLR;
+    }
+  }
+
+  ForcingPrefetch *prefetch = new ForcingPrefetch(&cells, &stepTimes, depth);
+  ForcingFeed feed, fallback;
+  feed.type = precipSec->GetType();
+  feed.loc = precipSec->GetLoc();
+  feed.name = *precipFile;
+  feed.time = currentTimePrecip;
+  feed.freq = timeStepPrecip;
+  feed.convert = precipConvert;
+  if (hasQPF) {
+    fallback.type = qpfSec->GetType();
+    fallback.loc = qpfSec->GetLoc();
+    fallback.name = *qpfFile;
+    fallback.time = currentTimeQPF;
+    fallback.freq = timeStepQPF;
+    fallback.convert = qpfConvert;
+  }
+  prefetch->SetPrecip(&feed, hasQPF ? &fallback : NULL);
+
+  feed.type = petSec->GetType();
+  feed.loc = petSec->GetLoc();
+  feed.name = *petFile;
+  feed.time = currentTimePET;
+  feed.freq = timeStepPET;
+  feed.convert = petConvert;
+  prefetch->SetPET(&feed, petSec->IsTemperature());
+
+  if (sModel) {
+    feed.type = tempSec->GetType();
+    feed.loc = tempSec->GetLoc();
+    feed.name = *tempFile;
+    feed.time = currentTimeTemp;
+    feed.freq = timeStepTemp;
+    feed.convert = 1.0;
+    if (hasTempF) {
+      fallback.type = tempSec->GetType();
+      fallback.loc = tempFSec->GetLoc();
+      fallback.name = *tempFFile;
+      fallback.time = currentTimeTempF;
+      fallback.freq = timeStepTempF;
+      fallback.convert = 1.0;
+    }
+    prefetch->SetTemp(&feed, hasTempF ? &fallback : NULL, tempSec->GetDEM());
+  }
+
+  if (!prefetch->Start()) {
+    delete prefetch;
+    return NULL;
+  }
+  return prefetch;
+}
+
+int Simulator::TakeForcings(ForcingPrefetch *prefetch) {
+  ForcingStep *step = prefetch->Next();
+  int retVal = 0;
+
+  // The files were read by the prefetch threads, what is left is reporting
+  // the missing ones as LoadForcings does
+  if (sModel) {
+    currentTempSimu = step->values[FORCING_TEMP];
+    if (step->missing[FORCING_TEMP]) {
+      NORMAL_LOGF(" Missing Temp file(%s%s%s)... Assuming zeros.",
+                  step->file[FORCING_TEMP], (!hasTempF) ? "" : "; ",
+                  step->fallbackFile[FORCING_TEMP]);
+    }
+  }
+
+  currentPrecipSimu = step->values[FORCING_PRECIP];
+  if (step->missing[FORCING_PRECIP]) {
+    NORMAL_LOGF(" Missing precip file(%s%s%s)... Assuming zeros.",
+                step->file[FORCING_PRECIP], (!hasQPF) ? "" : "; ",
+                step->fallbackFile[FORCING_PRECIP]);
+    if (inLR) {
+      missingQPF = missingQPF + 1;
+    } else {
+      missingQPE = missingQPE + 1;
+    }
+  } else if (step->usedFallback[FORCING_PRECIP]) {
+    retVal = 1;
+  }
+
+  currentPETSimu = step->values[FORCING_PET];
+  if (step->missing[FORCING_PET]) {
+    NORMAL_LOGF(" Missing PET file(%s)... Assuming zeros.",
+                step->file[FORCING_PET]);
+  }
+
+  return retVal;
+}
+
 void Simulator::SaveLP3Params() {
   char buffer[CONFIG_MAX_LEN * 2];
   std::vector<float> avgGrid, stdGrid, csGrid;
@@ -946,13 +1108,13 @@ void Simulator::SaveLP3Params() {
   }
 
   sprintf(buffer, "%s/avgq.%s.tif", outputPath, wbModel->GetName());
-  gridWriter.WriteGrid(&nodes, &avgGrid, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &avgGrid, buffer, false);
 
   sprintf(buffer, "%s/stdq.%s.tif", outputPath, wbModel->GetName());
-  gridWriter.WriteGrid(&nodes, &stdGrid, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &stdGrid, buffer, false);
 
   sprintf(buffer, "%s/sc.%s.tif", outputPath, wbModel->GetName());
-  gridWriter.WriteGrid(&nodes, &csGrid, buffer, false);
+  gridWriter.WriteGrid(&nodes, &cells, &csGrid, buffer, false);
 }
 
 void Simulator::SaveTSOutput() {
@@ -1074,7 +1236,7 @@ void Simulator::OutputCombinedOutput() {
   fclose(fp);
 }
 
-bool Simulator::ReadThresFile(char *file, std::vector<GridNode> *nodes,
+bool Simulator::ReadThresFile(char *file, std::vector<GridCell> *cells,
                               std::vector<float> *thresVals) {
   FloatGrid *grid = NULL;
 
@@ -1091,10 +1253,10 @@ bool Simulator::ReadThresFile(char *file, std::vector<GridNode> *nodes,
   if (g_DEM->IsSpatialMatch(grid)) {
     INFO_LOGF("Loading exact match threshold grid %s", file);
     // The grids are the same! Our life is easy!
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (grid->data[node->y][node->x] != grid->noData) {
-        thresVals->at(i) = grid->data[node->y][node->x];
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      if (grid->data[cell->y][cell->x] != grid->noData) {
+        thresVals->at(i) = grid->data[cell->y][cell->x];
       } else {
         thresVals->at(i) = 0;
       }
@@ -1102,13 +1264,13 @@ bool Simulator::ReadThresFile(char *file, std::vector<GridNode> *nodes,
 
   } else {
     INFO_LOGF("Threshold grids aren't an exact match so guessing! %s", file);
-    // The grids are different, we must do some resampling fun.
-    GridLoc pt;
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
-          grid->data[pt.y][pt.x] != grid->noData) {
-        thresVals->at(i) = grid->data[pt.y][pt.x];
+    // The grids are different, the cells take the values the sampling index
+    // points them to
+    SamplingIndex *index = GetSamplingIndex(cells, grid);
+    for (size_t i = 0; i < cells->size(); i++) {
+      int row = index->rows[i], col = index->cols[i];
+      if (row >= 0 && grid->data[row][col] != grid->noData) {
+        thresVals->at(i) = grid->data[row][col];
       } else {
         thresVals->at(i) = 0;
       }
@@ -1208,10 +1370,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     minorVals.resize(nodes.size());
     moderateVals.resize(nodes.size());
     majorVals.resize(nodes.size());
-    if (ReadThresFile(task->GetActionGrid(), &nodes, &actionVals) &&
-        ReadThresFile(task->GetMinorGrid(), &nodes, &minorVals) &&
-        ReadThresFile(task->GetModerateGrid(), &nodes, &moderateVals) &&
-        ReadThresFile(task->GetMajorGrid(), &nodes, &majorVals)) {
+    if (ReadThresFile(task->GetActionGrid(), &cells, &actionVals) &&
+        ReadThresFile(task->GetMinorGrid(), &cells, &minorVals) &&
+        ReadThresFile(task->GetModerateGrid(), &cells, &moderateVals) &&
+        ReadThresFile(task->GetMajorGrid(), &cells, &majorVals)) {
       outputThres = true;
 
       if (((griddedOutputs & OG_MAXTHRESP) == OG_MAXTHRESP) &&
@@ -1221,10 +1383,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
         minorSDVals.resize(nodes.size());
         moderateSDVals.resize(nodes.size());
         majorSDVals.resize(nodes.size());
-        if (ReadThresFile(task->GetActionSDGrid(), &nodes, &actionSDVals) &&
-            ReadThresFile(task->GetMinorSDGrid(), &nodes, &minorSDVals) &&
-            ReadThresFile(task->GetModerateSDGrid(), &nodes, &moderateSDVals) &&
-            ReadThresFile(task->GetMajorSDGrid(), &nodes, &majorSDVals)) {
+        if (ReadThresFile(task->GetActionSDGrid(), &cells, &actionSDVals) &&
+            ReadThresFile(task->GetMinorSDGrid(), &cells, &minorSDVals) &&
+            ReadThresFile(task->GetModerateSDGrid(), &cells, &moderateSDVals) &&
+            ReadThresFile(task->GetMajorSDGrid(), &cells, &majorSDVals)) {
           outputThresP = true;
           for (size_t i = 0; i < currentFF.size(); i++) {
             actionSDVals[i] = 3.67 * nodes[i].contribArea;
@@ -1247,18 +1409,24 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
 
   // Initialize our models
   // NORMAL_LOGF("%s\n", "Got here!4");
-  wbModel->InitializeModel(&nodes, &fullParamSettings, &paramGrids);
+  wbModel->InitializeModel(&nodes, &cells, &fullParamSettings, &paramGrids);
   //	NORMAL_LOGF("%s\n", "Got here!5");
   if (rModel) {
-    rModel->InitializeModel(&nodes, &fullParamSettingsRoute, &paramGridsRoute);
+    rModel->InitializeModel(&nodes, &cells, &fullParamSettingsRoute,
+                            &paramGridsRoute);
+    rModel->PrepareTimeStep(timeStepSR->GetTimeInSec() / 3600.0f);
+    if (timeStepLR) {
+      rModel->PrepareTimeStep(timeStepLR->GetTimeInSec() / 3600.0f);
+    }
   }
   //	NORMAL_LOGF("%s\n", "Got here!6");
   if (sModel) {
     currentPrecipSnow.resize(currentPrecipSimu.size());
-    sModel->InitializeModel(&nodes, &fullParamSettingsSnow, &paramGridsSnow);
+    sModel->InitializeModel(&nodes, &cells, &fullParamSettingsSnow,
+                            &paramGridsSnow);
   }
   if (iModel) {
-    iModel->InitializeModel(&nodes, &fullParamSettingsInundation,
+    iModel->InitializeModel(&nodes, &cells, &fullParamSettingsInundation,
                             &paramGridsInundation);
   }
   if (griddedOutputs != OG_NONE || trackPeaks || outputRP || saveStates) {
@@ -1312,6 +1480,79 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     currentQ[i] = 0.0;
   }
 
+  // With the forcings preloaded the water balance can run a block of steps
+  // at a time. A block has to end at a step whose states are saved and where
+  // the step length changes.
+  RunoffBlock runoffBlock;
+  bool blockedWB = false;
+  if (wbBlockSteps > 1) {
+    if (preloadedForcings && !sModel) {
+      blockedWB = true;
+      runoffBlock.numSteps = 0;
+      TimeVar blockTime = currentTime;
+      TimeUnit *blockTimeStep = timeStep;
+      bool blockInLR = inLR;
+      size_t blockIndex = 0;
+      for (blockTime.Increment(blockTimeStep); blockTime <= endTime;
+           blockTime.Increment(blockTimeStep)) {
+        blockIndex++;
+        if (saveStates && stateTime == blockTime) {
+          runoffBlock.breaks.push_back(blockIndex);
+        }
+        if (timeStepLR && !blockInLR && beginLRTime <= blockTime) {
+          blockInLR = true;
+          blockTimeStep = timeStepLR;
+          runoffBlock.breaks.push_back(blockIndex);
+        }
+      }
+    } else {
+      WARNING_LOGF("%s", "Water balance blocks need preloaded forcings and no "
+                         "snow model, running one step at a time");
+    }
+  }
+
+  // The common model combinations run through an engine built for them,
+  // the rest go through the model interfaces
+  SimEngineBase *engine = NewSimEngine(task, wbModel, rModel, sModel);
+
+  // A fused sweep runs the water balance of each sub-tree right before
+  // routing it and takes the gauge averages along the way
+  bool fusedSweep = false;
+  if (task->UseFusedSweep()) {
+    if (engine && engine->CanSweep() && !blockedWB && !wantsDA) {
+      fusedSweep = true;
+      std::vector<float> *sweepAvgs[SWEEP_AVG_QTY] = {NULL};
+      if (outputTS) {
+        sweepAvgs[SWEEP_AVG_FASTFLOW] = &avgFF;
+        sweepAvgs[SWEEP_AVG_SLOWFLOW] = &avgSF;
+        sweepAvgs[SWEEP_AVG_SOILMOISTURE] = &avgSM;
+        sweepAvgs[SWEEP_AVG_PRECIP] = &avgPrecip;
+        sweepAvgs[SWEEP_AVG_PET] = &avgPET;
+        if (sModel) {
+          sweepAvgs[SWEEP_AVG_SWE] = &avgSWE;
+          sweepAvgs[SWEEP_AVG_TEMP] = &avgT;
+        }
+      }
+      engine->SetGaugeAverages(&gaugeMap, &cells, sweepAvgs);
+    } else {
+      WARNING_LOGF("%s", "A fused sweep needs a CREST, SAC or HP water "
+                         "balance with routing, no water balance blocks, data "
+                         "assimilation or kinematic wave active set, running "
+                         "the models one after the other");
+    }
+  }
+
+  // Reader threads load the forcings of the coming steps while the models
+  // run this one
+  ForcingPrefetch *prefetch = NULL;
+  if (prefetchSteps > 0 && !preloadedForcings) {
+    prefetch = StartPrefetch(prefetchSteps);
+    if (!prefetch) {
+      WARNING_LOGF("%s", "Could not start the forcing prefetch threads, "
+                         "reading the forcings at each step");
+    }
+  }
+
 #if _OPENMP
   double timeTotal = 0.0, timeCount = 0.0;
   double simStartTime = omp_get_wtime();
@@ -1335,38 +1576,76 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
 
     int qpf = 0;
     if (!preloadedForcings) {
-      qpf = LoadForcings(&precipReader, &petReader, &tempReader);
+      if (prefetch) {
+        qpf = TakeForcings(prefetch);
+      } else {
+        qpf = LoadForcings(&precipReader, &petReader, &tempReader);
+      }
       currentPrecip = &currentPrecipSimu;
     }
 
     float stepHoursReal = timeStep->GetTimeInSec() / 3600.0f;
+    float jday = (float)currentTime.GetTM()->tm_yday;
 
-    if (sModel) {
+    // Integrate the models for this timestep
+    if (fusedSweep) {
       if (preloadedForcings) {
-        sModel->SnowBalance((float)currentTime.GetTM()->tm_yday, stepHoursReal,
-                            &(currentPrecipCali[tsIndex]),
-                            &(currentTempCali[tsIndex]),
-                            &(currentPrecipCali[tsIndex]), &currentSWE);
+        engine->Sweep(jday, stepHoursReal, &(currentPrecipCali[tsIndex]),
+                      &(currentTempCali[tsIndex]), &(currentPETCali[tsIndex]),
+                      &(currentPrecipCali[tsIndex]), &currentSWE, &currentFF,
+                      &currentSF, &SM, &currentQ);
       } else {
-        sModel->SnowBalance((float)currentTime.GetTM()->tm_yday, stepHoursReal,
-                            currentPrecip, &currentTempSimu, &currentPrecipSnow,
-                            &currentSWE);
-        currentPrecip = &currentPrecipSnow;
+        engine->Sweep(jday, stepHoursReal, currentPrecip, &currentTempSimu,
+                      &currentPETSimu, &currentPrecipSnow, &currentSWE,
+                      &currentFF, &currentSF, &SM, &currentQ);
+        if (sModel) {
+          currentPrecip = &currentPrecipSnow;
+        }
+      }
+    } else if (engine && !blockedWB) {
+      if (preloadedForcings) {
+        engine->Balance(jday, stepHoursReal, &(currentPrecipCali[tsIndex]),
+                        &(currentTempCali[tsIndex]), &(currentPETCali[tsIndex]),
+                        &(currentPrecipCali[tsIndex]), &currentSWE,
+                        &currentFF, &currentSF, &SM);
+      } else {
+        engine->Balance(jday, stepHoursReal, currentPrecip, &currentTempSimu,
+                        &currentPETSimu, &currentPrecipSnow, &currentSWE,
+                        &currentFF, &currentSF, &SM);
+        if (sModel) {
+          currentPrecip = &currentPrecipSnow;
+        }
+      }
+    } else {
+      if (sModel) {
+        if (preloadedForcings) {
+          sModel->SnowBalance(jday, stepHoursReal,
+                              &(currentPrecipCali[tsIndex]),
+                              &(currentTempCali[tsIndex]),
+                              &(currentPrecipCali[tsIndex]), &currentSWE);
+        } else {
+          sModel->SnowBalance(jday, stepHoursReal, currentPrecip,
+                              &currentTempSimu, &currentPrecipSnow,
+                              &currentSWE);
+          currentPrecip = &currentPrecipSnow;
+        }
       }
-    }
 
-    // Integrate the models for this timestep
-    if (!preloadedForcings) {
-      wbModel->WaterBalance(stepHoursReal, currentPrecip, &currentPETSimu,
+      if (!preloadedForcings) {
+        wbModel->WaterBalance(stepHoursReal, currentPrecip, &currentPETSimu,
+                              &currentFF, &currentSF, &SM);
+      } else if (blockedWB) {
+        BlockedWaterBalance(wbModel, &runoffBlock, tsIndex, stepHoursReal,
                             &currentFF, &currentSF, &SM);
-    } else {
-      wbModel->WaterBalance(stepHoursReal, &(currentPrecipCali[tsIndex]),
-                            &(currentPETCali[tsIndex]), &currentFF, &currentSF,
-                            &SM);
+      } else {
+        wbModel->WaterBalance(stepHoursReal, &(currentPrecipCali[tsIndex]),
+                              &(currentPETCali[tsIndex]), &currentFF,
+                              &currentSF, &SM);
+      }
     }
-    if (outputTS) {
-      gaugeMap.GaugeAverage(&nodes, &currentFF, &avgFF);
-      gaugeMap.GaugeAverage(&nodes, &currentSF, &avgSF);
+    if (outputTS && !fusedSweep) {
+      gaugeMap.GaugeAverage(&cells, &currentFF, &avgFF);
+      gaugeMap.GaugeAverage(&cells, &currentSF, &avgSF);
     }
 
     if (rModel && wantsDA) {
@@ -1378,13 +1657,27 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       double beginTimeR = omp_get_wtime();
 #endif
 #endif
-      rModel->Route(stepHoursReal, &currentFF, &currentSF, &currentQ);
+      // A fused sweep has already routed the step
+      if (!engine) {
+        rModel->Route(stepHoursReal, &currentFF, &currentSF, &currentQ);
+      } else if (!fusedSweep) {
+        engine->Route(stepHoursReal, &currentFF, &currentSF, &currentQ);
+      }
 #if _OPENMP
 #ifndef _WIN32
       double endTimeR = omp_get_wtime();
       NORMAL_LOGF(" %f routing sec", endTimeR - beginTimeR);
 #endif
 #endif
+      if (task->GetRouting() == ROUTE_KINEMATIC &&
+          task->GetKWSolver() == KW_SOLVER_WARMSTART) {
+        NORMAL_LOGF(" %.2f kw iterations",
+                    static_cast<KWRoute *>(rModel)->GetMeanIterations());
+      }
+      if (task->GetRouting() == ROUTE_KINEMATIC && task->UseKWActiveSet()) {
+        NORMAL_LOGF(" %.1f%% kw cells active",
+                    100.0 * static_cast<KWRoute *>(rModel)->GetActiveFraction());
+      }
     } else {
       for (size_t i = 0; i < currentFF.size(); i++) {
         currentFF[i] = 0.0;
@@ -1422,26 +1715,27 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
         indexYear++;
       }
 
-      if (outputTS) {
-        gaugeMap.GaugeAverage(&nodes, &SM, &avgSM);
+      if (outputTS && !fusedSweep) {
+        gaugeMap.GaugeAverage(&cells, &SM, &avgSM);
         if (!preloadedForcings) {
-          gaugeMap.GaugeAverage(&nodes, currentPrecip, &avgPrecip);
-          gaugeMap.GaugeAverage(&nodes, &currentPETSimu, &avgPET);
+          gaugeMap.GaugeAverage(&cells, currentPrecip, &avgPrecip);
+          gaugeMap.GaugeAverage(&cells, &currentPETSimu, &avgPET);
         } else {
-          gaugeMap.GaugeAverage(&nodes, &(currentPrecipCali[tsIndex]),
+          gaugeMap.GaugeAverage(&cells, &(currentPrecipCali[tsIndex]),
                                 &avgPrecip);
-          gaugeMap.GaugeAverage(&nodes, &(currentPETCali[tsIndex]), &avgPET);
+          gaugeMap.GaugeAverage(&cells, &(currentPETCali[tsIndex]), &avgPET);
         }
 
         if (sModel) {
-          gaugeMap.GaugeAverage(&nodes, &currentSWE, &avgSWE);
+          gaugeMap.GaugeAverage(&cells, &currentSWE, &avgSWE);
           if (!preloadedForcings) {
-            gaugeMap.GaugeAverage(&nodes, &currentTempSimu, &avgT);
+            gaugeMap.GaugeAverage(&cells, &currentTempSimu, &avgT);
           } else {
-            gaugeMap.GaugeAverage(&nodes, &(currentTempCali[tsIndex]), &avgT);
+            gaugeMap.GaugeAverage(&cells, &(currentTempCali[tsIndex]), &avgT);
           }
         }
-
+      }
+      if (outputTS) {
         // Write the output to file
         SaveTSOutput();
       }
@@ -1486,43 +1780,43 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
           float val = floorf(currentQ[i] * 10.0f + 0.5f) / 10.0f;
           currentDepth[i] = val;
         }
-        gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
       }
       if ((griddedOutputs & OG_SM) == OG_SM) {
         sprintf(buffer, "%s/sm.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &SM, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &SM, buffer, false);
       }
       if (outputRP && ((griddedOutputs & OG_QRP) == OG_QRP)) {
         sprintf(buffer, "%s/rp.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &rpGrid, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &rpGrid, buffer, false);
       }
       if ((griddedOutputs & OG_PRECIP) == OG_PRECIP) {
         sprintf(buffer, "%s/precip.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentPrecipSimu, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentPrecipSimu, buffer, false);
       }
       if ((griddedOutputs & OG_PET) == OG_PET) {
         sprintf(buffer, "%s/pet.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentPETSimu, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentPETSimu, buffer, false);
       }
       if (sModel && (griddedOutputs & OG_SWE) == OG_SWE) {
         sprintf(buffer, "%s/swe.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentSWE, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentSWE, buffer, false);
       }
       if (sModel && (griddedOutputs & OG_TEMP) == OG_TEMP) {
         sprintf(buffer, "%s/temp.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentTempSimu, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentTempSimu, buffer, false);
       }
       if (iModel && (griddedOutputs & OG_DEPTH) == OG_DEPTH) {
         iModel->Inundation(&currentQ, &currentDepth);
         sprintf(buffer, "%s/depth.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), iModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
       }
       if ((griddedOutputs & OG_UNITQ) == OG_UNITQ) {
         for (size_t i = 0; i < currentQ.size(); i++) {
@@ -1532,7 +1826,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
         }
         sprintf(buffer, "%s/unitq.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
       }
       if (outputThres && (griddedOutputs & OG_THRES) == OG_THRES) {
         for (size_t i = 0; i < currentQ.size(); i++) {
@@ -1542,7 +1836,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
         }
         sprintf(buffer, "%s/thres.%s.%s.tif", outputPath,
                 currentTimeTextOutput.GetName(), wbModel->GetName());
-        gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+        gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
       }
     }
 
@@ -1591,10 +1885,10 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       float val = floorf(rpMaxGrid[i] + 0.5f);
       rpMaxGrid[i] = val;
     }
-    gridWriter.WriteGrid(&nodes, &rpMaxGrid, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &rpMaxGrid, buffer, false);
 
     // sprintf(buffer, "%s/qmax.%s.asc", outputPath, model->GetName());
-    // gridWriter.WriteGrid(&nodes, &maxGrid, buffer);
+    // gridWriter.WriteGrid(&nodes, &cells, &maxGrid, buffer);
   }
 
   if ((griddedOutputs & OG_MAXSM) == OG_MAXSM) {
@@ -1605,7 +1899,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       float val = floorf(SM[i] + 0.5f);
       SM[i] = val;
     }
-    gridWriter.WriteGrid(&nodes, &SM, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &SM, buffer, false);
   }
 
   if ((griddedOutputs & OG_MAXQ) == OG_MAXQ) {
@@ -1616,14 +1910,14 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
       float val = floorf(maxGrid[i] * 10.0f + 0.5f) / 10.0f;
       currentDepth[i] = val;
     }
-    gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
   }
 
   if (sModel && (griddedOutputs & OG_MAXSWE) == OG_MAXSWE) {
     sprintf(buffer, "%s/maxswe.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &currentSWE, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &currentSWE, buffer, false);
   }
 
   if ((griddedOutputs & OG_MAXUNITQ) == OG_MAXUNITQ) {
@@ -1635,7 +1929,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     sprintf(buffer, "%s/maxunitq.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
   }
 
   if (outputThres && (griddedOutputs & OG_MAXTHRES) == OG_MAXTHRES) {
@@ -1653,7 +1947,7 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     sprintf(buffer, "%s/maxthres.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
   }
 
   if (outputThresP && (griddedOutputs & OG_MAXTHRESP) == OG_MAXTHRESP) {
@@ -1670,20 +1964,28 @@ void Simulator::SimulateDistributed(bool trackPeaks) {
     sprintf(buffer, "%s/maxthresp.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &currentDepth, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &currentDepth, buffer, false);
   }
 
   if (savePrecip) {
     sprintf(buffer, "%s/qpeaccum.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &qpeAccum, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &qpeAccum, buffer, false);
     sprintf(buffer, "%s/qpfaccum.%04i%02i%02i.%02i%02i%02i.tif", outputPath,
             ctWE->tm_year + 1900, ctWE->tm_mon + 1, ctWE->tm_mday,
             ctWE->tm_hour, ctWE->tm_min, ctWE->tm_sec);
-    gridWriter.WriteGrid(&nodes, &qpfAccum, buffer, false);
+    gridWriter.WriteGrid(&nodes, &cells, &qpfAccum, buffer, false);
   }
 
+  delete engine;
+  delete prefetch;
+
+  unsigned long gridsAllocated, gridsReused;
+  GetGridPoolStats(&gridsAllocated, &gridsReused);
+  DEBUG_LOGF("Forcing grids allocated %lu, reused %lu", gridsAllocated,
+             gridsReused);
+
 #if _OPENMP
   double simEndTime = omp_get_wtime();
   double timeDiff = simEndTime - simStartTime;
@@ -1710,7 +2012,8 @@ void Simulator::SimulateLumped() {
   SM.resize(currentFF.size());
 
   // Initialize our model
-  wbModel->InitializeModel(&lumpedNodes, &fullParamSettings, &paramGrids);
+  wbModel->InitializeModel(&lumpedNodes, &lumpedCells, &fullParamSettings,
+                           &paramGrids);
 
   // This is the temporal loop for each time step
   // Here we load the input forcings & actually run the model
@@ -1733,13 +2036,13 @@ void Simulator::SimulateLumped() {
       petFile->UpdateName(currentTimePET.GetTM());
 
       sprintf(buffer, "%s/%s", precipSec->GetLoc(), precipFile->GetName());
-      if (!precipReader.Read(buffer, precipSec->GetType(), &nodes,
+      if (!precipReader.Read(buffer, precipSec->GetType(), &cells,
                              &currentPrecipSimu, precipConvert)) {
         printf(" Missing precip file(%s)... Assuming zeros.", buffer);
       }
 
       sprintf(buffer, "%s/%s", petSec->GetLoc(), petFile->GetName());
-      if (!petReader.Read(buffer, petSec->GetType(), &nodes, &currentPETSimu,
+      if (!petReader.Read(buffer, petSec->GetType(), &cells, &currentPETSimu,
                           petConvert, petSec->IsTemperature(),
                           (float)currentTime.GetTM()->tm_yday)) {
         printf(" Missing PET file(%s)... Assuming zeros.", buffer);
@@ -1747,8 +2050,8 @@ void Simulator::SimulateLumped() {
     }
 
     if (!preloadedForcings) {
-      gaugeMap.GaugeAverage(&nodes, &currentPrecipSimu, &avgPrecip);
-      gaugeMap.GaugeAverage(&nodes, &currentPETSimu, &avgPET);
+      gaugeMap.GaugeAverage(&cells, &currentPrecipSimu, &avgPrecip);
+      gaugeMap.GaugeAverage(&cells, &currentPETSimu, &avgPET);
 
       wbModel->WaterBalance(timeStepHours, &avgPrecip, &avgPET, &currentFF,
                             &currentSF, &SM);
@@ -1766,7 +2069,7 @@ void Simulator::SimulateLumped() {
         if (gaugeOutputs[i]) {
           float discharge = (currentFF[gauge->GetGridNodeIndex()] +
                              currentSF[gauge->GetGridNodeIndex()]) *
-                            nodes[gauge->GetGridNodeIndex()].area / 3.6;
+                            cells[gauge->GetGridNodeIndex()].area / 3.6;
           if (!preloadedForcings) {
             fprintf(gaugeOutputs[i], "%s,%.2f,%.2f,%.2f,%.2f\n",
                     currentTimeText.GetName(), discharge,
@@ -1866,11 +2169,11 @@ void Simulator::PreloadForcings(char *file, bool cali) {
       } else {
         vecPrev = NULL;
       }
-      if (!precipReader.Read(buffer, precipSec->GetType(), &nodes, &readVec,
+      if (!precipReader.Read(buffer, precipSec->GetType(), &cells, &readVec,
                              precipConvert, vecPrev)) {
         NORMAL_LOGF("Missing precip file(%s)... Assuming zeros.\n", buffer);
       }
-      gaugeMap.GaugeAverage(&nodes, &readVec, vec);
+      gaugeMap.GaugeAverage(&cells, &readVec, vec);
 
       sprintf(buffer, "%s/%s", petSec->GetLoc(), petFile->GetName());
       vec = &(currentPETCali[tsIndex]);
@@ -1879,12 +2182,12 @@ void Simulator::PreloadForcings(char *file, bool cali) {
       } else {
         vecPrev = NULL;
       }
-      if (!petReader.Read(buffer, petSec->GetType(), &nodes, &readVec,
+      if (!petReader.Read(buffer, petSec->GetType(), &cells, &readVec,
                           petConvert, petSec->IsTemperature(),
                           currentTime.GetTM()->tm_yday, vecPrev)) {
         NORMAL_LOGF("Missing PET file(%s)... Assuming zeros.\n", buffer);
       }
-      gaugeMap.GaugeAverage(&nodes, &readVec, vec);
+      gaugeMap.GaugeAverage(&cells, &readVec, vec);
     } else {
       std::vector<float> *vec, *vecPrev;
 
@@ -1895,7 +2198,7 @@ void Simulator::PreloadForcings(char *file, bool cali) {
       } else {
         vecPrev = NULL;
       }
-      if (!precipReader.Read(buffer, precipSec->GetType(), &nodes, vec,
+      if (!precipReader.Read(buffer, precipSec->GetType(), &cells, vec,
                              precipConvert, vecPrev)) {
         NORMAL_LOGF("Missing precip file(%s)... Assuming zeros.\n", buffer);
       }
@@ -1907,7 +2210,7 @@ void Simulator::PreloadForcings(char *file, bool cali) {
       } else {
         vecPrev = NULL;
       }
-      if (!petReader.Read(buffer, petSec->GetType(), &nodes, vec, petConvert,
+      if (!petReader.Read(buffer, petSec->GetType(), &cells, vec, petConvert,
                           petSec->IsTemperature(), currentTime.GetTM()->tm_yday,
                           vecPrev)) {
         NORMAL_LOGF("Missing PET file(%s)... Assuming zeros.\n", buffer);
@@ -1921,7 +2224,7 @@ void Simulator::PreloadForcings(char *file, bool cali) {
         } else {
           vecPrev = NULL;
         }
-        if (!tempReader.Read(buffer, tempSec->GetType(), &nodes, vec,
+        if (!tempReader.Read(buffer, tempSec->GetType(), &cells, vec,
                              vecPrev)) {
           NORMAL_LOGF("Missing Temp file(%s)... Assuming zeros.\n", buffer);
         }
@@ -2049,8 +2352,10 @@ float Simulator::SimulateForCali(float *testParams) {
   std::map<GaugeConfigSection *, float *> *currentRParamSettings;
   std::map<GaugeConfigSection *, float *> *currentSParamSettings;
   float *currentWBParams, *currentRParams, *currentSParams;
+  RunoffBlock *runoffBlock;
 #if _OPENMP
   int thread = omp_get_thread_num();
+  runoffBlock = &(caliBlocks[thread]);
   runModel = caliWBModels[thread];
   runRoutingModel = caliRModels[thread];
   runSnowModel = caliSModels[thread];
@@ -2070,7 +2375,11 @@ float Simulator::SimulateForCali(float *testParams) {
   currentWBParams = caliWBParams;
   currentRParams = caliRParams;
   currentSParams = caliSParams;
+  runoffBlock = &(caliBlocks[0]);
 #endif
+  runoffBlock->numSteps = 0;
+  bool blockedWB =
+      (wbBlockSteps > 1 && !runSnowModel && !runModel->IsLumped());
 
   memcpy(currentWBParams, testParams, sizeof(float) * numWBParams);
   memcpy(currentRParams, testParams + numWBParams, sizeof(float) * numRParams);
@@ -2079,17 +2388,22 @@ float Simulator::SimulateForCali(float *testParams) {
 
   // Initialize our model
   if (!runModel->IsLumped()) {
-    runModel->InitializeModel(&nodes, currentWBParamSettings, &paramGrids);
-  } else {
-    runModel->InitializeModel(&lumpedNodes, currentWBParamSettings,
+    runModel->InitializeModel(&nodes, &cells, currentWBParamSettings,
                               &paramGrids);
+  } else {
+    runModel->InitializeModel(&lumpedNodes, &lumpedCells,
+                              currentWBParamSettings, &paramGrids);
   }
 
-  runRoutingModel->InitializeModel(&nodes, currentRParamSettings,
+  runRoutingModel->InitializeModel(&nodes, &cells, currentRParamSettings,
                                    &paramGridsRoute);
+  runRoutingModel->PrepareTimeStep(timeStepSR->GetTimeInSec() / 3600.0f);
+  if (timeStepLR) {
+    runRoutingModel->PrepareTimeStep(timeStepLR->GetTimeInSec() / 3600.0f);
+  }
 
   if (runSnowModel) {
-    runSnowModel->InitializeModel(&nodes, currentSParamSettings,
+    runSnowModel->InitializeModel(&nodes, &cells, currentSParamSettings,
                                   &paramGridsSnow);
   }
 
@@ -2122,12 +2436,17 @@ float Simulator::SimulateForCali(float *testParams) {
       precipVec = &currentPrecipSnow;
     }
     /*if (tsIndex == 0) {
-     gaugeMap.GaugeAverage(&nodes, precipVec, &avgPrecip);
-     gaugeMap.GaugeAverage(&nodes, petVec, &avgPET);
+     gaugeMap.GaugeAverage(&cells, precipVec, &avgPrecip);
+     gaugeMap.GaugeAverage(&cells, petVec, &avgPET);
      printf("%f %f\n", precipVec->at(300), petVec->at(300));
      }*/
-    runModel->WaterBalance(timeStepHours, precipVec, petVec, &currentFFCali,
-                           &currentSFCali, &SMCali);
+    if (blockedWB) {
+      BlockedWaterBalance(runModel, runoffBlock, tsIndex, timeStepHours,
+                          &currentFFCali, &currentSFCali, NULL);
+    } else {
+      runModel->WaterBalance(timeStepHours, precipVec, petVec, &currentFFCali,
+                             &currentSFCali, &SMCali);
+    }
 
     runRoutingModel->Route(timeStepHours, &currentFFCali, &currentSFCali,
                            &currentQCali);
@@ -2154,6 +2473,176 @@ float Simulator::SimulateForCali(float *testParams) {
   // return CalcObjFunc(&obsQ, &simQCali, objectiveFunc);
 }
 
+void Simulator::SimulateForCaliSets(int numSets, float **testParams,
+                                    float *skills) {
+  int numDone = 0;
+  while (caliUseSets && numDone < numSets) {
+    int count = numSets - numDone;
+    if (count > CALI_SET_BATCH) {
+      count = CALI_SET_BATCH;
+    }
+    if (!SimulateForCaliBatch(count, &(testParams[numDone]),
+                              &(skills[numDone]))) {
+      // The water balance model has no parameter set batches
+      caliUseSets = false;
+      break;
+    }
+    numDone += count;
+  }
+
+  // Anything left over is run one parameter set per thread
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (int s = numDone; s < numSets; s++) {
+    skills[s] = SimulateForCali(testParams[s]);
+  }
+}
+
+bool Simulator::SimulateForCaliBatch(int numSets, float **testParams,
+                                     float *skills) {
+
+  for (int s = 0; s < numSets; s++) {
+    memcpy(caliSetWBCurrentParams[s], testParams[s],
+           sizeof(float) * numWBParams);
+    memcpy(caliSetRCurrentParams[s], testParams[s] + numWBParams,
+           sizeof(float) * numRParams);
+  }
+
+  // Initialize our models
+  if (!caliSetWBModel->InitializeSets(&nodes, &cells, numSets,
+                                      &(caliSetWBFullParamSettings[0]),
+                                      &paramGrids)) {
+    return false;
+  }
+
+  std::vector<std::vector<float> > currentFFSets(numSets),
+      currentSFSets(numSets), currentQSets(numSets), simQSets(numSets);
+  for (int s = 0; s < numSets; s++) {
+    RoutingModel *runRoutingModel = caliSetRModels[s];
+    runRoutingModel->InitializeModel(&nodes, &cells,
+                                     &(caliSetRFullParamSettings[s]),
+                                     &paramGridsRoute);
+    runRoutingModel->PrepareTimeStep(timeStepSR->GetTimeInSec() / 3600.0f);
+    if (timeStepLR) {
+      runRoutingModel->PrepareTimeStep(timeStepLR->GetTimeInSec() / 3600.0f);
+    }
+    currentFFSets[s].resize(currentFF.size());
+    currentSFSets[s].resize(currentFF.size());
+    currentQSets[s].resize(currentFF.size());
+    simQSets[s].resize(simQ.size());
+  }
+
+  // This is the temporal loop for each time step
+  // Here we actually run the model
+  size_t tsIndex = 0, tsIndexWarm = 0;
+  size_t caliNode = caliGauge->GetGridNodeIndex();
+  TimeVar currentTimeCali = beginTime;
+
+  for (currentTimeCali.Increment(timeStep); currentTimeCali <= endTime;
+       currentTimeCali.Increment(timeStep)) {
+
+    caliSetWBModel->WaterBalanceSets(
+        timeStepHours, &(currentPrecipCali[tsIndex]),
+        &(currentPETCali[tsIndex]), &(currentFFSets[0]), &(currentSFSets[0]));
+
+    // Every set is routed by its own model so they can go in parallel
+    bool pastWarm = (warmEndTime <= currentTimeCali);
+#if _OPENMP
+#pragma omp parallel for
+#endif
+    for (int s = 0; s < numSets; s++) {
+      caliSetRModels[s]->Route(timeStepHours, &(currentFFSets[s]),
+                               &(currentSFSets[s]), &(currentQSets[s]));
+      if (pastWarm) {
+        simQSets[s][tsIndexWarm] = currentQSets[s][caliNode];
+      }
+    }
+
+    if (pastWarm) {
+      tsIndexWarm++;
+    }
+    tsIndex++;
+  }
+
+  for (int s = 0; s < numSets; s++) {
+    skills[s] = CalcObjFunc(&obsQ, &(simQSets[s]), objectiveFunc);
+  }
+
+  return true;
+}
+
+void Simulator::BlockedWaterBalance(WaterBalanceModel *model,
+                                    RunoffBlock *block, size_t tsIndex,
+                                    float stepHours,
+                                    std::vector<float> *fastFlow,
+                                    std::vector<float> *slowFlow,
+                                    std::vector<float> *soilMoisture) {
+
+  long numNodes = (long)fastFlow->size();
+
+  if (block->numSteps == 0 || tsIndex < block->firstStep ||
+      tsIndex >= block->firstStep + block->numSteps) {
+    // Run the water balance for the steps up to the end of the next block
+    size_t numSteps = currentPrecipCali.size() - tsIndex;
+    if (numSteps > (size_t)wbBlockSteps) {
+      numSteps = wbBlockSteps;
+    }
+    for (size_t i = 0; i < block->breaks.size(); i++) {
+      if (block->breaks[i] > tsIndex &&
+          block->breaks[i] - tsIndex < numSteps) {
+        numSteps = block->breaks[i] - tsIndex;
+      }
+    }
+    if (block->fastFlow.size() < numSteps) {
+      block->fastFlow.resize(wbBlockSteps);
+      block->slowFlow.resize(wbBlockSteps);
+      for (int k = 0; k < wbBlockSteps; k++) {
+        block->fastFlow[k].resize(numNodes);
+        block->slowFlow[k].resize(numNodes);
+      }
+    }
+    if (soilMoisture && block->soilMoisture.size() < numSteps) {
+      block->soilMoisture.resize(wbBlockSteps);
+      for (int k = 0; k < wbBlockSteps; k++) {
+        block->soilMoisture[k].resize(numNodes);
+      }
+    }
+    model->WaterBalanceBlock(stepHours, (int)numSteps,
+                             &(currentPrecipCali[tsIndex]),
+                             &(currentPETCali[tsIndex]), &(block->fastFlow[0]),
+                             &(block->slowFlow[0]),
+                             (soilMoisture) ? &(block->soilMoisture[0]) : NULL);
+    block->firstStep = tsIndex;
+    block->numSteps = numSteps;
+  }
+
+  // Add this step's runoff to what the routing left behind, as WaterBalance
+  // would have done
+  size_t k = tsIndex - block->firstStep;
+  const double *fastIn = &(block->fastFlow[k][0]);
+  const double *slowIn = &(block->slowFlow[k][0]);
+  float *fastOut = &(fastFlow->at(0));
+  float *slowOut = &(slowFlow->at(0));
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long i = 0; i < numNodes; i++) {
+    fastOut[i] += fastIn[i];
+    slowOut[i] += slowIn[i];
+  }
+  if (soilMoisture) {
+    const float *smIn = &(block->soilMoisture[k][0]);
+    float *smOut = &(soilMoisture->at(0));
+#if _OPENMP
+#pragma omp parallel for
+#endif
+    for (long i = 0; i < numNodes; i++) {
+      smOut[i] = smIn[i];
+    }
+  }
+}
+
 float *Simulator::SimulateForCaliTS(float *testParams) {
 
   WaterBalanceModel *runModel;
@@ -2177,9 +2666,11 @@ float *Simulator::SimulateForCaliTS(float *testParams) {
 
   // Initialize our model
   if (!runModel->IsLumped()) {
-    runModel->InitializeModel(&nodes, currentParamSettings, &paramGrids);
+    runModel->InitializeModel(&nodes, &cells, currentParamSettings,
+                              &paramGrids);
   } else {
-    runModel->InitializeModel(&lumpedNodes, currentParamSettings, &paramGrids);
+    runModel->InitializeModel(&lumpedNodes, &lumpedCells, currentParamSettings,
+                              &paramGrids);
   }
 
   currentFFCali.resize(currentFF.size());
@@ -1,6 +1,7 @@
 #ifndef SIMULATOR_H
 #define SIMULATOR_H
 
+#include "ForcingPrefetch.h"
 #include "GaugeConfigSection.h"
 #include "GaugeMap.h"
 #include "GridNode.h"
@@ -15,6 +16,19 @@
 #include "TempConfigSection.h"
 #include "TempReader.h"
 
+// Largest number of parameter sets SimulateForCaliSets runs together
+#define CALI_SET_BATCH 16
+
+// Runoff from a block of water balance steps that were run together, waiting
+// to be routed one step at a time
+struct RunoffBlock {
+  size_t firstStep, numSteps;
+  // Steps a block has to start at, such as where the step length changes
+  std::vector<size_t> breaks;
+  std::vector<std::vector<double> > fastFlow, slowFlow;
+  std::vector<std::vector<float> > soilMoisture;
+};
+
 class Simulator {
 public:
   bool Initialize(TaskConfigSection *taskN);
@@ -26,6 +40,11 @@ public:
   void BasinAvg();
   void Simulate(bool trackPeaks = false);
   float SimulateForCali(float *testParams);
+  // Sets skills[s] to SimulateForCali(testParams[s]) for numSets parameter
+  // sets. Sets are run CALI_SET_BATCH at a time through the water balance
+  // model's parameter set batches when it has them, otherwise they are run
+  // in parallel one set per thread.
+  void SimulateForCaliSets(int numSets, float **testParams, float *skills);
   float *SimulateForCaliTS(float *testParams);
   float *GetObsTS();
   size_t GetNumSteps() { return totalTimeStepsOutsideWarm; }
@@ -35,13 +54,30 @@ private:
   bool InitializeSimu(TaskConfigSection *task);
   bool InitializeCali(TaskConfigSection *task);
   bool InitializeGridParams(TaskConfigSection *task);
+  WaterBalanceModel *NewWaterBalanceModel(TaskConfigSection *task);
+  RoutingModel *NewRoutingModel(TaskConfigSection *task);
+  SnowModel *NewSnowModel(TaskConfigSection *task);
+  void ReplaceCaliParams(std::map<GaugeConfigSection *, float *> *fullSettings,
+                         float *caliParams, float *currentParams,
+                         std::map<GaugeConfigSection *, float *> *settings);
+  bool SimulateForCaliBatch(int numSets, float **testParams, float *skills);
 
   void SimulateDistributed(bool trackPeaks);
   void SimulateLumped();
+  void BlockedWaterBalance(WaterBalanceModel *model, RunoffBlock *block,
+                           size_t tsIndex, float stepHours,
+                           std::vector<float> *fastFlow,
+                           std::vector<float> *slowFlow,
+                           std::vector<float> *soilMoisture);
 
   float GetNumSimulatedYears();
   int LoadForcings(PrecipReader *precipReader, PETReader *petReader,
                    TempReader *tempReader);
+  // Starts threads reading the forcings of the steps from currentTime on,
+  // NULL if they could not be started. TakeForcings does what LoadForcings
+  // does with the forcings of the next step.
+  ForcingPrefetch *StartPrefetch(int depth);
+  int TakeForcings(ForcingPrefetch *prefetch);
   void SaveLP3Params();
   void SaveTSOutput();
   bool IsOutputTS();
@@ -49,7 +85,7 @@ private:
   void AssimilateData();
   void OutputCombinedOutput();
 
-  bool ReadThresFile(char *file, std::vector<GridNode> *nodes,
+  bool ReadThresFile(char *file, std::vector<GridCell> *cells,
                      std::vector<float> *thresVals);
   float ComputeThresValue(float discharge, float action, float minor,
                           float moderate, float major);
@@ -61,7 +97,9 @@ private:
   // These guys are the basic variables
   TaskConfigSection *task;
   GridNodeVec nodes;
+  GridCellVec cells;
   GridNodeVec lumpedNodes;
+  GridCellVec lumpedCells;
   WaterBalanceModel *wbModel;
   RoutingModel *rModel;
   SnowModel *sModel;
@@ -101,6 +139,8 @@ private:
   bool outputRP;
   bool useStates, saveStates;
   bool preloadedForcings;
+  int wbBlockSteps;
+  int prefetchSteps;
   std::vector<RPData> rpData;
   char *outputPath;
   char *statePath;
@@ -128,10 +168,17 @@ private:
   std::vector<WaterBalanceModel *> caliWBModels;
   std::vector<RoutingModel *> caliRModels;
   std::vector<SnowModel *> caliSModels;
+  std::vector<RunoffBlock> caliBlocks;
   std::vector<float *> caliWBCurrentParams, caliRCurrentParams,
       caliSCurrentParams;
   std::vector<std::map<GaugeConfigSection *, float *> > caliWBFullParamSettings,
       caliRFullParamSettings, caliSFullParamSettings;
+  bool caliUseSets;
+  WaterBalanceModel *caliSetWBModel;
+  std::vector<RoutingModel *> caliSetRModels;
+  std::vector<float *> caliSetWBCurrentParams, caliSetRCurrentParams;
+  std::vector<std::map<GaugeConfigSection *, float *> >
+      caliSetWBFullParamSettings, caliSetRFullParamSettings;
 };
 
 #endif
@@ -1,8 +1,12 @@
 #include "Snow17Model.h"
 #include "DatedName.h"
+#include "KernelPrecision.h"
 #include <cmath>
 #include <cstdio>
 #include <cstring>
+#if _OPENMP
+#include <omp.h>
+#endif
 
 static const char *stateStrings[] = {
     "ati",
@@ -11,35 +15,46 @@ static const char *stateStrings[] = {
     "deficit",
 };
 
-Snow17Model::Snow17Model() {}
+void Snow17Cells::Resize(size_t numCells) {
+  for (int p = 0; p < PARAM_SNOW17_QTY; p++) {
+    params[p].resize(numCells);
+  }
+  for (int p = 0; p < STATE_SNOW17_QTY; p++) {
+    states[p].resize(numCells);
+  }
+  pAtm.resize(numCells);
+  tipmStep.resize(numCells);
+}
+
+Snow17Model::Snow17Model() {
+  tipmStepHours = 0.0f;
+  stepSv = 0.0f;
+  precision = KERNEL_PRECISION(PRECISION_SINGLE);
+}
 
 Snow17Model::~Snow17Model() {}
 
 bool Snow17Model::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
-  if (snowNodes.size() != nodes->size()) {
-    snowNodes.resize(nodes->size());
-  }
+  gridCells = newCells;
+  cells.Resize(nodes->size());
 
   // Fill in modelIndex in the gridNodes
   size_t numNodes = nodes->size();
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     node->modelIndex = i;
-    float elevation = g_DEM->data[node->y][node->x] / 100.0;
-    snowNodes[i].P_atm = 33.86 * (29.9 - (0.335 * elevation) +
-                                  (0.00022 * (powf(elevation, 2.4))));
+    float elevation = g_DEM->data[cell->y][cell->x] / 100.0;
+    cells.pAtm[i] = 33.86 * (29.9 - (0.335 * elevation) +
+                             (0.00022 * (powf(elevation, 2.4))));
     for (int p = 0; p < STATE_SNOW17_QTY; p++) {
-      snowNodes[i].states[p] = 0.0;
+      cells.states[p][i] = 0.0;
     }
-    // snowNodes[i].states[STATE_SNOW17_ATI] = 0.0;
-    // snowNodes[i].states[STATE_SNOW17_WI] = 0.0;
-    // snowNodes[i].states[STATE_SNOW17_WQ] = 0.0;
-    // snowNodes[i].states[STATE_SNOW17_DEFICIT] = 0.0;
   }
 
   InitializeParameters(paramSettings, paramGrids);
@@ -63,20 +78,18 @@ void Snow17Model::InitializeStates(TimeVar *beginTime, char *statePath) {
       printf("Using Snow-17 %s State Grid %s\n", stateStrings[p], buffer);
       if (g_DEM->IsSpatialMatch(sGrid)) {
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &nodes->at(i);
-          Snow17GridNode *cNode = &(snowNodes[i]);
-          if (sGrid->data[node->y][node->x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[node->y][node->x];
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->data[cell->y][cell->x] != sGrid->noData) {
+            cells.states[p][i] = sGrid->data[cell->y][cell->x];
           }
         }
       } else {
         GridLoc pt;
         for (size_t i = 0; i < nodes->size(); i++) {
-          GridNode *node = &(nodes->at(i));
-          Snow17GridNode *cNode = &(snowNodes[i]);
-          if (sGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
+          GridCell *cell = &gridCells->at(i);
+          if (sGrid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt) &&
               sGrid->data[pt.y][pt.x] != sGrid->noData) {
-            cNode->states[p] = sGrid->data[pt.y][pt.x];
+            cells.states[p][i] = sGrid->data[pt.y][pt.x];
           }
         }
       }
@@ -102,10 +115,9 @@ void Snow17Model::SaveStates(TimeVar *currentTime, char *statePath,
     sprintf(buffer, "%s/snow17_%s_%s.tif", statePath, stateStrings[p],
             timeStr.GetName());
     for (size_t i = 0; i < nodes->size(); i++) {
-      Snow17GridNode *cNode = &(snowNodes[i]);
-      dataVals[i] = cNode->states[p];
+      dataVals[i] = cells.states[p][i];
     }
-    gridWriter->WriteGrid(nodes, &dataVals, buffer, false);
+    gridWriter->WriteGrid(nodes, gridCells, &dataVals, buffer, false);
   }
 }
 
@@ -115,65 +127,135 @@ bool Snow17Model::SnowBalance(float jday, float stepHours,
                               std::vector<float> *melt,
                               std::vector<float> *swe) {
 
-  size_t numNodes = nodes->size();
-
-  for (size_t i = 0; i < numNodes; i++) {
-    GridNode *node = &nodes->at(i);
-    Snow17GridNode *cNode = &(snowNodes[i]);
-    SnowBalanceInt(node, cNode, stepHours, jday, precip->at(i), temp->at(i),
-                   &(melt->at(i)), &(swe->at(i)));
-    // soilMoisture->at(i) = cNode->soilMoisture * 100.0 /
-    // cNode->params[PARAM_CREST_WM];
+  long numNodes = (long)nodes->size();
+  if (numNodes == 0) {
+    return true;
+  }
+  long numTiles = (numNodes + WB_BLOCK_TILE - 1) / WB_BLOCK_TILE;
+  const float *precipIn = &(precip->at(0));
+  const float *tempIn = &(temp->at(0));
+  float *meltOut = &(melt->at(0));
+  float *sweOut = &(swe->at(0));
+
+  BeginStep(jday, stepHours);
+
+  // Every cell is independent of the others
+#if _OPENMP
+#pragma omp parallel for
+#endif
+  for (long tile = 0; tile < numTiles; tile++) {
+    long begin = tile * WB_BLOCK_TILE;
+    long end = (begin + WB_BLOCK_TILE < numNodes) ? begin + WB_BLOCK_TILE
+                                                  : numNodes;
+    StepCells(stepHours, begin, end, precipIn, tempIn, meltOut, sweOut);
   }
 
   return true;
 }
 
-void Snow17Model::SnowBalanceInt(GridNode *node, Snow17GridNode *cNode,
-                                 float stepHours, float jday, float precipIn,
-                                 float tempIn, float *melt, float *swe) {
+void Snow17Model::BeginStep(float jday, float stepHours) {
+  long numNodes = (long)nodes->size();
+
+  // The decay of the antecedent temperature index only depends on TIPM and
+  // the step length
+  if (stepHours != tipmStepHours) {
+    const float *tipm = &(cells.params[PARAM_SNOW17_TIPM][0]);
+    float *tipmStep = &(cells.tipmStep[0]);
+#if _OPENMP
+#pragma omp parallel for
+#endif
+    for (long i = 0; i < numNodes; i++) {
+      tipmStep[i] = 1.0 - (powf(1.0 - tipm[i], stepHours / 6));
+    }
+    tipmStepHours = stepHours;
+  }
 
-  float stefan = 6.12e-10;
-  float PXTEMP = 1; // Temperature of rainfall (Deg C)
-  float TIPM_dtt =
-      1.0 - (powf(1.0 - cNode->params[PARAM_SNOW17_TIPM], stepHours / 6));
+  stepSv =
+      (0.5 * sinf((jday - 81 * 2 * M_PI) / 366.0)) + 0.5; // seasonal variation
+}
 
-  float precip = precipIn * stepHours; // precipIn is mm/hr, precip is mm
+void Snow17Model::StepCells(float stepHours, long begin, long end,
+                            const float *precip, const float *temp,
+                            float *melt, float *swe) {
+  if (precision == PRECISION_DOUBLE) {
+    RunCells<double>(stepHours, NULL, begin, end, precip, temp, melt, swe);
+  } else {
+    RunCells<float>(stepHours, NULL, begin, end, precip, temp, melt, swe);
+  }
+}
 
-  float Sv =
-      (0.5 * sinf((jday - 81 * 2 * M_PI) / 366.0)) + 0.5; // seasonal variation
-  float mf = (stepHours / 6) *
-             ((Sv * (cNode->params[PARAM_SNOW17_MFMAX] -
-                     cNode->params[PARAM_SNOW17_MFMIN])) +
-              cNode->params[PARAM_SNOW17_MFMIN]); // non-rain melt factor,
-                                                  // seasonally varying
+void Snow17Model::StepList(float stepHours, const long *list, long count,
+                           const float *precip, const float *temp,
+                           float *melt, float *swe) {
+  if (precision == PRECISION_DOUBLE) {
+    RunCells<double>(stepHours, list, 0, count, precip, temp, melt, swe);
+  } else {
+    RunCells<float>(stepHours, list, 0, count, precip, temp, melt, swe);
+  }
+}
+
+template <class Real>
+void Snow17Model::RunCells(float stepHours, const long *list, long begin,
+                           long end, const float *precip, const float *temp,
+                           float *melt, float *swe) {
+  for (long j = begin; j < end; j++) {
+    long i = list ? list[j] : j;
+    SnowBalanceInt<Real>(i, stepHours, stepSv, precip[i], temp[i], &(melt[i]),
+                         &(swe[i]));
+  }
+}
+
+template <class Real>
+void Snow17Model::SnowBalanceInt(long index, float stepHours, float Sv,
+                                 float precipIn, float tempIn, float *melt,
+                                 float *swe) {
+
+  const float SCF = cells.params[PARAM_SNOW17_SCF][index];
+  const float MFMAX = cells.params[PARAM_SNOW17_MFMAX][index];
+  const float MFMIN = cells.params[PARAM_SNOW17_MFMIN][index];
+  const float UADJ = cells.params[PARAM_SNOW17_UADJ][index];
+  const float MBASE = cells.params[PARAM_SNOW17_MBASE][index];
+  const float NMF = cells.params[PARAM_SNOW17_NMF][index];
+  const float PLWHC = cells.params[PARAM_SNOW17_PLWHC][index];
+  const float TIPM_dtt = cells.tipmStep[index];
+
+  Real ATI = cells.states[STATE_SNOW17_ATI][index];
+  Real WQ = cells.states[STATE_SNOW17_WQ][index];
+  Real WI = cells.states[STATE_SNOW17_WI][index];
+  Real DEFICIT = cells.states[STATE_SNOW17_DEFICIT][index];
+
+  Real stefan = 6.12e-10;
+  Real PXTEMP = 1; // Temperature of rainfall (Deg C)
+
+  Real precip = precipIn * stepHours; // precipIn is mm/hr, precip is mm
+
+  Real mf = (stepHours / 6) * ((Sv * (MFMAX - MFMIN)) +
+                               MFMIN); // non-rain melt factor,
+                                       // seasonally varying
 
   // Snow Accumulation
 
-  float fracsnow = 0.0;
-  float fracrain = 1.0;
+  Real fracsnow = 0.0;
+  Real fracrain = 1.0;
 
   if (tempIn < PXTEMP) {
     fracrain = 0.0;
     fracsnow = 1.0;
   }
 
-  float Pn =
-      precip * fracsnow *
-      cNode->params[PARAM_SNOW17_SCF];  // water equivalent of new snowfall (mm)
-  cNode->states[STATE_SNOW17_WI] += Pn; // W_i = accumulated water equivalent of
-                                        // the ice portion of the snow cover
-                                        // (mm)
-  float E = 0;
-  float RAIN =
+  Real Pn = precip * fracsnow * SCF; // water equivalent of new snowfall (mm)
+  WI += Pn; // W_i = accumulated water equivalent of the ice portion of the
+            // snow cover (mm)
+  Real E = 0;
+  Real RAIN =
       fracrain *
       precip; // amount of precip (mm) that is rain during this time step
 
   // Temperature and Heat Deficit from new Snow
 
-  float T_snow_new = 0.0;
-  float delta_HD_snow = 0.0;
-  float T_rain = tempIn;
+  Real T_snow_new = 0.0;
+  Real delta_HD_snow = 0.0;
+  Real T_rain = tempIn;
 
   if (tempIn < 0.0) {
     T_snow_new = tempIn;
@@ -186,150 +268,127 @@ void Snow17Model::SnowBalanceInt(GridNode *node, Snow17GridNode *cNode,
   // Antecedent temperature Index
 
   if (Pn > (1.5 * stepHours)) {
-    cNode->states[STATE_SNOW17_ATI] = T_snow_new;
+    ATI = T_snow_new;
   } else {
-    cNode->states[STATE_SNOW17_ATI] =
-        cNode->states[STATE_SNOW17_ATI] +
-        TIPM_dtt *
-            (tempIn -
-             cNode->states[STATE_SNOW17_ATI]); // Antecedent temperature index
+    ATI = ATI + TIPM_dtt * (tempIn - ATI); // Antecedent temperature index
   }
 
-  if (cNode->states[STATE_SNOW17_ATI] > 0) {
-    cNode->states[STATE_SNOW17_ATI] = 0;
+  if (ATI > 0) {
+    ATI = 0;
   }
 
   // Heat Exchange when no Surface Melt
 
-  float delta_HD_T = cNode->params[PARAM_SNOW17_NMF] * (stepHours / 6.0) *
-                     (mf / cNode->params[PARAM_SNOW17_MFMAX]) *
-                     (cNode->states[STATE_SNOW17_ATI] -
-                      T_snow_new); // delta_HD_T = change in heat deficit due to
-                                   // a temperature gradient (mm)
-
-  // Rain-on-Snow Melt
-  float M_RoS = 0.0;
-  float e_sat =
-      2.7489 * 100000000.0 *
-      expf(
-          (-4278.63 /
-           (tempIn + 242.792))); // saturated vapor pressure at T_air_meanC (mb)
-  if (RAIN > (0.25 * stepHours)) { // 1.5 mm/ 6 hrs
-    // Melt (mm) during rain-on-snow periods is:
-    float M_RoS1 = fmaxf(stefan * stepHours *
-                             (powf(tempIn + 273.0, 4.0) - powf(273.0, 4.0)),
-                         0.0);
-    float M_RoS2 = fmaxf((0.0125 * RAIN * T_rain), 0.0);
-    float M_RoS3 =
-        fmaxf((8.5 * cNode->params[PARAM_SNOW17_UADJ] * (stepHours / 6) *
-               (((0.9 * e_sat) - 6.11) + (0.00057 * cNode->P_atm * tempIn))),
-              0.0);
-    M_RoS = M_RoS1 + M_RoS2 + M_RoS3;
-  }
+  Real delta_HD_T =
+      NMF * (stepHours / 6.0) * (mf / MFMAX) *
+      (ATI - T_snow_new); // delta_HD_T = change in heat deficit due to a
+                          // temperature gradient (mm)
+
+  // Without any ice everything left in the pack drains whatever the melt
+  // would have been, so the melt terms are only worked out under snow
+  Real Melt = 0.0;
+  if (WI > 0) {
+    // Rain-on-Snow Melt
+    Real M_RoS = 0.0;
+    if (RAIN > (0.25 * stepHours)) { // 1.5 mm/ 6 hrs
+      Real e_sat = 2.7489 * 100000000.0 *
+                   KernelExp((Real)(-4278.63 /
+                                    (tempIn + 242.792))); // saturated vapor
+                                                          // pressure at
+                                                          // T_air_meanC (mb)
+      // Melt (mm) during rain-on-snow periods is:
+      Real M_RoS1 =
+          KernelMax((Real)(stefan * stepHours *
+                           (KernelPow((Real)(tempIn + 273.0), (Real)4.0) -
+                            KernelPow((Real)273.0, (Real)4.0))),
+                    (Real)0.0);
+      Real M_RoS2 = KernelMax((Real)(0.0125 * RAIN * T_rain), (Real)0.0);
+      Real M_RoS3 =
+          KernelMax((Real)(8.5 * UADJ * (stepHours / 6) *
+                           (((0.9 * e_sat) - 6.11) +
+                            (0.00057 * cells.pAtm[index] * tempIn))),
+                    (Real)0.0);
+      M_RoS = M_RoS1 + M_RoS2 + M_RoS3;
+    }
 
-  // Non-Rain Melt
-  float M_NR = 0.0;
-  if (RAIN <= (0.25 * stepHours) &&
-      (tempIn > cNode->params[PARAM_SNOW17_MBASE])) {
-    // Melt during non-rain periods is:
-    M_NR = (mf * (tempIn - cNode->params[PARAM_SNOW17_MBASE])) +
-           (0.0125 * RAIN * T_rain);
-  }
+    // Non-Rain Melt
+    Real M_NR = 0.0;
+    if (RAIN <= (0.25 * stepHours) && (tempIn > MBASE)) {
+      // Melt during non-rain periods is:
+      M_NR = (mf * (tempIn - MBASE)) + (0.0125 * RAIN * T_rain);
+    }
 
-  // Ripeness of the snow cover
+    // Ripeness of the snow cover
 
-  float Melt = M_RoS + M_NR;
+    Melt = M_RoS + M_NR;
 
-  if (Melt < 0.0) {
-    Melt = 0.0;
+    if (Melt < 0.0) {
+      Melt = 0.0;
+    }
   }
 
-  if (Melt < cNode->states[STATE_SNOW17_WI]) {
-    cNode->states[STATE_SNOW17_WI] -= Melt;
+  if (Melt < WI) {
+    WI -= Melt;
   } else {
-    Melt = cNode->states[STATE_SNOW17_WI] + cNode->states[STATE_SNOW17_WQ];
-    cNode->states[STATE_SNOW17_WI] = 0;
+    Melt = WI + WQ;
+    WI = 0;
   }
 
-  float Qw = Melt + RAIN; // Qw = liquid water available melted/rained at the
-                          // snow surface (mm)
-  float W_qx =
-      cNode->params[PARAM_SNOW17_PLWHC] *
-      cNode->states[STATE_SNOW17_WI]; // W_qx = liquid water capacity (mm)
-  cNode->states[STATE_SNOW17_DEFICIT] =
-      cNode->states[STATE_SNOW17_DEFICIT] + delta_HD_snow +
-      delta_HD_T; // Deficit = heat deficit (mm)
-
-  if (cNode->states[STATE_SNOW17_DEFICIT] <= 0.0) { // limits of heat deficit
-    cNode->states[STATE_SNOW17_DEFICIT] = 0.0;
-  } else if (cNode->states[STATE_SNOW17_DEFICIT] >
-             (0.33 * cNode->states[STATE_SNOW17_WI])) {
-    cNode->states[STATE_SNOW17_DEFICIT] = 0.33 * cNode->states[STATE_SNOW17_WI];
+  Real Qw = Melt + RAIN; // Qw = liquid water available melted/rained at the
+                         // snow surface (mm)
+  Real W_qx = PLWHC * WI; // W_qx = liquid water capacity (mm)
+  DEFICIT = DEFICIT + delta_HD_snow + delta_HD_T; // Deficit = heat deficit (mm)
+
+  if (DEFICIT <= 0.0) { // limits of heat deficit
+    DEFICIT = 0.0;
+  } else if (DEFICIT > (0.33 * WI)) {
+    DEFICIT = 0.33 * WI;
   }
 
-  float SWE = 0.0;
+  Real SWE = 0.0;
   // In SNOW-17 the snow cover is ripe when both (Deficit=0) & (W_q = W_qx)
-  if (cNode->states[STATE_SNOW17_WI] > 0) {
-    if ((Qw + cNode->states[STATE_SNOW17_WQ]) >
-        ((cNode->states[STATE_SNOW17_DEFICIT] *
-          (1 + cNode->params[PARAM_SNOW17_PLWHC])) +
-         W_qx)) { // THEN the snow is RIPE
-      E = Qw + cNode->states[STATE_SNOW17_WQ] - W_qx -
-          (cNode->states[STATE_SNOW17_DEFICIT] *
-           (1 + cNode->params[PARAM_SNOW17_PLWHC])); // Excess liquid water (mm)
-      cNode->states[STATE_SNOW17_WQ] = W_qx; // fills liquid water capacity
-      cNode->states[STATE_SNOW17_WI] =
-          cNode->states[STATE_SNOW17_WI] +
-          cNode->states[STATE_SNOW17_DEFICIT]; // W_i increases because water
-                                               // refreezes as heat deficit is
-                                               // decreased
-      cNode->states[STATE_SNOW17_DEFICIT] = 0;
-    } else if (
-        (Qw >=
-         cNode->states
-             [STATE_SNOW17_DEFICIT])) { // %& ((Qw + cNode->W_q) <=
-                                        // ((cNode->Deficit*(1+cNode->params[PARAM_SNOW17_PLWHC]))
-                                        // + W_qx))) { // THEN the snow is NOT
-                                        // yet ripe, but ice is being melted
+  if (WI > 0) {
+    if ((Qw + WQ) > ((DEFICIT * (1 + PLWHC)) + W_qx)) { // THEN the snow is RIPE
+      E = Qw + WQ - W_qx -
+          (DEFICIT * (1 + PLWHC)); // Excess liquid water (mm)
+      WQ = W_qx;                   // fills liquid water capacity
+      WI = WI + DEFICIT; // W_i increases because water refreezes as heat
+                         // deficit is decreased
+      DEFICIT = 0;
+    } else if ((Qw >= DEFICIT)) { // %& ((Qw + W_q) <= ((Deficit*(1+PLWHC))
+                                  // + W_qx))) { // THEN the snow is NOT yet
+                                  // ripe, but ice is being melted
       E = 0;
-      cNode->states[STATE_SNOW17_WQ] = cNode->states[STATE_SNOW17_WQ] + Qw -
-                                       cNode->states[STATE_SNOW17_DEFICIT];
-      cNode->states[STATE_SNOW17_WI] =
-          cNode->states[STATE_SNOW17_WI] +
-          cNode->states[STATE_SNOW17_DEFICIT]; // W_i increases because water
-                                               // refreezes as heat deficit is
-                                               // decreased
-      cNode->states[STATE_SNOW17_DEFICIT] = 0;
-    } else if ((Qw <
-                cNode->states[STATE_SNOW17_DEFICIT])) { // elseif ((Qw + W_q) <
-                                                        // cNode->Deficit)) { //
-                                                        // THEN the snow is NOT
-                                                        // yet ripe
+      WQ = WQ + Qw - DEFICIT;
+      WI = WI + DEFICIT; // W_i increases because water refreezes as heat
+                         // deficit is decreased
+      DEFICIT = 0;
+    } else if ((Qw < DEFICIT)) { // elseif ((Qw + W_q) < Deficit)) { // THEN
+                                 // the snow is NOT yet ripe
       E = 0;
-      cNode->states[STATE_SNOW17_WI] += Qw; // W_i increases because water
-                                            // refreezes as heat deficit is
-                                            // decreased
-      cNode->states[STATE_SNOW17_DEFICIT] -= Qw;
+      WI += Qw; // W_i increases because water refreezes as heat deficit is
+                // decreased
+      DEFICIT -= Qw;
     }
 
-    SWE =
-        cNode->states[STATE_SNOW17_WI] + cNode->states[STATE_SNOW17_WQ]; // + E;
+    SWE = WI + WQ; // + E;
   } else {
     // then no snow exists!
     E = Qw;
     SWE = 0;
-    cNode->states[STATE_SNOW17_WQ] = 0;
+    WQ = 0;
   }
 
-  if (cNode->states[STATE_SNOW17_DEFICIT] == 0) {
-    cNode->states[STATE_SNOW17_ATI] = 0;
+  if (DEFICIT == 0) {
+    ATI = 0;
   }
 
   // End of model execution
 
-  /*if (SWE == 0.0) {
-          printf("pIn %f, pOut %f\n", cNode->pIn, cNode->pOut);
-  }*/
+  cells.states[STATE_SNOW17_ATI][index] = ATI;
+  cells.states[STATE_SNOW17_WQ][index] = WQ;
+  cells.states[STATE_SNOW17_WI][index] = WI;
+  cells.states[STATE_SNOW17_DEFICIT][index] = DEFICIT;
 
   *swe = SWE; // total SWE (mm) at this time step
   *melt = E / stepHours;
@@ -344,13 +403,14 @@ void Snow17Model::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
-    Snow17GridNode *cNode = &(snowNodes[i]);
+    GridCell *cell = &gridCells->at(i);
+    float params[PARAM_SNOW17_QTY];
     if (!node->gauge) {
       unused++;
       continue;
     }
     // Copy all of the parameters over
-    memcpy(cNode->params, (*paramSettings)[node->gauge],
+    memcpy(params, (*paramSettings)[node->gauge],
            sizeof(float) * PARAM_SNOW17_QTY);
 
     // Some of the parameters are special, deal with that here
@@ -363,21 +423,25 @@ void Snow17Model::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_SNOW17_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
           // modelParamStrings[MODEL_CREST][paramI]);
         }
-        cNode->params[paramI] *= grid->data[pt.y][pt.x];
+        params[paramI] *= grid->data[pt.y][pt.x];
       }
     }
 
+    for (size_t paramI = 0; paramI < PARAM_SNOW17_QTY; paramI++) {
+      cells.params[paramI][i] = params[paramI];
+    }
+
     /*if (!paramGrids->at(PARAM_CREST_IWU)) {
       cNode->soilMoisture = cNode->params[PARAM_CREST_IWU] *
     cNode->params[PARAM_CREST_WM] / 100.0;
@@ -407,4 +471,7 @@ void Snow17Model::InitializeParameters(
     0.0); cNode->params[PARAM_CREST_B] = 0.0;
     }*/
   }
+
+  // The parameters may have changed, recompute the TIPM weights
+  tipmStepHours = 0.0f;
 }
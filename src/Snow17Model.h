@@ -11,11 +11,17 @@ enum STATES_SNOW17 {
   STATE_SNOW17_QTY
 };
 
-struct Snow17GridNode : BasicGridNode {
-  float params[PARAM_SNOW17_QTY];
-  float states[STATE_SNOW17_QTY];
+// Snow-17 cells are stored as one contiguous array per field so the cells can
+// run in parallel.
+struct Snow17Cells {
+  void Resize(size_t numCells);
 
-  float P_atm;
+  std::vector<float> params[PARAM_SNOW17_QTY];
+  std::vector<float> states[STATE_SNOW17_QTY];
+  // Atmospheric pressure from the cell elevation (mb)
+  std::vector<float> pAtm;
+  // Antecedent temperature index weight for a step of tipmStepHours
+  std::vector<float> tipmStep;
 };
 
 class Snow17Model : public SnowModel {
@@ -24,6 +30,7 @@ public:
   Snow17Model();
   ~Snow17Model();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   void InitializeStates(TimeVar *beginTime, char *statePath);
@@ -33,17 +40,42 @@ public:
                    std::vector<float> *temp, std::vector<float> *melt,
                    std::vector<float> *swe);
   const char *GetName() { return "snow17"; }
+  void SetPrecision(PRECISIONS newPrecision) { precision = newPrecision; }
+  // Tile access for SimEngine. BeginStep is called once per step before
+  // StepCells, which runs cells begin to end - 1 as SnowBalance does, or
+  // StepList, which runs the count cells in list. melt may be the same array
+  // as precip.
+  void BeginStep(float jday, float stepHours);
+  void StepCells(float stepHours, long begin, long end, const float *precip,
+                 const float *temp, float *melt, float *swe);
+  void StepList(float stepHours, const long *list, long count,
+                const float *precip, const float *temp, float *melt,
+                float *swe);
 
 private:
   void
   InitializeParameters(std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
-  void SnowBalanceInt(GridNode *node, Snow17GridNode *cNode, float stepHours,
-                      float jday, float precipIn, float tempIn, float *melt,
-                      float *swe);
+  // Sv is the seasonal variation of the melt factor for this step, Real is
+  // the compute type picked by precision
+  template <class Real>
+  void SnowBalanceInt(long index, float stepHours, float Sv, float precipIn,
+                      float tempIn, float *melt, float *swe);
+  // Runs list[begin] to list[end - 1], or begin to end - 1 when list is NULL
+  template <class Real>
+  void RunCells(float stepHours, const long *list, long begin, long end,
+                const float *precip, const float *temp, float *melt,
+                float *swe);
 
   std::vector<GridNode> *nodes;
-  std::vector<Snow17GridNode> snowNodes;
+  std::vector<GridCell> *gridCells;
+  Snow17Cells cells;
+  // Step length in hours the tipmStep of cells was computed for
+  float tipmStepHours;
+  // Seasonal variation of the melt factor set by BeginStep
+  float stepSv;
+  // Single unless a task or the build asks for double
+  PRECISIONS precision;
 };
 
 #endif
@@ -59,6 +59,13 @@ TaskConfigSection::TaskConfigSection(const char *nameVal) {
   routing = ROUTE_QTY;
   snow = SNOW_QTY;
   inundation = INUNDATION_QTY;
+  kwSolver = KW_SOLVER_NEWTON;
+  kwActiveSet = false;
+  wbBlockSteps = 1;
+  fusedSweep = false;
+  prefetchSteps = 0;
+  lrDepthTolerance = 0.0;
+  precision = PRECISION_QTY;
   temp = NULL;
 }
 
@@ -239,6 +246,71 @@ CONFIG_SEC_RET TaskConfigSection::ProcessKeyValue(char *name, char *value) {
     INFO_LOGF("Valid inundation options are \"%s\"",
               "SIMPLEINUNDATION, VCINUNDATION");
     return INVALID_RESULT;
+  } else if (!strcasecmp(name, "kw_solver")) {
+    for (int i = 0; i < KW_SOLVER_QTY; i++) {
+      if (!strcasecmp(value, kwSolverStrings[i])) {
+        kwSolver = (KW_SOLVERS)i;
+        return VALID_RESULT;
+      }
+    }
+    ERROR_LOGF("Unknown kinematic wave solver option \"%s\"!", value);
+    INFO_LOGF("Valid kinematic wave solver options are \"%s\"",
+              "NEWTON, BATCH, WARMSTART");
+    return INVALID_RESULT;
+  } else if (!strcasecmp(name, "kw_active_set")) {
+    if (!strcasecmp(value, "true")) {
+      kwActiveSet = true;
+    } else if (!strcasecmp(value, "false")) {
+      kwActiveSet = false;
+    } else {
+      ERROR_LOGF("Unknown kinematic wave active set option \"%s\"", value);
+      INFO_LOGF("Valid kinematic wave active set options are \"%s\"",
+                "TRUE, FALSE");
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "wb_block_steps")) {
+    wbBlockSteps = atoi(value);
+    if (wbBlockSteps < 1) {
+      ERROR_LOGF("Invalid water balance block steps \"%s\", it must be at "
+                 "least 1",
+                 value);
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "fused_sweep")) {
+    if (!strcasecmp(value, "true")) {
+      fusedSweep = true;
+    } else if (!strcasecmp(value, "false")) {
+      fusedSweep = false;
+    } else {
+      ERROR_LOGF("Unknown fused sweep option \"%s\"", value);
+      INFO_LOGF("Valid fused sweep options are \"%s\"", "TRUE, FALSE");
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "prefetch_steps")) {
+    prefetchSteps = atoi(value);
+    if (prefetchSteps < 0) {
+      ERROR_LOGF("Invalid prefetch steps \"%s\", it must be at least 0",
+                 value);
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "lr_depth_tolerance")) {
+    lrDepthTolerance = atof(value);
+    if (lrDepthTolerance < 0.0) {
+      ERROR_LOGF("Invalid linear reservoir depth tolerance \"%s\", it must be "
+                 "at least 0",
+                 value);
+      return INVALID_RESULT;
+    }
+  } else if (!strcasecmp(name, "precision")) {
+    for (int i = 0; i < PRECISION_QTY; i++) {
+      if (!strcasecmp(value, precisionStrings[i])) {
+        precision = (PRECISIONS)i;
+        return VALID_RESULT;
+      }
+    }
+    ERROR_LOGF("Unknown precision option \"%s\"!", value);
+    INFO_LOGF("Valid precision options are \"%s\"", "SINGLE, DOUBLE");
+    return INVALID_RESULT;
   } else if (!strcasecmp(name, "basin")) {
     TOLOWER(value);
     std::map<std::string, BasinConfigSection *>::iterator itr =
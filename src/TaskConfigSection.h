@@ -70,6 +70,14 @@ public:
   ROUTES GetRouting();
   SNOWS GetSnow();
   INUNDATIONS GetInundation();
+  KW_SOLVERS GetKWSolver() { return kwSolver; }
+  bool UseKWActiveSet() { return kwActiveSet; }
+  int GetWBBlockSteps() { return wbBlockSteps; }
+  bool UseFusedSweep() { return fusedSweep; }
+  int GetPrefetchSteps() { return prefetchSteps; }
+  float GetLRDepthTolerance() { return lrDepthTolerance; }
+  // PRECISION_QTY when the task leaves each model at its own precision
+  PRECISIONS GetPrecision() { return precision; }
   GaugeConfigSection *GetDefaultGauge();
   bool UseStates() { return stateSet; }
   bool SaveStates() { return (stateSet && timeStateSet); }
@@ -101,6 +109,13 @@ private:
   ROUTES routing;
   SNOWS snow;
   INUNDATIONS inundation;
+  KW_SOLVERS kwSolver;
+  bool kwActiveSet;
+  int wbBlockSteps;
+  bool fusedSweep;
+  int prefetchSteps;
+  float lrDepthTolerance;
+  PRECISIONS precision;
   BasinConfigSection *basin;
   PrecipConfigSection *precip, *qpf;
   PETConfigSection *pet;
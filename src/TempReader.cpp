@@ -17,12 +17,12 @@ void TempReader::ReadDEM(char *file) {
 }
 
 bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
-                      std::vector<GridNode> *nodes,
+                      std::vector<GridCell> *cells,
                       std::vector<float> *currentTemp,
                       std::vector<float> *prevTemp, bool hasF) {
   if (!strcmp(lastTempFile, file)) {
     if (prevTemp) {
-      for (size_t i = 0; i < nodes->size(); i++) {
+      for (size_t i = 0; i < cells->size(); i++) {
         currentTemp->at(i) = prevTemp->at(i);
       }
     }
@@ -43,7 +43,7 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
     tempGrid = ReadFloatAscGrid(file);
     break;
   case TEMP_TIF:
-    tempGrid = ReadFloatTifGrid(file);
+    tempGrid = ReadFloatTifGridWindow(file, window.Get(cells), &pool);
     break;
   default:
     ERROR_LOG("Unsupported Temp format!");
@@ -53,7 +53,7 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
   if (!tempGrid) {
     // The temp file was not found! We return zeros if there is no qpf.
     if (!hasF) {
-      for (size_t i = 0; i < nodes->size(); i++) {
+      for (size_t i = 0; i < cells->size(); i++) {
         currentTemp->at(i) = 0;
       }
     }
@@ -69,32 +69,38 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
   // We have two options now... Either the temp grid & the basic grids are the
   // same Or they are different!
 
+  // Windowed grids only hold the rows and columns around the cells
+  long left = tempGrid->windowLeft, top = tempGrid->windowTop;
+
   if (g_DEM->IsSpatialMatch(tempGrid)) {
     // The grids are the same! Our life is easy!
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (tempGrid->data[node->y][node->x] != tempGrid->noData) {
-        currentTemp->at(i) = tempGrid->data[node->y][node->x];
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      float value = tempGrid->data[cell->y - top][cell->x - left];
+      if (value != tempGrid->noData) {
+        currentTemp->at(i) = value;
       } else {
         currentTemp->at(i) = 0.0;
       }
     }
 
   } else {
-    // The grids are different, we must do some resampling fun.
-    GridLoc pt;
-    for (size_t i = 0; i < nodes->size(); i++) {
-      GridNode *node = &(nodes->at(i));
-      if (tempGrid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt) &&
-          tempGrid->data[pt.y][pt.x] != tempGrid->noData) {
-        if (tempDEM && tempDEM->IsSpatialMatch(tempGrid)) {
-          float temp = tempGrid->data[pt.y][pt.x];
-          float diffHeight =
-              g_DEM->data[node->y][node->x] - tempDEM->data[pt.y][pt.x];
+    // The grids are different, each cell takes the value the sampling index
+    // points it to
+    SamplingIndex *index = GetSamplingIndex(cells, tempGrid);
+    bool lapse = tempDEM && tempDEM->IsSpatialMatch(tempGrid);
+    for (size_t i = 0; i < cells->size(); i++) {
+      GridCell *cell = &(cells->at(i));
+      int row = index->rows[i], col = index->cols[i];
+      if (row >= 0 && tempGrid->data[row][col] != tempGrid->noData) {
+        if (lapse) {
+          float temp = tempGrid->data[row][col];
+          float diffHeight = g_DEM->data[cell->y][cell->x] -
+                             tempDEM->data[row + top][col + left];
           float tempMod = -0.0065 * diffHeight;
           currentTemp->at(i) = temp + tempMod;
         } else {
-          currentTemp->at(i) = tempGrid->data[pt.y][pt.x];
+          currentTemp->at(i) = tempGrid->data[row][col];
         }
       } else {
         currentTemp->at(i) = 0.0;
@@ -103,7 +109,7 @@ bool TempReader::Read(char *file, SUPPORTED_TEMP_TYPES type,
   }
 
   // We don't actually need to keep the PET grid in memory anymore
-  delete tempGrid;
+  pool.Give(tempGrid);
 
   return true;
 }
@@ -3,12 +3,14 @@
 
 #include "BasicGrids.h"
 #include "Defines.h"
+#include "GridPool.h"
 #include "TempType.h"
 #include <vector>
 
 class TempReader {
 public:
-  bool Read(char *file, SUPPORTED_TEMP_TYPES type, std::vector<GridNode> *nodes,
+  TempReader() { lastTempFile[0] = 0; }
+  bool Read(char *file, SUPPORTED_TEMP_TYPES type, std::vector<GridCell> *cells,
             std::vector<float> *currentTemp,
             std::vector<float> *prevTemp = NULL, bool hasF = false);
   void ReadDEM(char *file);
@@ -17,6 +19,8 @@ public:
 private:
   char lastTempFile[CONFIG_MAX_LEN * 2];
   FloatGrid *tempDEM;
+  CellWindow window;
+  GridPool pool;
 };
 
 #endif
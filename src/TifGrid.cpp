@@ -3,9 +3,23 @@
 #include "Messages.h"
 #include "geotiffio.h"
 #include "xtiffio.h"
+#include <algorithm>
+#include <cmath>
 #include <cstdio>
+#include <cstring>
 #include <limits>
+#include <map>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+#if _OPENMP
+#include <omp.h>
+#endif
+#ifndef _WIN32
+#include <pthread.h>
+#endif
 
 #define TIFFTAG_GDAL_METADATA 42112
 #define TIFFTAG_GDAL_NODATA 42113
@@ -49,11 +63,231 @@ static void TIFFDefaultDirectory(TIFF *tif) {
   }
 }
 
+static FloatGrid *ReadFloatTif(const char *file, FloatGrid *incGrid,
+                               const GridWindow *window, GridPool *pool);
+
 FloatGrid *ReadFloatTifGrid(const char *file) {
-  return ReadFloatTifGrid(file, NULL);
+  return ReadFloatTif(file, NULL, NULL, NULL);
 }
 
 FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
+  return ReadFloatTif(file, incGrid, NULL, NULL);
+}
+
+FloatGrid *ReadFloatTifGridWindow(const char *file, const GridWindow *window,
+                                  GridPool *pool) {
+  return ReadFloatTif(file, NULL, window, pool);
+}
+
+static long ClampIndex(long index, long count) {
+  if (index < 0) {
+    return 0;
+  } else if (index >= count) {
+    return count - 1;
+  }
+  return index;
+}
+
+// Rows and columns of a width by height grid with its top left corner at
+// (left, top) covering window. The reference points are padded by a cell on
+// each side for the rounding in Grid::GetGridLoc.
+static void FindTifWindow(const GridWindow *window, long width, long height,
+                          double left, double top, double cellSize,
+                          long *firstCol, long *firstRow, long *lastCol,
+                          long *lastRow) {
+  if (width == window->numCols && height == window->numRows) {
+    *firstCol = window->left;
+    *lastCol = window->right;
+    *firstRow = window->top;
+    *lastRow = window->bottom;
+    return;
+  }
+  long geoLeft = (long)floor((window->extent.left - left) / cellSize) - 1;
+  long geoRight = (long)floor((window->extent.right - left) / cellSize) + 1;
+  long geoTop = (long)floor((top - window->extent.top) / cellSize) - 1;
+  long geoBottom = (long)floor((top - window->extent.bottom) / cellSize) + 1;
+  *firstCol = ClampIndex(geoLeft, width);
+  *lastCol = ClampIndex(geoRight, width);
+  *firstRow = ClampIndex(geoTop, height);
+  *lastRow = ClampIndex(geoBottom, height);
+}
+
+// Decoded tiles of the tiled files read through a window most recently, so
+// reading one of them again only decodes the tiles it has not decoded yet. A
+// file is dropped when its size or modification time change.
+#define TIF_TILE_CACHE_FILES 4
+
+struct TifTileCache {
+  std::string file;
+  time_t modified;
+  off_t size;
+  unsigned long lastUse;
+  std::map<uint32_t, std::vector<float> > tiles;
+};
+
+static std::vector<TifTileCache *> tileCaches;
+static unsigned long tileCacheUses = 0;
+#ifndef _WIN32
+static pthread_mutex_t tileCacheLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+// Returns the cache of file, emptied when the file is new or has changed,
+// NULL if the file cannot be found. Takes the place of the least recently
+// used file when all are in use. Call with tileCacheLock held.
+static TifTileCache *GetTileCache(const char *file) {
+  struct stat info;
+  if (stat(file, &info)) {
+    return NULL;
+  }
+  TifTileCache *cache = NULL;
+  for (size_t c = 0; c < tileCaches.size(); c++) {
+    if (tileCaches[c]->file == file) {
+      cache = tileCaches[c];
+      break;
+    }
+    if (!cache || tileCaches[c]->lastUse < cache->lastUse) {
+      cache = tileCaches[c];
+    }
+  }
+  if (!cache || cache->file != file) {
+    if (tileCaches.size() < TIF_TILE_CACHE_FILES) {
+      cache = new TifTileCache;
+      tileCaches.push_back(cache);
+    }
+    cache->file = file;
+    cache->tiles.clear();
+    cache->modified = info.st_mtime;
+    cache->size = info.st_size;
+  }
+  if (cache->modified != info.st_mtime || cache->size != info.st_size) {
+    cache->tiles.clear();
+    cache->modified = info.st_mtime;
+    cache->size = info.st_size;
+  }
+  cache->lastUse = ++tileCacheUses;
+  return cache;
+}
+
+// Copies the part of a tile with its top left cell at (tileCol, tileRow)
+// within columns firstCol to lastCol and rows firstRow to lastRow into grid,
+// whose data starts at (firstCol, firstRow)
+static void CopyTile(const float *tile, long tileCol, long tileRow,
+                     long tileWidth, long tileLength, FloatGrid *grid,
+                     long firstCol, long firstRow, long lastCol,
+                     long lastRow) {
+  long colBegin = std::max(tileCol, firstCol);
+  long colEnd = std::min(tileCol + tileWidth - 1, lastCol);
+  long rowBegin = std::max(tileRow, firstRow);
+  long rowEnd = std::min(tileRow + tileLength - 1, lastRow);
+  for (long row = rowBegin; row <= rowEnd; row++) {
+    memcpy(grid->data[row - firstRow] + (colBegin - firstCol),
+           tile + (row - tileRow) * tileWidth + (colBegin - tileCol),
+           sizeof(float) * (colEnd - colBegin + 1));
+  }
+}
+
+// Reads columns firstCol to lastCol and rows firstRow to lastRow of a tiled
+// file, only decoding the tiles that cover them. The tiles are spread over
+// the threads, each reading through a TIFF handle of its own since libtiff
+// handles cannot be shared. Tiles that fail to decode are noData.
+static void ReadTifTiles(const char *file, TIFF *tif, FloatGrid *grid,
+                         long firstCol, long firstRow, long lastCol,
+                         long lastRow, bool useCache) {
+  uint32_t tileWidth = 0, tileLength = 0;
+  TIFFGetField(tif, TIFFTAG_TILEWIDTH, &tileWidth);
+  TIFFGetField(tif, TIFFTAG_TILELENGTH, &tileLength);
+  size_t tileCells = (size_t)tileWidth * tileLength;
+
+  std::vector<long> tileCols, tileRows;
+  std::vector<uint32_t> tileIndices;
+  for (long row = firstRow - firstRow % tileLength; row <= lastRow;
+       row += tileLength) {
+    for (long col = firstCol - firstCol % tileWidth; col <= lastCol;
+         col += tileWidth) {
+      tileCols.push_back(col);
+      tileRows.push_back(row);
+      tileIndices.push_back(TIFFComputeTile(tif, col, row, 0, 0));
+    }
+  }
+
+  // Cached tiles are copied while the lock is held, the others decoded
+  std::vector<long> toDecode;
+#ifndef _WIN32
+  if (useCache) {
+    pthread_mutex_lock(&tileCacheLock);
+  }
+#endif
+  TifTileCache *cache = useCache ? GetTileCache(file) : NULL;
+  for (size_t t = 0; t < tileIndices.size(); t++) {
+    std::map<uint32_t, std::vector<float> >::iterator itr;
+    if (cache &&
+        (itr = cache->tiles.find(tileIndices[t])) != cache->tiles.end()) {
+      CopyTile(&(itr->second[0]), tileCols[t], tileRows[t], tileWidth,
+               tileLength, grid, firstCol, firstRow, lastCol, lastRow);
+    } else {
+      toDecode.push_back(t);
+    }
+  }
+#ifndef _WIN32
+  if (useCache) {
+    pthread_mutex_unlock(&tileCacheLock);
+  }
+#endif
+
+  long numDecode = (long)toDecode.size();
+  std::vector<std::vector<float> > decoded(cache ? numDecode : 0);
+#if _OPENMP
+#pragma omp parallel if (numDecode > 1)
+#endif
+  {
+    TIFF *tileTif = tif;
+#if _OPENMP
+    if (omp_get_thread_num() > 0) {
+      tileTif = XTIFFOpen(file, "r");
+    }
+#endif
+    std::vector<float> buffer(tileCells);
+#if _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (long d = 0; d < numDecode; d++) {
+      long t = toDecode[d];
+      if (!tileTif || TIFFReadEncodedTile(tileTif, tileIndices[t], &buffer[0],
+                                          tileCells * sizeof(float)) == -1) {
+        for (size_t i = 0; i < tileCells; i++) {
+          buffer[i] = grid->noData;
+        }
+      } else if (cache) {
+        decoded[d] = buffer;
+      }
+      CopyTile(&buffer[0], tileCols[t], tileRows[t], tileWidth, tileLength,
+               grid, firstCol, firstRow, lastCol, lastRow);
+    }
+    if (tileTif && tileTif != tif) {
+      XTIFFClose(tileTif);
+    }
+  }
+
+  if (!cache) {
+    return;
+  }
+#ifndef _WIN32
+  pthread_mutex_lock(&tileCacheLock);
+#endif
+  // Another thread may have given the file's place to a different one
+  cache = GetTileCache(file);
+  for (long d = 0; cache && d < numDecode; d++) {
+    if (!decoded[d].empty()) {
+      cache->tiles[tileIndices[toDecode[d]]].swap(decoded[d]);
+    }
+  }
+#ifndef _WIN32
+  pthread_mutex_unlock(&tileCacheLock);
+#endif
+}
+
+static FloatGrid *ReadFloatTif(const char *file, FloatGrid *incGrid,
+                               const GridWindow *window, GridPool *pool) {
 
   TIFFExtenderInit();
 
@@ -85,13 +319,6 @@ FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
     return NULL;
   }
 
-  if (TIFFIsTiled(tif)) {
-    WARNING_LOGF("%s is an unsupported tiled GeoTiff", file);
-    GTIFFree(gtif);
-    XTIFFClose(tif);
-    return NULL;
-  }
-
   int width, height;
   TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &width);
   TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &height);
@@ -102,7 +329,32 @@ FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
   TIFFGetField(tif, TIFFTAG_GEOTIEPOINTS, &tiepointsize, &tiepoints);
   TIFFGetField(tif, TIFFTAG_GEOPIXELSCALE, &pixscalesize, &pixscale);
 
-  if (!grid || grid->numCols != width || grid->numRows != height) {
+  // Windows are read into a grid of their own
+  long firstCol = 0, firstRow = 0, lastCol = width - 1, lastRow = height - 1;
+  if (window) {
+    FindTifWindow(window, width, height, tiepoints[3], tiepoints[4],
+                  pixscale[0], &firstCol, &firstRow, &lastCol, &lastRow);
+  }
+  if (pool) {
+    grid = pool->Take(lastCol - firstCol + 1, lastRow - firstRow + 1);
+    grid->numCols = width;
+    grid->numRows = height;
+    grid->windowLeft = firstCol;
+    grid->windowTop = firstRow;
+  } else if (window) {
+    grid = new FloatGrid();
+    grid->numCols = width;
+    grid->numRows = height;
+    grid->windowLeft = firstCol;
+    grid->windowTop = firstRow;
+    long windowCols = lastCol - firstCol + 1;
+    long windowRows = lastRow - firstRow + 1;
+    grid->backingStore = new float[windowCols * windowRows];
+    grid->data = new float *[windowRows];
+    for (long i = 0; i < windowRows; i++) {
+      grid->data[i] = grid->backingStore + i * windowCols;
+    }
+  } else if (!grid || grid->numCols != width || grid->numRows != height) {
     if (grid) {
       delete grid;
     }
@@ -148,12 +400,34 @@ FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid) {
   GTIFKeyGet(gtif, GeogGeodeticDatumGeoKey, &grid->geodeticDatum, 0, 1);
   grid->geoSet = true;
 
-  for (long i = 0; i < grid->numRows; i++) {
-    if (TIFFReadScanline(tif, grid->data[i], (unsigned int)i, 1) == -1) {
-      for (long j = 0; j < grid->numCols; j++) {
-        grid->data[i][j] = grid->noData;
+  if (TIFFIsTiled(tif)) {
+    // Only tiles read through a window are worth keeping
+    ReadTifTiles(file, tif, grid, firstCol, firstRow, lastCol, lastRow,
+                 window != NULL);
+  } else if (!window) {
+    for (long i = 0; i < grid->numRows; i++) {
+      if (TIFFReadScanline(tif, grid->data[i], (unsigned int)i, 1) == -1) {
+        for (long j = 0; j < grid->numCols; j++) {
+          grid->data[i][j] = grid->noData;
+        }
+      }
+    }
+  } else {
+    // Strips above the window are never decoded, the rows below it are
+    // never read
+    long windowCols = lastCol - firstCol + 1;
+    float *scanline = new float[width];
+    for (long i = firstRow; i <= lastRow; i++) {
+      float *row = grid->data[i - firstRow];
+      if (TIFFReadScanline(tif, scanline, (unsigned int)i, 1) == -1) {
+        for (long j = 0; j < windowCols; j++) {
+          row[j] = grid->noData;
+        }
+      } else {
+        memcpy(row, scanline + firstCol, sizeof(float) * windowCols);
       }
     }
+    delete[] scanline;
   }
 
   GTIFFree(gtif);
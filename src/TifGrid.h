@@ -2,9 +2,15 @@
 #define TIF_GRID_H
 
 #include "Grid.h"
+#include "GridPool.h"
 
 FloatGrid *ReadFloatTifGrid(const char *file);
 FloatGrid *ReadFloatTifGrid(const char *file, FloatGrid *incGrid);
+// Only decodes the rows covering window and only keeps its columns, see
+// FloatGrid::windowLeft. Reads the whole grid when window is NULL. The grid
+// comes from pool when there is one and goes back to it.
+FloatGrid *ReadFloatTifGridWindow(const char *file, const GridWindow *window,
+                                  GridPool *pool = NULL);
 void WriteFloatTifGrid(const char *file, FloatGrid *grid,
                        const char *artist = NULL, const char *datetime = NULL,
                        const char *copyright = NULL);
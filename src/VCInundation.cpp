@@ -7,18 +7,31 @@
 #include <stack>
 
 static bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc);
-static bool SortByHeight(GridNode *d1, GridNode *d2);
+
+// Orders nodes by the DEM height of their cells, lowest first
+struct SortByHeight {
+  std::vector<GridCell> *cells;
+  SortByHeight(std::vector<GridCell> *newCells) { cells = newCells; }
+  bool operator()(GridNode *d1, GridNode *d2) const {
+    GridCell *c1 = &cells->at(d1->index), *c2 = &cells->at(d2->index);
+    if (g_DEM->data[c1->y][c1->x] == g_DEM->data[c2->y][c2->x]) {
+      return d1->index < d2->index;
+    }
+    return g_DEM->data[c1->y][c1->x] < g_DEM->data[c2->y][c2->x];
+  }
+};
 
 VCInundation::VCInundation() {}
 
 VCInundation::~VCInundation() {}
 
 bool VCInundation::InitializeModel(
-    std::vector<GridNode> *newNodes,
+    std::vector<GridNode> *newNodes, std::vector<GridCell> *newCells,
     std::map<GaugeConfigSection *, float *> *paramSettings,
     std::vector<FloatGrid *> *paramGrids) {
 
   nodes = newNodes;
+  gridCells = newCells;
   if (iNodes.size() != nodes->size()) {
     iNodes.resize(nodes->size());
   }
@@ -56,11 +69,12 @@ void VCInundation::ComputeLayers(size_t nodeIndex, GridNode *node,
     // Lets figure out what flows into this node
     for (int i = 1; i < FLOW_QTY; i++) {
       GridLoc nextNode;
-      if (TestUpstream(currentN->x, currentN->y, (FLOW_DIR)i, &nextNode)) {
+      GridCell *currentC = &gridCells->at(currentN->index);
+      if (TestUpstream(currentC->x, currentC->y, (FLOW_DIR)i, &nextNode)) {
         GridNode *nextN = NULL;
         for (size_t nodeI = currentN->index; nodeI < nodes->size(); nodeI++) {
-          if (nodes->at(nodeI).x == nextNode.x &&
-              nodes->at(nodeI).y == nextNode.y) {
+          if (gridCells->at(nodeI).x == nextNode.x &&
+              gridCells->at(nodeI).y == nextNode.y) {
             nextN = &nodes->at(nodeI);
             break;
           }
@@ -72,15 +86,16 @@ void VCInundation::ComputeLayers(size_t nodeIndex, GridNode *node,
     }
   }
 
-  std::sort(upstreamNodes.begin(), upstreamNodes.end(), SortByHeight);
+  std::sort(upstreamNodes.begin(), upstreamNodes.end(),
+            SortByHeight(gridCells));
 
   int upstreamCount = (int)(upstreamNodes.size()) - 1;
   // printf("Found %i upstream cells for node %i, FAM is %f\n", upstreamCount,
   // (int)nodeIndex, g_FAM->data[node->y][node->x]);
   cNode->layers.reserve(upstreamNodes.size());
   for (int i = 0; i < upstreamCount; i++) {
-    GridNode *current = upstreamNodes[i];
-    GridNode *up = upstreamNodes[i + 1];
+    GridCell *current = &gridCells->at(upstreamNodes[i]->index);
+    GridCell *up = &gridCells->at(upstreamNodes[i + 1]->index);
     if (nodeIndex == 54) {
       printf("%i, %f\n", i, g_DEM->data[current->y][current->x]);
     }
@@ -99,12 +114,11 @@ void VCInundation::ComputeLayers(size_t nodeIndex, GridNode *node,
     cNode->layers.push_back(layer);
   }
 
-  float layerVolume =
-      upstreamNodes[0]->area * (upstreamNodes.size()) * 1000.0 * 1000000.0;
+  float bottomArea = gridCells->at(upstreamNodes[0]->index).area;
+  float layerVolume = bottomArea * (upstreamNodes.size()) * 1000.0 * 1000000.0;
   VCILayer *layer = new VCILayer;
   layer->totalVolume = layerVolume;
-  layer->totalArea =
-      upstreamNodes[0]->area * (upstreamNodes.size()) * 1000000.0;
+  layer->totalArea = bottomArea * (upstreamNodes.size()) * 1000000.0;
   layer->height = 1000.0;
   layer->toIndex = upstreamNodes.size();
   upstreamCount = (int)(upstreamNodes.size());
@@ -161,6 +175,7 @@ void VCInundation::InitializeParameters(
   size_t unused = 0;
   for (size_t i = 0; i < numNodes; i++) {
     GridNode *node = &nodes->at(i);
+    GridCell *cell = &gridCells->at(i);
     VCInundationGridNode *cNode = &(iNodes[i]);
     if (!node->gauge) {
       unused++;
@@ -175,12 +190,12 @@ void VCInundation::InitializeParameters(
     for (size_t paramI = 0; paramI < PARAM_VCI_QTY; paramI++) {
       FloatGrid *grid = paramGrids->at(paramI);
       if (grid && g_DEM->IsSpatialMatch(grid)) {
-        if (grid->data[node->y][node->x] == 0) {
-          grid->data[node->y][node->x] = 0.01;
+        if (grid->data[cell->y][cell->x] == 0) {
+          grid->data[cell->y][cell->x] = 0.01;
         }
-        cNode->params[paramI] *= grid->data[node->y][node->x];
+        cNode->params[paramI] *= grid->data[cell->y][cell->x];
       } else if (grid &&
-                 grid->GetGridLoc(node->refLoc.x, node->refLoc.y, &pt)) {
+                 grid->GetGridLoc(cell->refLoc.x, cell->refLoc.y, &pt)) {
         if (grid->data[pt.y][pt.x] == 0) {
           grid->data[pt.y][pt.x] = 0.01;
           // printf("Using nodata value in param %s\n",
@@ -192,13 +207,6 @@ void VCInundation::InitializeParameters(
   }
 }
 
-bool SortByHeight(GridNode *d1, GridNode *d2) {
-  if (g_DEM->data[d1->y][d1->x] == g_DEM->data[d2->y][d2->x]) {
-    return d1->index < d2->index;
-  }
-  return g_DEM->data[d1->y][d1->x] < g_DEM->data[d2->y][d2->x];
-}
-
 bool TestUpstream(long nextX, long nextY, FLOW_DIR dir, GridLoc *loc) {
   FLOW_DIR wantDir;
 
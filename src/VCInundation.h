@@ -22,6 +22,7 @@ public:
   VCInundation();
   ~VCInundation();
   bool InitializeModel(std::vector<GridNode> *newNodes,
+                       std::vector<GridCell> *newCells,
                        std::map<GaugeConfigSection *, float *> *paramSettings,
                        std::vector<FloatGrid *> *paramGrids);
   bool Inundation(std::vector<float> *discharge, std::vector<float> *depth);
@@ -35,6 +36,7 @@ private:
                      VCInundationGridNode *cNode);
 
   std::vector<GridNode> *nodes;
+  std::vector<GridCell> *gridCells;
   std::vector<VCInundationGridNode> iNodes;
 };
 
@@ -0,0 +1,197 @@
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#include "CRESTModel.h"
+#include "Defines.h"
+#include "GaugeConfigSection.h"
+#include "GridNode.h"
+#include "KernelPrecision.h"
+#include "Model.h"
+#include "ModelBase.h"
+#include "SAC.h"
+
+#define NUM_GRID_CELLS 50000
+#define NUM_GAUGES 4
+#define TOTAL_TIME_STEPS 400
+
+// Times the CREST and SAC water balance on a single thread over the same
+// cells and forcing and reports the cost of each cell step. The forcing has
+// dry spells, light rain and storms heavy enough to split SAC steps into
+// several increments, and the step length changes part way through. Built
+// with -DWBBENCH_COUNT it also reports the pow and exp calls of each model per
+// cell step, the times then include the counting. The counts are printed next
+// to those of the kernels before CREST and SAC were stored as struct of arrays,
+// measured over the same cells and forcing by counting the libm calls.
+
+struct BenchModel {
+  WaterBalanceModel *model;
+  std::map<GaugeConfigSection *, float *> paramSettings;
+  std::vector<FloatGrid *> paramGrids;
+  unsigned long powCalls, expCalls;
+};
+
+#ifdef WBBENCH_COUNT
+unsigned long g_kernelPowCalls = 0, g_kernelExpCalls = 0;
+#endif
+
+std::vector<GridNode> nodes;
+std::vector<GridCell> gridCells;
+std::vector<float> precip, pet;
+GaugeConfigSection *gauges[NUM_GAUGES];
+float crestParams[NUM_GAUGES][PARAM_CREST_QTY];
+float sacParams[NUM_GAUGES][PARAM_SAC_QTY];
+
+static float RandomRange(float low, float high) {
+  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+}
+
+void MakeCells() {
+  char gaugeName[20];
+  for (int g = 0; g < NUM_GAUGES; g++) {
+    sprintf(gaugeName, "%06i", g + 1);
+    gauges[g] = new GaugeConfigSection(gaugeName);
+
+    float *p = crestParams[g];
+    p[PARAM_CREST_WM] = 100.0 + 40.0 * g;
+    p[PARAM_CREST_B] = 0.5 + 0.3 * g;
+    p[PARAM_CREST_IM] = 2.0 + g;
+    p[PARAM_CREST_KE] = 0.8 + 0.1 * g;
+    p[PARAM_CREST_FC] = 5.0 + 5.0 * g;
+    p[PARAM_CREST_IWU] = 30.0 + 10.0 * g;
+
+    p = sacParams[g];
+    p[PARAM_SAC_UZTWM] = 50.0 + 20.0 * g;
+    p[PARAM_SAC_UZFWM] = 20.0 + 10.0 * g;
+    p[PARAM_SAC_UZK] = 0.3 + 0.05 * g;
+    p[PARAM_SAC_PCTIM] = 0.01 * g;
+    p[PARAM_SAC_ADIMP] = 0.05 + 0.02 * g;
+    p[PARAM_SAC_RIVA] = 0.01;
+    p[PARAM_SAC_ZPERC] = 40.0 + 20.0 * g;
+    p[PARAM_SAC_REXP] = 1.5 + 0.5 * g;
+    p[PARAM_SAC_LZTWM] = 100.0 + 50.0 * g;
+    p[PARAM_SAC_LZFSM] = 20.0 + 10.0 * g;
+    p[PARAM_SAC_LZFPM] = 50.0 + 30.0 * g;
+    p[PARAM_SAC_LZSK] = 0.05 + 0.03 * g;
+    p[PARAM_SAC_LZPK] = 0.005 + 0.003 * g;
+    p[PARAM_SAC_PFREE] = 0.1 + 0.1 * g;
+    p[PARAM_SAC_SIDE] = 0.0;
+    p[PARAM_SAC_RSERV] = 0.3;
+    p[PARAM_SAC_UZTWC] = 0.5;
+    p[PARAM_SAC_UZFWC] = 0.2;
+    p[PARAM_SAC_ADIMC] = 10.0;
+    p[PARAM_SAC_LZTWC] = 0.5;
+    p[PARAM_SAC_LZFSC] = 0.3;
+    p[PARAM_SAC_LZFPC] = 0.4;
+  }
+
+  nodes.resize(NUM_GRID_CELLS);
+  gridCells.resize(NUM_GRID_CELLS);
+  for (int i = 0; i < NUM_GRID_CELLS; i++) {
+    nodes[i].index = i;
+    gridCells[i].x = i;
+    gridCells[i].y = 0;
+    nodes[i].downStreamNode = INVALID_DOWNSTREAM_NODE;
+    nodes[i].gauge = gauges[i % NUM_GAUGES];
+  }
+
+  // Storms pass over part of the domain every so often, it is dry or
+  // drizzling elsewhere
+  srand(1);
+  precip.resize((size_t)NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  pet.resize((size_t)NUM_GRID_CELLS * TOTAL_TIME_STEPS);
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    bool storm = (t % 50) < 10;
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      size_t index = (size_t)t * NUM_GRID_CELLS + i;
+      float chance = (float)rand() / (float)RAND_MAX;
+      if (storm && i < NUM_GRID_CELLS / 3) {
+        precip[index] = RandomRange(2.0, 25.0);
+      } else if (chance < 0.2) {
+        precip[index] = RandomRange(0.0, 2.0);
+      } else {
+        precip[index] = 0.0;
+      }
+      pet[index] = RandomRange(0.0, 0.3);
+    }
+  }
+}
+
+double TimeModel(BenchModel *bench) {
+#ifdef WBBENCH_COUNT
+  g_kernelPowCalls = 0;
+  g_kernelExpCalls = 0;
+#endif
+  bench->model->InitializeModel(&nodes, &gridCells, &(bench->paramSettings),
+                                &(bench->paramGrids));
+
+  std::vector<float> stepPrecip(NUM_GRID_CELLS), stepPET(NUM_GRID_CELLS);
+  std::vector<float> fastFlow(NUM_GRID_CELLS), slowFlow(NUM_GRID_CELLS),
+      soilMoisture(NUM_GRID_CELLS);
+  double seconds = 0.0;
+  for (int t = 0; t < TOTAL_TIME_STEPS; t++) {
+    float stepHours = (t < TOTAL_TIME_STEPS / 2) ? 1.0 : 3.0;
+    for (int i = 0; i < NUM_GRID_CELLS; i++) {
+      stepPrecip[i] = precip[(size_t)t * NUM_GRID_CELLS + i];
+      stepPET[i] = pet[(size_t)t * NUM_GRID_CELLS + i];
+      fastFlow[i] = 0.0;
+      slowFlow[i] = 0.0;
+    }
+    clock_t start = clock();
+    bench->model->WaterBalance(stepHours, &stepPrecip, &stepPET, &fastFlow,
+                               &slowFlow, &soilMoisture);
+    seconds += (double)(clock() - start) / CLOCKS_PER_SEC;
+  }
+#ifdef WBBENCH_COUNT
+  bench->powCalls = g_kernelPowCalls;
+  bench->expCalls = g_kernelExpCalls;
+#endif
+  return seconds;
+}
+
+int main(int argc, char *argv[]) {
+#if _OPENMP
+  omp_set_num_threads(1);
+#endif
+
+  MakeCells();
+
+  BenchModel crest, sac;
+  crest.model = new CRESTModel();
+  sac.model = new SAC();
+  for (int g = 0; g < NUM_GAUGES; g++) {
+    crest.paramSettings[gauges[g]] = crestParams[g];
+    sac.paramSettings[gauges[g]] = sacParams[g];
+  }
+  for (int p = 0; p < PARAM_CREST_QTY; p++) {
+    crest.paramGrids.push_back(NULL);
+  }
+  for (int p = 0; p < PARAM_SAC_QTY; p++) {
+    sac.paramGrids.push_back(NULL);
+  }
+
+  double cellSteps = (double)NUM_GRID_CELLS * TOTAL_TIME_STEPS;
+  double crestTime = TimeModel(&crest);
+  double sacTime = TimeModel(&sac);
+  printf("Ran %i cells for %i steps\n", NUM_GRID_CELLS, TOTAL_TIME_STEPS);
+  printf("CREST: %.3f s, %.1f ns per cell step\n", crestTime,
+         crestTime * 1e9 / cellSteps);
+  printf("SAC: %.3f s, %.1f ns per cell step\n", sacTime,
+         sacTime * 1e9 / cellSteps);
+#ifdef WBBENCH_COUNT
+  BenchModel *models[] = {&crest, &sac};
+  const char *names[] = {"CREST", "SAC"};
+  const double originalPow[] = {0.597, 4.863}, originalExp[] = {0.0, 0.0};
+  for (int m = 0; m < 2; m++) {
+    printf("%s: %.3f pow and %.3f exp calls per cell step, the original "
+           "kernel made %.3f and %.3f\n",
+           names[m], models[m]->powCalls / cellSteps,
+           models[m]->expCalls / cellSteps, originalPow[m], originalExp[m]);
+  }
+#endif
+
+  return 0;
+}